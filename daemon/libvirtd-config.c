@@ -187,6 +187,31 @@ static int remoteConfigGetAuth(virConfPtr conf, const char *key, int *auth, cons
     return 0;
 }
 
+static int
+remoteConfigGetClientWeight(virConfPtr conf, const char *key, int *weight,
+                            const char *filename)
+{
+    virConfValuePtr p;
+
+    p = virConfGetValue(conf, key);
+    if (!p)
+        return 0;
+
+    if (checkType(p, filename, key, VIR_CONF_LONG) < 0)
+        return -1;
+
+    if (p->l < 1 || p->l > VIR_NET_SERVER_CLIENT_WEIGHT_MAX) {
+        virReportError(VIR_ERR_CONFIG_UNSUPPORTED,
+                       _("remoteReadConfigFile: %s: %s: weight %ld is not "
+                         "between 1 and %d"),
+                       filename, key, p->l, VIR_NET_SERVER_CLIENT_WEIGHT_MAX);
+        return -1;
+    }
+
+    *weight = p->l;
+    return 0;
+}
+
 int
 daemonConfigFilePath(bool privileged, char **configfile)
 {
@@ -265,6 +290,11 @@ daemonConfigNew(bool privileged ATTRIBUTE_UNUSED)
     data->max_requests = 20;
     data->max_client_requests = 5;
 
+    data->client_weight_readonly = 1;
+    data->client_weight_readwrite = 1;
+    data->client_weight_local = 1;
+    data->client_weight_remote = 1;
+
     data->log_buffer_size = 64;
 
     data->audit_level = 1;
@@ -421,6 +451,20 @@ daemonConfigLoadOptions(struct daemonConfig *data,
     GET_CONF_INT(conf, filename, max_requests);
     GET_CONF_INT(conf, filename, max_client_requests);
 
+    if (remoteConfigGetClientWeight(conf, "client_weight_readonly",
+                                    &data->client_weight_readonly,
+                                    filename) < 0 ||
+        remoteConfigGetClientWeight(conf, "client_weight_readwrite",
+                                    &data->client_weight_readwrite,
+                                    filename) < 0 ||
+        remoteConfigGetClientWeight(conf, "client_weight_local",
+                                    &data->client_weight_local,
+                                    filename) < 0 ||
+        remoteConfigGetClientWeight(conf, "client_weight_remote",
+                                    &data->client_weight_remote,
+                                    filename) < 0)
+        goto error;
+
     GET_CONF_INT(conf, filename, audit_level);
     GET_CONF_INT(conf, filename, audit_logging);
 
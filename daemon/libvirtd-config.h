@@ -70,6 +70,11 @@ struct daemonConfig {
     int max_requests;
     int max_client_requests;
 
+    int client_weight_readonly;
+    int client_weight_readwrite;
+    int client_weight_local;
+    int client_weight_remote;
+
     int log_level;
     char *log_filters;
     char *log_outputs;
@@ -53,6 +53,7 @@
 #include "virhook.h"
 #include "viraudit.h"
 #include "virstring.h"
+#include "virobject.h"
 #include "locking/lock_manager.h"
 #include "viraccessmanager.h"
 
@@ -808,6 +809,23 @@ static void daemonReloadHandler(virNetServerPtr srv ATTRIBUTE_UNUSED,
             VIR_WARN("Error while reloading drivers");
 }
 
+static void daemonObjectStatsHandler(virNetServerPtr srv ATTRIBUTE_UNUSED,
+                                     siginfo_t *sig ATTRIBUTE_UNUSED,
+                                     void *opaque ATTRIBUTE_UNUSED)
+{
+    virBuffer buf = VIR_BUFFER_INITIALIZER;
+    char *stats;
+
+    virObjectStatsFormat(&buf);
+    if (!(stats = virBufferContentAndReset(&buf))) {
+        VIR_WARN("Unable to format object statistics");
+        return;
+    }
+
+    VIR_INFO("Object statistics on SIGUSR2:\n%s", stats);
+    VIR_FREE(stats);
+}
+
 static int daemonSetupSignals(virNetServerPtr srv)
 {
     if (virNetServerAddSignalHandler(srv, SIGINT, daemonShutdownHandler, NULL) < 0)
@@ -818,6 +836,8 @@ static int daemonSetupSignals(virNetServerPtr srv)
         return -1;
     if (virNetServerAddSignalHandler(srv, SIGHUP, daemonReloadHandler, NULL) < 0)
         return -1;
+    if (virNetServerAddSignalHandler(srv, SIGUSR2, daemonObjectStatsHandler, NULL) < 0)
+        return -1;
     return 0;
 }
 
@@ -1388,6 +1408,12 @@ int main(int argc, char **argv) {
         goto cleanup;
     }
 
+    virNetServerSetClientWeights(srv,
+                                 config->client_weight_readonly,
+                                 config->client_weight_readwrite,
+                                 config->client_weight_local,
+                                 config->client_weight_remote);
+
     /* Beyond this point, nothing should rely on using
      * getuid/geteuid() == 0, for privilege level checks.
      */
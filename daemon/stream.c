@@ -151,11 +151,15 @@ daemonStreamEvent(virStreamPtr st, int events, void *opaque)
         /* If we detected EOF during read processing,
          * then clear hangup/error conditions, since
          * we want the client to see the EOF message
-         * we just sent them
+         * we just sent them. Otherwise data may still
+         * be pending behind the hangup: it is reported
+         * again once we are done reading it.
          */
         if (stream->recvEOF)
             events = events & ~(VIR_STREAM_EVENT_HANGUP |
                                 VIR_STREAM_EVENT_ERROR);
+        else
+            events = events & ~(VIR_STREAM_EVENT_HANGUP);
     }
 
     /* If we have a completion/abort message, always process it */
@@ -281,7 +285,8 @@ daemonStreamFilter(virNetServerClientPtr client ATTRIBUTE_UNUSED,
 
     virMutexLock(&stream->priv->lock);
 
-    if (msg->header.type != VIR_NET_STREAM)
+    if (msg->header.type != VIR_NET_STREAM &&
+        msg->header.type != VIR_NET_STREAM_HOLE)
         goto cleanup;
 
     if (!virNetServerProgramMatches(stream->prog, msg))
@@ -548,6 +553,54 @@ daemonStreamHandleWriteData(virNetServerClientPtr client,
 }
 
 
+/*
+ * Skips a hole in the stream data sent by the client.
+ *
+ * Returns:
+ *   -1  if fatal error occurred
+ *    0  if message was fully processed
+ *    1  if message is still being processed
+ */
+static int
+daemonStreamHandleHole(virNetServerClientPtr client,
+                       daemonClientStream *stream,
+                       virNetMessagePtr msg)
+{
+    virNetStreamHole data;
+    int ret;
+
+    VIR_DEBUG("client=%p, stream=%p, proc=%d, serial=%d",
+              client, stream, msg->header.proc, msg->header.serial);
+
+    memset(&data, 0, sizeof(data));
+
+    if (virNetMessageDecodePayload(msg, (xdrproc_t)xdr_virNetStreamHole,
+                                   &data) < 0)
+        ret = -1;
+    else
+        ret = virStreamSendHole(stream->st, data.length, data.flags);
+
+    if (ret == -2) {
+        /* Blocking, so indicate we have more todo later */
+        return 1;
+    } else if (ret < 0) {
+        virNetMessageError rerr;
+
+        memset(&rerr, 0, sizeof(rerr));
+
+        VIR_INFO("Stream hole failed");
+        stream->closed = 1;
+        return virNetServerProgramSendReplyError(stream->prog,
+                                                 client,
+                                                 msg,
+                                                 &rerr,
+                                                 &msg->header);
+    }
+
+    return 0;
+}
+
+
 /*
  * Process a finish handshake from the client.
  *
@@ -652,7 +705,10 @@ daemonStreamHandleWrite(virNetServerClientPtr client,
             break;
 
         case VIR_NET_CONTINUE:
-            ret = daemonStreamHandleWriteData(client, stream, msg);
+            if (msg->header.type == VIR_NET_STREAM_HOLE)
+                ret = daemonStreamHandleHole(client, stream, msg);
+            else
+                ret = daemonStreamHandleWriteData(client, stream, msg);
             break;
 
         case VIR_NET_ERROR:
@@ -696,7 +752,8 @@ daemonStreamHandleWrite(virNetServerClientPtr client,
 /*
  * Invoked when a stream is signalled as having data
  * available to read. This reads up to one message
- * worth of data, and then queues that for transmission
+ * worth of data, or a hole in the data of a sparse
+ * stream, and then queues that for transmission
  * to the client.
  *
  * Returns 0 if data was queued for TX, or a error RPC
@@ -709,6 +766,7 @@ daemonStreamHandleRead(virNetServerClientPtr client,
 {
     char *buffer;
     size_t bufferLen = VIR_NET_MESSAGE_LEGACY_PAYLOAD_MAX;
+    long long length;
     int ret;
 
     VIR_DEBUG("client=%p, stream=%p tx=%d closed=%d",
@@ -729,8 +787,30 @@ daemonStreamHandleRead(virNetServerClientPtr client,
     if (VIR_ALLOC_N(buffer, bufferLen) < 0)
         return -1;
 
-    ret = virStreamRecv(stream->st, buffer, bufferLen);
-    if (ret == -2) {
+    /* Streams which aren't sparse never stop at a hole */
+    ret = virStreamRecvFlags(stream->st, buffer, bufferLen,
+                             VIR_STREAM_RECV_STOP_AT_HOLE);
+    if (ret == -3 &&
+        virStreamRecvHole(stream->st, &length, 0) < 0)
+        ret = -1;
+
+    if (ret == -3) {
+        virNetMessagePtr msg;
+        stream->tx = 0;
+        if (!(msg = virNetMessageNew(false))) {
+            ret = -1;
+        } else {
+            msg->cb = daemonStreamMessageFinished;
+            msg->opaque = stream;
+            stream->refs++;
+            ret = virNetServerProgramSendStreamHole(remoteProgram,
+                                                    client,
+                                                    msg,
+                                                    stream->procedure,
+                                                    stream->serial,
+                                                    length, 0);
+        }
+    } else if (ret == -2) {
         /* Should never get this, since we're only called when we know
          * we're readable, but hey things change... */
         ret = 0;
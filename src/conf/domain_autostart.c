@@ -0,0 +1,333 @@
+/*
+ * domain_autostart.c: scheduling of domain autostart
+ *
+ * Copyright (C) 2014 Red Hat, Inc.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library.  If not, see
+ * <http://www.gnu.org/licenses/>.
+ */
+
+#include <config.h>
+
+#include <fnmatch.h>
+
+#include "domain_autostart.h"
+#include "viralloc.h"
+#include "virerror.h"
+#include "virlog.h"
+#include "virstring.h"
+#include "virthread.h"
+#include "virthreadpool.h"
+#include "virtime.h"
+
+#define VIR_FROM_THIS VIR_FROM_DOMAIN
+
+typedef struct _virDomainAutostartJob virDomainAutostartJob;
+typedef virDomainAutostartJob *virDomainAutostartJobPtr;
+struct _virDomainAutostartJob {
+    virDomainObjPtr vm;
+    char *name;
+    size_t group;
+    size_t order;
+    unsigned long long memory; /* KiB */
+};
+
+typedef struct _virDomainAutostartState virDomainAutostartState;
+typedef virDomainAutostartState *virDomainAutostartStatePtr;
+struct _virDomainAutostartState {
+    virMutex lock;
+    virCond cond;
+
+    virDomainAutostartCallback callback;
+    virDomainAutostartMemoryCallback memoryCallback;
+    void *opaque;
+
+    char **groups;
+    size_t ngroups;
+
+    virDomainAutostartJobPtr jobs;
+    size_t njobs;
+
+    size_t running;
+    size_t done;
+    size_t failed;
+    /* Memory of the domains currently being started, in KiB */
+    unsigned long long pendingMemory;
+    unsigned long long reservedMemory;
+    bool noMemoryStats;
+};
+
+
+static size_t
+virDomainAutostartGroup(virDomainAutostartStatePtr state,
+                        const char *name)
+{
+    size_t i;
+
+    for (i = 0; i < state->ngroups; i++) {
+        if (fnmatch(state->groups[i], name, 0) == 0)
+            return i;
+    }
+
+    return state->ngroups;
+}
+
+
+static int
+virDomainAutostartCollect(virDomainObjPtr vm,
+                          void *opaque)
+{
+    virDomainAutostartStatePtr state = opaque;
+    virDomainAutostartJob job = { NULL, NULL, 0, 0, 0 };
+    int ret = -1;
+
+    virObjectLock(vm);
+    if (!vm->autostart || virDomainObjIsActive(vm)) {
+        ret = 0;
+        goto cleanup;
+    }
+
+    if (VIR_STRDUP(job.name, vm->def->name) < 0)
+        goto cleanup;
+    job.vm = virObjectRef(vm);
+    job.group = virDomainAutostartGroup(state, job.name);
+    job.order = state->njobs;
+    job.memory = vm->def->mem.max_balloon;
+
+    if (VIR_APPEND_ELEMENT(state->jobs, state->njobs, job) < 0) {
+        virObjectUnref(job.vm);
+        VIR_FREE(job.name);
+        goto cleanup;
+    }
+
+    ret = 0;
+cleanup:
+    virObjectUnlock(vm);
+    return ret;
+}
+
+
+static int
+virDomainAutostartCompare(const void *a,
+                          const void *b)
+{
+    const virDomainAutostartJob *ja = a;
+    const virDomainAutostartJob *jb = b;
+
+    if (ja->group != jb->group)
+        return ja->group < jb->group ? -1 : 1;
+    if (ja->order != jb->order)
+        return ja->order < jb->order ? -1 : 1;
+    return 0;
+}
+
+
+/* Called with state->lock held */
+static bool
+virDomainAutostartHaveMemory(virDomainAutostartStatePtr state,
+                             virDomainAutostartJobPtr job)
+{
+    unsigned long long avail = 0;
+
+    if (!state->memoryCallback || state->noMemoryStats)
+        return true;
+
+    if ((state->memoryCallback)(&avail) < 0) {
+        virErrorPtr err = virGetLastError();
+        VIR_WARN("Unable to get host memory statistics, "
+                 "autostart will not wait for free memory: %s",
+                 err ? err->message : _("unknown error"));
+        virResetLastError();
+        state->noMemoryStats = true;
+        return true;
+    }
+
+    /* Guests allocate their memory lazily, so the domains that are
+     * still starting are not accounted for by the host yet */
+    if (avail > state->pendingMemory)
+        avail -= state->pendingMemory;
+    else
+        avail = 0;
+
+    if (avail < job->memory + state->reservedMemory) {
+        VIR_DEBUG("Delaying start of domain '%s': %lluKiB available, "
+                  "%lluKiB needed", job->name, avail,
+                  job->memory + state->reservedMemory);
+        return false;
+    }
+
+    return true;
+}
+
+
+static void
+virDomainAutostartWorker(void *jobdata,
+                         void *opaque)
+{
+    virDomainAutostartJobPtr job = jobdata;
+    virDomainAutostartStatePtr state = opaque;
+    int rc;
+
+    rc = (state->callback)(job->vm, state->opaque);
+
+    virMutexLock(&state->lock);
+    state->running--;
+    state->pendingMemory -= job->memory;
+    state->done++;
+    if (rc < 0)
+        state->failed++;
+    VIR_INFO("Autostart of domain '%s' %s, %zu of %zu done, %zu failed",
+             job->name, rc < 0 ? "failed" : "finished",
+             state->done, state->njobs, state->failed);
+    virCondBroadcast(&state->cond);
+    virMutexUnlock(&state->lock);
+}
+
+
+/**
+ * virDomainAutostartRun:
+ * @doms: list of domains
+ * @maxConcurrent: how many domains may be starting at once
+ * @reservedMemory: host memory in KiB to keep free, on top of the
+ *                  memory of the domain being started
+ * @memoryCallback: function getting the host memory available to
+ *                  domains, or NULL to not wait for memory
+ * @groups: NULL terminated list of patterns, or NULL
+ * @callback: function starting a single domain
+ * @opaque: data for @callback
+ *
+ * Start all inactive domains of @doms which are marked for autostart.
+ *
+ * Domains are ordered by the first pattern of @groups matching their
+ * name, and domains matching no pattern come last. A group only begins
+ * once every domain of the previous group finished starting. Within a
+ * group up to @maxConcurrent domains are started in parallel. While
+ * others are still starting, a domain is held back until the host has
+ * enough free memory for it.
+ *
+ * With @maxConcurrent of 0 or 1, domains are started one after another
+ * in the calling thread.
+ *
+ * Returns the number of domains which failed to start, or -1 on error.
+ */
+int
+virDomainAutostartRun(virDomainObjListPtr doms,
+                      unsigned int maxConcurrent,
+                      unsigned long long reservedMemory,
+                      virDomainAutostartMemoryCallback memoryCallback,
+                      char **groups,
+                      virDomainAutostartCallback callback,
+                      void *opaque)
+{
+    virDomainAutostartState state;
+    virThreadPoolPtr pool = NULL;
+    unsigned long long then = 0;
+    unsigned long long now = 0;
+    size_t group = 0;
+    size_t i;
+    int ret = -1;
+
+    memset(&state, 0, sizeof(state));
+    state.callback = callback;
+    state.opaque = opaque;
+    state.groups = groups;
+    state.ngroups = groups ? virStringListLength(groups) : 0;
+    state.reservedMemory = reservedMemory;
+    state.memoryCallback = memoryCallback;
+
+    if (virMutexInit(&state.lock) < 0) {
+        virReportSystemError(errno, "%s",
+                             _("cannot initialize mutex"));
+        return -1;
+    }
+    if (virCondInit(&state.cond) < 0) {
+        virReportSystemError(errno, "%s",
+                             _("cannot initialize condition variable"));
+        virMutexDestroy(&state.lock);
+        return -1;
+    }
+
+    if (virDomainObjListForEach(doms, virDomainAutostartCollect, &state) < 0)
+        goto cleanup;
+
+    if (state.njobs == 0) {
+        ret = 0;
+        goto cleanup;
+    }
+
+    qsort(state.jobs, state.njobs, sizeof(*state.jobs),
+          virDomainAutostartCompare);
+
+    if (maxConcurrent > 1 &&
+        !(pool = virThreadPoolNew(0, maxConcurrent, 0,
+                                  virDomainAutostartWorker, &state)))
+        goto cleanup;
+
+    ignore_value(virTimeMillisNow(&then));
+    VIR_INFO("Autostarting %zu domains, up to %u at once",
+             state.njobs, pool ? maxConcurrent : 1);
+
+    for (i = 0; i < state.njobs; i++) {
+        virDomainAutostartJobPtr job = &state.jobs[i];
+
+        virMutexLock(&state.lock);
+        while (state.running > 0 &&
+               (state.running >= maxConcurrent ||
+                job->group != group ||
+                !virDomainAutostartHaveMemory(&state, job))) {
+            if (virCondWait(&state.cond, &state.lock) < 0) {
+                virReportSystemError(errno, "%s",
+                                     _("cannot wait on condition"));
+                virMutexUnlock(&state.lock);
+                goto cleanup;
+            }
+        }
+        group = job->group;
+        state.running++;
+        state.pendingMemory += job->memory;
+        virMutexUnlock(&state.lock);
+
+        if (!pool || virThreadPoolSendJob(pool, 0, job) < 0)
+            virDomainAutostartWorker(job, &state);
+    }
+
+    ret = 0;
+
+cleanup:
+    /* Let the jobs already handed over to the pool finish */
+    virMutexLock(&state.lock);
+    while (state.running > 0) {
+        if (virCondWait(&state.cond, &state.lock) < 0)
+            break;
+    }
+    virMutexUnlock(&state.lock);
+    virThreadPoolFree(pool);
+
+    if (ret == 0) {
+        ignore_value(virTimeMillisNow(&now));
+        if (state.njobs)
+            VIR_INFO("Autostart of %zu domains done in %llums, %zu failed",
+                     state.njobs, now - then, state.failed);
+        ret = state.failed;
+    }
+
+    for (i = 0; i < state.njobs; i++) {
+        virObjectUnref(state.jobs[i].vm);
+        VIR_FREE(state.jobs[i].name);
+    }
+    VIR_FREE(state.jobs);
+    virCondDestroy(&state.cond);
+    virMutexDestroy(&state.lock);
+    return ret;
+}
@@ -0,0 +1,56 @@
+/*
+ * domain_autostart.h: scheduling of domain autostart
+ *
+ * Copyright (C) 2014 Red Hat, Inc.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library.  If not, see
+ * <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef __VIR_DOMAIN_AUTOSTART_H__
+# define __VIR_DOMAIN_AUTOSTART_H__
+
+# include "domain_conf.h"
+
+/**
+ * virDomainAutostartCallback:
+ * @vm: unlocked domain object, referenced for the duration of the call
+ * @opaque: data passed to virDomainAutostartRun
+ *
+ * Start @vm. The callback is responsible for locking @vm and for
+ * checking it still needs to be started.
+ *
+ * Returns 0 on success or if nothing was done, -1 if the start failed.
+ */
+typedef int (*virDomainAutostartCallback)(virDomainObjPtr vm,
+                                          void *opaque);
+
+/**
+ * virDomainAutostartMemoryCallback:
+ * @avail: filled with the host memory available to domains, in KiB
+ *
+ * Returns 0 on success, -1 with an error reported otherwise.
+ */
+typedef int (*virDomainAutostartMemoryCallback)(unsigned long long *avail);
+
+int virDomainAutostartRun(virDomainObjListPtr doms,
+                          unsigned int maxConcurrent,
+                          unsigned long long reservedMemory,
+                          virDomainAutostartMemoryCallback memoryCallback,
+                          char **groups,
+                          virDomainAutostartCallback callback,
+                          void *opaque)
+    ATTRIBUTE_NONNULL(1) ATTRIBUTE_NONNULL(6);
+
+#endif /* __VIR_DOMAIN_AUTOSTART_H__ */
@@ -17714,6 +17714,10 @@ virDomainDefFormat(virDomainDefPtr def, unsigned int flags)
     virBuffer buf = VIR_BUFFER_INITIALIZER;
 
     virCheckFlags(DUMPXML_FLAGS, NULL);
+
+    /* most domain XML documents fit, which saves growing the buffer */
+    virBufferReserve(&buf, 8192);
+
     if (virDomainDefFormatInternal(def, flags, &buf) < 0)
         return NULL;
 
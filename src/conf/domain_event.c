@@ -192,10 +192,11 @@ virDomainEventsOnceInit(void)
                       virDomainEventDispose)))
         return -1;
     if (!(virDomainEventLifecycleClass =
-          virClassNew(virDomainEventClass,
-                      "virDomainEventLifecycle",
-                      sizeof(virDomainEventLifecycle),
-                      virDomainEventLifecycleDispose)))
+          virClassNewPooled(virDomainEventClass,
+                            "virDomainEventLifecycle",
+                            sizeof(virDomainEventLifecycle),
+                            virDomainEventLifecycleDispose,
+                            32)))
         return -1;
     if (!(virDomainEventRTCChangeClass =
           virClassNew(virDomainEventClass,
@@ -1183,8 +1183,20 @@ int virInterfaceFindByMACString(virInterfaceObjListPtr interfaces,
 virInterfaceObjPtr virInterfaceFindByName(virInterfaceObjListPtr interfaces,
                                           const char *name)
 {
+    virInterfaceObjPtr iface;
     size_t i;
 
+    if (virObjectIndexIsValid(&interfaces->index)) {
+        if (!(iface = virObjectIndexFindByName(&interfaces->index, name)))
+            return NULL;
+
+        virInterfaceObjLock(iface);
+        if (STREQ(iface->def->name, name))
+            return iface;
+        virInterfaceObjUnlock(iface);
+        return NULL;
+    }
+
     for (i = 0; i < interfaces->count; i++) {
         virInterfaceObjLock(interfaces->objs[i]);
         if (STREQ(interfaces->objs[i]->def->name, name))
@@ -1204,6 +1216,7 @@ void virInterfaceObjListFree(virInterfaceObjListPtr interfaces)
 
     VIR_FREE(interfaces->objs);
     interfaces->count = 0;
+    virObjectIndexClear(&interfaces->index);
 }
 
 int virInterfaceObjListClone(virInterfaceObjListPtr src,
@@ -1273,6 +1286,8 @@ virInterfaceObjPtr virInterfaceAssignDef(virInterfaceObjListPtr interfaces,
         return NULL;
     }
 
+    virObjectIndexAdd(&interfaces->index, interfaces->count,
+                      NULL, def->name, iface);
     interfaces->objs[interfaces->count] = iface;
     interfaces->count++;
 
@@ -1289,6 +1304,8 @@ void virInterfaceRemove(virInterfaceObjListPtr interfaces,
     for (i = 0; i < interfaces->count; i++) {
         virInterfaceObjLock(interfaces->objs[i]);
         if (interfaces->objs[i] == iface) {
+            virObjectIndexRemove(&interfaces->index,
+                                 NULL, iface->def->name, iface);
             virInterfaceObjUnlock(interfaces->objs[i]);
             virInterfaceObjFree(interfaces->objs[i]);
 
@@ -31,6 +31,7 @@
 # include "internal.h"
 # include "virutil.h"
 # include "virthread.h"
+# include "virobjectindex.h"
 
 /* There is currently 3 types of interfaces */
 
@@ -173,6 +174,7 @@ typedef virInterfaceObjList *virInterfaceObjListPtr;
 struct _virInterfaceObjList {
     unsigned int count;
     virInterfaceObjPtr *objs;
+    virObjectIndex index;
 };
 
 static inline bool
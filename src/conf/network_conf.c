@@ -91,8 +91,20 @@ virNetworkObjTaint(virNetworkObjPtr obj,
 virNetworkObjPtr virNetworkFindByUUID(virNetworkObjListPtr nets,
                                       const unsigned char *uuid)
 {
+    virNetworkObjPtr net;
     size_t i;
 
+    if (virObjectIndexIsValid(&nets->index)) {
+        if (!(net = virObjectIndexFindByUUID(&nets->index, uuid)))
+            return NULL;
+
+        virNetworkObjLock(net);
+        if (!memcmp(net->def->uuid, uuid, VIR_UUID_BUFLEN))
+            return net;
+        virNetworkObjUnlock(net);
+        return NULL;
+    }
+
     for (i = 0; i < nets->count; i++) {
         virNetworkObjLock(nets->objs[i]);
         if (!memcmp(nets->objs[i]->def->uuid, uuid, VIR_UUID_BUFLEN))
@@ -106,8 +118,20 @@ virNetworkObjPtr virNetworkFindByUUID(virNetworkObjListPtr nets,
 virNetworkObjPtr virNetworkFindByName(virNetworkObjListPtr nets,
                                       const char *name)
 {
+    virNetworkObjPtr net;
     size_t i;
 
+    if (virObjectIndexIsValid(&nets->index)) {
+        if (!(net = virObjectIndexFindByName(&nets->index, name)))
+            return NULL;
+
+        virNetworkObjLock(net);
+        if (STREQ(net->def->name, name))
+            return net;
+        virNetworkObjUnlock(net);
+        return NULL;
+    }
+
     for (i = 0; i < nets->count; i++) {
         virNetworkObjLock(nets->objs[i]);
         if (STREQ(nets->objs[i]->def->name, name))
@@ -297,6 +321,7 @@ void virNetworkObjListFree(virNetworkObjListPtr nets)
 
     VIR_FREE(nets->objs);
     nets->count = 0;
+    virObjectIndexClear(&nets->index);
 }
 
 /*
@@ -369,6 +394,9 @@ virNetworkAssignDef(virNetworkObjListPtr nets,
             virNetworkObjUnlock(network);
             return NULL;
         }
+        /* The name matched, but make sure a changed UUID is found too */
+        virObjectIndexAdd(&nets->index, nets->count,
+                          network->def->uuid, network->def->name, network);
         return network;
     }
 
@@ -395,6 +423,8 @@ virNetworkAssignDef(virNetworkObjListPtr nets,
     ignore_value(virBitmapSetBit(network->class_id, 2));
 
     network->def = def;
+    virObjectIndexAdd(&nets->index, nets->count,
+                      def->uuid, def->name, network);
     nets->objs[nets->count] = network;
     nets->count++;
 
@@ -573,6 +603,8 @@ void virNetworkRemoveInactive(virNetworkObjListPtr nets,
     for (i = 0; i < nets->count; i++) {
         virNetworkObjLock(nets->objs[i]);
         if (nets->objs[i] == net) {
+            virObjectIndexRemove(&nets->index,
+                                 net->def->uuid, net->def->name, net);
             virNetworkObjUnlock(nets->objs[i]);
             virNetworkObjFree(nets->objs[i]);
 
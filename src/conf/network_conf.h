@@ -39,6 +39,7 @@
 # include "virmacaddr.h"
 # include "device_conf.h"
 # include "virbitmap.h"
+# include "virobjectindex.h"
 
 enum virNetworkForwardType {
     VIR_NETWORK_FORWARD_NONE   = 0,
@@ -296,6 +297,7 @@ typedef virNetworkObjList *virNetworkObjListPtr;
 struct _virNetworkObjList {
     unsigned int count;
     virNetworkObjPtr *objs;
+    virObjectIndex index;
 };
 
 enum virNetworkTaintFlags {
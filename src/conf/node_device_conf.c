@@ -84,12 +84,67 @@ int virNodeDeviceHasCap(const virNodeDeviceObj *dev, const char *cap)
 }
 
 
+/*
+ * Devices are indexed by name and, in a second index, by sysfs path.
+ * Should several devices share a sysfs path, only the one which got
+ * it first is indexed; the path moves on to another one when that
+ * device goes away or changes its path.
+ */
+static void
+virNodeDeviceObjListIndexPath(virNodeDeviceObjListPtr devs,
+                              virNodeDeviceObjPtr dev)
+{
+    const char *path = dev->def->sysfs_path;
+
+    /* Still called without a path so the index gets created */
+    if (path && virObjectIndexFindByName(&devs->pathIndex, path))
+        path = NULL;
+
+    virObjectIndexAdd(&devs->pathIndex, devs->count, NULL, path, dev);
+}
+
+static void
+virNodeDeviceObjListUnindexPath(virNodeDeviceObjListPtr devs,
+                                virNodeDeviceObjPtr dev)
+{
+    const char *path = dev->def->sysfs_path;
+    size_t i;
+
+    if (!path || virObjectIndexFindByName(&devs->pathIndex, path) != dev)
+        return;
+
+    virObjectIndexRemove(&devs->pathIndex, NULL, path, dev);
+
+    /* Hand the path over to the next device sharing it */
+    for (i = 0; i < devs->count; i++) {
+        if (devs->objs[i] != dev &&
+            STREQ_NULLABLE(devs->objs[i]->def->sysfs_path, path)) {
+            virObjectIndexAdd(&devs->pathIndex, devs->count,
+                              NULL, path, devs->objs[i]);
+            break;
+        }
+    }
+}
+
+
 virNodeDeviceObjPtr
 virNodeDeviceFindBySysfsPath(virNodeDeviceObjListPtr devs,
                              const char *sysfs_path)
 {
+    virNodeDeviceObjPtr dev;
     size_t i;
 
+    if (virObjectIndexIsValid(&devs->pathIndex)) {
+        if (!(dev = virObjectIndexFindByName(&devs->pathIndex, sysfs_path)))
+            return NULL;
+
+        virNodeDeviceObjLock(dev);
+        if (STREQ_NULLABLE(dev->def->sysfs_path, sysfs_path))
+            return dev;
+        virNodeDeviceObjUnlock(dev);
+        return NULL;
+    }
+
     for (i = 0; i < devs->count; i++) {
         virNodeDeviceObjLock(devs->objs[i]);
         if ((devs->objs[i]->def->sysfs_path != NULL) &&
@@ -106,8 +161,20 @@ virNodeDeviceFindBySysfsPath(virNodeDeviceObjListPtr devs,
 virNodeDeviceObjPtr virNodeDeviceFindByName(virNodeDeviceObjListPtr devs,
                                             const char *name)
 {
+    virNodeDeviceObjPtr dev;
     size_t i;
 
+    if (virObjectIndexIsValid(&devs->index)) {
+        if (!(dev = virObjectIndexFindByName(&devs->index, name)))
+            return NULL;
+
+        virNodeDeviceObjLock(dev);
+        if (STREQ(dev->def->name, name))
+            return dev;
+        virNodeDeviceObjUnlock(dev);
+        return NULL;
+    }
+
     for (i = 0; i < devs->count; i++) {
         virNodeDeviceObjLock(devs->objs[i]);
         if (STREQ(devs->objs[i]->def->name, name))
@@ -163,6 +230,8 @@ void virNodeDeviceObjListFree(virNodeDeviceObjListPtr devs)
         virNodeDeviceObjFree(devs->objs[i]);
     VIR_FREE(devs->objs);
     devs->count = 0;
+    virObjectIndexClear(&devs->index);
+    virObjectIndexClear(&devs->pathIndex);
 }
 
 virNodeDeviceObjPtr virNodeDeviceAssignDef(virNodeDeviceObjListPtr devs,
@@ -171,8 +240,15 @@ virNodeDeviceObjPtr virNodeDeviceAssignDef(virNodeDeviceObjListPtr devs,
     virNodeDeviceObjPtr device;
 
     if ((device = virNodeDeviceFindByName(devs, def->name))) {
-        virNodeDeviceDefFree(device->def);
-        device->def = def;
+        if (STRNEQ_NULLABLE(device->def->sysfs_path, def->sysfs_path)) {
+            virNodeDeviceObjListUnindexPath(devs, device);
+            virNodeDeviceDefFree(device->def);
+            device->def = def;
+            virNodeDeviceObjListIndexPath(devs, device);
+        } else {
+            virNodeDeviceDefFree(device->def);
+            device->def = def;
+        }
         return device;
     }
 
@@ -194,6 +270,8 @@ virNodeDeviceObjPtr virNodeDeviceAssignDef(virNodeDeviceObjListPtr devs,
         virNodeDeviceObjFree(device);
         return NULL;
     }
+    virObjectIndexAdd(&devs->index, devs->count, NULL, def->name, device);
+    virNodeDeviceObjListIndexPath(devs, device);
     devs->objs[devs->count++] = device;
 
     return device;
@@ -211,7 +289,6 @@ void virNodeDeviceObjRemove(virNodeDeviceObjListPtr devs,
         virNodeDeviceObjLock(dev);
         if (devs->objs[i] == dev) {
             virNodeDeviceObjUnlock(dev);
-            virNodeDeviceObjFree(devs->objs[i]);
 
             if (i < (devs->count - 1))
                 memmove(devs->objs + i, devs->objs + i + 1,
@@ -222,6 +299,10 @@ void virNodeDeviceObjRemove(virNodeDeviceObjListPtr devs,
             }
             devs->count--;
 
+            virObjectIndexRemove(&devs->index, NULL, dev->def->name, dev);
+            virNodeDeviceObjListUnindexPath(devs, dev);
+            virNodeDeviceObjFree(dev);
+
             break;
         }
         virNodeDeviceObjUnlock(dev);
@@ -29,6 +29,7 @@
 # include "virutil.h"
 # include "virthread.h"
 # include "virpci.h"
+# include "virobjectindex.h"
 
 # include <libxml/tree.h>
 
@@ -206,6 +207,9 @@ typedef virNodeDeviceObjList *virNodeDeviceObjListPtr;
 struct _virNodeDeviceObjList {
     unsigned int count;
     virNodeDeviceObjPtr *objs;
+
+    virObjectIndex index;
+    virObjectIndex pathIndex; /* keyed by sysfs path */
 };
 
 typedef struct _virNodeDeviceDriverState virNodeDeviceDriverState;
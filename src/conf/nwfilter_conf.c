@@ -358,6 +358,7 @@ virNWFilterObjListFree(virNWFilterObjListPtr nwfilters)
         virNWFilterObjFree(nwfilters->objs[i]);
     VIR_FREE(nwfilters->objs);
     nwfilters->count = 0;
+    virObjectIndexClear(&nwfilters->index);
 }
 
 
@@ -422,6 +423,8 @@ virNWFilterObjRemove(virNWFilterObjListPtr nwfilters,
     for (i = 0; i < nwfilters->count; i++) {
         virNWFilterObjLock(nwfilters->objs[i]);
         if (nwfilters->objs[i] == nwfilter) {
+            virObjectIndexRemove(&nwfilters->index, nwfilter->def->uuid,
+                                 nwfilter->def->name, nwfilter);
             virNWFilterObjUnlock(nwfilters->objs[i]);
             virNWFilterObjFree(nwfilters->objs[i]);
 
@@ -2679,8 +2682,20 @@ virNWFilterObjPtr
 virNWFilterObjFindByUUID(virNWFilterObjListPtr nwfilters,
                          const unsigned char *uuid)
 {
+    virNWFilterObjPtr nwfilter;
     size_t i;
 
+    if (virObjectIndexIsValid(&nwfilters->index)) {
+        if (!(nwfilter = virObjectIndexFindByUUID(&nwfilters->index, uuid)))
+            return NULL;
+
+        virNWFilterObjLock(nwfilter);
+        if (!memcmp(nwfilter->def->uuid, uuid, VIR_UUID_BUFLEN))
+            return nwfilter;
+        virNWFilterObjUnlock(nwfilter);
+        return NULL;
+    }
+
     for (i = 0; i < nwfilters->count; i++) {
         virNWFilterObjLock(nwfilters->objs[i]);
         if (!memcmp(nwfilters->objs[i]->def->uuid, uuid, VIR_UUID_BUFLEN))
@@ -2695,8 +2710,20 @@ virNWFilterObjFindByUUID(virNWFilterObjListPtr nwfilters,
 virNWFilterObjPtr
 virNWFilterObjFindByName(virNWFilterObjListPtr nwfilters, const char *name)
 {
+    virNWFilterObjPtr nwfilter;
     size_t i;
 
+    if (virObjectIndexIsValid(&nwfilters->index)) {
+        if (!(nwfilter = virObjectIndexFindByName(&nwfilters->index, name)))
+            return NULL;
+
+        virNWFilterObjLock(nwfilter);
+        if (STREQ(nwfilter->def->name, name))
+            return nwfilter;
+        virNWFilterObjUnlock(nwfilter);
+        return NULL;
+    }
+
     for (i = 0; i < nwfilters->count; i++) {
         virNWFilterObjLock(nwfilters->objs[i]);
         if (STREQ(nwfilters->objs[i]->def->name, name))
@@ -2999,8 +3026,13 @@ virNWFilterObjAssignDef(virNWFilterObjListPtr nwfilters,
     if ((nwfilter = virNWFilterObjFindByName(nwfilters, def->name))) {
 
         if (virNWFilterDefEqual(def, nwfilter->def, false)) {
+            /* Equal up to the UUID, which may differ */
+            virObjectIndexRemove(&nwfilters->index, nwfilter->def->uuid,
+                                 nwfilter->def->name, nwfilter);
             virNWFilterDefFree(nwfilter->def);
             nwfilter->def = def;
+            virObjectIndexAdd(&nwfilters->index, nwfilters->count,
+                              def->uuid, def->name, nwfilter);
             return nwfilter;
         }
 
@@ -3012,9 +3044,14 @@ virNWFilterObjAssignDef(virNWFilterObjListPtr nwfilters,
             return NULL;
         }
 
+        /* The new definition may carry a different UUID */
+        virObjectIndexRemove(&nwfilters->index, nwfilter->def->uuid,
+                             nwfilter->def->name, nwfilter);
         virNWFilterDefFree(nwfilter->def);
         nwfilter->def = def;
         nwfilter->newDef = NULL;
+        virObjectIndexAdd(&nwfilters->index, nwfilters->count,
+                          def->uuid, def->name, nwfilter);
         return nwfilter;
     }
 
@@ -3037,6 +3074,8 @@ virNWFilterObjAssignDef(virNWFilterObjListPtr nwfilters,
         virNWFilterObjFree(nwfilter);
         return NULL;
     }
+    virObjectIndexAdd(&nwfilters->index, nwfilters->count,
+                      def->uuid, def->name, nwfilter);
     nwfilters->objs[nwfilters->count++] = nwfilter;
 
     return nwfilter;
@@ -29,6 +29,7 @@
 # include "internal.h"
 
 # include "virhash.h"
+# include "virobjectindex.h"
 # include "virxml.h"
 # include "virbuffer.h"
 # include "virsocketaddr.h"
@@ -549,6 +550,7 @@ typedef virNWFilterObjList *virNWFilterObjListPtr;
 struct _virNWFilterObjList {
     unsigned int count;
     virNWFilterObjPtr *objs;
+    virObjectIndex index;
 };
 
 
@@ -622,6 +624,13 @@ typedef int (*virNWFilterRuleFreeInstanceData)(void * _inst);
 
 typedef int (*virNWFilterRuleDisplayInstanceData)(void *_inst);
 
+/* Copy instance data created for interface @ifname so that it applies
+ * to @newifname instead; returns -1 if that is not possible */
+typedef int (*virNWFilterRuleCopyInstanceData)(void *_inst,
+                                               const char *ifname,
+                                               const char *newifname,
+                                               void **_copy);
+
 typedef int (*virNWFilterCanApplyBasicRules)(void);
 
 typedef int (*virNWFilterApplyBasicRules)(const char *ifname,
@@ -655,6 +664,7 @@ struct _virNWFilterTechDriver {
     virNWFilterRuleAllTeardown allTeardown;
     virNWFilterRuleFreeInstanceData freeRuleInstance;
     virNWFilterRuleDisplayInstanceData displayRuleInstance;
+    virNWFilterRuleCopyInstanceData copyRuleInstance;
 
     virNWFilterCanApplyBasicRules canApplyBasicRules;
     virNWFilterApplyBasicRules applyBasicRules;
@@ -957,51 +957,101 @@ virDomainSnapshotForEachChild(virDomainSnapshotObjPtr snapshot,
     return snapshot->nchildren;
 }
 
-struct snapshot_act_on_descendant {
-    int number;
-    virHashIterator iter;
-    void *data;
-};
-
-static void
-virDomainSnapshotActOnDescendant(void *payload,
-                                 const void *name,
-                                 void *data)
-{
-    virDomainSnapshotObjPtr obj = payload;
-    struct snapshot_act_on_descendant *curr = data;
-
-    curr->number += 1 + virDomainSnapshotForEachDescendant(obj,
-                                                           curr->iter,
-                                                           curr->data);
-    (curr->iter)(payload, name, curr->data);
-}
-
 /* Run iter(data) on all descendants of snapshot, while ignoring all
  * other entries in snapshots.  Return the number of descendants
- * visited.  No particular ordering is guaranteed.  */
+ * visited.  Children are visited before their parent, so iter may
+ * remove the snapshot it is handed; no other ordering is guaranteed.
+ * The walk follows the parent and sibling links rather than
+ * recursing, so arbitrarily long snapshot chains are fine.  */
 int
 virDomainSnapshotForEachDescendant(virDomainSnapshotObjPtr snapshot,
                                    virHashIterator iter,
                                    void *data)
 {
-    struct snapshot_act_on_descendant act;
+    virDomainSnapshotObjPtr curr = snapshot->first_child;
+    virDomainSnapshotObjPtr next;
+    int number = 0;
+
+    if (!curr)
+        return 0;
+    while (curr->first_child)
+        curr = curr->first_child;
+
+    while (curr != snapshot) {
+        /* Pick the successor before iter gets a chance to free curr */
+        if (curr->sibling) {
+            next = curr->sibling;
+            while (next->first_child)
+                next = next->first_child;
+        } else {
+            next = curr->parent;
+        }
 
-    act.number = 0;
-    act.iter = iter;
-    act.data = data;
-    virDomainSnapshotForEachChild(snapshot,
-                                  virDomainSnapshotActOnDescendant, &act);
+        (iter)(curr, curr->def->name, data);
+        number++;
+        curr = next;
+    }
 
-    return act.number;
+    return number;
+}
+
+/* Link snapshot in as the first child of parent.  The snapshot must
+ * not currently have a parent.  */
+void
+virDomainSnapshotSetParent(virDomainSnapshotObjPtr snapshot,
+                           virDomainSnapshotObjPtr parent)
+{
+    snapshot->parent = parent;
+    snapshot->prev_sibling = NULL;
+    snapshot->sibling = parent->first_child;
+    if (parent->first_child)
+        parent->first_child->prev_sibling = snapshot;
+    parent->first_child = snapshot;
+    parent->nchildren++;
 }
 
-/* Struct and callback function used as a hash table callback; each call
- * inspects the pre-existing snapshot->def->parent field, and adjusts
- * the snapshot->parent field as well as the parent's child fields to
- * wire up the hierarchical relations for the given snapshot.  The error
- * indicator gets set if a parent is missing or a requested parent would
- * cause a circular parent chain.  */
+/* Hand all children of from over to to, in time proportional to the
+ * number of children moved.  Only the in-memory relations are
+ * updated; the caller is responsible for each child's def->parent.  */
+void
+virDomainSnapshotMoveChildren(virDomainSnapshotObjPtr from,
+                              virDomainSnapshotObjPtr to)
+{
+    virDomainSnapshotObjPtr child = from->first_child;
+
+    if (!child)
+        return;
+
+    while (true) {
+        child->parent = to;
+        if (!child->sibling)
+            break;
+        child = child->sibling;
+    }
+
+    child->sibling = to->first_child;
+    if (to->first_child)
+        to->first_child->prev_sibling = child;
+    to->first_child = from->first_child;
+    to->nchildren += from->nchildren;
+    from->first_child = NULL;
+    from->nchildren = 0;
+}
+
+static void
+virDomainSnapshotCountDescendant(void *payload ATTRIBUTE_UNUSED,
+                                 const void *name ATTRIBUTE_UNUSED,
+                                 void *data ATTRIBUTE_UNUSED)
+{
+}
+
+/* Struct and callback functions used as hash table callbacks.  The
+ * first pass inspects the pre-existing snapshot->def->parent field and
+ * links each snapshot below its parent.  The second pass only runs
+ * when some snapshots are not reachable from the metaroot, which can
+ * only happen when a requested parent chain is circular; it detaches
+ * one member of each cycle.  The error indicator gets set if a parent
+ * is missing or a cycle had to be broken.  */
 struct snapshot_set_relation {
     virDomainSnapshotObjListPtr snapshots;
     int err;
@@ -1013,40 +1063,59 @@ virDomainSnapshotSetRelations(void *payload,
 {
     virDomainSnapshotObjPtr obj = payload;
     struct snapshot_set_relation *curr = data;
-    virDomainSnapshotObjPtr tmp;
+    virDomainSnapshotObjPtr parent;
 
-    obj->parent = virDomainSnapshotFindByName(curr->snapshots,
-                                              obj->def->parent);
-    if (!obj->parent) {
+    parent = virDomainSnapshotFindByName(curr->snapshots, obj->def->parent);
+    if (!parent) {
         curr->err = -1;
-        obj->parent = &curr->snapshots->metaroot;
+        parent = &curr->snapshots->metaroot;
         VIR_WARN("snapshot %s lacks parent", obj->def->name);
-    } else {
-        tmp = obj->parent;
-        while (tmp && tmp->def) {
-            if (tmp == obj) {
-                curr->err = -1;
-                obj->parent = &curr->snapshots->metaroot;
-                VIR_WARN("snapshot %s in circular chain", obj->def->name);
-                break;
-            }
-            tmp = tmp->parent;
+    }
+    virDomainSnapshotSetParent(obj, parent);
+}
+
+static void
+virDomainSnapshotBreakCycles(void *payload,
+                             const void *name ATTRIBUTE_UNUSED,
+                             void *data)
+{
+    virDomainSnapshotObjPtr obj = payload;
+    struct snapshot_set_relation *curr = data;
+    virDomainSnapshotObjPtr tmp = obj->parent;
+    ssize_t limit = virHashSize(curr->snapshots->objs);
+
+    /* A snapshot hanging below a cycle it is not part of never
+     * reaches either itself or the metaroot, hence the limit */
+    while (tmp->def && limit-- > 0) {
+        if (tmp == obj) {
+            curr->err = -1;
+            virDomainSnapshotDropParent(obj);
+            virDomainSnapshotSetParent(obj, &curr->snapshots->metaroot);
+            VIR_WARN("snapshot %s in circular chain", obj->def->name);
+            return;
         }
+        tmp = tmp->parent;
     }
-    obj->parent->nchildren++;
-    obj->sibling = obj->parent->first_child;
-    obj->parent->first_child = obj;
 }
 
-/* Populate parent link and child count of all snapshots, with all
- * relations starting as 0/NULL.  Return 0 on success, -1 if a parent
- * is missing or if a circular relationship was requested.  */
+/* Populate parent link, sibling links and child count of all
+ * snapshots, with all relations starting as 0/NULL.  Return 0 on
+ * success, -1 if a parent is missing or if a circular relationship
+ * was requested.  */
 int
 virDomainSnapshotUpdateRelations(virDomainSnapshotObjListPtr snapshots)
 {
     struct snapshot_set_relation act = { snapshots, 0 };
+    int reachable;
 
     virHashForEach(snapshots->objs, virDomainSnapshotSetRelations, &act);
+
+    reachable = virDomainSnapshotForEachDescendant(&snapshots->metaroot,
+                                                   virDomainSnapshotCountDescendant,
+                                                   NULL);
+    if (reachable != virHashSize(snapshots->objs))
+        virHashForEach(snapshots->objs, virDomainSnapshotBreakCycles, &act);
+
     return act.err;
 }
 
@@ -1057,25 +1126,19 @@ virDomainSnapshotUpdateRelations(virDomainSnapshotObjListPtr snapshots)
 void
 virDomainSnapshotDropParent(virDomainSnapshotObjPtr snapshot)
 {
-    virDomainSnapshotObjPtr prev = NULL;
-    virDomainSnapshotObjPtr curr = NULL;
+    if (!snapshot->parent)
+        return;
 
     snapshot->parent->nchildren--;
-    curr = snapshot->parent->first_child;
-    while (curr != snapshot) {
-        if (!curr) {
-            VIR_WARN("inconsistent snapshot relations");
-            return;
-        }
-        prev = curr;
-        curr = curr->sibling;
-    }
-    if (prev)
-        prev->sibling = snapshot->sibling;
+    if (snapshot->prev_sibling)
+        snapshot->prev_sibling->sibling = snapshot->sibling;
     else
         snapshot->parent->first_child = snapshot->sibling;
+    if (snapshot->sibling)
+        snapshot->sibling->prev_sibling = snapshot->prev_sibling;
     snapshot->parent = NULL;
     snapshot->sibling = NULL;
+    snapshot->prev_sibling = NULL;
 }
 
 int
@@ -1156,6 +1219,7 @@ virDomainSnapshotRedefinePrep(virDomainPtr domain,
     int align_match = true;
     char uuidstr[VIR_UUID_STRING_BUFLEN];
     virDomainSnapshotObjPtr other;
+    virDomainSnapshotObjPtr self;
 
     virUUIDFormat(domain->uuid, uuidstr);
 
@@ -1174,20 +1238,23 @@ virDomainSnapshotRedefinePrep(virDomainPtr domain,
                            def->parent, def->name);
             goto cleanup;
         }
-        while (other->def->parent) {
-            if (STREQ(other->def->parent, def->name)) {
+        /* Only a snapshot that already exists can be an ancestor of
+         * the requested parent; follow the maintained parent links
+         * rather than resolving each ancestor by name.  */
+        self = virDomainSnapshotFindByName(vm->snapshots, def->name);
+        while (self && other->def) {
+            if (other == self) {
                 virReportError(VIR_ERR_INVALID_ARG,
                                _("parent %s would create cycle to %s"),
-                               other->def->name, def->name);
+                               def->parent, def->name);
                 goto cleanup;
             }
-            other = virDomainSnapshotFindByName(vm->snapshots,
-                                                other->def->parent);
-            if (!other) {
+            if (!other->parent) {
                 VIR_WARN("snapshots are inconsistent for %s",
                          vm->def->name);
                 break;
             }
+            other = other->parent;
         }
     }
 
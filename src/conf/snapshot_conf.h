@@ -89,6 +89,7 @@ struct _virDomainSnapshotObj {
                                        virDomainSnapshotUpdateRelations, or
                                        after virDomainSnapshotDropParent */
     virDomainSnapshotObjPtr sibling; /* NULL if last child of parent */
+    virDomainSnapshotObjPtr prev_sibling; /* NULL if first child of parent */
     size_t nchildren;
     virDomainSnapshotObjPtr first_child; /* NULL if no children */
 };
@@ -146,6 +147,10 @@ int virDomainSnapshotForEachDescendant(virDomainSnapshotObjPtr snapshot,
                                        virHashIterator iter,
                                        void *data);
 int virDomainSnapshotUpdateRelations(virDomainSnapshotObjListPtr snapshots);
+void virDomainSnapshotSetParent(virDomainSnapshotObjPtr snapshot,
+                                virDomainSnapshotObjPtr parent);
+void virDomainSnapshotMoveChildren(virDomainSnapshotObjPtr from,
+                                   virDomainSnapshotObjPtr to);
 void virDomainSnapshotDropParent(virDomainSnapshotObjPtr snapshot);
 
 # define VIR_DOMAIN_SNAPSHOT_FILTERS_METADATA           \
@@ -434,6 +434,22 @@ virStoragePoolObjFree(virStoragePoolObjPtr obj)
     VIR_FREE(obj);
 }
 
+static void
+virStoragePoolObjListIndexAdd(virStoragePoolObjListPtr pools,
+                              virStoragePoolObjPtr pool)
+{
+    virObjectIndexAdd(&pools->index, pools->count,
+                      pool->def->uuid, pool->def->name, pool);
+}
+
+static void
+virStoragePoolObjListIndexRemove(virStoragePoolObjListPtr pools,
+                                 virStoragePoolObjPtr pool)
+{
+    virObjectIndexRemove(&pools->index,
+                         pool->def->uuid, pool->def->name, pool);
+}
+
 void
 virStoragePoolObjListFree(virStoragePoolObjListPtr pools)
 {
@@ -442,6 +458,7 @@ virStoragePoolObjListFree(virStoragePoolObjListPtr pools)
         virStoragePoolObjFree(pools->objs[i]);
     VIR_FREE(pools->objs);
     pools->count = 0;
+    virObjectIndexClear(&pools->index);
 }
 
 void
@@ -455,6 +472,7 @@ virStoragePoolObjRemove(virStoragePoolObjListPtr pools,
     for (i = 0; i < pools->count; i++) {
         virStoragePoolObjLock(pools->objs[i]);
         if (pools->objs[i] == pool) {
+            virStoragePoolObjListIndexRemove(pools, pool);
             virStoragePoolObjUnlock(pools->objs[i]);
             virStoragePoolObjFree(pools->objs[i]);
 
@@ -1660,8 +1678,20 @@ virStoragePoolObjPtr
 virStoragePoolObjFindByUUID(virStoragePoolObjListPtr pools,
                             const unsigned char *uuid)
 {
+    virStoragePoolObjPtr pool;
     size_t i;
 
+    if (virObjectIndexIsValid(&pools->index)) {
+        if (!(pool = virObjectIndexFindByUUID(&pools->index, uuid)))
+            return NULL;
+
+        virStoragePoolObjLock(pool);
+        if (!memcmp(pool->def->uuid, uuid, VIR_UUID_BUFLEN))
+            return pool;
+        virStoragePoolObjUnlock(pool);
+        return NULL;
+    }
+
     for (i = 0; i < pools->count; i++) {
         virStoragePoolObjLock(pools->objs[i]);
         if (!memcmp(pools->objs[i]->def->uuid, uuid, VIR_UUID_BUFLEN))
@@ -1676,8 +1706,20 @@ virStoragePoolObjPtr
 virStoragePoolObjFindByName(virStoragePoolObjListPtr pools,
                             const char *name)
 {
+    virStoragePoolObjPtr pool;
     size_t i;
 
+    if (virObjectIndexIsValid(&pools->index)) {
+        if (!(pool = virObjectIndexFindByName(&pools->index, name)))
+            return NULL;
+
+        virStoragePoolObjLock(pool);
+        if (STREQ(pool->def->name, name))
+            return pool;
+        virStoragePoolObjUnlock(pool);
+        return NULL;
+    }
+
     for (i = 0; i < pools->count; i++) {
         virStoragePoolObjLock(pools->objs[i]);
         if (STREQ(pools->objs[i]->def->name, name))
@@ -1704,6 +1746,85 @@ virStoragePoolSourceFindDuplicateDevices(virStoragePoolObjPtr pool,
     return NULL;
 }
 
+/*
+ * Volumes are indexed by name, key and target path.  Just like the
+ * pool list, the tables are created with the first volume and dropped
+ * if they cannot be kept in sync, in which case lookups walk the
+ * array again.  Should several volumes share a key or path, the one
+ * added first wins, which is what the linear lookup used to return.
+ */
+static const char *
+virStorageVolDefIndexKey(virStorageVolDefPtr vol,
+                         virStorageVolIndex idx)
+{
+    switch (idx) {
+    case VIR_STORAGE_VOL_INDEX_NAME:
+        return vol->name;
+    case VIR_STORAGE_VOL_INDEX_KEY:
+        return vol->key;
+    case VIR_STORAGE_VOL_INDEX_PATH:
+        return vol->target.path;
+    case VIR_STORAGE_VOL_INDEX_LAST:
+        break;
+    }
+
+    return NULL;
+}
+
+static void
+virStorageVolDefListDropIndex(virStorageVolDefListPtr vols)
+{
+    size_t i;
+
+    for (i = 0; i < VIR_STORAGE_VOL_INDEX_LAST; i++) {
+        virHashFree(vols->index[i]);
+        vols->index[i] = NULL;
+    }
+    vols->ndups = 0;
+}
+
+static int
+virStorageVolDefListIndexAdd(virStorageVolDefListPtr vols,
+                             virStorageVolDefPtr vol)
+{
+    size_t i;
+
+    for (i = 0; i < VIR_STORAGE_VOL_INDEX_LAST; i++) {
+        const char *key = virStorageVolDefIndexKey(vol, i);
+
+        if (!key)
+            continue;
+
+        if (virHashLookup(vols->index[i], key)) {
+            vols->ndups++;
+            continue;
+        }
+
+        if (virHashAddEntry(vols->index[i], key, vol) < 0)
+            return -1;
+    }
+
+    return 0;
+}
+
+static void
+virStorageVolDefListReindex(virStorageVolDefListPtr vols)
+{
+    size_t i;
+
+    vols->ndups = 0;
+    for (i = 0; i < VIR_STORAGE_VOL_INDEX_LAST; i++)
+        virHashRemoveAll(vols->index[i]);
+
+    for (i = 0; i < vols->count; i++) {
+        if (virStorageVolDefListIndexAdd(vols, vols->objs[i]) < 0) {
+            virResetLastError();
+            virStorageVolDefListDropIndex(vols);
+            return;
+        }
+    }
+}
+
 void
 virStoragePoolObjClearVols(virStoragePoolObjPtr pool)
 {
@@ -1713,47 +1834,124 @@ virStoragePoolObjClearVols(virStoragePoolObjPtr pool)
 
     VIR_FREE(pool->volumes.objs);
     pool->volumes.count = 0;
+    virStorageVolDefListDropIndex(&pool->volumes);
 }
 
-virStorageVolDefPtr
-virStorageVolDefFindByKey(virStoragePoolObjPtr pool,
-                          const char *key)
+/**
+ * virStoragePoolObjAddVol:
+ * @pool: locked pool object
+ * @vol: fully populated volume definition
+ *
+ * Append @vol to the volumes of @pool and index it.  The name, key
+ * and target path of @vol must not change while it is in the list.
+ * On success, @pool takes ownership of @vol.
+ *
+ * Returns 0 on success, -1 on error.
+ */
+int
+virStoragePoolObjAddVol(virStoragePoolObjPtr pool,
+                        virStorageVolDefPtr vol)
 {
+    virStorageVolDefListPtr vols = &pool->volumes;
     size_t i;
 
-    for (i = 0; i < pool->volumes.count; i++)
-        if (STREQ(pool->volumes.objs[i]->key, key))
-            return pool->volumes.objs[i];
+    if (vols->count == 0 && !vols->index[0]) {
+        for (i = 0; i < VIR_STORAGE_VOL_INDEX_LAST; i++) {
+            if (!(vols->index[i] = virHashCreate(32, NULL))) {
+                virStorageVolDefListDropIndex(vols);
+                return -1;
+            }
+        }
+    }
 
-    return NULL;
+    if (VIR_APPEND_ELEMENT_COPY(vols->objs, vols->count, vol) < 0)
+        return -1;
+
+    if (vols->index[0] && virStorageVolDefListIndexAdd(vols, vol) < 0) {
+        virStoragePoolObjRemoveVol(pool, vol);
+        return -1;
+    }
+
+    return 0;
 }
 
-virStorageVolDefPtr
-virStorageVolDefFindByPath(virStoragePoolObjPtr pool,
-                           const char *path)
+/**
+ * virStoragePoolObjRemoveVol:
+ * @pool: locked pool object
+ * @vol: volume definition
+ *
+ * Drop @vol from the volumes of @pool.  The caller is responsible for
+ * freeing @vol.
+ */
+void
+virStoragePoolObjRemoveVol(virStoragePoolObjPtr pool,
+                           virStorageVolDefPtr vol)
 {
+    virStorageVolDefListPtr vols = &pool->volumes;
     size_t i;
 
-    for (i = 0; i < pool->volumes.count; i++)
-        if (STREQ(pool->volumes.objs[i]->target.path, path))
-            return pool->volumes.objs[i];
+    for (i = 0; i < vols->count; i++) {
+        if (vols->objs[i] == vol) {
+            VIR_DELETE_ELEMENT(vols->objs, i, vols->count);
+            break;
+        }
+    }
 
-    return NULL;
+    if (!vols->index[0])
+        return;
+
+    if (vols->ndups) {
+        virStorageVolDefListReindex(vols);
+        return;
+    }
+
+    for (i = 0; i < VIR_STORAGE_VOL_INDEX_LAST; i++) {
+        const char *key = virStorageVolDefIndexKey(vol, i);
+
+        if (key && virHashLookup(vols->index[i], key) == vol)
+            ignore_value(virHashRemoveEntry(vols->index[i], key));
+    }
 }
 
-virStorageVolDefPtr
-virStorageVolDefFindByName(virStoragePoolObjPtr pool,
-                           const char *name)
+static virStorageVolDefPtr
+virStorageVolDefFind(virStoragePoolObjPtr pool,
+                     virStorageVolIndex idx,
+                     const char *key)
 {
     size_t i;
 
+    if (pool->volumes.index[idx])
+        return virHashLookup(pool->volumes.index[idx], key);
+
     for (i = 0; i < pool->volumes.count; i++)
-        if (STREQ(pool->volumes.objs[i]->name, name))
+        if (STREQ_NULLABLE(virStorageVolDefIndexKey(pool->volumes.objs[i],
+                                                    idx), key))
             return pool->volumes.objs[i];
 
     return NULL;
 }
 
+virStorageVolDefPtr
+virStorageVolDefFindByKey(virStoragePoolObjPtr pool,
+                          const char *key)
+{
+    return virStorageVolDefFind(pool, VIR_STORAGE_VOL_INDEX_KEY, key);
+}
+
+virStorageVolDefPtr
+virStorageVolDefFindByPath(virStoragePoolObjPtr pool,
+                           const char *path)
+{
+    return virStorageVolDefFind(pool, VIR_STORAGE_VOL_INDEX_PATH, path);
+}
+
+virStorageVolDefPtr
+virStorageVolDefFindByName(virStoragePoolObjPtr pool,
+                           const char *name)
+{
+    return virStorageVolDefFind(pool, VIR_STORAGE_VOL_INDEX_NAME, name);
+}
+
 virStoragePoolObjPtr
 virStoragePoolObjAssignDef(virStoragePoolObjListPtr pools,
                            virStoragePoolDefPtr def)
@@ -1762,8 +1960,10 @@ virStoragePoolObjAssignDef(virStoragePoolObjListPtr pools,
 
     if ((pool = virStoragePoolObjFindByName(pools, def->name))) {
         if (!virStoragePoolObjIsActive(pool)) {
+            virStoragePoolObjListIndexRemove(pools, pool);
             virStoragePoolDefFree(pool->def);
             pool->def = def;
+            virStoragePoolObjListIndexAdd(pools, pool);
         } else {
             virStoragePoolDefFree(pool->newDef);
             pool->newDef = def;
@@ -1790,6 +1990,7 @@ virStoragePoolObjAssignDef(virStoragePoolObjListPtr pools,
         virStoragePoolObjFree(pool);
         return NULL;
     }
+    virStoragePoolObjListIndexAdd(pools, pool);
     pools->objs[pools->count++] = pool;
 
     return pool;
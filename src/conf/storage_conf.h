@@ -28,6 +28,8 @@
 # include "storage_encryption_conf.h"
 # include "virbitmap.h"
 # include "virthread.h"
+# include "virhash.h"
+# include "virobjectindex.h"
 
 # include <libxml/tree.h>
 
@@ -100,6 +102,8 @@ struct _virStorageVolDef {
     int type; /* enum virStorageVolType */
 
     unsigned int building;
+    unsigned int wiping;
+    int wipeAbort; /* set atomically to stop a running wipe */
 
     unsigned long long allocation; /* bytes */
     unsigned long long capacity; /* bytes */
@@ -109,11 +113,24 @@ struct _virStorageVolDef {
     virStorageVolTarget backingStore;
 };
 
+typedef enum {
+    VIR_STORAGE_VOL_INDEX_NAME,
+    VIR_STORAGE_VOL_INDEX_KEY,
+    VIR_STORAGE_VOL_INDEX_PATH,
+
+    VIR_STORAGE_VOL_INDEX_LAST
+} virStorageVolIndex;
+
 typedef struct _virStorageVolDefList virStorageVolDefList;
 typedef virStorageVolDefList *virStorageVolDefListPtr;
 struct _virStorageVolDefList {
     size_t count;
     virStorageVolDefPtr *objs;
+
+    /* Lookup tables by name, key and target path, kept up to date by
+     * virStoragePoolObjAddVol/virStoragePoolObjRemoveVol */
+    virHashTablePtr index[VIR_STORAGE_VOL_INDEX_LAST];
+    size_t ndups; /* volumes sharing a key or path with another one */
 };
 
 VIR_ENUM_DECL(virStorageVol)
@@ -344,6 +361,8 @@ typedef virStoragePoolObjList *virStoragePoolObjListPtr;
 struct _virStoragePoolObjList {
     size_t count;
     virStoragePoolObjPtr *objs;
+
+    virObjectIndex index;
 };
 
 typedef struct _virStorageDriverState virStorageDriverState;
@@ -357,6 +376,12 @@ struct _virStorageDriverState {
     char *configDir;
     char *autostartDir;
     bool privileged;
+
+    /* Maps volume paths to the name of the pool they were last seen
+     * in.  Only a hint for path lookups, which verify it against the
+     * pool; guarded by its own lock, which nests inside pool locks */
+    virMutex volPathsLock;
+    virHashTablePtr volPaths;
 };
 
 typedef struct _virStoragePoolSourceList virStoragePoolSourceList;
@@ -401,6 +426,12 @@ virStorageVolDefFindByName(virStoragePoolObjPtr pool,
                            const char *name);
 
 void virStoragePoolObjClearVols(virStoragePoolObjPtr pool);
+int virStoragePoolObjAddVol(virStoragePoolObjPtr pool,
+                            virStorageVolDefPtr vol)
+    ATTRIBUTE_NONNULL(1) ATTRIBUTE_NONNULL(2) ATTRIBUTE_RETURN_CHECK;
+void virStoragePoolObjRemoveVol(virStoragePoolObjPtr pool,
+                                virStorageVolDefPtr vol)
+    ATTRIBUTE_NONNULL(1) ATTRIBUTE_NONNULL(2);
 
 virStoragePoolDefPtr virStoragePoolDefParseString(const char *xml);
 virStoragePoolDefPtr virStoragePoolDefParseFile(const char *filename);
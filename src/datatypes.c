@@ -60,32 +60,38 @@ static void virStoragePoolDispose(void *obj);
 static int
 virDataTypesOnceInit(void)
 {
-#define DECLARE_CLASS_COMMON(basename, parent)                   \
-    if (!(basename ## Class = virClassNew(parent,                \
-                                          #basename,             \
-                                          sizeof(basename),      \
-                                          basename ## Dispose))) \
+#define DECLARE_CLASS_COMMON(basename, parent, poolsize)            \
+    if (!(basename ## Class = virClassNewPooled(parent,              \
+                                                #basename,           \
+                                                sizeof(basename),    \
+                                                basename ## Dispose, \
+                                                poolsize)))          \
         return -1;
-#define DECLARE_CLASS(basename)                                  \
-    DECLARE_CLASS_COMMON(basename, virClassForObject())
-#define DECLARE_CLASS_LOCKABLE(basename)                         \
-    DECLARE_CLASS_COMMON(basename, virClassForObjectLockable())
-
+#define DECLARE_CLASS(basename)                                      \
+    DECLARE_CLASS_COMMON(basename, virClassForObject(), 0)
+#define DECLARE_CLASS_POOLED(basename, poolsize)                     \
+    DECLARE_CLASS_COMMON(basename, virClassForObject(), poolsize)
+#define DECLARE_CLASS_LOCKABLE(basename)                             \
+    DECLARE_CLASS_COMMON(basename, virClassForObjectLockable(), 0)
+
+    /* Domain and stream handles are created and released for
+     * almost every API call, so recycle their memory */
     DECLARE_CLASS(virConnect);
     DECLARE_CLASS_LOCKABLE(virConnectCloseCallbackData);
-    DECLARE_CLASS(virDomain);
+    DECLARE_CLASS_POOLED(virDomain, 64);
     DECLARE_CLASS(virDomainSnapshot);
     DECLARE_CLASS(virInterface);
     DECLARE_CLASS(virNetwork);
     DECLARE_CLASS(virNodeDevice);
     DECLARE_CLASS(virNWFilter);
     DECLARE_CLASS(virSecret);
-    DECLARE_CLASS(virStream);
+    DECLARE_CLASS_POOLED(virStream, 16);
     DECLARE_CLASS(virStorageVol);
     DECLARE_CLASS(virStoragePool);
 
 #undef DECLARE_CLASS_COMMON
 #undef DECLARE_CLASS_LOCKABLE
+#undef DECLARE_CLASS_POOLED
 #undef DECLARE_CLASS
 
     return 0;
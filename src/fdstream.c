@@ -41,6 +41,7 @@
 #include "virfile.h"
 #include "configmake.h"
 #include "virstring.h"
+#include "virtime.h"
 
 #define VIR_FROM_THIS VIR_FROM_STREAMS
 
@@ -52,6 +53,21 @@ struct virFDStreamData {
     unsigned long long offset;
     unsigned long long length;
 
+    /* Sparse mode: holes are reported to the reader instead of
+     * zeroes, and can be written without sending any data. When
+     * talking to the I/O helper the pipe carries framed chunks,
+     * otherwise we look for holes in @fd ourselves */
+    bool sparse;
+    virFDStreamSparseHeader hdr; /* header being read from the helper */
+    size_t hdrLen;               /* how much of @hdr was read so far */
+    unsigned long long dataLeft; /* data left in the current chunk */
+    unsigned long long holeLeft; /* hole left at the current position */
+
+    /* throughput counters, logged when the stream is closed */
+    unsigned long long dataBytes;
+    unsigned long long holeBytes;
+    unsigned long long startMs;
+
     int watch;
     int events;         /* events the stream callback is subscribed for */
     bool cbRemoved;
@@ -292,6 +308,16 @@ virFDStreamCloseInt(virStreamPtr st, bool streamAbort)
     }
 
     /* mutex locked */
+    if (fdst->sparse || fdst->cmd) {
+        unsigned long long now;
+
+        if (virTimeMillisNow(&now) < 0)
+            now = fdst->startMs;
+        VIR_INFO("stream %p transferred %llu bytes of data and skipped "
+                 "%llu bytes of holes in %llu ms",
+                 st, fdst->dataBytes, fdst->holeBytes, now - fdst->startMs);
+    }
+
     ret = VIR_CLOSE(fdst->fd);
     if (fdst->cmd) {
         char buf[1024];
@@ -361,10 +387,45 @@ virFDStreamAbort(virStreamPtr st)
     return virFDStreamCloseInt(st, true);
 }
 
+/* Write a chunk header to the I/O helper. Headers are far smaller
+ * than PIPE_BUF, so they are written to the pipe in one go or not
+ * at all. */
+static int
+virFDStreamWriteHeader(struct virFDStreamData *fdst,
+                       virFDStreamSparseType type,
+                       unsigned long long length)
+{
+    virFDStreamSparseHeader hdr;
+    ssize_t ret;
+
+    memset(&hdr, 0, sizeof(hdr));
+    hdr.type = type;
+    hdr.length = length;
+
+retry:
+    ret = write(fdst->fd, &hdr, sizeof(hdr));
+    if (ret < 0) {
+        if (errno == EAGAIN || errno == EWOULDBLOCK)
+            return -2;
+        if (errno == EINTR)
+            goto retry;
+        virReportSystemError(errno, "%s",
+                             _("cannot write to stream"));
+        return -1;
+    }
+    if (ret != sizeof(hdr)) {
+        virReportError(VIR_ERR_INTERNAL_ERROR, "%s",
+                       _("short write of sparse stream header"));
+        return -1;
+    }
+    return 0;
+}
+
+
 static int virFDStreamWrite(virStreamPtr st, const char *bytes, size_t nbytes)
 {
     struct virFDStreamData *fdst = st->privateData;
-    int ret;
+    int ret = -1;
 
     if (nbytes > INT_MAX) {
         virReportSystemError(ERANGE, "%s",
@@ -384,14 +445,24 @@ static int virFDStreamWrite(virStreamPtr st, const char *bytes, size_t nbytes)
         if (fdst->length == fdst->offset) {
             virReportSystemError(ENOSPC, "%s",
                                  _("cannot write to stream"));
-            virMutexUnlock(&fdst->lock);
-            return -1;
+            goto cleanup;
         }
 
         if ((fdst->length - fdst->offset) < nbytes)
             nbytes = fdst->length - fdst->offset;
     }
 
+    if (fdst->sparse && fdst->cmd && nbytes) {
+        if (!fdst->dataLeft) {
+            if ((ret = virFDStreamWriteHeader(fdst, VIR_FDSTREAM_SPARSE_DATA,
+                                              nbytes)) < 0)
+                goto cleanup;
+            fdst->dataLeft = nbytes;
+        }
+        if (fdst->dataLeft < nbytes)
+            nbytes = fdst->dataLeft;
+    }
+
 retry:
     ret = write(fdst->fd, bytes, nbytes);
     if (ret < 0) {
@@ -404,19 +475,234 @@ retry:
             virReportSystemError(errno, "%s",
                                  _("cannot write to stream"));
         }
-    } else if (fdst->length) {
-        fdst->offset += ret;
+    } else {
+        if (fdst->length)
+            fdst->offset += ret;
+        if (fdst->sparse && fdst->cmd)
+            fdst->dataLeft -= ret;
+        fdst->dataBytes += ret;
     }
 
+cleanup:
     virMutexUnlock(&fdst->lock);
     return ret;
 }
 
 
-static int virFDStreamRead(virStreamPtr st, char *bytes, size_t nbytes)
+static int
+virFDStreamSendHole(virStreamPtr st, long long length, unsigned int flags)
 {
     struct virFDStreamData *fdst = st->privateData;
-    int ret;
+    int ret = -1;
+
+    virCheckFlags(0, -1);
+
+    if (!fdst) {
+        virReportError(VIR_ERR_INTERNAL_ERROR,
+                       "%s", _("stream is not open"));
+        return -1;
+    }
+
+    virMutexLock(&fdst->lock);
+
+    if (!fdst->sparse) {
+        virReportError(VIR_ERR_OPERATION_UNSUPPORTED, "%s",
+                       _("holes can only be sent on sparse streams"));
+        goto cleanup;
+    }
+
+    if (fdst->length &&
+        (fdst->length - fdst->offset) < length) {
+        virReportSystemError(ENOSPC, "%s",
+                             _("cannot write to stream"));
+        goto cleanup;
+    }
+
+    if (length == 0) {
+        ret = 0;
+        goto cleanup;
+    }
+
+    if (fdst->cmd) {
+        if (fdst->dataLeft) {
+            virReportError(VIR_ERR_INTERNAL_ERROR, "%s",
+                           _("cannot send a hole before all data was sent"));
+            goto cleanup;
+        }
+        if ((ret = virFDStreamWriteHeader(fdst, VIR_FDSTREAM_SPARSE_HOLE,
+                                          length)) < 0)
+            goto cleanup;
+    } else if (virFileWriteHole(fdst->fd, length) < 0) {
+        virReportSystemError(errno, "%s",
+                             _("cannot write hole to stream"));
+        goto cleanup;
+    }
+
+    if (fdst->length)
+        fdst->offset += length;
+    fdst->holeBytes += length;
+    ret = 0;
+
+cleanup:
+    virMutexUnlock(&fdst->lock);
+    return ret;
+}
+
+
+/*
+ * Find out what the stream is positioned at in sparse mode, either
+ * by reading the next chunk header from the I/O helper or by looking
+ * at the file. On success, either @dataLeft or @holeLeft is set, or
+ * both are zero at the end of the stream.
+ *
+ * Returns 0 on success, -2 if the helper has not sent the whole
+ * header yet, -1 on error.
+ */
+static int
+virFDStreamSparseNext(struct virFDStreamData *fdst)
+{
+    bool inData;
+    unsigned long long length;
+    ssize_t got;
+
+    if (fdst->dataLeft || fdst->holeLeft)
+        return 0;
+
+    if (!fdst->cmd) {
+        if (virFileInData(fdst->fd, &inData, &length) < 0) {
+            virReportSystemError(errno, "%s",
+                                 _("cannot read from stream"));
+            return -1;
+        }
+        if (inData)
+            fdst->dataLeft = length;
+        else
+            fdst->holeLeft = length;
+        return 0;
+    }
+
+    while (fdst->hdrLen < sizeof(fdst->hdr)) {
+        got = read(fdst->fd, (char *)&fdst->hdr + fdst->hdrLen,
+                   sizeof(fdst->hdr) - fdst->hdrLen);
+        if (got < 0) {
+            if (errno == EAGAIN || errno == EWOULDBLOCK)
+                return -2;
+            if (errno == EINTR)
+                continue;
+            virReportSystemError(errno, "%s",
+                                 _("cannot read from stream"));
+            return -1;
+        }
+        if (got == 0) {
+            if (fdst->hdrLen == 0)
+                return 0;
+            virReportError(VIR_ERR_INTERNAL_ERROR, "%s",
+                           _("truncated sparse stream header"));
+            return -1;
+        }
+        fdst->hdrLen += got;
+    }
+    fdst->hdrLen = 0;
+
+    switch ((virFDStreamSparseType) fdst->hdr.type) {
+    case VIR_FDSTREAM_SPARSE_DATA:
+        fdst->dataLeft = fdst->hdr.length;
+        break;
+    case VIR_FDSTREAM_SPARSE_HOLE:
+        fdst->holeLeft = fdst->hdr.length;
+        break;
+    default:
+        virReportError(VIR_ERR_INTERNAL_ERROR,
+                       _("unknown sparse stream chunk type %u"),
+                       fdst->hdr.type);
+        return -1;
+    }
+
+    /* An empty chunk carries nothing, move on to the next one */
+    return virFDStreamSparseNext(fdst);
+}
+
+
+/* Consume @length bytes of the hole the stream is positioned at */
+static int
+virFDStreamSkipHole(virStreamPtr st,
+                    struct virFDStreamData *fdst,
+                    unsigned long long length)
+{
+    if (!fdst->cmd &&
+        lseek(fdst->fd, length, SEEK_CUR) < 0) {
+        virReportSystemError(errno, "%s",
+                             _("cannot read from stream"));
+        return -1;
+    }
+
+    VIR_DEBUG("st=%p skipped hole of %llu bytes", st, length);
+    fdst->holeLeft -= length;
+    fdst->holeBytes += length;
+    if (fdst->length)
+        fdst->offset += length;
+    return 0;
+}
+
+
+static int
+virFDStreamRecvHole(virStreamPtr st, long long *length, unsigned int flags)
+{
+    struct virFDStreamData *fdst = st->privateData;
+    unsigned long long hole;
+    int ret = -1;
+
+    virCheckFlags(0, -1);
+
+    if (!fdst) {
+        virReportError(VIR_ERR_INTERNAL_ERROR,
+                       "%s", _("stream is not open"));
+        return -1;
+    }
+
+    virMutexLock(&fdst->lock);
+
+    *length = 0;
+    if (!fdst->sparse ||
+        (fdst->length && fdst->length == fdst->offset)) {
+        ret = 0;
+        goto cleanup;
+    }
+
+    if ((ret = virFDStreamSparseNext(fdst)) < 0) {
+        /* Not at a hole if the helper didn't tell us about one yet */
+        if (ret == -2)
+            ret = 0;
+        goto cleanup;
+    }
+
+    hole = MIN(fdst->holeLeft, LLONG_MAX);
+    if (fdst->length && (fdst->length - fdst->offset) < hole)
+        hole = fdst->length - fdst->offset;
+
+    if (hole &&
+        virFDStreamSkipHole(st, fdst, hole) < 0) {
+        ret = -1;
+        goto cleanup;
+    }
+    *length = hole;
+
+cleanup:
+    virMutexUnlock(&fdst->lock);
+    return ret;
+}
+
+
+static int
+virFDStreamReadFlags(virStreamPtr st,
+                     char *bytes,
+                     size_t nbytes,
+                     unsigned int flags)
+{
+    struct virFDStreamData *fdst = st->privateData;
+    int ret = -1;
+
+    virCheckFlags(VIR_STREAM_RECV_STOP_AT_HOLE, -1);
 
     if (nbytes > INT_MAX) {
         virReportSystemError(ERANGE, "%s",
@@ -434,14 +720,42 @@ static int virFDStreamRead(virStreamPtr st, char *bytes, size_t nbytes)
 
     if (fdst->length) {
         if (fdst->length == fdst->offset) {
-            virMutexUnlock(&fdst->lock);
-            return 0;
+            ret = 0;
+            goto cleanup;
         }
 
         if ((fdst->length - fdst->offset) < nbytes)
             nbytes = fdst->length - fdst->offset;
     }
 
+    if (fdst->sparse) {
+        if ((ret = virFDStreamSparseNext(fdst)) < 0)
+            goto cleanup;
+
+        if (fdst->holeLeft) {
+            if (flags & VIR_STREAM_RECV_STOP_AT_HOLE) {
+                ret = -3;
+                goto cleanup;
+            }
+            if (fdst->holeLeft < nbytes)
+                nbytes = fdst->holeLeft;
+            if (virFDStreamSkipHole(st, fdst, nbytes) < 0) {
+                ret = -1;
+                goto cleanup;
+            }
+            memset(bytes, 0, nbytes);
+            ret = nbytes;
+            goto cleanup;
+        }
+
+        /* End of the stream */
+        if (!fdst->dataLeft)
+            goto cleanup;
+
+        if (fdst->dataLeft < nbytes)
+            nbytes = fdst->dataLeft;
+    }
+
 retry:
     ret = read(fdst->fd, bytes, nbytes);
     if (ret < 0) {
@@ -454,18 +768,36 @@ retry:
             virReportSystemError(errno, "%s",
                                  _("cannot read from stream"));
         }
-    } else if (fdst->length) {
-        fdst->offset += ret;
+    } else if (ret == 0 && fdst->sparse && fdst->cmd && nbytes) {
+        virReportError(VIR_ERR_INTERNAL_ERROR, "%s",
+                       _("sparse stream ended in the middle of data"));
+        ret = -1;
+    } else {
+        if (fdst->length)
+            fdst->offset += ret;
+        if (fdst->sparse)
+            fdst->dataLeft -= MIN(fdst->dataLeft, ret);
+        fdst->dataBytes += ret;
     }
 
+cleanup:
     virMutexUnlock(&fdst->lock);
     return ret;
 }
 
 
+static int virFDStreamRead(virStreamPtr st, char *bytes, size_t nbytes)
+{
+    return virFDStreamReadFlags(st, bytes, nbytes, 0);
+}
+
+
 static virStreamDriver virFDStreamDrv = {
     .streamSend = virFDStreamWrite,
     .streamRecv = virFDStreamRead,
+    .streamRecvFlags = virFDStreamReadFlags,
+    .streamSendHole = virFDStreamSendHole,
+    .streamRecvHole = virFDStreamRecvHole,
     .streamFinish = virFDStreamClose,
     .streamAbort = virFDStreamAbort,
     .streamEventAddCallback = virFDStreamAddCallback,
@@ -477,12 +809,13 @@ static int virFDStreamOpenInternal(virStreamPtr st,
                                    int fd,
                                    virCommandPtr cmd,
                                    int errfd,
-                                   unsigned long long length)
+                                   unsigned long long length,
+                                   bool sparse)
 {
     struct virFDStreamData *fdst;
 
-    VIR_DEBUG("st=%p fd=%d cmd=%p errfd=%d length=%llu",
-              st, fd, cmd, errfd, length);
+    VIR_DEBUG("st=%p fd=%d cmd=%p errfd=%d length=%llu sparse=%d",
+              st, fd, cmd, errfd, length, sparse);
 
     if ((st->flags & VIR_STREAM_NONBLOCK) &&
         virSetNonBlock(fd) < 0)
@@ -495,6 +828,11 @@ static int virFDStreamOpenInternal(virStreamPtr st,
     fdst->cmd = cmd;
     fdst->errfd = errfd;
     fdst->length = length;
+    fdst->sparse = sparse;
+    if (virTimeMillisNow(&fdst->startMs) < 0) {
+        VIR_FREE(fdst);
+        return -1;
+    }
     if (virMutexInit(&fdst->lock) < 0) {
         VIR_FREE(fdst);
         virReportError(VIR_ERR_INTERNAL_ERROR, "%s",
@@ -512,7 +850,7 @@ static int virFDStreamOpenInternal(virStreamPtr st,
 int virFDStreamOpen(virStreamPtr st,
                     int fd)
 {
-    return virFDStreamOpenInternal(st, fd, NULL, -1, 0);
+    return virFDStreamOpenInternal(st, fd, NULL, -1, 0, false);
 }
 
 
@@ -557,7 +895,7 @@ int virFDStreamConnectUNIX(virStreamPtr st,
         goto error;
     } while ((++i <= timeout*5) && (usleep(.2 * 1000000) <= 0));
 
-    if (virFDStreamOpenInternal(st, fd, NULL, -1, 0) < 0)
+    if (virFDStreamOpenInternal(st, fd, NULL, -1, 0, false) < 0)
         goto error;
     return 0;
 
@@ -582,7 +920,8 @@ virFDStreamOpenFileInternal(virStreamPtr st,
                             unsigned long long offset,
                             unsigned long long length,
                             int oflags,
-                            int mode)
+                            int mode,
+                            bool sparse)
 {
     int fd = -1;
     int childfd = -1;
@@ -590,8 +929,8 @@ virFDStreamOpenFileInternal(virStreamPtr st,
     virCommandPtr cmd = NULL;
     int errfd = -1;
 
-    VIR_DEBUG("st=%p path=%s oflags=%x offset=%llu length=%llu mode=%o",
-              st, path, oflags, offset, length, mode);
+    VIR_DEBUG("st=%p path=%s oflags=%x offset=%llu length=%llu mode=%o "
+              "sparse=%d", st, path, oflags, offset, length, mode, sparse);
 
     oflags |= O_NOCTTY | O_BINARY;
 
@@ -613,6 +952,16 @@ virFDStreamOpenFileInternal(virStreamPtr st,
         goto error;
     }
 
+    if (sparse &&
+        ((oflags & O_ACCMODE) == O_RDWR ||
+         (!S_ISREG(sb.st_mode) && !S_ISBLK(sb.st_mode)))) {
+        virReportError(VIR_ERR_OPERATION_UNSUPPORTED,
+                       _("%s: sparse streams need a regular file or block "
+                         "device opened for reading or writing"),
+                       path);
+        goto error;
+    }
+
     if (offset &&
         lseek(fd, offset, SEEK_SET) != offset) {
         virReportSystemError(errno,
@@ -651,6 +1000,8 @@ virFDStreamOpenFileInternal(virStreamPtr st,
         virCommandPassFD(cmd, fd,
                          VIR_COMMAND_PASS_FD_CLOSE_PARENT);
         virCommandAddArgFormat(cmd, "%d", fd);
+        if (sparse)
+            virCommandAddArg(cmd, "--sparse");
 
         if ((oflags & O_ACCMODE) == O_RDONLY) {
             childfd = fds[1];
@@ -669,7 +1020,7 @@ virFDStreamOpenFileInternal(virStreamPtr st,
         VIR_FORCE_CLOSE(childfd);
     }
 
-    if (virFDStreamOpenInternal(st, fd, cmd, errfd, length) < 0)
+    if (virFDStreamOpenInternal(st, fd, cmd, errfd, length, sparse) < 0)
         goto error;
 
     return 0;
@@ -698,7 +1049,24 @@ int virFDStreamOpenFile(virStreamPtr st,
     }
     return virFDStreamOpenFileInternal(st, path,
                                        offset, length,
-                                       oflags, 0);
+                                       oflags, 0, false);
+}
+
+int virFDStreamOpenSparseFile(virStreamPtr st,
+                              const char *path,
+                              unsigned long long offset,
+                              unsigned long long length,
+                              int oflags)
+{
+    if (oflags & O_CREAT) {
+        virReportError(VIR_ERR_INTERNAL_ERROR,
+                       _("Attempt to create %s without specifying mode"),
+                       path);
+        return -1;
+    }
+    return virFDStreamOpenFileInternal(st, path,
+                                       offset, length,
+                                       oflags, 0, true);
 }
 
 int virFDStreamCreateFile(virStreamPtr st,
@@ -710,7 +1078,7 @@ int virFDStreamCreateFile(virStreamPtr st,
 {
     return virFDStreamOpenFileInternal(st, path,
                                        offset, length,
-                                       oflags | O_CREAT, mode);
+                                       oflags | O_CREAT, mode, false);
 }
 
 int virFDStreamSetInternalCloseCb(virStreamPtr st,
@@ -32,6 +32,21 @@ typedef void (*virFDStreamInternalCloseCb)(virStreamPtr st, void *opaque);
 
 typedef void (*virFDStreamInternalCloseCbFreeOpaque)(void *opaque);
 
+/* Sparse streams to and from the I/O helper are framed: each chunk
+ * written to the pipe is preceded by a header telling whether it
+ * carries data, or stands for a hole in which case no data follows */
+typedef enum {
+    VIR_FDSTREAM_SPARSE_DATA = 0,
+    VIR_FDSTREAM_SPARSE_HOLE,
+} virFDStreamSparseType;
+
+typedef struct _virFDStreamSparseHeader virFDStreamSparseHeader;
+struct _virFDStreamSparseHeader {
+    unsigned int type; /* virFDStreamSparseType */
+    unsigned int padding;
+    unsigned long long length;
+};
+
 
 /* Only for use by test suite */
 void virFDStreamSetIOHelper(const char *path);
@@ -48,6 +63,11 @@ int virFDStreamOpenFile(virStreamPtr st,
                         unsigned long long offset,
                         unsigned long long length,
                         int oflags);
+int virFDStreamOpenSparseFile(virStreamPtr st,
+                              const char *path,
+                              unsigned long long offset,
+                              unsigned long long length,
+                              int oflags);
 int virFDStreamCreateFile(virStreamPtr st,
                           const char *path,
                           unsigned long long offset,
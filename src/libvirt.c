@@ -13667,12 +13667,18 @@ error:
  * @stream: stream to use as output
  * @offset: position in @vol to start reading from
  * @length: limit on amount of data to download
- * @flags: extra flags; not used yet, so callers should always pass 0
+ * @flags: bitwise-OR of virStorageVolDownloadFlags
  *
  * Download the content of the volume as a stream. If @length
  * is zero, then the remaining contents of the volume after
  * @offset will be downloaded.
  *
+ * If @flags contains VIR_STORAGE_VOL_DOWNLOAD_SPARSE_STREAM,
+ * holes in the volume are not transferred as zeroes but
+ * signalled as holes in the stream, which the caller should
+ * retrieve with virStreamRecvFlags and virStreamRecvHole.
+ * Plain virStreamRecv still works and reads holes as zeroes.
+ *
  * This call sets up an asynchronous stream; subsequent use of
  * stream APIs is necessary to transfer the actual data,
  * determine how much data is successfully transferred, and
@@ -13731,7 +13737,7 @@ error:
  * @stream: stream to use as input
  * @offset: position to start writing to
  * @length: limit on amount of data to upload
- * @flags: extra flags; not used yet, so callers should always pass 0
+ * @flags: bitwise-OR of virStorageVolUploadFlags
  *
  * Upload new content to the volume from a stream. This call
  * will fail if @offset + @length exceeds the size of the
@@ -13739,6 +13745,11 @@ error:
  * will be raised if an attempt is made to upload greater
  * than @length bytes of data.
  *
+ * If @flags contains VIR_STORAGE_VOL_UPLOAD_SPARSE_STREAM,
+ * the caller may use virStreamSendHole to skip ranges of
+ * zeroes; they are punched out of the volume rather than
+ * written.
+ *
  * This call sets up an asynchronous stream; subsequent use of
  * stream APIs is necessary to transfer the actual data,
  * determine how much data is successfully transferred, and
@@ -15893,6 +15904,168 @@ error:
 }
 
 
+/**
+ * virStreamRecvFlags:
+ * @stream: pointer to the stream object
+ * @data: buffer to read into from stream
+ * @nbytes: size of @data buffer
+ * @flags: bitwise-OR of virStreamRecvFlagsValues
+ *
+ * Reads a series of bytes from the stream, like virStreamRecv.
+ *
+ * A sparse stream (see VIR_STORAGE_VOL_DOWNLOAD_SPARSE_STREAM)
+ * may contain holes. By default they are read back as zeroes,
+ * but if @flags contains VIR_STREAM_RECV_STOP_AT_HOLE, reading
+ * stops at the start of a hole and -3 is returned. The caller
+ * should then use virStreamRecvHole to learn how large the
+ * hole is and skip over it.
+ *
+ * Returns the number of bytes read, which may be less
+ * than requested, 0 at the end of the stream, -1 upon
+ * error, -2 if there is no data pending to be read & the
+ * stream is marked as non-blocking, or -3 if the stream
+ * is positioned at a hole and VIR_STREAM_RECV_STOP_AT_HOLE
+ * was requested.
+ */
+int
+virStreamRecvFlags(virStreamPtr stream,
+                   char *data,
+                   size_t nbytes,
+                   unsigned int flags)
+{
+    VIR_DEBUG("stream=%p, data=%p, nbytes=%zi, flags=%x",
+              stream, data, nbytes, flags);
+
+    virResetLastError();
+
+    virCheckStreamReturn(stream, -1);
+    virCheckNonNullArgGoto(data, error);
+
+    if (stream->driver &&
+        (stream->driver->streamRecvFlags ||
+         stream->driver->streamRecv)) {
+        int ret;
+        /* A driver which doesn't know about holes never has any,
+         * so a plain read satisfies every flag */
+        if (stream->driver->streamRecvFlags)
+            ret = (stream->driver->streamRecvFlags)(stream, data,
+                                                    nbytes, flags);
+        else
+            ret = (stream->driver->streamRecv)(stream, data, nbytes);
+        if (ret == -2 || ret == -3)
+            return ret;
+        if (ret < 0)
+            goto error;
+        return ret;
+    }
+
+    virReportUnsupportedError();
+
+error:
+    virDispatchError(stream->conn);
+    return -1;
+}
+
+
+/**
+ * virStreamSendHole:
+ * @stream: pointer to the stream object
+ * @length: number of bytes to skip
+ * @flags: extra flags; not used yet, so callers should always pass 0
+ *
+ * Skip @length bytes of a sparse stream, which the receiving end
+ * reads back as zeroes without them being transferred. This can
+ * only be used on streams opened for a sparse transfer, such as
+ * with VIR_STORAGE_VOL_UPLOAD_SPARSE_STREAM.
+ *
+ * Returns 0 on success, -1 upon error, at which time the
+ * stream will be marked as aborted, or -2 if the outgoing
+ * transmit buffers are full & the stream is marked as
+ * non-blocking.
+ */
+int
+virStreamSendHole(virStreamPtr stream,
+                  long long length,
+                  unsigned int flags)
+{
+    VIR_DEBUG("stream=%p, length=%lld, flags=%x",
+              stream, length, flags);
+
+    virResetLastError();
+
+    virCheckStreamReturn(stream, -1);
+    if (length < 0) {
+        virReportInvalidArg(length,
+                            _("length in %s must not be negative"),
+                            __FUNCTION__);
+        goto error;
+    }
+
+    if (stream->driver &&
+        stream->driver->streamSendHole) {
+        int ret;
+        ret = (stream->driver->streamSendHole)(stream, length, flags);
+        if (ret == -2)
+            return -2;
+        if (ret < 0)
+            goto error;
+        return ret;
+    }
+
+    virReportUnsupportedError();
+
+error:
+    virDispatchError(stream->conn);
+    return -1;
+}
+
+
+/**
+ * virStreamRecvHole:
+ * @stream: pointer to the stream object
+ * @length: returns the size of the hole
+ * @flags: extra flags; not used yet, so callers should always pass 0
+ *
+ * Consumes the hole the stream is positioned at, typically after
+ * virStreamRecvFlags returned -3, and stores its size in @length.
+ * If the stream is not positioned at a hole, @length is set to 0.
+ *
+ * Returns 0 on success, -1 upon error.
+ */
+int
+virStreamRecvHole(virStreamPtr stream,
+                  long long *length,
+                  unsigned int flags)
+{
+    VIR_DEBUG("stream=%p, length=%p, flags=%x",
+              stream, length, flags);
+
+    virResetLastError();
+
+    virCheckStreamReturn(stream, -1);
+    virCheckNonNullArgGoto(length, error);
+
+    if (stream->driver &&
+        stream->driver->streamRecvHole) {
+        if ((stream->driver->streamRecvHole)(stream, length, flags) < 0)
+            goto error;
+        return 0;
+    }
+
+    /* Streams without hole support never stop at one */
+    if (stream->driver &&
+        stream->driver->streamRecv) {
+        *length = 0;
+        return 0;
+    }
+
+    virReportUnsupportedError();
+
+error:
+    virDispatchError(stream->conn);
+    return -1;
+}
+
 /**
  * virStreamSendAll:
  * @stream: pointer to the stream object
@@ -17316,6 +17489,12 @@ error:
  * may receive fields that they do not understand in case they talk to a
  * newer server.
  *
+ * When no job is active, @type is set to VIR_DOMAIN_JOB_NONE. Callers
+ * must not assume @params is then empty: fields which describe the
+ * domain rather than a particular job, such as the job wait histogram
+ * (VIR_DOMAIN_JOB_WAIT_COUNT and friends), may still be returned and
+ * @params must be freed as usual.
+ *
  * Returns 0 in case of success and -1 in case of failure.
  */
 int
@@ -30,6 +30,7 @@
 #include "lock_protocol.h"
 #include "lock_daemon_dispatch_stubs.h"
 #include "virerror.h"
+#include "viralloc.h"
 
 #define VIR_FROM_THIS VIR_FROM_RPC
 
@@ -93,6 +94,102 @@ cleanup:
 }
 
 
+static int
+virLockSpaceProtocolDispatchAcquireResources(virNetServerPtr server ATTRIBUTE_UNUSED,
+                                             virNetServerClientPtr client,
+                                             virNetMessagePtr msg ATTRIBUTE_UNUSED,
+                                             virNetMessageErrorPtr rerr,
+                                             virLockSpaceProtocolAcquireResourcesArgs *args)
+{
+    int rv = -1;
+    unsigned int flags = args->flags;
+    virLockDaemonClientPtr priv =
+        virNetServerClientGetPrivateData(client);
+    virLockSpaceProtocolResource *res = args->resources.resources_val;
+    size_t nres = args->resources.resources_len;
+    virLockSpacePtr *lockspaces = NULL;
+    virErrorPtr orig_err;
+    size_t i;
+
+    virMutexLock(&priv->lock);
+
+    virCheckFlagsGoto(0, cleanup);
+
+    if (priv->restricted) {
+        virReportError(VIR_ERR_OPERATION_DENIED, "%s",
+                       _("lock manager connection has been restricted"));
+        goto cleanup;
+    }
+
+    if (!priv->ownerPid) {
+        virReportError(VIR_ERR_OPERATION_INVALID, "%s",
+                       _("lock owner details have not been registered"));
+        goto cleanup;
+    }
+
+    if (VIR_ALLOC_N(lockspaces, nres) < 0)
+        goto cleanup;
+
+    /* Validate the whole request before taking any lock */
+    for (i = 0; i < nres; i++) {
+        if (res[i].flags & ~(VIR_LOCK_SPACE_PROTOCOL_ACQUIRE_RESOURCE_SHARED |
+                             VIR_LOCK_SPACE_PROTOCOL_ACQUIRE_RESOURCE_AUTOCREATE)) {
+            virReportError(VIR_ERR_INVALID_ARG,
+                           _("unsupported flags (0x%x) for resource %s"),
+                           res[i].flags, res[i].name);
+            goto cleanup;
+        }
+
+        if (!(lockspaces[i] = virLockDaemonFindLockSpace(lockDaemon,
+                                                         res[i].path))) {
+            virReportError(VIR_ERR_INTERNAL_ERROR,
+                           _("Lockspace for path %s does not exist"),
+                           res[i].path);
+            goto cleanup;
+        }
+    }
+
+    for (i = 0; i < nres; i++) {
+        unsigned int newFlags = 0;
+
+        if (res[i].flags & VIR_LOCK_SPACE_PROTOCOL_ACQUIRE_RESOURCE_SHARED)
+            newFlags |= VIR_LOCK_SPACE_ACQUIRE_SHARED;
+        if (res[i].flags & VIR_LOCK_SPACE_PROTOCOL_ACQUIRE_RESOURCE_AUTOCREATE)
+            newFlags |= VIR_LOCK_SPACE_ACQUIRE_AUTOCREATE;
+
+        if (virLockSpaceAcquireResource(lockspaces[i],
+                                        res[i].name,
+                                        priv->ownerPid,
+                                        newFlags) < 0)
+            break;
+    }
+
+    if (i < nres) {
+        /* Give back whatever this request got so far */
+        orig_err = virSaveLastError();
+        while (i-- > 0) {
+            if (virLockSpaceReleaseResource(lockspaces[i],
+                                            res[i].name,
+                                            priv->ownerPid) < 0)
+                VIR_WARN("Unable to release resource %s after failed acquire",
+                         res[i].name);
+        }
+        virSetError(orig_err);
+        virFreeError(orig_err);
+        goto cleanup;
+    }
+
+    rv = 0;
+
+cleanup:
+    if (rv < 0)
+        virNetMessageSaveError(rerr);
+    virMutexUnlock(&priv->lock);
+    VIR_FREE(lockspaces);
+    return rv;
+}
+
+
 static int
 virLockSpaceProtocolDispatchCreateResource(virNetServerPtr server ATTRIBUTE_UNUSED,
                                            virNetServerClientPtr client,
@@ -261,7 +358,7 @@ virLockSpaceProtocolDispatchRegister(virNetServerPtr server ATTRIBUTE_UNUSED,
 
     virMutexLock(&priv->lock);
 
-    virCheckFlagsGoto(0, cleanup);
+    virCheckFlagsGoto(VIR_LOCK_SPACE_PROTOCOL_REGISTER_REPLACE, cleanup);
 
     if (priv->restricted) {
         virReportError(VIR_ERR_OPERATION_DENIED, "%s",
@@ -270,11 +367,17 @@ virLockSpaceProtocolDispatchRegister(virNetServerPtr server ATTRIBUTE_UNUSED,
     }
 
     if (priv->ownerPid) {
-        virReportError(VIR_ERR_OPERATION_INVALID, "%s",
-                       _("lock owner details have already been registered"));
-        goto cleanup;
+        /* A connection made by the owner itself releases the owner's
+         * locks when it closes, so it must stay bound to that owner */
+        if (!(flags & VIR_LOCK_SPACE_PROTOCOL_REGISTER_REPLACE) ||
+            priv->clientPid == priv->ownerPid) {
+            virReportError(VIR_ERR_OPERATION_INVALID, "%s",
+                           _("lock owner details have already been registered"));
+            goto cleanup;
+        }
     }
 
+    VIR_FREE(priv->ownerName);
     if (VIR_STRDUP(priv->ownerName, args->owner.name) < 0)
         goto cleanup;
     memcpy(priv->ownerUUID, args->owner.uuid, VIR_UUID_BUFLEN);
@@ -344,6 +447,75 @@ cleanup:
 }
 
 
+static int
+virLockSpaceProtocolDispatchReleaseResources(virNetServerPtr server ATTRIBUTE_UNUSED,
+                                             virNetServerClientPtr client,
+                                             virNetMessagePtr msg ATTRIBUTE_UNUSED,
+                                             virNetMessageErrorPtr rerr,
+                                             virLockSpaceProtocolReleaseResourcesArgs *args)
+{
+    int rv = -1;
+    unsigned int flags = args->flags;
+    virLockDaemonClientPtr priv =
+        virNetServerClientGetPrivateData(client);
+    virLockSpaceProtocolResource *res = args->resources.resources_val;
+    virErrorPtr orig_err = NULL;
+    virLockSpacePtr lockspace;
+    size_t i;
+
+    virMutexLock(&priv->lock);
+
+    virCheckFlagsGoto(0, cleanup);
+
+    if (priv->restricted) {
+        virReportError(VIR_ERR_OPERATION_DENIED, "%s",
+                       _("lock manager connection has been restricted"));
+        goto cleanup;
+    }
+
+    if (!priv->ownerPid) {
+        virReportError(VIR_ERR_OPERATION_INVALID, "%s",
+                       _("lock owner details have not been registered"));
+        goto cleanup;
+    }
+
+    /* Release as much as possible, reporting the first failure */
+    for (i = 0; i < args->resources.resources_len; i++) {
+        if (res[i].flags) {
+            virReportError(VIR_ERR_INVALID_ARG,
+                           _("unsupported flags (0x%x) for resource %s"),
+                           res[i].flags, res[i].name);
+        } else if (!(lockspace = virLockDaemonFindLockSpace(lockDaemon,
+                                                            res[i].path))) {
+            virReportError(VIR_ERR_INTERNAL_ERROR,
+                           _("Lockspace for path %s does not exist"),
+                           res[i].path);
+        } else if (virLockSpaceReleaseResource(lockspace,
+                                               res[i].name,
+                                               priv->ownerPid) == 0) {
+            continue;
+        }
+
+        if (!orig_err)
+            orig_err = virSaveLastError();
+    }
+
+    if (orig_err) {
+        virSetError(orig_err);
+        virFreeError(orig_err);
+        goto cleanup;
+    }
+
+    rv = 0;
+
+cleanup:
+    if (rv < 0)
+        virNetMessageSaveError(rerr);
+    virMutexUnlock(&priv->lock);
+    return rv;
+}
+
+
 static int
 virLockSpaceProtocolDispatchRestrict(virNetServerPtr server ATTRIBUTE_UNUSED,
                                      virNetServerClientPtr client,
@@ -75,6 +75,16 @@ struct _virLockManagerLockDaemonDriver {
     char *fileLockSpaceDir;
     char *lvmLockSpaceDir;
     char *scsiLockSpaceDir;
+
+    /* Connection shared by the calls made from within libvirtd,
+     * re-registered to each domain it acts for */
+    virMutex lock;
+    virNetClientPtr client;
+    virNetClientProgramPtr program;
+    int counter;
+
+    /* virtlockd predates batched calls and owner replacement */
+    bool legacy;
 };
 
 static virLockManagerLockDaemonDriverPtr driver = NULL;
@@ -193,7 +203,8 @@ static int
 virLockManagerLockDaemonConnectionRegister(virLockManagerPtr lock,
                                            virNetClientPtr client,
                                            virNetClientProgramPtr program,
-                                           int *counter)
+                                           int *counter,
+                                           unsigned int flags)
 {
     virLockManagerLockDaemonPrivatePtr priv = lock->privateData;
     virLockSpaceProtocolRegisterArgs args;
@@ -201,7 +212,7 @@ virLockManagerLockDaemonConnectionRegister(virLockManagerPtr lock,
 
     memset(&args, 0, sizeof(args));
 
-    args.flags = 0;
+    args.flags = flags;
     memcpy(args.owner.uuid, priv->uuid, VIR_UUID_BUFLEN);
     args.owner.name = priv->name;
     args.owner.id = priv->id;
@@ -308,7 +319,7 @@ virLockManagerLockDaemonConnect(virLockManagerPtr lock,
     if (virLockManagerLockDaemonConnectionRegister(lock,
                                                    client,
                                                    *program,
-                                                   counter) < 0)
+                                                   counter, 0) < 0)
         goto error;
 
     return client;
@@ -377,6 +388,13 @@ static int virLockManagerLockDaemonInit(unsigned int version,
     if (VIR_ALLOC(driver) < 0)
         return -1;
 
+    if (virMutexInit(&driver->lock) < 0) {
+        virReportSystemError(errno, "%s",
+                             _("Unable to initialize mutex"));
+        VIR_FREE(driver);
+        return -1;
+    }
+
     driver->requireLeaseForDisks = true;
     driver->autoDiskLease = true;
 
@@ -409,7 +427,14 @@ static int virLockManagerLockDaemonDeinit(void)
     if (!driver)
         return 0;
 
+    virNetClientClose(driver->client);
+    virObjectUnref(driver->client);
+    virObjectUnref(driver->program);
+    virMutexDestroy(&driver->lock);
+
     VIR_FREE(driver->fileLockSpaceDir);
+    VIR_FREE(driver->lvmLockSpaceDir);
+    VIR_FREE(driver->scsiLockSpaceDir);
     VIR_FREE(driver);
 
     return 0;
@@ -682,6 +707,192 @@ error:
 }
 
 
+/* Acquire or release all of @lock's resources over @client, in a
+ * single call unless virtlockd is too old to support that */
+static int
+virLockManagerLockDaemonCallResources(virLockManagerPtr lock,
+                                      virNetClientPtr client,
+                                      virNetClientProgramPtr program,
+                                      int *counter,
+                                      bool acquire)
+{
+    virLockManagerLockDaemonPrivatePtr priv = lock->privateData;
+    virLockSpaceProtocolAcquireResourcesArgs acquireArgs;
+    virLockSpaceProtocolReleaseResourcesArgs releaseArgs;
+    virLockSpaceProtocolResource *res = NULL;
+    virErrorPtr err;
+    size_t i;
+    int rv = -1;
+
+    if (priv->nresources == 0)
+        return 0;
+
+    if (driver->legacy)
+        goto legacy;
+
+    if (VIR_ALLOC_N(res, priv->nresources) < 0)
+        return -1;
+
+    for (i = 0; i < priv->nresources; i++) {
+        res[i].path = priv->resources[i].lockspace;
+        res[i].name = priv->resources[i].name;
+        if (acquire)
+            res[i].flags = priv->resources[i].flags;
+    }
+
+    if (acquire) {
+        memset(&acquireArgs, 0, sizeof(acquireArgs));
+        acquireArgs.resources.resources_val = res;
+        acquireArgs.resources.resources_len = priv->nresources;
+
+        rv = virNetClientProgramCall(program,
+                                     client,
+                                     (*counter)++,
+                                     VIR_LOCK_SPACE_PROTOCOL_PROC_ACQUIRE_RESOURCES,
+                                     0, NULL, NULL, NULL,
+                                     (xdrproc_t)xdr_virLockSpaceProtocolAcquireResourcesArgs, (char*)&acquireArgs,
+                                     (xdrproc_t)xdr_void, NULL);
+    } else {
+        memset(&releaseArgs, 0, sizeof(releaseArgs));
+        releaseArgs.resources.resources_val = res;
+        releaseArgs.resources.resources_len = priv->nresources;
+
+        rv = virNetClientProgramCall(program,
+                                     client,
+                                     (*counter)++,
+                                     VIR_LOCK_SPACE_PROTOCOL_PROC_RELEASE_RESOURCES,
+                                     0, NULL, NULL, NULL,
+                                     (xdrproc_t)xdr_virLockSpaceProtocolReleaseResourcesArgs, (char*)&releaseArgs,
+                                     (xdrproc_t)xdr_void, NULL);
+    }
+    if (rv == 0)
+        goto cleanup;
+
+    /* An unknown procedure is rejected without closing the connection */
+    err = virGetLastError();
+    if (!err || err->code != VIR_ERR_RPC || !virNetClientIsOpen(client))
+        goto cleanup;
+
+    VIR_DEBUG("virtlockd lacks batched resource calls, falling back");
+    virResetLastError();
+    driver->legacy = true;
+    rv = -1;
+
+legacy:
+    for (i = 0; i < priv->nresources; i++) {
+        if (acquire) {
+            virLockSpaceProtocolAcquireResourceArgs args;
+
+            memset(&args, 0, sizeof(args));
+            args.path = priv->resources[i].lockspace;
+            args.name = priv->resources[i].name;
+            args.flags = priv->resources[i].flags;
+
+            if (virNetClientProgramCall(program,
+                                        client,
+                                        (*counter)++,
+                                        VIR_LOCK_SPACE_PROTOCOL_PROC_ACQUIRE_RESOURCE,
+                                        0, NULL, NULL, NULL,
+                                        (xdrproc_t)xdr_virLockSpaceProtocolAcquireResourceArgs, &args,
+                                        (xdrproc_t)xdr_void, NULL) < 0)
+                goto cleanup;
+        } else {
+            virLockSpaceProtocolReleaseResourceArgs args;
+
+            memset(&args, 0, sizeof(args));
+            args.path = priv->resources[i].lockspace;
+            args.name = priv->resources[i].name;
+
+            if (virNetClientProgramCall(program,
+                                        client,
+                                        (*counter)++,
+                                        VIR_LOCK_SPACE_PROTOCOL_PROC_RELEASE_RESOURCE,
+                                        0, NULL, NULL, NULL,
+                                        (xdrproc_t)xdr_virLockSpaceProtocolReleaseResourceArgs, &args,
+                                        (xdrproc_t)xdr_void, NULL) < 0)
+                goto cleanup;
+        }
+    }
+
+    rv = 0;
+
+cleanup:
+    VIR_FREE(res);
+    return rv;
+}
+
+
+/* Acquire or release @lock's resources over the shared connection,
+ * opening it first if needed. Returns 1 if virtlockd does not allow
+ * a connection to act for several owners, in which case the caller
+ * must use a connection of its own. */
+static int
+virLockManagerLockDaemonSharedCall(virLockManagerPtr lock,
+                                   bool acquire)
+{
+    virErrorPtr err;
+    int rv = -1;
+
+    virMutexLock(&driver->lock);
+
+    if (driver->legacy) {
+        rv = 1;
+        goto cleanup;
+    }
+
+    if (driver->client && !virNetClientIsOpen(driver->client)) {
+        VIR_DEBUG("Dropping closed virtlockd connection");
+        virObjectUnref(driver->client);
+        virObjectUnref(driver->program);
+        driver->client = NULL;
+        driver->program = NULL;
+    }
+
+    if (!driver->client) {
+        if (!(driver->client =
+              virLockManagerLockDaemonConnectionNew(geteuid() == 0,
+                                                    &driver->program)))
+            goto cleanup;
+        driver->counter = 0;
+    }
+
+    if (virLockManagerLockDaemonConnectionRegister(lock,
+                                                   driver->client,
+                                                   driver->program,
+                                                   &driver->counter,
+                                                   VIR_LOCK_SPACE_PROTOCOL_REGISTER_REPLACE) < 0) {
+        err = virGetLastError();
+        if (err && err->code == VIR_ERR_INVALID_ARG &&
+            virNetClientIsOpen(driver->client)) {
+            VIR_DEBUG("virtlockd cannot replace owners, not sharing connection");
+            virResetLastError();
+            driver->legacy = true;
+            rv = 1;
+        }
+        goto cleanup;
+    }
+
+    if (virLockManagerLockDaemonCallResources(lock,
+                                              driver->client,
+                                              driver->program,
+                                              &driver->counter,
+                                              acquire) < 0)
+        goto cleanup;
+
+    rv = 0;
+
+cleanup:
+    if (rv != 0 && driver->client && !virNetClientIsOpen(driver->client)) {
+        virObjectUnref(driver->client);
+        virObjectUnref(driver->program);
+        driver->client = NULL;
+        driver->program = NULL;
+    }
+    virMutexUnlock(&driver->lock);
+    return rv;
+}
+
+
 static int virLockManagerLockDaemonAcquire(virLockManagerPtr lock,
                                            const char *state ATTRIBUTE_UNUSED,
                                            unsigned int flags,
@@ -705,6 +916,16 @@ static int virLockManagerLockDaemonAcquire(virLockManagerPtr lock,
         return -1;
     }
 
+    /* Without an FD to hand over, the connection does not need to
+     * outlive this call and the shared one will do */
+    if (!fd &&
+        !(flags & (VIR_LOCK_MANAGER_ACQUIRE_REGISTER_ONLY |
+                   VIR_LOCK_MANAGER_ACQUIRE_RESTRICT))) {
+        if ((rv = virLockManagerLockDaemonSharedCall(lock, true)) <= 0)
+            return rv;
+        rv = -1;
+    }
+
     if (!(client = virLockManagerLockDaemonConnect(lock, &program, &counter)))
         goto cleanup;
 
@@ -712,28 +933,10 @@ static int virLockManagerLockDaemonAcquire(virLockManagerPtr lock,
         (*fd = virNetClientDupFD(client, false)) < 0)
         goto cleanup;
 
-    if (!(flags & VIR_LOCK_MANAGER_ACQUIRE_REGISTER_ONLY)) {
-        size_t i;
-        for (i = 0; i < priv->nresources; i++) {
-            virLockSpaceProtocolAcquireResourceArgs args;
-
-            memset(&args, 0, sizeof(args));
-
-            if (priv->resources[i].lockspace)
-                args.path = priv->resources[i].lockspace;
-            args.name = priv->resources[i].name;
-            args.flags = priv->resources[i].flags;
-
-            if (virNetClientProgramCall(program,
-                                        client,
-                                        counter++,
-                                        VIR_LOCK_SPACE_PROTOCOL_PROC_ACQUIRE_RESOURCE,
-                                        0, NULL, NULL, NULL,
-                                        (xdrproc_t)xdr_virLockSpaceProtocolAcquireResourceArgs, &args,
-                                        (xdrproc_t)xdr_void, NULL) < 0)
-                goto cleanup;
-        }
-    }
+    if (!(flags & VIR_LOCK_MANAGER_ACQUIRE_REGISTER_ONLY) &&
+        virLockManagerLockDaemonCallResources(lock, client, program,
+                                              &counter, true) < 0)
+        goto cleanup;
 
     if ((flags & VIR_LOCK_MANAGER_ACQUIRE_RESTRICT) &&
         virLockManagerLockDaemonConnectionRestrict(lock, client, program, &counter) < 0)
@@ -759,40 +962,22 @@ static int virLockManagerLockDaemonRelease(virLockManagerPtr lock,
     virNetClientProgramPtr program = NULL;
     int counter = 0;
     int rv = -1;
-    size_t i;
-    virLockManagerLockDaemonPrivatePtr priv = lock->privateData;
 
     virCheckFlags(0, -1);
 
     if (state)
         *state = NULL;
 
+    if ((rv = virLockManagerLockDaemonSharedCall(lock, false)) <= 0)
+        return rv;
+    rv = -1;
+
     if (!(client = virLockManagerLockDaemonConnect(lock, &program, &counter)))
         goto cleanup;
 
-    for (i = 0; i < priv->nresources; i++) {
-        virLockSpaceProtocolReleaseResourceArgs args;
-
-        memset(&args, 0, sizeof(args));
-
-        if (priv->resources[i].lockspace)
-            args.path = priv->resources[i].lockspace;
-        args.name = priv->resources[i].name;
-        args.flags = priv->resources[i].flags;
-
-        args.flags &=
-            ~(VIR_LOCK_SPACE_PROTOCOL_ACQUIRE_RESOURCE_SHARED |
-              VIR_LOCK_SPACE_PROTOCOL_ACQUIRE_RESOURCE_AUTOCREATE);
-
-        if (virNetClientProgramCall(program,
-                                    client,
-                                    counter++,
-                                    VIR_LOCK_SPACE_PROTOCOL_PROC_RELEASE_RESOURCE,
-                                    0, NULL, NULL, NULL,
-                                    (xdrproc_t)xdr_virLockSpaceProtocolReleaseResourceArgs, &args,
-                                    (xdrproc_t)xdr_void, NULL) < 0)
-            goto cleanup;
-    }
+    if (virLockManagerLockDaemonCallResources(lock, client, program,
+                                              &counter, false) < 0)
+        goto cleanup;
 
     rv = 0;
 
@@ -49,6 +49,15 @@ xdr_virLockSpaceProtocolOwner (XDR *xdrs, virLockSpaceProtocolOwner *objp)
         return TRUE;
 }
 
+bool_t
+xdr_virLockSpaceProtocolRegisterFlags (XDR *xdrs, virLockSpaceProtocolRegisterFlags *objp)
+{
+
+         if (!xdr_enum (xdrs, (enum_t *) objp))
+                 return FALSE;
+        return TRUE;
+}
+
 bool_t
 xdr_virLockSpaceProtocolRegisterArgs (XDR *xdrs, virLockSpaceProtocolRegisterArgs *objp)
 {
@@ -141,6 +150,45 @@ xdr_virLockSpaceProtocolReleaseResourceArgs (XDR *xdrs, virLockSpaceProtocolRele
         return TRUE;
 }
 
+bool_t
+xdr_virLockSpaceProtocolResource (XDR *xdrs, virLockSpaceProtocolResource *objp)
+{
+
+         if (!xdr_virLockSpaceProtocolNonNullString (xdrs, &objp->path))
+                 return FALSE;
+         if (!xdr_virLockSpaceProtocolNonNullString (xdrs, &objp->name))
+                 return FALSE;
+         if (!xdr_u_int (xdrs, &objp->flags))
+                 return FALSE;
+        return TRUE;
+}
+
+bool_t
+xdr_virLockSpaceProtocolAcquireResourcesArgs (XDR *xdrs, virLockSpaceProtocolAcquireResourcesArgs *objp)
+{
+        char **objp_cpp0 = (char **) (void *) &objp->resources.resources_val;
+
+         if (!xdr_array (xdrs, objp_cpp0, (u_int *) &objp->resources.resources_len, VIR_LOCK_SPACE_PROTOCOL_RESOURCES_MAX,
+                sizeof (virLockSpaceProtocolResource), (xdrproc_t) xdr_virLockSpaceProtocolResource))
+                 return FALSE;
+         if (!xdr_u_int (xdrs, &objp->flags))
+                 return FALSE;
+        return TRUE;
+}
+
+bool_t
+xdr_virLockSpaceProtocolReleaseResourcesArgs (XDR *xdrs, virLockSpaceProtocolReleaseResourcesArgs *objp)
+{
+        char **objp_cpp0 = (char **) (void *) &objp->resources.resources_val;
+
+         if (!xdr_array (xdrs, objp_cpp0, (u_int *) &objp->resources.resources_len, VIR_LOCK_SPACE_PROTOCOL_RESOURCES_MAX,
+                sizeof (virLockSpaceProtocolResource), (xdrproc_t) xdr_virLockSpaceProtocolResource))
+                 return FALSE;
+         if (!xdr_u_int (xdrs, &objp->flags))
+                 return FALSE;
+        return TRUE;
+}
+
 bool_t
 xdr_virLockSpaceProtocolCreateLockSpaceArgs (XDR *xdrs, virLockSpaceProtocolCreateLockSpaceArgs *objp)
 {
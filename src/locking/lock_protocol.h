@@ -30,6 +30,11 @@ struct virLockSpaceProtocolOwner {
 };
 typedef struct virLockSpaceProtocolOwner virLockSpaceProtocolOwner;
 
+enum virLockSpaceProtocolRegisterFlags {
+        VIR_LOCK_SPACE_PROTOCOL_REGISTER_REPLACE = 1,
+};
+typedef enum virLockSpaceProtocolRegisterFlags virLockSpaceProtocolRegisterFlags;
+
 struct virLockSpaceProtocolRegisterArgs {
         virLockSpaceProtocolOwner owner;
         u_int flags;
@@ -80,6 +85,32 @@ struct virLockSpaceProtocolReleaseResourceArgs {
         u_int flags;
 };
 typedef struct virLockSpaceProtocolReleaseResourceArgs virLockSpaceProtocolReleaseResourceArgs;
+#define VIR_LOCK_SPACE_PROTOCOL_RESOURCES_MAX 4096
+
+struct virLockSpaceProtocolResource {
+        virLockSpaceProtocolNonNullString path;
+        virLockSpaceProtocolNonNullString name;
+        u_int flags;
+};
+typedef struct virLockSpaceProtocolResource virLockSpaceProtocolResource;
+
+struct virLockSpaceProtocolAcquireResourcesArgs {
+        struct {
+                u_int resources_len;
+                virLockSpaceProtocolResource *resources_val;
+        } resources;
+        u_int flags;
+};
+typedef struct virLockSpaceProtocolAcquireResourcesArgs virLockSpaceProtocolAcquireResourcesArgs;
+
+struct virLockSpaceProtocolReleaseResourcesArgs {
+        struct {
+                u_int resources_len;
+                virLockSpaceProtocolResource *resources_val;
+        } resources;
+        u_int flags;
+};
+typedef struct virLockSpaceProtocolReleaseResourcesArgs virLockSpaceProtocolReleaseResourcesArgs;
 
 struct virLockSpaceProtocolCreateLockSpaceArgs {
         virLockSpaceProtocolNonNullString path;
@@ -97,6 +128,8 @@ enum virLockSpaceProtocolProcedure {
         VIR_LOCK_SPACE_PROTOCOL_PROC_ACQUIRE_RESOURCE = 6,
         VIR_LOCK_SPACE_PROTOCOL_PROC_RELEASE_RESOURCE = 7,
         VIR_LOCK_SPACE_PROTOCOL_PROC_CREATE_LOCKSPACE = 8,
+        VIR_LOCK_SPACE_PROTOCOL_PROC_ACQUIRE_RESOURCES = 9,
+        VIR_LOCK_SPACE_PROTOCOL_PROC_RELEASE_RESOURCES = 10,
 };
 typedef enum virLockSpaceProtocolProcedure virLockSpaceProtocolProcedure;
 
@@ -107,6 +140,7 @@ extern  bool_t xdr_virLockSpaceProtocolUUID (XDR *, virLockSpaceProtocolUUID);
 extern  bool_t xdr_virLockSpaceProtocolNonNullString (XDR *, virLockSpaceProtocolNonNullString*);
 extern  bool_t xdr_virLockSpaceProtocolString (XDR *, virLockSpaceProtocolString*);
 extern  bool_t xdr_virLockSpaceProtocolOwner (XDR *, virLockSpaceProtocolOwner*);
+extern  bool_t xdr_virLockSpaceProtocolRegisterFlags (XDR *, virLockSpaceProtocolRegisterFlags*);
 extern  bool_t xdr_virLockSpaceProtocolRegisterArgs (XDR *, virLockSpaceProtocolRegisterArgs*);
 extern  bool_t xdr_virLockSpaceProtocolRestrictArgs (XDR *, virLockSpaceProtocolRestrictArgs*);
 extern  bool_t xdr_virLockSpaceProtocolNewArgs (XDR *, virLockSpaceProtocolNewArgs*);
@@ -115,6 +149,9 @@ extern  bool_t xdr_virLockSpaceProtocolDeleteResourceArgs (XDR *, virLockSpacePr
 extern  bool_t xdr_virLockSpaceProtocolAcquireResourceFlags (XDR *, virLockSpaceProtocolAcquireResourceFlags*);
 extern  bool_t xdr_virLockSpaceProtocolAcquireResourceArgs (XDR *, virLockSpaceProtocolAcquireResourceArgs*);
 extern  bool_t xdr_virLockSpaceProtocolReleaseResourceArgs (XDR *, virLockSpaceProtocolReleaseResourceArgs*);
+extern  bool_t xdr_virLockSpaceProtocolResource (XDR *, virLockSpaceProtocolResource*);
+extern  bool_t xdr_virLockSpaceProtocolAcquireResourcesArgs (XDR *, virLockSpaceProtocolAcquireResourcesArgs*);
+extern  bool_t xdr_virLockSpaceProtocolReleaseResourcesArgs (XDR *, virLockSpaceProtocolReleaseResourcesArgs*);
 extern  bool_t xdr_virLockSpaceProtocolCreateLockSpaceArgs (XDR *, virLockSpaceProtocolCreateLockSpaceArgs*);
 extern  bool_t xdr_virLockSpaceProtocolProcedure (XDR *, virLockSpaceProtocolProcedure*);
 
@@ -123,6 +160,7 @@ extern bool_t xdr_virLockSpaceProtocolUUID ();
 extern bool_t xdr_virLockSpaceProtocolNonNullString ();
 extern bool_t xdr_virLockSpaceProtocolString ();
 extern bool_t xdr_virLockSpaceProtocolOwner ();
+extern bool_t xdr_virLockSpaceProtocolRegisterFlags ();
 extern bool_t xdr_virLockSpaceProtocolRegisterArgs ();
 extern bool_t xdr_virLockSpaceProtocolRestrictArgs ();
 extern bool_t xdr_virLockSpaceProtocolNewArgs ();
@@ -131,6 +169,9 @@ extern bool_t xdr_virLockSpaceProtocolDeleteResourceArgs ();
 extern bool_t xdr_virLockSpaceProtocolAcquireResourceFlags ();
 extern bool_t xdr_virLockSpaceProtocolAcquireResourceArgs ();
 extern bool_t xdr_virLockSpaceProtocolReleaseResourceArgs ();
+extern bool_t xdr_virLockSpaceProtocolResource ();
+extern bool_t xdr_virLockSpaceProtocolAcquireResourcesArgs ();
+extern bool_t xdr_virLockSpaceProtocolReleaseResourcesArgs ();
 extern bool_t xdr_virLockSpaceProtocolCreateLockSpaceArgs ();
 extern bool_t xdr_virLockSpaceProtocolProcedure ();
 
@@ -24,6 +24,11 @@ struct virLockSpaceProtocolOwner {
     unsigned int pid;
 };
 
+enum virLockSpaceProtocolRegisterFlags {
+    /* Replace the owner registered earlier on this connection */
+    VIR_LOCK_SPACE_PROTOCOL_REGISTER_REPLACE = 1
+};
+
 struct virLockSpaceProtocolRegisterArgs {
     virLockSpaceProtocolOwner owner;
     unsigned int flags;
@@ -67,6 +72,25 @@ struct virLockSpaceProtocolReleaseResourceArgs {
     unsigned int flags;
 };
 
+/* Upper bound on the resources passed in a single call */
+const VIR_LOCK_SPACE_PROTOCOL_RESOURCES_MAX = 4096;
+
+struct virLockSpaceProtocolResource {
+    virLockSpaceProtocolNonNullString path;
+    virLockSpaceProtocolNonNullString name;
+    unsigned int flags;
+};
+
+struct virLockSpaceProtocolAcquireResourcesArgs {
+    virLockSpaceProtocolResource resources<VIR_LOCK_SPACE_PROTOCOL_RESOURCES_MAX>;
+    unsigned int flags;
+};
+
+struct virLockSpaceProtocolReleaseResourcesArgs {
+    virLockSpaceProtocolResource resources<VIR_LOCK_SPACE_PROTOCOL_RESOURCES_MAX>;
+    unsigned int flags;
+};
+
 struct virLockSpaceProtocolCreateLockSpaceArgs {
     virLockSpaceProtocolNonNullString path;
 };
@@ -149,5 +173,17 @@ enum virLockSpaceProtocolProcedure {
      * @generate: none
      * @acl: none
      */
-    VIR_LOCK_SPACE_PROTOCOL_PROC_CREATE_LOCKSPACE = 8
+    VIR_LOCK_SPACE_PROTOCOL_PROC_CREATE_LOCKSPACE = 8,
+
+    /**
+     * @generate: none
+     * @acl: none
+     */
+    VIR_LOCK_SPACE_PROTOCOL_PROC_ACQUIRE_RESOURCES = 9,
+
+    /**
+     * @generate: none
+     * @acl: none
+     */
+    VIR_LOCK_SPACE_PROTOCOL_PROC_RELEASE_RESOURCES = 10
 };
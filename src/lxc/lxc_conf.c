@@ -226,6 +226,7 @@ virLXCDriverConfigNew(void)
         goto error;
     if (VIR_STRDUP(cfg->autostartDir, LXC_AUTOSTART_DIR) < 0)
         goto error;
+    cfg->autoStartMaxConcurrent = 1;
 
     return cfg;
 error:
@@ -276,6 +277,52 @@ virLXCLoadDriverConfig(virLXCDriverConfigPtr cfg,
     CHECK_TYPE("security_require_confined", VIR_CONF_LONG);
     if (p) cfg->securityRequireConfined = p->l;
 
+    p = virConfGetValue(conf, "auto_start_max_concurrent");
+    CHECK_TYPE("auto_start_max_concurrent", VIR_CONF_LONG);
+    if (p) {
+        if (p->l < 1) {
+            virReportError(VIR_ERR_INTERNAL_ERROR,
+                           _("%s: auto_start_max_concurrent: must be "
+                             "greater than 0"), filename);
+            virConfFree(conf);
+            return -1;
+        }
+        cfg->autoStartMaxConcurrent = p->l;
+    }
+
+    p = virConfGetValue(conf, "auto_start_reserved_memory");
+    CHECK_TYPE("auto_start_reserved_memory", VIR_CONF_LONG);
+    if (p) cfg->autoStartReservedMemory = p->l;
+
+    p = virConfGetValue(conf, "auto_start_groups");
+    CHECK_TYPE("auto_start_groups", VIR_CONF_LIST);
+    if (p) {
+        virConfValuePtr pp;
+        size_t i;
+
+        virStringFreeList(cfg->autoStartGroups);
+        cfg->autoStartGroups = NULL;
+        for (i = 0, pp = p->list; pp; pp = pp->next)
+            i++;
+        if (VIR_ALLOC_N(cfg->autoStartGroups, i + 1) < 0) {
+            virConfFree(conf);
+            return -1;
+        }
+
+        for (i = 0, pp = p->list; pp; i++, pp = pp->next) {
+            if (pp->type != VIR_CONF_STRING) {
+                virReportError(VIR_ERR_CONF_SYNTAX, "%s",
+                               _("auto_start_groups must be a "
+                                 "list of strings"));
+                virConfFree(conf);
+                return -1;
+            }
+            if (VIR_STRDUP(cfg->autoStartGroups[i], pp->str) < 0) {
+                virConfFree(conf);
+                return -1;
+            }
+        }
+    }
 
 #undef CHECK_TYPE
 
@@ -304,4 +351,5 @@ virLXCDriverConfigDispose(void *obj)
     VIR_FREE(cfg->stateDir);
     VIR_FREE(cfg->logDir);
     VIR_FREE(cfg->securityDriverName);
+    virStringFreeList(cfg->autoStartGroups);
 }
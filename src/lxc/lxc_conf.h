@@ -64,6 +64,10 @@ struct _virLXCDriverConfig {
     char *securityDriverName;
     bool securityDefaultConfined;
     bool securityRequireConfined;
+
+    unsigned int autoStartMaxConcurrent;
+    unsigned long long autoStartReservedMemory; /* in MiB */
+    char **autoStartGroups;
 };
 
 struct _virLXCDriver {
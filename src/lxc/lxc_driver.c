@@ -581,21 +581,22 @@ static int lxcDomainGetInfo(virDomainPtr dom,
         info->cpuTime = 0;
         info->memory = vm->def->mem.cur_balloon;
     } else {
-        if (virCgroupGetCpuacctUsage(priv->cgroup, &(info->cpuTime)) < 0) {
+        virCgroupStats stats;
+
+        /* Memory usage is optional, it may lack kernel support */
+        if (virCgroupGetStats(priv->cgroup,
+                              VIR_CGROUP_STATS_CPU_TIME |
+                              VIR_CGROUP_STATS_MEMORY,
+                              &stats) < 0)
+            goto cleanup;
+
+        if (!(stats.fields & VIR_CGROUP_STATS_CPU_TIME)) {
             virReportError(VIR_ERR_OPERATION_FAILED,
                            "%s", _("Cannot read cputime for domain"));
             goto cleanup;
         }
-        if (virCgroupGetMemoryUsage(priv->cgroup, &(info->memory)) < 0) {
-            /* Don't fail if we can't read memory usage due to a lack of
-             * kernel support */
-            if (virLastErrorIsSystemErrno(ENOENT)) {
-                virResetLastError();
-                info->memory = 0;
-            } else {
-                goto cleanup;
-            }
-        }
+        info->cpuTime = stats.cpuTime;
+        info->memory = stats.memoryUsage >> 10;
     }
 
     info->maxMem = vm->def->mem.max_balloon;
@@ -42,6 +42,8 @@
 #include "network/bridge_driver.h"
 #include "viralloc.h"
 #include "domain_audit.h"
+#include "domain_autostart.h"
+#include "nodeinfo.h"
 #include "virerror.h"
 #include "virlog.h"
 #include "vircommand.h"
@@ -1444,13 +1446,19 @@ virLXCProcessAutostartAll(virLXCDriverPtr driver)
      */
     virConnectPtr conn = virConnectOpen("lxc:///");
     /* Ignoring NULL conn which is mostly harmless here */
+    virLXCDriverConfigPtr cfg = virLXCDriverGetConfig(driver);
 
     struct virLXCProcessAutostartData data = { driver, conn };
 
-    virDomainObjListForEach(driver->domains,
-                            virLXCProcessAutostartDomain,
-                            &data);
+    ignore_value(virDomainAutostartRun(driver->domains,
+                                       cfg->autoStartMaxConcurrent,
+                                       cfg->autoStartReservedMemory * 1024,
+                                       nodeGetAvailableMemory,
+                                       cfg->autoStartGroups,
+                                       virLXCProcessAutostartDomain,
+                                       &data));
 
+    virObjectUnref(cfg);
     virObjectUnref(conn);
 }
 
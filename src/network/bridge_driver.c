@@ -72,6 +72,7 @@
 #include "viraccessapicheck.h"
 #include "network_event.h"
 #include "virhook.h"
+#include "virevent.h"
 
 #define VIR_FROM_THIS VIR_FROM_NETWORK
 
@@ -438,6 +439,10 @@ networkStateInitialize(bool privileged,
     }
     networkDriverLock(driverState);
 
+    driverState->dnsmasqReloadTimer = -1;
+    if (!(driverState->dnsmasqReloads = virHashCreate(16, NULL)))
+        goto error;
+
     /* configuration/state paths are one of
      * ~/.config/libvirt/... (session/unprivileged)
      * /etc/libvirt/... && /var/(run|lib)/libvirt/... (system/privileged).
@@ -597,6 +602,10 @@ networkStateCleanup(void) {
 
     virObjectEventStateFree(driverState->networkEventState);
 
+    if (driverState->dnsmasqReloadTimer >= 0)
+        virEventRemoveTimeout(driverState->dnsmasqReloadTimer);
+    virHashFree(driverState->dnsmasqReloads);
+
     /* free inactive networks */
     virNetworkObjListFree(&driverState->networks);
 
@@ -1211,6 +1220,51 @@ cleanup:
     return ret;
 }
 
+/* networkBuildDnsmasqHostsfiles:
+ *  Fill @dctx with the entries dnsmasq reads from its dhcp-hostsfile
+ *  and addn-hosts file.
+ *
+ *  Returns 0 on success, -1 on failure.
+ */
+static int
+networkBuildDnsmasqHostsfiles(dnsmasqContext *dctx,
+                              virNetworkDefPtr def)
+{
+    size_t i;
+    virNetworkIpDefPtr ipdef, ipv4def, ipv6def;
+
+    /* Look for first IPv4 address that has dhcp defined.
+     * We only support dhcp-host config on one IPv4 subnetwork
+     * and on one IPv6 subnetwork.
+     */
+    ipv4def = NULL;
+    for (i = 0;
+         (ipdef = virNetworkDefGetIpByIndex(def, AF_INET, i));
+         i++) {
+        if (!ipv4def && (ipdef->nranges || ipdef->nhosts))
+            ipv4def = ipdef;
+    }
+
+    ipv6def = NULL;
+    for (i = 0;
+         (ipdef = virNetworkDefGetIpByIndex(def, AF_INET6, i));
+         i++) {
+        if (!ipv6def && (ipdef->nranges || ipdef->nhosts))
+            ipv6def = ipdef;
+    }
+
+    if (ipv4def && (networkBuildDnsmasqDhcpHostsList(dctx, ipv4def) < 0))
+        return -1;
+
+    if (ipv6def && (networkBuildDnsmasqDhcpHostsList(dctx, ipv6def) < 0))
+        return -1;
+
+    if (networkBuildDnsmasqHostsList(dctx, &def->dns) < 0)
+        return -1;
+
+    return 0;
+}
+
 /* networkRefreshDhcpDaemon:
  *  Update dnsmasq config files, then send a SIGHUP so that it rereads
  *  them.   This only works for the dhcp-hostsfile and the
@@ -1223,8 +1277,6 @@ networkRefreshDhcpDaemon(virNetworkDriverStatePtr driver,
                          virNetworkObjPtr network)
 {
     int ret = -1;
-    size_t i;
-    virNetworkIpDefPtr ipdef, ipv4def, ipv6def;
     dnsmasqContext *dctx = NULL;
 
     /* if no IP addresses specified, nothing to do */
@@ -1241,39 +1293,126 @@ networkRefreshDhcpDaemon(virNetworkDriverStatePtr driver,
         goto cleanup;
     }
 
-    /* Look for first IPv4 address that has dhcp defined.
-     * We only support dhcp-host config on one IPv4 subnetwork
-     * and on one IPv6 subnetwork.
-     */
-    ipv4def = NULL;
-    for (i = 0;
-         (ipdef = virNetworkDefGetIpByIndex(network->def, AF_INET, i));
-         i++) {
-        if (!ipv4def && (ipdef->nranges || ipdef->nhosts))
-            ipv4def = ipdef;
+    if (networkBuildDnsmasqHostsfiles(dctx, network->def) < 0)
+        goto cleanup;
+
+    if ((ret = dnsmasqSave(dctx)) < 0)
+        goto cleanup;
+
+    ret = kill(network->dnsmasqPid, SIGHUP);
+cleanup:
+    dnsmasqContextFree(dctx);
+    return ret;
+}
+
+/* Bursts of updates to a network's hosts are coalesced into a
+ * single SIGHUP sent this many milliseconds after the first one.
+ * dnsmasq rereads its whole hosts files on every SIGHUP.
+ */
+#define NETWORK_DNSMASQ_RELOAD_DELAY 100
+
+static void
+networkReloadDhcpDaemonOne(void *payload ATTRIBUTE_UNUSED,
+                           const void *name,
+                           void *opaque)
+{
+    virNetworkDriverStatePtr driver = opaque;
+    virNetworkObjPtr network;
+
+    if (!(network = virNetworkFindByName(&driver->networks, name)))
+        return;
+
+    if (virNetworkObjIsActive(network) && network->dnsmasqPid > 0) {
+        VIR_DEBUG("Reloading dnsmasq for network %s", network->def->name);
+        if (dnsmasqReload(network->dnsmasqPid) < 0)
+            virResetLastError();
     }
 
-    ipv6def = NULL;
-    for (i = 0;
-         (ipdef = virNetworkDefGetIpByIndex(network->def, AF_INET6, i));
-         i++) {
-        if (!ipv6def && (ipdef->nranges || ipdef->nhosts))
-            ipv6def = ipdef;
+    virNetworkObjUnlock(network);
+}
+
+static void
+networkReloadDhcpDaemonTimer(int timer ATTRIBUTE_UNUSED,
+                             void *opaque)
+{
+    virNetworkDriverStatePtr driver = opaque;
+
+    networkDriverLock(driver);
+    virEventUpdateTimeout(driver->dnsmasqReloadTimer, -1);
+    virHashForEach(driver->dnsmasqReloads, networkReloadDhcpDaemonOne, driver);
+    virHashRemoveAll(driver->dnsmasqReloads);
+    networkDriverUnlock(driver);
+}
+
+/* networkScheduleReloadDhcpDaemon:
+ *  Arrange for dnsmasq to be sent a SIGHUP shortly, together with
+ *  any other network updated in the meantime. Without an event loop
+ *  the signal is sent right away.
+ *
+ *  Returns 0 on success, -1 on failure.
+ */
+static int
+networkScheduleReloadDhcpDaemon(virNetworkDriverStatePtr driver,
+                                virNetworkObjPtr network)
+{
+    bool armed = virHashSize(driver->dnsmasqReloads) > 0;
+
+    if (driver->dnsmasqReloadTimer < 0)
+        driver->dnsmasqReloadTimer =
+            virEventAddTimeout(-1, networkReloadDhcpDaemonTimer,
+                               driver, NULL);
+
+    if (driver->dnsmasqReloadTimer < 0 ||
+        virHashUpdateEntry(driver->dnsmasqReloads,
+                           network->def->name, NULL) < 0) {
+        virResetLastError();
+        return dnsmasqReload(network->dnsmasqPid);
     }
 
-    if (ipv4def && (networkBuildDnsmasqDhcpHostsList(dctx, ipv4def) < 0))
-           goto cleanup;
+    if (!armed)
+        virEventUpdateTimeout(driver->dnsmasqReloadTimer,
+                              NETWORK_DNSMASQ_RELOAD_DELAY);
 
-    if (ipv6def && (networkBuildDnsmasqDhcpHostsList(dctx, ipv6def) < 0))
-           goto cleanup;
+    return 0;
+}
 
-    if (networkBuildDnsmasqHostsList(dctx, &network->def->dns) < 0)
-       goto cleanup;
+/* networkUpdateDhcpDaemon:
+ *  Like networkRefreshDhcpDaemon(), but only apply to the files what
+ *  changed since they were last written from @prev, and batch the
+ *  SIGHUP with other updates. Entries that have not changed are left
+ *  untouched on disk, so dnsmasq keeps serving them throughout.
+ *
+ *  Returns 0 on success, -1 on failure.
+ */
+static int
+networkUpdateDhcpDaemon(virNetworkDriverStatePtr driver,
+                        virNetworkObjPtr network,
+                        dnsmasqContext *prev)
+{
+    int ret = -1;
+    int rc;
+    dnsmasqContext *dctx = NULL;
 
-    if ((ret = dnsmasqSave(dctx)) < 0)
+    if (!virNetworkDefGetIpByIndex(network->def, AF_UNSPEC, 0))
+        return 0;
+
+    if (network->dnsmasqPid <= 0 || (kill(network->dnsmasqPid, 0) < 0))
+        return networkStartDhcpDaemon(driver, network);
+
+    if (!(dctx = dnsmasqContextNew(network->def->name,
+                                   driverState->dnsmasqStateDir)))
         goto cleanup;
 
-    ret = kill(network->dnsmasqPid, SIGHUP);
+    if (networkBuildDnsmasqHostsfiles(dctx, network->def) < 0)
+        goto cleanup;
+
+    if ((rc = dnsmasqSaveChanges(dctx, prev)) < 0)
+        goto cleanup;
+
+    if (rc > 0 && networkScheduleReloadDhcpDaemon(driver, network) < 0)
+        goto cleanup;
+
+    ret = 0;
 cleanup:
     dnsmasqContextFree(dctx);
     return ret;
@@ -2811,7 +2950,7 @@ networkUpdate(virNetworkPtr net,
     virNetworkIpDefPtr ipdef;
     bool oldDhcpActive = false;
     bool needFirewallRefresh = false;
-
+    dnsmasqContext *olddctx = NULL;
 
     virCheckFlags(VIR_NETWORK_UPDATE_AFFECT_LIVE |
                   VIR_NETWORK_UPDATE_AFFECT_CONFIG,
@@ -2876,6 +3015,20 @@ networkUpdate(virNetworkPtr net,
                 break;
             }
         }
+
+        /* remember what dnsmasq's hosts files hold now, so that only
+         * the entries that change need to be written out afterwards
+         */
+        if (section == VIR_NETWORK_SECTION_IP_DHCP_HOST ||
+            section == VIR_NETWORK_SECTION_DNS_HOST) {
+            if (!(olddctx = dnsmasqContextNew(network->def->name,
+                                              driverState->dnsmasqStateDir)) ||
+                networkBuildDnsmasqHostsfiles(olddctx, network->def) < 0) {
+                if (needFirewallRefresh)
+                    ignore_value(networkAddFirewallRules(network));
+                goto cleanup;
+            }
+        }
     }
 
     /* update the network config in memory/on disk */
@@ -2915,8 +3068,8 @@ networkUpdate(virNetworkPtr net,
         } else if (section == VIR_NETWORK_SECTION_IP_DHCP_HOST) {
             /* if we previously weren't listening for dhcp and now we
              * are (or vice-versa) then we need to do a restart,
-             * otherwise we just need to do a refresh (redo the config
-             * files and send SIGHUP)
+             * otherwise we just need to patch the changed entries in
+             * the hosts file and send SIGHUP)
              */
             bool newDhcpActive = false;
 
@@ -2929,14 +3082,20 @@ networkUpdate(virNetworkPtr net,
                 }
             }
 
-            if ((newDhcpActive != oldDhcpActive &&
-                 networkRestartDhcpDaemon(driver, network) < 0) ||
-                networkRefreshDhcpDaemon(driver, network) < 0) {
+            if (newDhcpActive != oldDhcpActive) {
+                if (networkRestartDhcpDaemon(driver, network) < 0)
+                    goto cleanup;
+            } else if (networkUpdateDhcpDaemon(driver, network,
+                                               olddctx) < 0) {
                 goto cleanup;
             }
 
-        } else if (section == VIR_NETWORK_SECTION_DNS_HOST ||
-                   section == VIR_NETWORK_SECTION_DNS_TXT ||
+        } else if (section == VIR_NETWORK_SECTION_DNS_HOST) {
+            /* DNS host entries live in the addn-hosts file */
+            if (networkUpdateDhcpDaemon(driver, network, olddctx) < 0)
+                goto cleanup;
+
+        } else if (section == VIR_NETWORK_SECTION_DNS_TXT ||
                    section == VIR_NETWORK_SECTION_DNS_SRV) {
             /* these sections only change things in config files, so we
              * can just update the config files and send SIGHUP to
@@ -2963,6 +3122,7 @@ networkUpdate(virNetworkPtr net,
     }
     ret = 0;
 cleanup:
+    dnsmasqContextFree(olddctx);
     if (network)
         virNetworkObjUnlock(network);
     networkDriverUnlock(driver);
@@ -28,6 +28,7 @@
 # include "virlog.h"
 # include "virthread.h"
 # include "virdnsmasq.h"
+# include "virhash.h"
 # include "network_conf.h"
 # include "object_event.h"
 
@@ -45,6 +46,10 @@ struct _virNetworkDriverState {
     char *radvdStateDir;
     dnsmasqCapsPtr dnsmasqCaps;
 
+    /* names of networks whose dnsmasq is due for a SIGHUP */
+    virHashTablePtr dnsmasqReloads;
+    int dnsmasqReloadTimer;
+
     virObjectEventStatePtr networkEventState;
 };
 
@@ -475,7 +475,6 @@ dev_create(const char *udi)
     const char *name = hal_name(udi);
     int rv;
     char *privData;
-    char *devicePath = NULL;
 
     if (VIR_STRDUP(privData, udi) < 0)
         return;
@@ -503,20 +502,18 @@ dev_create(const char *udi)
     if (def->caps == NULL)
         goto cleanup;
 
-    /* Some devices don't have a path in sysfs, so ignore failure */
-    (void)get_str_prop(ctx, udi, "linux.sysfs_path", &devicePath);
+    /* Some devices don't have a path in sysfs, so ignore failure.
+     * Set it before adding the device, the list indexes it */
+    (void)get_str_prop(ctx, udi, "linux.sysfs_path", &def->sysfs_path);
 
     dev = virNodeDeviceAssignDef(&driverState->devs,
                                  def);
 
-    if (!dev) {
-        VIR_FREE(devicePath);
+    if (!dev)
         goto failure;
-    }
 
     dev->privateData = privData;
     dev->privateFree = free_udi;
-    dev->def->sysfs_path = devicePath;
 
     virNodeDeviceObjUnlock(dev);
 
@@ -22,6 +22,7 @@
 
 #include <config.h>
 #include <libudev.h>
+#include <poll.h>
 #include <pciaccess.h>
 #include <scsi/scsi.h>
 #include <c-ctype.h>
@@ -43,6 +44,8 @@
 
 #define VIR_FROM_THIS VIR_FROM_NODEDEV
 
+#define UDEV_EVENT_BATCH_MAX 128
+
 #ifndef TYPE_RAID
 # define TYPE_RAID 12
 #endif
@@ -1495,6 +1498,32 @@ static int nodeStateCleanup(void)
 }
 
 
+static void udevHandleOneEvent(struct udev_device *device)
+{
+    const char *action = udev_device_get_action(device);
+
+    VIR_DEBUG("udev action: '%s'", action);
+
+    if (STREQ(action, "add") || STREQ(action, "change"))
+        udevAddOneDevice(device);
+    else if (STREQ(action, "remove"))
+        udevRemoveOneDevice(device);
+}
+
+
+static bool udevEventPending(int fd)
+{
+    struct pollfd pfd = { .fd = fd, .events = POLLIN };
+
+    return poll(&pfd, 1, 0) == 1 && (pfd.revents & POLLIN);
+}
+
+
+/* Creating many SR-IOV VFs or rescanning a SCSI host results in a
+ * storm of uevents. Rather than going back to the event loop after
+ * each of them, handle whatever is already queued in one go, up to
+ * UDEV_EVENT_BATCH_MAX events so API calls waiting for the driver
+ * lock still get a look in. */
 static void udevEventHandleCallback(int watch ATTRIBUTE_UNUSED,
                                     int fd,
                                     int events ATTRIBUTE_UNUSED,
@@ -1502,8 +1531,8 @@ static void udevEventHandleCallback(int watch ATTRIBUTE_UNUSED,
 {
     struct udev_device *device = NULL;
     struct udev_monitor *udev_monitor = DRV_STATE_UDEV_MONITOR(driverState);
-    const char *action = NULL;
     int udev_fd = -1;
+    size_t nevents = 0;
 
     nodeDeviceLock(driverState);
     udev_fd = udev_monitor_get_fd(udev_monitor);
@@ -1513,27 +1542,21 @@ static void udevEventHandleCallback(int watch ATTRIBUTE_UNUSED,
         goto out;
     }
 
-    device = udev_monitor_receive_device(udev_monitor);
-    if (device == NULL) {
-        VIR_ERROR(_("udev_monitor_receive_device returned NULL"));
-        goto out;
-    }
-
-    action = udev_device_get_action(device);
-    VIR_DEBUG("udev action: '%s'", action);
+    do {
+        device = udev_monitor_receive_device(udev_monitor);
+        if (device == NULL) {
+            if (nevents == 0)
+                VIR_ERROR(_("udev_monitor_receive_device returned NULL"));
+            break;
+        }
 
-    if (STREQ(action, "add") || STREQ(action, "change")) {
-        udevAddOneDevice(device);
-        goto out;
-    }
+        udevHandleOneEvent(device);
+        udev_device_unref(device);
+    } while (++nevents < UDEV_EVENT_BATCH_MAX && udevEventPending(fd));
 
-    if (STREQ(action, "remove")) {
-        udevRemoveOneDevice(device);
-        goto out;
-    }
+    VIR_DEBUG("Handled %zu udev events", nevents);
 
 out:
-    udev_device_unref(device);
     nodeDeviceUnlock(driverState);
     return;
 }
@@ -1211,6 +1211,45 @@ int nodeGetMemoryStats(int cellNum ATTRIBUTE_UNUSED,
 #endif
 }
 
+/**
+ * nodeGetAvailableMemory:
+ * @avail: filled with the amount of host memory in KiB
+ *
+ * Get how much host memory can be handed out without swapping, that
+ * is free memory plus buffers and page cache.
+ *
+ * Returns 0 on success, -1 with an error reported otherwise.
+ */
+int
+nodeGetAvailableMemory(unsigned long long *avail)
+{
+    virNodeMemoryStatsPtr params = NULL;
+    int nparams = 0;
+    size_t i;
+    int ret = -1;
+
+    *avail = 0;
+
+    if (nodeGetMemoryStats(VIR_NODE_MEMORY_STATS_ALL_CELLS,
+                           NULL, &nparams, 0) < 0 ||
+        VIR_ALLOC_N(params, nparams) < 0 ||
+        nodeGetMemoryStats(VIR_NODE_MEMORY_STATS_ALL_CELLS,
+                           params, &nparams, 0) < 0)
+        goto cleanup;
+
+    for (i = 0; i < nparams; i++) {
+        if (STREQ(params[i].field, VIR_NODE_MEMORY_STATS_FREE) ||
+            STREQ(params[i].field, VIR_NODE_MEMORY_STATS_BUFFERS) ||
+            STREQ(params[i].field, VIR_NODE_MEMORY_STATS_CACHED))
+            *avail += params[i].value;
+    }
+
+    ret = 0;
+cleanup:
+    VIR_FREE(params);
+    return ret;
+}
+
 int
 nodeGetCPUCount(void)
 {
@@ -41,6 +41,7 @@ int nodeGetCellsFreeMemory(unsigned long long *freeMems,
                            int startCell,
                            int maxCells);
 unsigned long long nodeGetFreeMemory(void);
+int nodeGetAvailableMemory(unsigned long long *avail);
 
 virBitmapPtr nodeGetCPUBitmap(int *max_id);
 int nodeGetCPUCount(void);
@@ -69,6 +69,7 @@
 #include "configmake.h"
 #include "virtime.h"
 #include "virstring.h"
+#include "virbuffer.h"
 
 #define VIR_FROM_THIS VIR_FROM_NWFILTER
 
@@ -78,18 +79,32 @@
 # define LEASEFILE LEASEFILE_DIR "nwfilter.leases"
 # define TMPLEASEFILE LEASEFILE_DIR "nwfilter.ltmp"
 
+typedef struct _virNWFilterSnoopSession virNWFilterSnoopSession;
+typedef virNWFilterSnoopSession *virNWFilterSnoopSessionPtr;
+
 struct virNWFilterSnoopState {
     /* lease file */
     int                  leaseFD;
     int                  nLeases; /* number of active leases */
     int                  wLeases; /* number of written leases */
-    int                  nThreads; /* number of running threads */
+    virBuffer            leaseBuf; /* lease file lines not yet written */
+    int                  pLeases; /* number of lines in leaseBuf */
     /* thread management */
     virHashTablePtr      snoopReqs;
     virHashTablePtr      ifnameToKey;
-    virMutex             snoopLock;  /* protects SnoopReqs and IfNameToKey */
+    virMutex             snoopLock;  /* protects SnoopReqs, IfNameToKey
+                                        and leaseBuf */
     virHashTablePtr      active;
     virMutex             activeLock; /* protects Active */
+    /* shared snooping engine */
+    virThread            engineThread;
+    bool                 engineRunning;
+    bool                 engineQuit;
+    int                  engineWakeupFD[2];
+    virNWFilterSnoopSessionPtr *pending; /* sessions not yet polled */
+    size_t               npending;
+    virMutex             engineLock; /* protects pending and engineQuit */
+    virThreadPoolPtr     workers;    /* shared DHCP decode workers */
 };
 
 # define virNWFilterSnoopLock() \
@@ -117,11 +132,8 @@ typedef virNWFilterSnoopReq *virNWFilterSnoopReqPtr;
 typedef struct _virNWFilterSnoopIPLease virNWFilterSnoopIPLease;
 typedef virNWFilterSnoopIPLease *virNWFilterSnoopIPLeasePtr;
 
-typedef enum {
-    THREAD_STATUS_NONE,
-    THREAD_STATUS_OK,
-    THREAD_STATUS_FAIL,
-} virNWFilterSnoopThreadStatus;
+typedef struct _virNWFilterDHCPDecodeJob virNWFilterDHCPDecodeJob;
+typedef virNWFilterDHCPDecodeJob *virNWFilterDHCPDecodeJobPtr;
 
 struct _virNWFilterSnoopReq {
     /*
@@ -146,11 +158,13 @@ struct _virNWFilterSnoopReq {
     virNWFilterSnoopIPLeasePtr           end;
     char                                *threadkey;
 
-    virNWFilterSnoopThreadStatus         threadStatus;
-    virCond                              threadStatusCond;
-
     int                                  jobCompletionStatus;
-    /* the number of submitted jobs in the worker's queue */
+    /* packets waiting to be decoded by the shared workers */
+    virNWFilterDHCPDecodeJobPtr          jobsHead;
+    virNWFilterDHCPDecodeJobPtr          jobsTail;
+    bool                                 jobsScheduled;
+    /* the number of queued jobs per direction */
+    int                                  qCtr[2];
     /*
      * protect those members that can change while the
      * req is on the public SnoopReq hash and
@@ -160,7 +174,7 @@ struct _virNWFilterSnoopReq {
      * - start
      * - end
      * - a lease while it is on the list
-     * - threadStatus
+     * - jobsHead, jobsTail and jobsScheduled
      * (for refctr, see above)
      */
     virMutex                             lock;
@@ -236,14 +250,19 @@ struct _virNWFilterSnoopDHCPHdr {
 # define PCAP_READ_MAXERRS          25 /* retries on failing device */
 # define PCAP_FLOOD_TIMEOUT_MS      10 /* ms */
 
-typedef struct _virNWFilterDHCPDecodeJob virNWFilterDHCPDecodeJob;
-typedef virNWFilterDHCPDecodeJob *virNWFilterDHCPDecodeJobPtr;
+# define PCAP_READ_BATCH            32 /* max. pkts read per wakeup */
+
+# define LEASEFILE_BATCH_MAX        64 /* max. lines held back */
+
+# define SNOOP_ENGINE_TIMEOUT_MS  1000 /* lease timer and flush interval */
+# define SNOOP_MAX_WORKERS           8 /* shared DHCP decode workers */
 
 struct _virNWFilterDHCPDecodeJob {
     unsigned char packet[PCAP_PBUFSIZE];
     int caplen;
     bool fromVM;
     int *qCtr;
+    virNWFilterDHCPDecodeJobPtr next;
 };
 
 # define DHCP_PKT_RATE          10 /* pkts/sec */
@@ -274,11 +293,26 @@ struct _virNWFilterSnoopPcapConf {
     const pcap_direction_t dir;
     const char *filter;
     virNWFilterSnoopRateLimitConf rateLimit; /* indep. rate limiters */
-    int qCtr; /* number of jobs in the worker's queue */
     const unsigned int maxQSize;
     unsigned long long penaltyTimeoutAbs;
 };
 
+/*
+ * A snooping session: the pcap handles of one interface that are
+ * multiplexed by the shared snooping engine thread. The session
+ * holds a reference on its req and is owned by the engine thread
+ * once it has been handed over to it.
+ */
+struct _virNWFilterSnoopSession {
+    virNWFilterSnoopReqPtr req;
+    char *threadkey;
+    int ifindex;
+    int errcount;
+    time_t last_displayed;
+    time_t last_displayed_queue;
+    virNWFilterSnoopPcapConf pcapConf[2];
+};
+
 /* local function prototypes */
 static int virNWFilterSnoopReqLeaseDel(virNWFilterSnoopReqPtr req,
                                        virSocketAddrPtr ipaddr,
@@ -290,10 +324,15 @@ static void virNWFilterSnoopReqUnlock(virNWFilterSnoopReqPtr req);
 
 static void virNWFilterSnoopLeaseFileLoad(void);
 static void virNWFilterSnoopLeaseFileSave(virNWFilterSnoopIPLeasePtr ipl);
+static void virNWFilterSnoopLeaseFileFlush(bool refresh);
+
+static void virNWFilterSnoopEngineWakeup(void);
 
 /* local variables */
 static struct virNWFilterSnoopState virNWFilterSnoopState = {
     .leaseFD = -1,
+    .leaseBuf = VIR_BUFFER_INITIALIZER,
+    .engineWakeupFD = { -1, -1 },
 };
 
 static const unsigned char dhcp_magic[4] = { 99, 130, 83, 99 };
@@ -330,6 +369,9 @@ virNWFilterSnoopCancel(char **threadKey)
     VIR_FREE(*threadKey);
 
     virNWFilterSnoopActiveUnlock();
+
+    /* let the engine drop the session */
+    virNWFilterSnoopEngineWakeup();
 }
 
 static bool
@@ -585,22 +627,14 @@ virNWFilterSnoopReqNew(const char *ifkey)
     if (VIR_ALLOC(req) < 0)
         return NULL;
 
-    req->threadStatus = THREAD_STATUS_NONE;
-
     if (virStrcpyStatic(req->ifkey, ifkey) == NULL ||
         virMutexInitRecursive(&req->lock) < 0)
         goto err_free_req;
 
-    if (virCondInit(&req->threadStatusCond) < 0)
-        goto err_destroy_mutex;
-
     virNWFilterSnoopReqGet(req);
 
     return req;
 
-err_destroy_mutex:
-    virMutexDestroy(&req->lock);
-
 err_free_req:
     VIR_FREE(req);
 
@@ -634,7 +668,6 @@ virNWFilterSnoopReqFree(virNWFilterSnoopReqPtr req)
     virNWFilterHashTableFree(req->vars);
 
     virMutexDestroy(&req->lock);
-    virCondDestroy(&req->threadStatusCond);
 
     VIR_FREE(req);
 }
@@ -1136,6 +1169,13 @@ virNWFilterSnoopDHCPOpen(const char *ifname, virMacAddr *mac,
         goto cleanup_freecode;
     }
 
+    /* the engine drains the handle until no more packets are queued */
+    if (pcap_setnonblock(handle, 1, pcap_errbuf) < 0) {
+        virReportError(VIR_ERR_INTERNAL_ERROR,
+                       _("pcap_setnonblock: %s"), pcap_errbuf);
+        goto cleanup_freecode;
+    }
+
     pcap_freecode(&fp);
     VIR_FREE(ext_filter);
 
@@ -1152,38 +1192,67 @@ cleanup_nohandle:
 }
 
 /*
- * Worker function to decode the DHCP message and with that
- * also do the time-consuming work of instantiating the filters
+ * Worker function to decode the DHCP messages queued on a req and with
+ * that also do the time-consuming work of instantiating the filters.
+ * All packets that arrive while the worker is busy are processed in the
+ * same run, so a req is never handled by more than one worker at a time
+ * and its packets are decoded in the order they were received.
  */
-static void virNWFilterDHCPDecodeWorker(void *jobdata, void *opaque)
+static void virNWFilterDHCPDecodeWorker(void *jobdata,
+                                        void *opaque ATTRIBUTE_UNUSED)
 {
-    virNWFilterSnoopReqPtr req = opaque;
-    virNWFilterDHCPDecodeJobPtr job = jobdata;
-    virNWFilterSnoopEthHdrPtr packet = (virNWFilterSnoopEthHdrPtr)job->packet;
+    virNWFilterSnoopReqPtr req = jobdata;
+    virNWFilterDHCPDecodeJobPtr jobs, job;
 
-    if (virNWFilterSnoopDHCPDecode(req, packet,
-                                   job->caplen, job->fromVM) == -1) {
-        req->jobCompletionStatus = -1;
+    for (;;) {
+        /* protect req->jobsHead & req->jobsTail */
+        virNWFilterSnoopReqLock(req);
 
-        virReportError(VIR_ERR_INTERNAL_ERROR,
-                       _("Instantiation of rules failed on "
-                         "interface '%s'"), req->ifname);
+        jobs = req->jobsHead;
+        req->jobsHead = req->jobsTail = NULL;
+        if (!jobs)
+            req->jobsScheduled = false;
+
+        virNWFilterSnoopReqUnlock(req);
+
+        if (!jobs)
+            break;
+
+        while ((job = jobs) != NULL) {
+            virNWFilterSnoopEthHdrPtr packet;
+
+            jobs = job->next;
+            packet = (virNWFilterSnoopEthHdrPtr)job->packet;
+
+            if (virNWFilterSnoopDHCPDecode(req, packet,
+                                           job->caplen, job->fromVM) == -1) {
+                req->jobCompletionStatus = -1;
+
+                virReportError(VIR_ERR_INTERNAL_ERROR,
+                               _("Instantiation of rules failed on "
+                                 "interface '%s'"), req->ifname);
+            }
+            virAtomicIntDecAndTest(job->qCtr);
+            VIR_FREE(job);
+        }
     }
-    virAtomicIntDecAndTest(job->qCtr);
-    VIR_FREE(job);
+
+    /* drop the reference taken when the req was scheduled */
+    virNWFilterSnoopReqPut(req);
 }
 
 /*
- * Submit a job to the worker thread doing the time-consuming work...
+ * Queue a packet on the req and have the req scheduled on the shared
+ * worker pool unless a worker is already processing its queue.
  */
 static int
-virNWFilterSnoopDHCPDecodeJobSubmit(virThreadPoolPtr pool,
+virNWFilterSnoopDHCPDecodeJobSubmit(virNWFilterSnoopReqPtr req,
                                     virNWFilterSnoopEthHdrPtr pep,
                                     int len, pcap_direction_t dir,
                                     int *qCtr)
 {
     virNWFilterDHCPDecodeJobPtr job;
-    int ret;
+    int ret = 0;
 
     if (len <= MIN_VALID_DHCP_PKT_SIZE || len > sizeof(job->packet))
         return 0;
@@ -1196,12 +1265,39 @@ virNWFilterSnoopDHCPDecodeJobSubmit(virThreadPoolPtr pool,
     job->fromVM = (dir == PCAP_D_IN);
     job->qCtr = qCtr;
 
-    ret = virThreadPoolSendJob(pool, 0, job);
+    /* protect req->refctr */
+    virNWFilterSnoopLock();
 
-    if (ret == 0)
-        virAtomicIntInc(qCtr);
+    /* protect req->jobsHead & req->jobsTail */
+    virNWFilterSnoopReqLock(req);
+
+    if (req->jobsTail)
+        req->jobsTail->next = job;
     else
-        VIR_FREE(job);
+        req->jobsHead = job;
+    req->jobsTail = job;
+
+    if (!req->jobsScheduled) {
+        /* the worker releases this reference */
+        virNWFilterSnoopReqGet(req);
+
+        if (virThreadPoolSendJob(virNWFilterSnoopState.workers,
+                                 0, req) < 0) {
+            /* nothing was queued before since no worker was scheduled */
+            req->jobsHead = req->jobsTail = NULL;
+            ignore_value(virAtomicIntDecAndTest(&req->refctr));
+            VIR_FREE(job);
+            ret = -1;
+            goto cleanup;
+        }
+        req->jobsScheduled = true;
+    }
+
+    virAtomicIntInc(qCtr);
+
+cleanup:
+    virNWFilterSnoopReqUnlock(req);
+    virNWFilterSnoopUnlock();
 
     return ret;
 }
@@ -1323,128 +1419,188 @@ virNWFilterSnoopAdjustPoll(virNWFilterSnoopPcapConfPtr pc,
     return ret;
 }
 
+static const virNWFilterSnoopPcapConf virNWFilterSnoopPcapConfTemplate[] = {
+    {
+        .dir = PCAP_D_IN, /* from VM */
+        .filter = "dst port 67 and src port 68",
+        .rateLimit = {
+            .rate = DHCP_PKT_RATE,
+            .burstRate = DHCP_PKT_BURST,
+            .burstInterval = DHCP_BURST_INTERVAL_S,
+        },
+        .maxQSize = MAX_QUEUED_JOBS,
+    }, {
+        .dir = PCAP_D_OUT, /* to VM */
+        .filter = "src port 67 and dst port 68",
+        .rateLimit = {
+            .rate = DHCP_PKT_RATE,
+            .burstRate = DHCP_PKT_BURST,
+            .burstInterval = DHCP_BURST_INTERVAL_S,
+        },
+        .maxQSize = MAX_QUEUED_JOBS,
+    },
+};
+
 /*
- * The DHCP snooping thread. It spends most of its time in the pcap
- * library and if it gets suitable packets, it submits them to the worker
- * thread for processing.
+ * Wake up the engine thread so it picks up new sessions, drops
+ * cancelled ones or writes out pending lease file updates.
  */
 static void
-virNWFilterDHCPSnoopThread(void *req0)
+virNWFilterSnoopEngineWakeup(void)
+{
+    char c = '\0';
+
+    if (virNWFilterSnoopState.engineWakeupFD[1] < 0)
+        return;
+
+    /* a full pipe already guarantees a wakeup */
+    ignore_value(safewrite(virNWFilterSnoopState.engineWakeupFD[1],
+                           &c, sizeof(c)));
+}
+
+static void
+virNWFilterSnoopSessionFree(virNWFilterSnoopSessionPtr sess)
 {
-    virNWFilterSnoopReqPtr req = req0;
-    struct pcap_pkthdr *hdr;
-    virNWFilterSnoopEthHdrPtr packet;
-    int ifindex = 0;
-    int errcount = 0;
-    int tmp = -1, rv, n, pollTo;
     size_t i;
-    char *threadkey = NULL;
-    virThreadPoolPtr worker = NULL;
-    time_t last_displayed = 0, last_displayed_queue = 0;
-    virNWFilterSnoopPcapConf pcapConf[] = {
-        {
-            .dir = PCAP_D_IN, /* from VM */
-            .filter = "dst port 67 and src port 68",
-            .rateLimit = {
-                .prev = time(0),
-                .rate = DHCP_PKT_RATE,
-                .burstRate = DHCP_PKT_BURST,
-                .burstInterval = DHCP_BURST_INTERVAL_S,
-            },
-            .maxQSize = MAX_QUEUED_JOBS,
-        }, {
-            .dir = PCAP_D_OUT, /* to VM */
-            .filter = "src port 67 and dst port 68",
-            .rateLimit = {
-                .prev = time(0),
-                .rate = DHCP_PKT_RATE,
-                .burstRate = DHCP_PKT_BURST,
-                .burstInterval = DHCP_BURST_INTERVAL_S,
-            },
-            .maxQSize = MAX_QUEUED_JOBS,
-        },
-    };
-    struct pollfd fds[] = {
-        {
-            /* get a POLLERR if interface goes down or disappears */
-            .events = POLLIN | POLLERR,
-        }, {
-            .events = POLLIN | POLLERR,
-        },
-    };
-    bool error = false;
 
-    /* whoever started us increased the reference counter for the req for us */
+    if (!sess)
+        return;
+
+    for (i = 0; i < ARRAY_CARDINALITY(sess->pcapConf); i++) {
+        if (sess->pcapConf[i].handle)
+            pcap_close(sess->pcapConf[i].handle);
+    }
 
-    /* protect req->ifname & req->threadkey */
-    virNWFilterSnoopReqLock(req);
+    VIR_FREE(sess->threadkey);
+    VIR_FREE(sess);
+}
 
-    if (req->ifname && req->threadkey) {
-        for (i = 0; i < ARRAY_CARDINALITY(pcapConf); i++) {
-            pcapConf[i].handle =
-                virNWFilterSnoopDHCPOpen(req->ifname, &req->macaddr,
-                                         pcapConf[i].filter,
-                                         pcapConf[i].dir);
-            if (!pcapConf[i].handle) {
-                error = true;
-                break;
-            }
-            fds[i].fd = pcap_fileno(pcapConf[i].handle);
-        }
-        tmp = virNetDevGetIndex(req->ifname, &ifindex);
-        ignore_value(VIR_STRDUP(threadkey, req->threadkey));
-        worker = virThreadPoolNew(1, 1, 0,
-                                  virNWFilterDHCPDecodeWorker,
-                                  req);
+/*
+ * Open the pcap handles of a req and hand them over to the engine.
+ * On success the engine takes over the caller's reference to the req.
+ * Call this function with the req lock held.
+ */
+static int
+virNWFilterSnoopSessionStart(virNWFilterSnoopReqPtr req)
+{
+    virNWFilterSnoopSessionPtr sess;
+    size_t i;
+
+    if (!req->ifname || !req->threadkey)
+        return -1;
+
+    if (VIR_ALLOC(sess) < 0)
+        return -1;
+
+    memcpy(sess->pcapConf, virNWFilterSnoopPcapConfTemplate,
+           sizeof(sess->pcapConf));
+
+    for (i = 0; i < ARRAY_CARDINALITY(sess->pcapConf); i++) {
+        sess->pcapConf[i].rateLimit.prev = time(0);
+        sess->pcapConf[i].handle =
+            virNWFilterSnoopDHCPOpen(req->ifname, &req->macaddr,
+                                     sess->pcapConf[i].filter,
+                                     sess->pcapConf[i].dir);
+        if (!sess->pcapConf[i].handle)
+            goto error;
     }
 
-    /* let creator know how well we initialized */
-    if (error == true || !threadkey || tmp < 0 || !worker ||
-        ifindex != req->ifindex)
-        req->threadStatus = THREAD_STATUS_FAIL;
-    else
-        req->threadStatus = THREAD_STATUS_OK;
+    if (virNetDevGetIndex(req->ifname, &sess->ifindex) < 0 ||
+        sess->ifindex != req->ifindex ||
+        VIR_STRDUP(sess->threadkey, req->threadkey) < 0)
+        goto error;
 
-    virCondSignal(&req->threadStatusCond);
+    sess->req = req;
 
-    virNWFilterSnoopReqUnlock(req);
+    virMutexLock(&virNWFilterSnoopState.engineLock);
 
-    if (req->threadStatus != THREAD_STATUS_OK)
-        goto exit;
+    if (VIR_APPEND_ELEMENT(virNWFilterSnoopState.pending,
+                           virNWFilterSnoopState.npending, sess) < 0) {
+        virMutexUnlock(&virNWFilterSnoopState.engineLock);
+        goto error;
+    }
 
-    while (!error) {
-        if (virNWFilterSnoopAdjustPoll(pcapConf,
-                                       ARRAY_CARDINALITY(pcapConf),
-                                       fds, &pollTo) < 0) {
-            break;
-        }
+    virMutexUnlock(&virNWFilterSnoopState.engineLock);
+
+    virNWFilterSnoopEngineWakeup();
+
+    return 0;
+
+error:
+    virNWFilterSnoopSessionFree(sess);
+    return -1;
+}
+
+/*
+ * Release a session that the engine stopped polling.
+ *
+ * @detach: set to 'true' if the session ended while the daemon keeps
+ *          running; the req then loses its interface association so
+ *          that it may be picked up again by a later request.
+ */
+static void
+virNWFilterSnoopSessionRelease(virNWFilterSnoopSessionPtr sess, bool detach)
+{
+    virNWFilterSnoopReqPtr req = sess->req;
+
+    if (detach) {
+        /* protect IfNameToKey */
+        virNWFilterSnoopLock();
 
-        n = poll(fds, ARRAY_CARDINALITY(fds), pollTo);
+        /* protect req->ifname & req->threadkey */
+        virNWFilterSnoopReqLock(req);
+
+        /* don't touch the req if it has been handed to a new session */
+        if (req->threadkey && STREQ(req->threadkey, sess->threadkey)) {
+            virNWFilterSnoopCancel(&req->threadkey);
 
-        if (n < 0) {
-            if (errno != EAGAIN && errno != EINTR)
-                error = true;
+            if (req->ifname)
+                ignore_value(virHashRemoveEntry(
+                                 virNWFilterSnoopState.ifnameToKey,
+                                 req->ifname));
+
+            VIR_FREE(req->ifname);
         }
 
-        virNWFilterSnoopReqLeaseTimerRun(req);
+        virNWFilterSnoopReqUnlock(req);
+        virNWFilterSnoopUnlock();
+    }
 
-        /*
-         * Check whether we were cancelled or whether
-         * a previously submitted job failed.
-         */
-        if (!virNWFilterSnoopIsActive(threadkey) ||
-            req->jobCompletionStatus != 0)
-            goto exit;
+    virNWFilterSnoopSessionFree(sess);
 
-        for (i = 0; n > 0 && i < ARRAY_CARDINALITY(fds); i++) {
-            if (!fds[i].revents)
-                continue;
+    virNWFilterSnoopReqPut(req);
+}
+
+/*
+ * Drain up to PCAP_READ_BATCH packets from each readable pcap handle
+ * of the session and queue the DHCP packets for the workers, applying
+ * the per-interface rate limits.
+ *
+ * Returns 0 on success, -1 if the session has to be torn down.
+ */
+static int
+virNWFilterSnoopSessionRead(virNWFilterSnoopSessionPtr sess,
+                            struct pollfd *fds)
+{
+    virNWFilterSnoopReqPtr req = sess->req;
+    struct pcap_pkthdr *hdr;
+    virNWFilterSnoopEthHdrPtr packet;
+    int tmp, rv;
+    size_t i, j;
+
+    for (i = 0; i < ARRAY_CARDINALITY(sess->pcapConf); i++) {
+        virNWFilterSnoopPcapConfPtr pc = &sess->pcapConf[i];
+
+        if (!fds[i].revents)
+            continue;
 
-            fds[i].revents = 0;
-            n--;
+        for (j = 0; j < PCAP_READ_BATCH; j++) {
+            unsigned int diff;
 
-            rv = pcap_next_ex(pcapConf[i].handle, &hdr,
-                              (const u_char **)&packet);
+            rv = pcap_next_ex(pc->handle, &hdr, (const u_char **)&packet);
+
+            if (rv == 0)
+                break; /* drained */
 
             if (rv < 0) {
                 /* error reading from socket */
@@ -1454,18 +1610,17 @@ virNWFilterDHCPSnoopThread(void *req0)
                 virNWFilterSnoopReqLock(req);
 
                 if (req->ifname)
-                    tmp = virNetDevValidateConfig(req->ifname, NULL, ifindex);
+                    tmp = virNetDevValidateConfig(req->ifname, NULL,
+                                                  sess->ifindex);
 
                 virNWFilterSnoopReqUnlock(req);
 
-                if (tmp <= 0) {
-                    error = true;
-                    break;
-                }
+                if (tmp <= 0)
+                    return -1;
 
-                if (++errcount > PCAP_READ_MAXERRS) {
-                    pcap_close(pcapConf[i].handle);
-                    pcapConf[i].handle = NULL;
+                if (++sess->errcount > PCAP_READ_MAXERRS) {
+                    pcap_close(pc->handle);
+                    pc->handle = NULL;
 
                     /* protect req->ifname */
                     virNWFilterSnoopReqLock(req);
@@ -1475,96 +1630,267 @@ virNWFilterDHCPSnoopThread(void *req0)
                                      "reopening"),
                                    req->ifname);
                     if (req->ifname)
-                        pcapConf[i].handle =
-                            virNWFilterSnoopDHCPOpen(req->ifname, &req->macaddr,
-                                                     pcapConf[i].filter,
-                                                     pcapConf[i].dir);
+                        pc->handle =
+                            virNWFilterSnoopDHCPOpen(req->ifname,
+                                                     &req->macaddr,
+                                                     pc->filter, pc->dir);
 
                     virNWFilterSnoopReqUnlock(req);
 
-                    if (!pcapConf[i].handle) {
-                        error = true;
-                        break;
-                    }
+                    if (!pc->handle)
+                        return -1;
                 }
-                continue;
+                break;
             }
 
-            errcount = 0;
+            sess->errcount = 0;
 
-            if (rv) {
-                unsigned int diff;
+            /* submit packet to the workers */
+            if (virAtomicIntGet(&req->qCtr[i]) > pc->maxQSize) {
+                if (time(0) - sess->last_displayed_queue > 10) {
+                    sess->last_displayed_queue = time(0);
+                    VIR_WARN("Worker thread for interface '%s' has a "
+                             "job queue that is too long\n",
+                             req->ifname);
+                }
+                continue;
+            }
 
-                /* submit packet to worker thread */
-                if (virAtomicIntGet(&pcapConf[i].qCtr) >
-                    pcapConf[i].maxQSize) {
-                    if (last_displayed_queue - time(0) > 10) {
-                        last_displayed_queue = time(0);
-                        VIR_WARN("Worker thread for interface '%s' has a "
-                                 "job queue that is too long\n",
-                                 req->ifname);
-                    }
-                    continue;
+            diff = virNWFilterSnoopRateLimit(&pc->rateLimit);
+            if (diff > 0) {
+                virNWFilterSnoopRatePenalty(pc, diff, DHCP_PKT_RATE);
+                /* rate-limited warnings */
+                if (time(0) - sess->last_displayed > 10) {
+                     sess->last_displayed = time(0);
+                     VIR_WARN("Too many DHCP packets on interface '%s'",
+                              req->ifname);
                 }
+                if (pc->penaltyTimeoutAbs != 0)
+                    break; /* don't read again until the penalty expired */
+                continue;
+            }
+
+            if (virNWFilterSnoopDHCPDecodeJobSubmit(req, packet,
+                                                    hdr->caplen, pc->dir,
+                                                    &req->qCtr[i]) < 0) {
+                virReportError(VIR_ERR_INTERNAL_ERROR,
+                               _("Job submission failed on "
+                                 "interface '%s'"), req->ifname);
+                return -1;
+            }
+        }
+    }
+
+    return 0;
+}
+
+/*
+ * The shared DHCP snooping engine. A single thread polls the pcap
+ * handles of all snooped interfaces; suitable packets are submitted
+ * to the shared worker pool for processing. The thread also runs the
+ * lease timers and writes out batched lease file updates about once
+ * per second.
+ */
+static void
+virNWFilterSnoopEngineThread(void *opaque ATTRIBUTE_UNUSED)
+{
+    virNWFilterSnoopSessionPtr *sessions = NULL;
+    size_t nsessions = 0, maxsessions = 0;
+    struct pollfd *fds = NULL;
+    size_t nfds = 0, maxfds = 0;
+    time_t lastRun = 0;
+    size_t i, j, k;
+
+    for (;;) {
+        int n, pollTo = -1;
+        bool checkAll = false;
+        time_t now;
+        char buf[64];
+
+        /* pick up new sessions */
+        virMutexLock(&virNWFilterSnoopState.engineLock);
+
+        if (virNWFilterSnoopState.engineQuit) {
+            virMutexUnlock(&virNWFilterSnoopState.engineLock);
+            break;
+        }
+
+        if (virNWFilterSnoopState.npending &&
+            VIR_RESIZE_N(sessions, maxsessions, nsessions,
+                         virNWFilterSnoopState.npending) == 0) {
+            for (i = 0; i < virNWFilterSnoopState.npending; i++)
+                sessions[nsessions++] = virNWFilterSnoopState.pending[i];
+            VIR_FREE(virNWFilterSnoopState.pending);
+            virNWFilterSnoopState.npending = 0;
+        }
+
+        virMutexUnlock(&virNWFilterSnoopState.engineLock);
+
+        nfds = 1 + nsessions * 2;
+        if (VIR_RESIZE_N(fds, maxfds, 0, nfds) < 0) {
+            /* retry on the next wakeup */
+            usleep(SNOOP_ENGINE_TIMEOUT_MS * 1000);
+            continue;
+        }
+
+        fds[0].fd = virNWFilterSnoopState.engineWakeupFD[0];
+        fds[0].events = POLLIN;
+        fds[0].revents = 0;
+
+        for (i = 0; i < nsessions; i++) {
+            struct pollfd *sfds = &fds[1 + i * 2];
+            int tmp;
+
+            for (j = 0; j < 2; j++) {
+                sfds[j].fd = pcap_fileno(sessions[i]->pcapConf[j].handle);
+                /* get a POLLERR if interface goes down or disappears */
+                sfds[j].events = POLLIN | POLLERR;
+                sfds[j].revents = 0;
+            }
+
+            if (virNWFilterSnoopAdjustPoll(sessions[i]->pcapConf, 2,
+                                           sfds, &tmp) == 0 &&
+                tmp != -1 && (pollTo == -1 || tmp < pollTo))
+                pollTo = tmp;
+        }
+
+        if ((nsessions || virNWFilterSnoopState.pLeases) &&
+            (pollTo == -1 || pollTo > SNOOP_ENGINE_TIMEOUT_MS))
+            pollTo = SNOOP_ENGINE_TIMEOUT_MS;
+
+        n = poll(fds, nfds, pollTo);
+
+        if (n < 0 && errno != EAGAIN && errno != EINTR) {
+            VIR_WARN("poll on DHCP snooping handles failed: %s",
+                     strerror(errno));
+            usleep(PCAP_FLOOD_TIMEOUT_MS * 1000);
+            continue;
+        }
+
+        if (n > 0 && fds[0].revents) {
+            while (saferead(fds[0].fd, buf, sizeof(buf)) > 0)
+                ; /* empty */
+            checkAll = true;
+        }
+
+        now = time(0);
+        if (now != lastRun) {
+            lastRun = now;
+            checkAll = true;
+
+            virNWFilterSnoopLock();
+            virNWFilterSnoopLeaseFileFlush(true);
+            virNWFilterSnoopUnlock();
+        }
+
+        for (i = 0, k = 0; i < nsessions; i++) {
+            virNWFilterSnoopSessionPtr sess = sessions[i];
+            struct pollfd *sfds = &fds[1 + i * 2];
+            bool hasEvents = (sfds[0].revents || sfds[1].revents);
 
-                diff = virNWFilterSnoopRateLimit(&pcapConf[i].rateLimit);
-                if (diff > 0) {
-                    virNWFilterSnoopRatePenalty(&pcapConf[i], diff,
-                                                DHCP_PKT_RATE);
-                    /* rate-limited warnings */
-                    if (time(0) - last_displayed > 10) {
-                         last_displayed = time(0);
-                         VIR_WARN("Too many DHCP packets on interface '%s'",
-                                  req->ifname);
-                    }
+            if (hasEvents || checkAll) {
+                virNWFilterSnoopReqLeaseTimerRun(sess->req);
+
+                /*
+                 * Check whether we were cancelled or whether
+                 * a previously submitted job failed.
+                 */
+                if (!virNWFilterSnoopIsActive(sess->threadkey) ||
+                    sess->req->jobCompletionStatus != 0) {
+                    virNWFilterSnoopSessionRelease(sess, true);
                     continue;
                 }
 
-                if (virNWFilterSnoopDHCPDecodeJobSubmit(worker, packet,
-                                                      hdr->caplen,
-                                                      pcapConf[i].dir,
-                                                      &pcapConf[i].qCtr) < 0) {
-                    virReportError(VIR_ERR_INTERNAL_ERROR,
-                                   _("Job submission failed on "
-                                     "interface '%s'"), req->ifname);
-                    error = true;
-                    break;
+                if (hasEvents &&
+                    virNWFilterSnoopSessionRead(sess, sfds) < 0) {
+                    virNWFilterSnoopSessionRelease(sess, true);
+                    continue;
                 }
             }
-        } /* for all fds */
-    } /* while (!error) */
 
-    /* protect IfNameToKey */
-    virNWFilterSnoopLock();
+            sessions[k++] = sess;
+        }
+        nsessions = k;
+    }
 
-    /* protect req->ifname & req->threadkey */
-    virNWFilterSnoopReqLock(req);
+    for (i = 0; i < nsessions; i++)
+        virNWFilterSnoopSessionRelease(sessions[i], false);
+    VIR_FREE(sessions);
+    VIR_FREE(fds);
+
+    /* sessions that were started while we were shutting down */
+    virMutexLock(&virNWFilterSnoopState.engineLock);
+    sessions = virNWFilterSnoopState.pending;
+    nsessions = virNWFilterSnoopState.npending;
+    virNWFilterSnoopState.pending = NULL;
+    virNWFilterSnoopState.npending = 0;
+    virMutexUnlock(&virNWFilterSnoopState.engineLock);
+
+    for (i = 0; i < nsessions; i++)
+        virNWFilterSnoopSessionRelease(sessions[i], false);
+    VIR_FREE(sessions);
+}
 
-    virNWFilterSnoopCancel(&req->threadkey);
+static int
+virNWFilterSnoopEngineStart(void)
+{
+    if (pipe2(virNWFilterSnoopState.engineWakeupFD,
+              O_CLOEXEC | O_NONBLOCK) < 0) {
+        virReportSystemError(errno, "%s",
+                             _("Unable to setup wakeup pipe"));
+        return -1;
+    }
 
-    ignore_value(virHashRemoveEntry(virNWFilterSnoopState.ifnameToKey,
-                                    req->ifname));
+    virNWFilterSnoopState.workers = virThreadPoolNew(1, SNOOP_MAX_WORKERS, 0,
+                                                     virNWFilterDHCPDecodeWorker,
+                                                     NULL);
+    if (!virNWFilterSnoopState.workers)
+        goto error;
 
-    VIR_FREE(req->ifname);
+    virNWFilterSnoopState.engineQuit = false;
 
-    virNWFilterSnoopReqUnlock(req);
-    virNWFilterSnoopUnlock();
+    if (virThreadCreate(&virNWFilterSnoopState.engineThread, true,
+                        virNWFilterSnoopEngineThread, NULL) < 0) {
+        virReportSystemError(errno, "%s",
+                             _("Unable to create DHCP snooping thread"));
+        goto error;
+    }
 
-exit:
-    virThreadPoolFree(worker);
+    virNWFilterSnoopState.engineRunning = true;
 
-    virNWFilterSnoopReqPut(req);
+    return 0;
 
-    VIR_FREE(threadkey);
+error:
+    virThreadPoolFree(virNWFilterSnoopState.workers);
+    virNWFilterSnoopState.workers = NULL;
+    VIR_FORCE_CLOSE(virNWFilterSnoopState.engineWakeupFD[0]);
+    VIR_FORCE_CLOSE(virNWFilterSnoopState.engineWakeupFD[1]);
+    return -1;
+}
 
-    for (i = 0; i < ARRAY_CARDINALITY(pcapConf); i++) {
-        if (pcapConf[i].handle)
-            pcap_close(pcapConf[i].handle);
-    }
+/*
+ * Stop the engine thread and wait for the workers to finish the
+ * packets they have been handed.
+ */
+static void
+virNWFilterSnoopEngineStop(void)
+{
+    if (!virNWFilterSnoopState.engineRunning)
+        return;
 
-    virAtomicIntDecAndTest(&virNWFilterSnoopState.nThreads);
+    virMutexLock(&virNWFilterSnoopState.engineLock);
+    virNWFilterSnoopState.engineQuit = true;
+    virMutexUnlock(&virNWFilterSnoopState.engineLock);
 
-    return;
+    virNWFilterSnoopEngineWakeup();
+    virThreadJoin(&virNWFilterSnoopState.engineThread);
+    virNWFilterSnoopState.engineRunning = false;
+
+    virThreadPoolFree(virNWFilterSnoopState.workers);
+    virNWFilterSnoopState.workers = NULL;
+
+    VIR_FORCE_CLOSE(virNWFilterSnoopState.engineWakeupFD[0]);
+    VIR_FORCE_CLOSE(virNWFilterSnoopState.engineWakeupFD[1]);
 }
 
 static void
@@ -1591,7 +1917,6 @@ virNWFilterDHCPSnoopReq(virNWFilterTechDriverPtr techdriver,
     bool isnewreq;
     char ifkey[VIR_IFKEY_LEN];
     int tmp;
-    virThread thread;
     virNWFilterVarValuePtr dhcpsrvrs;
 
     virNWFilterSnoopIFKeyFMT(ifkey, vmuuid, macaddr);
@@ -1675,19 +2000,9 @@ virNWFilterDHCPSnoopReq(virNWFilterTechDriverPtr techdriver,
         goto exit_rem_ifnametokey;
     }
 
-    /* prevent thread from holding req */
+    /* prevent the engine from seeing a partially set up req */
     virNWFilterSnoopReqLock(req);
 
-    if (virThreadCreate(&thread, false, virNWFilterDHCPSnoopThread,
-                        req) != 0) {
-        virReportError(VIR_ERR_INTERNAL_ERROR,
-                       _("virNWFilterDHCPSnoopReq virThreadCreate "
-                         "failed on interface '%s'"), ifname);
-        goto exit_snoopreq_unlock;
-    }
-
-    virAtomicIntInc(&virNWFilterSnoopState.nThreads);
-
     req->threadkey = virNWFilterSnoopActivate(req);
     if (!req->threadkey) {
         virReportError(VIR_ERR_INTERNAL_ERROR,
@@ -1703,16 +2018,19 @@ virNWFilterDHCPSnoopReq(virNWFilterTechDriverPtr techdriver,
         goto exit_snoop_cancel;
     }
 
-    /* sync with thread */
-    if (virCondWait(&req->threadStatusCond, &req->lock) < 0 ||
-        req->threadStatus != THREAD_STATUS_OK)
+    /* have the shared engine snoop on the interface */
+    if (virNWFilterSnoopSessionStart(req) < 0) {
+        virReportError(VIR_ERR_INTERNAL_ERROR,
+                       _("Snooping DHCP traffic failed on "
+                         "interface '%s'"), req->ifname);
         goto exit_snoop_cancel;
+    }
 
     virNWFilterSnoopReqUnlock(req);
 
     virNWFilterSnoopUnlock();
 
-    /* do not 'put' the req -- the thread will do this */
+    /* do not 'put' the req -- the engine will do this */
 
     return 0;
 
@@ -1746,16 +2064,14 @@ virNWFilterSnoopLeaseFileOpen(void)
 }
 
 /*
- * Write a single lease to the given file.
+ * Format a single lease as a line of the lease file.
  *
  */
 static int
-virNWFilterSnoopLeaseFileWrite(int lfd, const char *ifkey,
-                               virNWFilterSnoopIPLeasePtr ipl)
+virNWFilterSnoopLeaseFileFormat(virBufferPtr buf, const char *ifkey,
+                                virNWFilterSnoopIPLeasePtr ipl)
 {
-    char *lbuf = NULL;
     char *ipstr, *dhcpstr;
-    int len;
     int ret = 0;
 
     ipstr = virSocketAddrFormat(&ipl->ipAddress);
@@ -1767,24 +2083,10 @@ virNWFilterSnoopLeaseFileWrite(int lfd, const char *ifkey,
     }
 
     /* time intf ip dhcpserver */
-    len = virAsprintf(&lbuf, "%u %s %s %s\n", ipl->timeout,
+    virBufferAsprintf(buf, "%u %s %s %s\n", ipl->timeout,
                       ifkey, ipstr, dhcpstr);
 
-    if (len < 0) {
-        ret = -1;
-        goto cleanup;
-    }
-
-    if (safewrite(lfd, lbuf, len) != len) {
-        virReportSystemError(errno, "%s", _("lease file write failed"));
-        ret = -1;
-        goto cleanup;
-    }
-
-    ignore_value(fsync(lfd));
-
 cleanup:
-    VIR_FREE(lbuf);
     VIR_FREE(dhcpstr);
     VIR_FREE(ipstr);
 
@@ -1792,10 +2094,9 @@ cleanup:
 }
 
 /*
- * Append a single lease to the end of the lease file.
- * To keep a limited number of dead leases, re-read the lease
- * file if the threshold of active leases versus written ones
- * exceeds a threshold.
+ * Queue a single lease for appending to the end of the lease file.
+ * The engine writes the queued leases about once per second, so a
+ * burst of lease updates costs a single write() and fsync().
  */
 static void
 virNWFilterSnoopLeaseFileSave(virNWFilterSnoopIPLeasePtr ipl)
@@ -1804,19 +2105,68 @@ virNWFilterSnoopLeaseFileSave(virNWFilterSnoopIPLeasePtr ipl)
 
     virNWFilterSnoopLock();
 
+    if (virNWFilterSnoopLeaseFileFormat(&virNWFilterSnoopState.leaseBuf,
+                                        req->ifkey, ipl) < 0)
+        goto err_exit;
+
+    virNWFilterSnoopState.pLeases++;
+
+    if (virNWFilterSnoopState.pLeases >= LEASEFILE_BATCH_MAX ||
+        !virNWFilterSnoopState.engineRunning)
+        virNWFilterSnoopLeaseFileFlush(true);
+    else if (virNWFilterSnoopState.pLeases == 1)
+        virNWFilterSnoopEngineWakeup();
+
+err_exit:
+    virNWFilterSnoopUnlock();
+}
+
+/*
+ * Write the lease file lines collected in leaseBuf with a single
+ * write() and fsync(). To keep a limited number of dead leases,
+ * re-read the lease file if the threshold of active leases versus
+ * written ones exceeds a threshold.
+ * Call this function with the SnoopLock held.
+ */
+static void
+virNWFilterSnoopLeaseFileFlush(bool refresh)
+{
+    char *lbuf;
+    size_t len;
+    int nlines = virNWFilterSnoopState.pLeases;
+
+    if (nlines == 0)
+        return;
+
+    virNWFilterSnoopState.pLeases = 0;
+
+    if (virBufferError(&virNWFilterSnoopState.leaseBuf)) {
+        virBufferFreeAndReset(&virNWFilterSnoopState.leaseBuf);
+        virReportOOMError();
+        return;
+    }
+
+    len = virBufferUse(&virNWFilterSnoopState.leaseBuf);
+    lbuf = virBufferContentAndReset(&virNWFilterSnoopState.leaseBuf);
+
     if (virNWFilterSnoopState.leaseFD < 0)
         virNWFilterSnoopLeaseFileOpen();
-    if (virNWFilterSnoopLeaseFileWrite(virNWFilterSnoopState.leaseFD,
-                                       req->ifkey, ipl) < 0)
-        goto err_exit;
+
+    if (safewrite(virNWFilterSnoopState.leaseFD, lbuf, len) != len) {
+        virReportSystemError(errno, "%s", _("lease file write failed"));
+        goto cleanup;
+    }
+
+    ignore_value(fsync(virNWFilterSnoopState.leaseFD));
 
     /* keep dead leases at < ~95% of file size */
-    if (virAtomicIntInc(&virNWFilterSnoopState.wLeases) >=
+    if (refresh &&
+        virAtomicIntAdd(&virNWFilterSnoopState.wLeases, nlines) + nlines >=
         virAtomicIntGet(&virNWFilterSnoopState.nLeases) * 20)
         virNWFilterSnoopLeaseFileLoad();   /* load & refresh lease file */
 
-err_exit:
-    virNWFilterSnoopUnlock();
+cleanup:
+    VIR_FREE(lbuf);
 }
 
 /*
@@ -1860,14 +2210,14 @@ virNWFilterSnoopSaveIter(void *payload,
                          void *data)
 {
     virNWFilterSnoopReqPtr req = payload;
-    int tfd = *(int *)data;
+    virBufferPtr buf = data;
     virNWFilterSnoopIPLeasePtr ipl;
 
     /* protect req->start */
     virNWFilterSnoopReqLock(req);
 
     for (ipl = req->start; ipl; ipl = ipl->next)
-        ignore_value(virNWFilterSnoopLeaseFileWrite(tfd, req->ifkey, ipl));
+        ignore_value(virNWFilterSnoopLeaseFileFormat(buf, req->ifkey, ipl));
 
     virNWFilterSnoopReqUnlock(req);
 }
@@ -1880,6 +2230,9 @@ virNWFilterSnoopSaveIter(void *payload,
 static void
 virNWFilterSnoopLeaseFileRefresh(void)
 {
+    virBuffer buf = VIR_BUFFER_INITIALIZER;
+    char *lbuf = NULL;
+    size_t len;
     int tfd;
 
     if (virFileMakePathWithMode(LEASEFILE_DIR, 0700) < 0) {
@@ -1903,9 +2256,26 @@ virNWFilterSnoopLeaseFileRefresh(void)
                          virNWFilterSnoopPruneIter, NULL);
         /* now save them */
         virHashForEach(virNWFilterSnoopState.snoopReqs,
-                       virNWFilterSnoopSaveIter, (void *)&tfd);
+                       virNWFilterSnoopSaveIter, &buf);
+    }
+
+    if (virBufferError(&buf)) {
+        virReportOOMError();
+        VIR_FORCE_CLOSE(tfd);
+        goto skip_rename;
+    }
+
+    len = virBufferUse(&buf);
+    lbuf = virBufferContentAndReset(&buf);
+
+    if (len && safewrite(tfd, lbuf, len) != len) {
+        virReportSystemError(errno, "%s", _("lease file write failed"));
+        VIR_FORCE_CLOSE(tfd);
+        goto skip_rename;
     }
 
+    ignore_value(fsync(tfd));
+
     if (VIR_CLOSE(tfd) < 0) {
         virReportSystemError(errno, _("unable to close %s"), TMPLEASEFILE);
         /* assuming the old lease file is still better, skip the renaming */
@@ -1920,6 +2290,8 @@ virNWFilterSnoopLeaseFileRefresh(void)
     virAtomicIntSet(&virNWFilterSnoopState.wLeases, 0);
 
 skip_rename:
+    virBufferFreeAndReset(&buf);
+    VIR_FREE(lbuf);
     virNWFilterSnoopLeaseFileOpen();
 }
 
@@ -1938,6 +2310,9 @@ virNWFilterSnoopLeaseFileLoad(void)
     /* protect the lease file */
     virNWFilterSnoopLock();
 
+    /* the file has to reflect all updates before we read it */
+    virNWFilterSnoopLeaseFileFlush(false);
+
     fp = fopen(LEASEFILE, "r");
     time(&now);
     while (fp && fgets(line, sizeof(line), fp)) {
@@ -2000,19 +2375,6 @@ virNWFilterSnoopLeaseFileLoad(void)
     virNWFilterSnoopUnlock();
 }
 
-/*
- * Wait until all threads have ended.
- */
-static void
-virNWFilterSnoopJoinThreads(void)
-{
-    while (virAtomicIntGet(&virNWFilterSnoopState.nThreads) != 0) {
-        VIR_WARN("Waiting for snooping threads to terminate: %u\n",
-                 virAtomicIntGet(&virNWFilterSnoopState.nThreads));
-        usleep(1000 * 1000);
-    }
-}
-
 /*
  * Iterator to remove a request, repeatedly called on one
  * request after another.
@@ -2073,7 +2435,8 @@ virNWFilterDHCPSnoopInit(void)
     VIR_DEBUG("Initializing DHCP snooping");
 
     if (virMutexInitRecursive(&virNWFilterSnoopState.snoopLock) < 0 ||
-        virMutexInit(&virNWFilterSnoopState.activeLock) < 0)
+        virMutexInit(&virNWFilterSnoopState.activeLock) < 0 ||
+        virMutexInit(&virNWFilterSnoopState.engineLock) < 0)
         return -1;
 
     virNWFilterSnoopState.ifnameToKey = virHashCreate(0, NULL);
@@ -2089,9 +2452,14 @@ virNWFilterDHCPSnoopInit(void)
     virNWFilterSnoopLeaseFileLoad();
     virNWFilterSnoopLeaseFileOpen();
 
+    if (virNWFilterSnoopEngineStart() < 0)
+        goto err_exit;
+
     return 0;
 
 err_exit:
+    virNWFilterSnoopLeaseFileClose();
+
     virHashFree(virNWFilterSnoopState.ifnameToKey);
     virNWFilterSnoopState.ifnameToKey = NULL;
 
@@ -2156,6 +2524,7 @@ virNWFilterDHCPSnoopEnd(const char *ifname)
 
         virNWFilterSnoopReqPut(req);
     } else {                      /* free all of them */
+        virNWFilterSnoopLeaseFileFlush(false);
         virNWFilterSnoopLeaseFileClose();
 
         virHashRemoveAll(virNWFilterSnoopState.ifnameToKey);
@@ -2174,10 +2543,11 @@ void
 virNWFilterDHCPSnoopShutdown(void)
 {
     virNWFilterSnoopEndThreads();
-    virNWFilterSnoopJoinThreads();
+    virNWFilterSnoopEngineStop();
 
     virNWFilterSnoopLock();
 
+    virNWFilterSnoopLeaseFileFlush(false);
     virNWFilterSnoopLeaseFileClose();
     virHashFree(virNWFilterSnoopState.ifnameToKey);
     virHashFree(virNWFilterSnoopState.snoopReqs);
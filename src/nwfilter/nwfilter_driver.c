@@ -290,6 +290,7 @@ nwfilterStateReload(void)
 
     virNWFilterLoadAllConfigs(&driverState->nwfilters,
                               driverState->configDir);
+    virNWFilterInstCacheInvalidate(NULL);
 
     virNWFilterCallbackDriversUnlock();
     virNWFilterUnlockFilterUpdates();
@@ -569,6 +570,7 @@ nwfilterDefineXML(virConnectPtr conn,
 
     if (!(nwfilter = virNWFilterObjAssignDef(&driver->nwfilters, def)))
         goto cleanup;
+    virNWFilterInstCacheInvalidate(nwfilter->def->name);
 
     if (virNWFilterObjSaveDef(driver, nwfilter, def) < 0) {
         virNWFilterObjRemove(&driver->nwfilters, nwfilter);
@@ -623,6 +625,7 @@ nwfilterUndefine(virNWFilterPtr obj) {
 
     VIR_FREE(nwfilter->configFile);
 
+    virNWFilterInstCacheInvalidate(nwfilter->def->name);
     virNWFilterObjRemove(&driver->nwfilters, nwfilter);
     nwfilter = NULL;
     ret = 0;
@@ -482,6 +482,7 @@ ebiptablesRuleInstFree(ebiptablesRuleInstPtr inst)
         return;
 
     VIR_FREE(inst->commandTemplate);
+    VIR_FREE(inst->neededProtocolChain);
     VIR_FREE(inst);
 }
 
@@ -497,11 +498,14 @@ ebiptablesAddRuleInst(virNWFilterRuleInstPtr res,
 {
     ebiptablesRuleInstPtr inst;
 
-    if (VIR_ALLOC(inst) < 0)
+    if (VIR_ALLOC(inst) < 0 ||
+        VIR_STRDUP(inst->neededProtocolChain, neededChain) < 0) {
+        VIR_FREE(inst);
+        VIR_FREE(commandTemplate);
         return -1;
+    }
 
     inst->commandTemplate = commandTemplate;
-    inst->neededProtocolChain = neededChain;
     inst->chainPriority = chainPriority;
     inst->chainprefix = chainprefix;
     inst->priority = priority;
@@ -2795,6 +2799,97 @@ ebiptablesDisplayRuleInstance(void *_inst)
 }
 
 
+/**
+ * ebiptablesCopyRuleInstance:
+ * @_inst : the rule instance created for @ifname
+ * @ifname : the interface @_inst was created for
+ * @newifname : the interface the copy is for
+ * @_copy : where to store the copy
+ *
+ * The only part of a command template that depends on the interface
+ * is the name of the chain the rule is added to, so rebuild that name
+ * for @newifname and splice it into a copy of the template.
+ *
+ * Returns 0 on success, -1 on error with error reported
+ */
+static int
+ebiptablesCopyRuleInstance(void *_inst,
+                           const char *ifname,
+                           const char *newifname,
+                           void **_copy)
+{
+    ebiptablesRuleInstPtr inst = _inst;
+    ebiptablesRuleInstPtr copy;
+    char chain[MAX_CHAINNAME_LENGTH];
+    char newchain[MAX_CHAINNAME_LENGTH];
+    char chainPrefix[2];
+    const char *start;
+    size_t len;
+
+    if (!(start = strstr(inst->commandTemplate, "-%c ")))
+        goto unsupported;
+    start += strlen("-%c ");
+
+    switch (inst->ruleType) {
+    case RT_EBTABLES:
+        if (STREQ(inst->neededProtocolChain,
+                  virNWFilterChainSuffixTypeToString(
+                      VIR_NWFILTER_CHAINSUFFIX_ROOT))) {
+            PRINT_ROOT_CHAIN(chain, inst->chainprefix, ifname);
+            PRINT_ROOT_CHAIN(newchain, inst->chainprefix, newifname);
+        } else {
+            PRINT_CHAIN(chain, inst->chainprefix, ifname,
+                        inst->neededProtocolChain);
+            PRINT_CHAIN(newchain, inst->chainprefix, newifname,
+                        inst->neededProtocolChain);
+        }
+    break;
+
+    case RT_IPTABLES:
+    case RT_IP6TABLES:
+        if (!start[0] || !start[1])
+            goto unsupported;
+        chainPrefix[0] = start[0];
+        chainPrefix[1] = start[1];
+        PRINT_IPT_ROOT_CHAIN(chain, chainPrefix, ifname);
+        PRINT_IPT_ROOT_CHAIN(newchain, chainPrefix, newifname);
+    break;
+    }
+
+    len = strlen(chain);
+    if (!STRPREFIX(start, chain) || start[len] != ' ' ||
+        strstr(start + len, "-%c "))
+        goto unsupported;
+
+    if (VIR_ALLOC(copy) < 0)
+        return -1;
+
+    *copy = *inst;
+    copy->commandTemplate = NULL;
+    copy->neededProtocolChain = NULL;
+
+    /* The chain name is copied rather than shared with the filter
+     * definition, as cached copies outlive redefinitions of it */
+    if (virAsprintf(&copy->commandTemplate, "%.*s%s%s",
+                    (int)(start - inst->commandTemplate),
+                    inst->commandTemplate, newchain, start + len) < 0 ||
+        VIR_STRDUP(copy->neededProtocolChain,
+                   inst->neededProtocolChain) < 0) {
+        ebiptablesRuleInstFree(copy);
+        return -1;
+    }
+
+    *_copy = copy;
+    return 0;
+
+unsupported:
+    virReportError(VIR_ERR_INTERNAL_ERROR,
+                   _("cannot find chain for interface '%s' in rule '%s'"),
+                   ifname, inst->commandTemplate);
+    return -1;
+}
+
+
 /**
  * ebiptablesExecCLI:
  * @buf : pointer to virBuffer containing the string with the commands to
@@ -3058,8 +3153,10 @@ ebtablesCreateTmpSubChain(ebiptablesRuleInstPtr *inst,
     tmp[*nRuleInstances - 1].priority = priority;
     tmp[*nRuleInstances - 1].commandTemplate =
         virBufferContentAndReset(&buf);
-    tmp[*nRuleInstances - 1].neededProtocolChain =
-        virNWFilterChainSuffixTypeToString(VIR_NWFILTER_CHAINSUFFIX_ROOT);
+    if (VIR_STRDUP(tmp[*nRuleInstances - 1].neededProtocolChain,
+                   virNWFilterChainSuffixTypeToString(
+                       VIR_NWFILTER_CHAINSUFFIX_ROOT)) < 0)
+        return -1;
 
     return 0;
 }
@@ -3904,8 +4001,10 @@ ebiptablesApplyNewRules(const char *ifname,
     virHashFree(chains_in_set);
     virHashFree(chains_out_set);
 
-    for (i = 0; i < nEbtChains; i++)
+    for (i = 0; i < nEbtChains; i++) {
         VIR_FREE(ebtChains[i].commandTemplate);
+        VIR_FREE(ebtChains[i].neededProtocolChain);
+    }
     VIR_FREE(ebtChains);
 
     VIR_FREE(errmsg);
@@ -3958,8 +4057,10 @@ exit_free_sets:
     virHashFree(chains_in_set);
     virHashFree(chains_out_set);
 
-    for (i = 0; i < nEbtChains; i++)
+    for (i = 0; i < nEbtChains; i++) {
         VIR_FREE(ebtChains[i].commandTemplate);
+        VIR_FREE(ebtChains[i].neededProtocolChain);
+    }
     VIR_FREE(ebtChains);
 
     VIR_FREE(errmsg);
@@ -4160,6 +4261,7 @@ virNWFilterTechDriver ebiptables_driver = {
     .removeRules         = ebiptablesRemoveRules,
     .freeRuleInstance    = ebiptablesFreeRuleInstance,
     .displayRuleInstance = ebiptablesDisplayRuleInstance,
+    .copyRuleInstance    = ebiptablesCopyRuleInstance,
 
     .canApplyBasicRules  = ebiptablesCanApplyBasicRules,
     .applyBasicRules     = ebtablesApplyBasicRules,
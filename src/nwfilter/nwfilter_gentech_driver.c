@@ -30,7 +30,7 @@
 #include "virlog.h"
 #include "domain_conf.h"
 #include "virerror.h"
-#include "nwfilter_gentech_driver.h"
+#include "nwfilter_gentech_driverpriv.h"
 #include "nwfilter_ebiptables_driver.h"
 #include "nwfilter_dhcpsnoop.h"
 #include "nwfilter_ipaddrmap.h"
@@ -47,6 +47,9 @@
 
 #define NWFILTER_DFLT_LEARN  "any"
 
+/* Upper bound on the number of compiled filter trees kept around */
+#define NWFILTER_INST_CACHE_MAX 1024
+
 static int _virNWFilterTeardownFilter(const char *ifname);
 
 
@@ -59,18 +62,43 @@ static virNWFilterTechDriverPtr filter_tech_drivers[] = {
  * to avoid lock ordering deadlocks. eg __virNWFilterInstantiateFilter
  * will hold a lock on a virNWFilterObjPtr. This in turn invokes
  * virNWFilterInstantiate which invokes virNWFilterDetermineMissingVarsRec
- * which invokes virNWFilterObjFindByName. This iterates over every single
- * virNWFilterObjPtr in the list. So if 2 threads try to instantiate a
+ * which invokes virNWFilterObjFindByName. That normally only locks the
+ * filter found through the list's name index, but falls back to
+ * iterating over every single virNWFilterObjPtr in the list if the
+ * index could not be maintained. So if 2 threads try to instantiate a
  * filter in parallel, they'll both hold 1 lock at the top level in
- * __virNWFilterInstantiateFilter which will cause the other thread
+ * __virNWFilterInstantiateFilter which could cause the other thread
  * to deadlock in virNWFilterObjFindByName.
- *
- * XXX better long term solution is to make virNWFilterObjList use a
- * hash table as is done for virDomainObjList. You can then get
- * lockless lookup of objects by name.
  */
 static virMutex updateMutex;
 
+/*
+ * Compiled filter trees. Instantiating a filter for an interface
+ * resolves the variables used by the whole tree and has the tech
+ * driver turn every rule into commands; guests using the same filter
+ * with the same values for those variables end up with the same
+ * commands except for the interface name. The rule instances are
+ * therefore kept here, keyed by the filter, tech driver and variable
+ * bindings, along with the names of all filters in the tree so that
+ * redefining any of them drops the entry.
+ *
+ * Protected by updateMutex.
+ */
+typedef struct _virNWFilterInstCacheEntry virNWFilterInstCacheEntry;
+typedef virNWFilterInstCacheEntry *virNWFilterInstCacheEntryPtr;
+struct _virNWFilterInstCacheEntry {
+    char *ifname;              /* interface the rules were built for */
+    virHashTablePtr filters;   /* names of the filters in the tree */
+    int ninsts;
+    virNWFilterRuleInstPtr *insts;
+};
+
+static virHashTablePtr instCache;
+static unsigned long long instCacheHits;
+static unsigned long long instCacheMisses;
+
+static void virNWFilterInstCacheEntryFree(void *payload, const void *name);
+
 int virNWFilterTechDriversInit(bool privileged)
 {
     size_t i = 0;
@@ -78,6 +106,11 @@ int virNWFilterTechDriversInit(bool privileged)
     if (virMutexInitRecursive(&updateMutex) < 0)
         return -1;
 
+    if (!(instCache = virHashCreate(64, virNWFilterInstCacheEntryFree))) {
+        virMutexDestroy(&updateMutex);
+        return -1;
+    }
+
     while (filter_tech_drivers[i]) {
         if (!(filter_tech_drivers[i]->flags & TECHDRV_FLAG_INITIALIZED))
             filter_tech_drivers[i]->init(privileged);
@@ -95,6 +128,13 @@ void virNWFilterTechDriversShutdown(void)
             filter_tech_drivers[i]->shutdown();
         i++;
     }
+
+    if (instCacheHits + instCacheMisses)
+        VIR_INFO("Filter instantiation cache: %llu hits, %llu misses (%.1f%%)",
+                 instCacheHits, instCacheMisses,
+                 100.0 * instCacheHits / (instCacheHits + instCacheMisses));
+    virHashFree(instCache);
+    instCache = NULL;
     virMutexDestroy(&updateMutex);
 }
 
@@ -140,7 +180,7 @@ virNWFilterRuleInstAddData(virNWFilterRuleInstPtr res,
 }
 
 
-static void
+void
 virNWFilterRuleInstFree(virNWFilterRuleInstPtr inst)
 {
     size_t i;
@@ -155,6 +195,134 @@ virNWFilterRuleInstFree(virNWFilterRuleInstPtr inst)
 }
 
 
+/**
+ * virNWFilterRuleInstsCopy:
+ * @insts: the rule instances to copy
+ * @ninsts: number of entries in @insts
+ * @ifname: the interface @insts were created for
+ * @newifname: the interface to create the copies for
+ * @copies: array to append the copies to
+ * @ncopies: number of entries in @copies
+ *
+ * Returns 0 on success, -1 on error with error reported; the
+ * copies made so far are left in @copies in either case.
+ */
+static int
+virNWFilterRuleInstsCopy(virNWFilterRuleInstPtr *insts,
+                         int ninsts,
+                         const char *ifname,
+                         const char *newifname,
+                         virNWFilterRuleInstPtr **copies,
+                         int *ncopies)
+{
+    virNWFilterRuleInstPtr copy;
+    void *data;
+    size_t i, j;
+
+    for (i = 0; i < ninsts; i++) {
+        virNWFilterTechDriverPtr techdriver = insts[i]->techdriver;
+
+        if (VIR_ALLOC(copy) < 0)
+            return -1;
+        copy->techdriver = techdriver;
+
+        if (VIR_REALLOC_N(*copies, (*ncopies) + 1) < 0) {
+            VIR_FREE(copy);
+            return -1;
+        }
+        (*copies)[(*ncopies)++] = copy;
+
+        for (j = 0; j < insts[i]->ndata; j++) {
+            if (techdriver->copyRuleInstance(insts[i]->data[j],
+                                             ifname, newifname,
+                                             &data) < 0)
+                return -1;
+
+            if (virNWFilterRuleInstAddData(copy, data) < 0) {
+                techdriver->freeRuleInstance(data);
+                return -1;
+            }
+        }
+    }
+
+    return 0;
+}
+
+
+static void
+virNWFilterInstCacheEntryFree(void *payload,
+                              const void *name ATTRIBUTE_UNUSED)
+{
+    virNWFilterInstCacheEntryPtr entry = payload;
+    size_t i;
+
+    if (!entry)
+        return;
+
+    for (i = 0; i < entry->ninsts; i++)
+        virNWFilterRuleInstFree(entry->insts[i]);
+    VIR_FREE(entry->insts);
+    virHashFree(entry->filters);
+    VIR_FREE(entry->ifname);
+    VIR_FREE(entry);
+}
+
+
+static int
+virNWFilterInstCacheEntryUsesFilter(const void *payload,
+                                    const void *name ATTRIBUTE_UNUSED,
+                                    const void *data)
+{
+    const virNWFilterInstCacheEntry *entry = payload;
+
+    return virHashLookup(entry->filters, data) != NULL;
+}
+
+
+/**
+ * virNWFilterInstCacheGetStats:
+ * @hits: filled with the number of filter trees reused
+ * @misses: filled with the number of filter trees compiled
+ */
+void
+virNWFilterInstCacheGetStats(unsigned long long *hits,
+                             unsigned long long *misses)
+{
+    virMutexLock(&updateMutex);
+    *hits = instCacheHits;
+    *misses = instCacheMisses;
+    virMutexUnlock(&updateMutex);
+}
+
+
+/**
+ * virNWFilterInstCacheInvalidate:
+ * @filtername: the filter that was redefined or removed, or NULL
+ *
+ * Drop all compiled filter trees that include the filter
+ * @filtername, or all of them if @filtername is NULL.
+ */
+void
+virNWFilterInstCacheInvalidate(const char *filtername)
+{
+    ssize_t n;
+
+    virMutexLock(&updateMutex);
+
+    if (filtername)
+        n = virHashRemoveSet(instCache,
+                             virNWFilterInstCacheEntryUsesFilter,
+                             filtername);
+    else
+        n = virHashRemoveAll(instCache);
+
+    VIR_DEBUG("Dropped %zd cached filter trees for %s",
+              n, NULLSTR(filtername));
+
+    virMutexUnlock(&updateMutex);
+}
+
+
 /**
  * virNWFilterVarHashmapAddStdValues:
  * @tables: pointer to hash tabel to add values to
@@ -502,6 +670,223 @@ _virNWFilterInstantiateRec(virNWFilterTechDriverPtr techdriver,
 }
 
 
+/*
+ * Collect the names of all filters referenced by @filter and of all
+ * variables its rules and those of its subfilters access. Returns -1
+ * without reporting an error if a subfilter is missing or about to be
+ * removed; _virNWFilterInstantiateRec reports those.
+ */
+static int
+virNWFilterInstCacheCollectRec(virNWFilterDefPtr filter,
+                               virHashTablePtr filters,
+                               virHashTablePtr varnames,
+                               virNWFilterDriverStatePtr driver)
+{
+    virNWFilterObjPtr obj;
+    size_t i, j;
+    int rc;
+
+    for (i = 0; i < filter->nentries; i++) {
+        virNWFilterRuleDefPtr    rule = filter->filterEntries[i]->rule;
+        virNWFilterIncludeDefPtr inc  = filter->filterEntries[i]->include;
+
+        if (rule) {
+            for (j = 0; j < rule->nVarAccess; j++) {
+                const char *name =
+                    virNWFilterVarAccessGetVarName(rule->varAccess[j]);
+
+                if (virHashUpdateEntry(varnames, name, (void *)~0) < 0)
+                    return -1;
+            }
+        } else if (inc) {
+            if (virHashLookup(filters, inc->filterref))
+                continue;
+
+            obj = virNWFilterObjFindByName(&driver->nwfilters,
+                                           inc->filterref);
+            if (!obj)
+                return -1;
+
+            if (obj->wantRemoved ||
+                virHashAddEntry(filters, inc->filterref, (void *)~0) < 0) {
+                virNWFilterObjUnlock(obj);
+                return -1;
+            }
+
+            rc = virNWFilterInstCacheCollectRec(obj->def, filters,
+                                                varnames, driver);
+            virNWFilterObjUnlock(obj);
+            if (rc < 0)
+                return -1;
+        }
+    }
+
+    return 0;
+}
+
+
+static int
+virNWFilterInstCacheCompareNames(const virHashKeyValuePair *a,
+                                 const virHashKeyValuePair *b)
+{
+    return strcmp(a->key, b->key);
+}
+
+
+/*
+ * Build the cache key for instantiating @filter with @vars: the tech
+ * driver, the network type, the filter name, and the values of all
+ * variables accessed anywhere in the tree. The values are length
+ * prefixed so that different bindings never produce the same key.
+ * The names of all filters in the tree are added to @filters.
+ */
+static char *
+virNWFilterInstCacheKey(virNWFilterTechDriverPtr techdriver,
+                        enum virDomainNetType nettype,
+                        virNWFilterDefPtr filter,
+                        virNWFilterHashTablePtr vars,
+                        virHashTablePtr filters,
+                        virNWFilterDriverStatePtr driver)
+{
+    virBuffer buf = VIR_BUFFER_INITIALIZER;
+    virHashTablePtr varnames = NULL;
+    virHashKeyValuePairPtr items = NULL;
+    const virNWFilterVarValue *val;
+    const char *str;
+    size_t i;
+    unsigned int j;
+
+    if (!(varnames = virHashCreate(8, NULL)) ||
+        virHashAddEntry(filters, filter->name, (void *)~0) < 0 ||
+        virNWFilterInstCacheCollectRec(filter, filters,
+                                       varnames, driver) < 0 ||
+        !(items = virHashGetItems(varnames,
+                                  virNWFilterInstCacheCompareNames)))
+        goto error;
+
+    virBufferAsprintf(&buf, "%s\n%d\n%s\n",
+                      techdriver->name, nettype, filter->name);
+
+    for (i = 0; items[i].key; i++) {
+        virBufferAdd(&buf, items[i].key, -1);
+        if ((val = virHashLookup(vars->hashTable, items[i].key))) {
+            for (j = 0; j < virNWFilterVarValueGetCardinality(val); j++) {
+                str = virNWFilterVarValueGetNthValue(val, j);
+                virBufferAsprintf(&buf, " %zu:%s", strlen(str), str);
+            }
+        }
+        virBufferAddChar(&buf, '\n');
+    }
+
+    if (virBufferError(&buf))
+        goto error;
+
+    VIR_FREE(items);
+    virHashFree(varnames);
+    return virBufferContentAndReset(&buf);
+
+error:
+    virBufferFreeAndReset(&buf);
+    VIR_FREE(items);
+    virHashFree(varnames);
+    return NULL;
+}
+
+
+/**
+ * virNWFilterInstantiateCached:
+ *
+ * Same as _virNWFilterInstantiateRec for INSTANTIATE_ALWAYS, but
+ * reuse the rule instances of an earlier instantiation of the same
+ * filter tree with the same variable bindings, copied for @ifname.
+ * Failure to use or fill the cache is not an error; the filter tree
+ * is then simply instantiated from scratch.
+ *
+ * Call this function while holding updateMutex.
+ */
+int
+virNWFilterInstantiateCached(virNWFilterTechDriverPtr techdriver,
+                             enum virDomainNetType nettype,
+                             virNWFilterDefPtr filter,
+                             const char *ifname,
+                             virNWFilterHashTablePtr vars,
+                             int *nEntries,
+                             virNWFilterRuleInstPtr **insts,
+                             virNWFilterDriverStatePtr driver)
+{
+    virNWFilterInstCacheEntryPtr entry = NULL;
+    virHashTablePtr filters = NULL;
+    bool foundNewFilter = false;
+    char *key = NULL;
+    int rc;
+
+    if (techdriver->copyRuleInstance &&
+        (filters = virHashCreate(8, NULL)) &&
+        (key = virNWFilterInstCacheKey(techdriver, nettype, filter,
+                                       vars, filters, driver)) &&
+        (entry = virHashLookup(instCache, key))) {
+        if (virNWFilterRuleInstsCopy(entry->insts, entry->ninsts,
+                                     entry->ifname, ifname,
+                                     insts, nEntries) == 0) {
+            instCacheHits++;
+            VIR_DEBUG("Reusing rules of filter %s on %s for %s "
+                      "(cache hits %llu, misses %llu)",
+                      filter->name, entry->ifname, ifname,
+                      instCacheHits, instCacheMisses);
+            entry = NULL;
+            rc = 0;
+            goto cleanup;
+        }
+
+        while (*nEntries > 0)
+            virNWFilterRuleInstFree((*insts)[--(*nEntries)]);
+        VIR_FREE(*insts);
+        ignore_value(virHashRemoveEntry(instCache, key));
+    }
+    entry = NULL;
+    virResetLastError();
+
+    rc = _virNWFilterInstantiateRec(techdriver, nettype, filter, ifname,
+                                    vars, nEntries, insts,
+                                    INSTANTIATE_ALWAYS, &foundNewFilter,
+                                    driver);
+    if (rc < 0 || !key)
+        goto cleanup;
+
+    instCacheMisses++;
+    VIR_DEBUG("Compiled rules of filter %s for %s "
+              "(cache hits %llu, misses %llu)",
+              filter->name, ifname, instCacheHits, instCacheMisses);
+
+    if (VIR_ALLOC(entry) < 0 ||
+        VIR_STRDUP(entry->ifname, ifname) < 0 ||
+        virNWFilterRuleInstsCopy(*insts, *nEntries, ifname, ifname,
+                                 &entry->insts, &entry->ninsts) < 0)
+        goto error;
+
+    entry->filters = filters;
+    filters = NULL;
+
+    if (virHashSize(instCache) >= NWFILTER_INST_CACHE_MAX)
+        virHashRemoveAll(instCache);
+
+    if (virHashAddEntry(instCache, key, entry) < 0)
+        goto error;
+    entry = NULL;
+
+cleanup:
+    virNWFilterInstCacheEntryFree(entry, NULL);
+    virHashFree(filters);
+    VIR_FREE(key);
+    return rc;
+
+error:
+    /* the rules are fine, they just could not be cached */
+    virResetLastError();
+    goto cleanup;
+}
+
+
 static int
 virNWFilterDetermineMissingVarsRec(virNWFilterDefPtr filter,
                                    virNWFilterHashTablePtr vars,
@@ -747,14 +1132,27 @@ virNWFilterInstantiate(const unsigned char *vmuuid ATTRIBUTE_UNUSED,
         goto err_exit;
     }
 
-    rc = _virNWFilterInstantiateRec(techdriver,
-                                    nettype,
-                                    filter,
-                                    ifname,
-                                    vars,
-                                    &nEntries, &insts,
-                                    useNewFilter, foundNewFilter,
-                                    driver);
+    switch (useNewFilter) {
+    case INSTANTIATE_FOLLOW_NEWFILTER:
+        rc = _virNWFilterInstantiateRec(techdriver,
+                                        nettype,
+                                        filter,
+                                        ifname,
+                                        vars,
+                                        &nEntries, &insts,
+                                        useNewFilter, foundNewFilter,
+                                        driver);
+    break;
+    case INSTANTIATE_ALWAYS:
+        rc = virNWFilterInstantiateCached(techdriver,
+                                          nettype,
+                                          filter,
+                                          ifname,
+                                          vars,
+                                          &nEntries, &insts,
+                                          driver);
+    break;
+    }
 
     if (rc < 0)
         goto err_exit;
@@ -34,6 +34,8 @@ int virNWFilterRuleInstAddData(virNWFilterRuleInstPtr res,
 int virNWFilterTechDriversInit(bool privileged);
 void virNWFilterTechDriversShutdown(void);
 
+void virNWFilterInstCacheInvalidate(const char *filtername);
+
 enum instCase {
     INSTANTIATE_ALWAYS,
     INSTANTIATE_FOLLOW_NEWFILTER,
@@ -0,0 +1,46 @@
+/*
+ * nwfilter_gentech_driverpriv.h: private declarations for the generic
+ *                                filter instantiation code
+ *
+ * Copyright (C) 2014 Red Hat, Inc.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library.  If not, see
+ * <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#ifndef __NWFILTER_GENTECH_DRIVERPRIV_H__
+# define __NWFILTER_GENTECH_DRIVERPRIV_H__
+
+/*
+ * This header file should never be used outside unit tests.
+ */
+
+# include "nwfilter_gentech_driver.h"
+
+int virNWFilterInstantiateCached(virNWFilterTechDriverPtr techdriver,
+                                 enum virDomainNetType nettype,
+                                 virNWFilterDefPtr filter,
+                                 const char *ifname,
+                                 virNWFilterHashTablePtr vars,
+                                 int *nEntries,
+                                 virNWFilterRuleInstPtr **insts,
+                                 virNWFilterDriverStatePtr driver);
+
+void virNWFilterInstCacheGetStats(unsigned long long *hits,
+                                  unsigned long long *misses);
+
+void virNWFilterRuleInstFree(virNWFilterRuleInstPtr inst);
+
+#endif /* __NWFILTER_GENTECH_DRIVERPRIV_H__ */
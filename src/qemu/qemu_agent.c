@@ -113,6 +113,14 @@ struct _qemuAgent {
      * but fire up an event on qemu monitor instead.
      * Take that as indication of successful completion */
     qemuAgentEvent await_event;
+
+    /* True while a command is being processed together with
+     * its guest-sync; threads sharing a query job have to wait */
+    bool running;
+
+    /* When the last command was answered, in milliseconds; 0 if
+     * something may have left a reply behind since */
+    unsigned long long lastReply;
 };
 
 static virClassPtr qemuAgentClass;
@@ -307,7 +315,7 @@ qemuAgentIOProcessLine(qemuAgentPtr mon,
 
     VIR_DEBUG("Line [%s]", line);
 
-    if (!(obj = virJSONValueFromString(line)))
+    if (!(obj = virJSONValueFromStringArena(line)))
         goto cleanup;
 
     if (obj->type != VIR_JSON_TYPE_OBJECT) {
@@ -322,7 +330,12 @@ qemuAgentIOProcessLine(qemuAgentPtr mon,
         ret = qemuAgentIOProcessEvent(mon, obj);
     } else if (virJSONValueObjectHasKey(obj, "error") == 1 ||
                virJSONValueObjectHasKey(obj, "return") == 1) {
-        if (msg) {
+        if (msg && msg->finished) {
+            /* The agent sent more replies than we asked for, most
+             * likely late ones to commands we gave up waiting on */
+            VIR_DEBUG("Ignoring unexpected reply '%s'", line);
+            ret = 0;
+        } else if (msg) {
             msg->rxObject = obj;
             msg->finished = 1;
             obj = NULL;
@@ -666,7 +679,7 @@ qemuAgentIO(int watch, int fd, int events, void *opaque) {
          * then wakeup that waiter */
         if (mon->msg && !mon->msg->finished) {
             mon->msg->finished = 1;
-            virCondSignal(&mon->notify);
+            virCondBroadcast(&mon->notify);
         }
     }
 
@@ -681,7 +694,7 @@ qemuAgentIO(int watch, int fd, int events, void *opaque) {
         virDomainObjPtr vm = mon->vm;
 
         /* Make sure anyone waiting wakes up now */
-        virCondSignal(&mon->notify);
+        virCondBroadcast(&mon->notify);
         virObjectUnlock(mon);
         virObjectUnref(mon);
         VIR_DEBUG("Triggering EOF callback");
@@ -692,7 +705,7 @@ qemuAgentIO(int watch, int fd, int events, void *opaque) {
         virDomainObjPtr vm = mon->vm;
 
         /* Make sure anyone waiting wakes up now */
-        virCondSignal(&mon->notify);
+        virCondBroadcast(&mon->notify);
         virObjectUnlock(mon);
         virObjectUnref(mon);
         VIR_DEBUG("Triggering error callback");
@@ -805,7 +818,7 @@ void qemuAgentClose(qemuAgentPtr mon)
      * wake him up. No message will arrive anyway. */
     if (mon->msg && !mon->msg->finished) {
         mon->msg->finished = 1;
-        virCondSignal(&mon->notify);
+        virCondBroadcast(&mon->notify);
     }
     virObjectUnlock(mon);
 
@@ -962,6 +975,16 @@ cleanup:
     return ret;
 }
 
+/*
+ * guest-sync is skipped for a command sent less than this many
+ * seconds after the previous one was answered. A restart of the agent
+ * inside the guest is not announced by any event, so a restart within
+ * this window goes unnoticed. That is harmless as long as the old
+ * agent did not leave a reply behind, which it only does for commands
+ * we gave up waiting on; those always make the next command sync.
+ */
+#define QEMU_AGENT_SYNC_WINDOW 5
+
 static int
 qemuAgentCommand(qemuAgentPtr mon,
                  virJSONValuePtr cmd,
@@ -971,14 +994,31 @@ qemuAgentCommand(qemuAgentPtr mon,
     int ret = -1;
     qemuAgentMessage msg;
     char *cmdstr = NULL;
-    int await_event = mon->await_event;
+    int await_event;
+    unsigned long long now;
 
     *reply = NULL;
+    memset(&msg, 0, sizeof(msg));
 
-    if (qemuAgentGuestSync(mon) < 0)
-        return -1;
+    while (mon->running) {
+        if (virCondWait(&mon->notify, &mon->parent.lock) < 0) {
+            virReportSystemError(errno, "%s",
+                                 _("Unable to wait on agent monitor "
+                                   "condition"));
+            return -1;
+        }
+    }
+    mon->running = true;
+    await_event = mon->await_event;
 
-    memset(&msg, 0, sizeof(msg));
+    if (virTimeMillisNow(&now) < 0)
+        goto cleanup;
+
+    if ((!mon->lastReply ||
+         now - mon->lastReply > QEMU_AGENT_SYNC_WINDOW * 1000ull) &&
+        qemuAgentGuestSync(mon) < 0)
+        goto cleanup;
+    mon->lastReply = 0;
 
     if (!(cmdstr = virJSONValueToString(cmd, false)))
         goto cleanup;
@@ -1006,12 +1046,18 @@ qemuAgentCommand(qemuAgentPtr mon,
             }
         } else {
             *reply = msg.rxObject;
+            /* The agent may go away with the guest after commands
+             * that wait for an event, so only trust plain replies */
+            if (!await_event)
+                ignore_value(virTimeMillisNowRaw(&mon->lastReply));
         }
     }
 
 cleanup:
     VIR_FREE(cmdstr);
     VIR_FREE(msg.txBuffer);
+    mon->running = false;
+    virCondBroadcast(&mon->notify);
 
     return ret;
 }
@@ -1234,13 +1280,18 @@ void qemuAgentNotifyEvent(qemuAgentPtr mon,
                           qemuAgentEvent event)
 {
     VIR_DEBUG("mon=%p event=%d", mon, event);
+
+    /* The agent restarts with the guest and may not answer
+     * whatever was sent before */
+    mon->lastReply = 0;
+
     if (mon->await_event == event) {
         VIR_DEBUG("Waking up a tragedian");
         mon->await_event = QEMU_AGENT_EVENT_NONE;
         /* somebody waiting for this event, wake him up. */
         if (mon->msg && !mon->msg->finished) {
             mon->msg->finished = 1;
-            virCondSignal(&mon->notify);
+            virCondBroadcast(&mon->notify);
         }
     } else {
         /* shouldn't happen but one never knows */
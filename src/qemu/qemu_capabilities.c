@@ -2095,6 +2095,9 @@ virQEMUCapsProbeQMPObjects(virQEMUCapsPtr qemuCaps,
 {
     int nvalues;
     char **values;
+    const char *types[ARRAY_CARDINALITY(virQEMUCapsObjectProps)];
+    char **props[ARRAY_CARDINALITY(virQEMUCapsObjectProps)];
+    int nprops[ARRAY_CARDINALITY(virQEMUCapsObjectProps)];
     size_t i;
 
     if ((nvalues = qemuMonitorGetObjectTypes(mon, &values)) < 0)
@@ -2105,17 +2108,21 @@ virQEMUCapsProbeQMPObjects(virQEMUCapsPtr qemuCaps,
                                   nvalues, values);
     virQEMUCapsFreeStringList(nvalues, values);
 
+    /* Query the properties of all the types in one go */
+    for (i = 0; i < ARRAY_CARDINALITY(virQEMUCapsObjectProps); i++)
+        types[i] = virQEMUCapsObjectProps[i].type;
+
+    if (qemuMonitorGetObjectPropsBatch(mon, types,
+                                       ARRAY_CARDINALITY(types),
+                                       props, nprops) < 0)
+        return -1;
+
     for (i = 0; i < ARRAY_CARDINALITY(virQEMUCapsObjectProps); i++) {
-        const char *type = virQEMUCapsObjectProps[i].type;
-        if ((nvalues = qemuMonitorGetObjectProps(mon,
-                                                 type,
-                                                 &values)) < 0)
-            return -1;
         virQEMUCapsProcessStringFlags(qemuCaps,
                                       virQEMUCapsObjectProps[i].nprops,
                                       virQEMUCapsObjectProps[i].props,
-                                      nvalues, values);
-        virQEMUCapsFreeStringList(nvalues, values);
+                                      nprops[i], props[i]);
+        virQEMUCapsFreeStringList(nprops[i], props[i]);
     }
 
     /* Prefer -chardev spicevmc (detected earlier) over -device spicevmc */
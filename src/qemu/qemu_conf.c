@@ -254,6 +254,8 @@ virQEMUDriverConfigPtr virQEMUDriverConfigNew(bool privileged)
     cfg->keepAliveCount = 5;
     cfg->seccompSandbox = -1;
 
+    cfg->autoStartMaxConcurrent = 1;
+
     return cfg;
 
 error:
@@ -268,6 +270,7 @@ static void virQEMUDriverConfigDispose(void *obj)
 
 
     virStringFreeList(cfg->cgroupDeviceACL);
+    virStringFreeList(cfg->autoStartGroups);
 
     VIR_FREE(cfg->configBaseDir);
     VIR_FREE(cfg->configDir);
@@ -552,6 +555,44 @@ int virQEMUDriverConfigLoadFile(virQEMUDriverConfigPtr cfg,
     GET_VALUE_BOOL("auto_dump_bypass_cache", cfg->autoDumpBypassCache);
     GET_VALUE_BOOL("auto_start_bypass_cache", cfg->autoStartBypassCache);
 
+    p = virConfGetValue(conf, "auto_start_max_concurrent");
+    CHECK_TYPE("auto_start_max_concurrent", VIR_CONF_LONG);
+    if (p) {
+        if (p->l < 1) {
+            virReportError(VIR_ERR_INTERNAL_ERROR,
+                           _("%s: auto_start_max_concurrent: must be "
+                             "greater than 0"), filename);
+            goto cleanup;
+        }
+        cfg->autoStartMaxConcurrent = p->l;
+    }
+
+    GET_VALUE_LONG("auto_start_reserved_memory", cfg->autoStartReservedMemory);
+
+    p = virConfGetValue(conf, "auto_start_groups");
+    CHECK_TYPE("auto_start_groups", VIR_CONF_LIST);
+    if (p) {
+        int len = 0;
+        virConfValuePtr pp;
+        for (pp = p->list; pp; pp = pp->next)
+            len++;
+        virStringFreeList(cfg->autoStartGroups);
+        if (VIR_ALLOC_N(cfg->autoStartGroups, 1+len) < 0)
+            goto cleanup;
+
+        for (i = 0, pp = p->list; pp; ++i, pp = pp->next) {
+            if (pp->type != VIR_CONF_STRING) {
+                virReportError(VIR_ERR_CONF_SYNTAX, "%s",
+                               _("auto_start_groups must be a "
+                                 "list of strings"));
+                goto cleanup;
+            }
+            if (VIR_STRDUP(cfg->autoStartGroups[i], pp->str) < 0)
+                goto cleanup;
+        }
+        cfg->autoStartGroups[i] = NULL;
+    }
+
     GET_VALUE_STR("hugetlbfs_mount", cfg->hugetlbfsMount);
     GET_VALUE_STR("bridge_helper", cfg->bridgeHelperName);
 
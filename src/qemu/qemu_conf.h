@@ -152,6 +152,9 @@ struct _virQEMUDriverConfig {
     char *autoDumpPath;
     bool autoDumpBypassCache;
     bool autoStartBypassCache;
+    unsigned int autoStartMaxConcurrent;
+    unsigned long long autoStartReservedMemory; /* in MiB */
+    char **autoStartGroups;
 
     char *lockManagerName;
 
@@ -241,6 +244,9 @@ struct _virQEMUDriver {
 
     /* Immutable pointer, self-clocking APIs */
     virCloseCallbacksPtr closeCallbacks;
+
+    /* Immutable pointer, self-locking APIs */
+    virStorageFileMetadataCachePtr metadataCache;
 };
 
 typedef struct _qemuDomainCmdlineDef qemuDomainCmdlineDef;
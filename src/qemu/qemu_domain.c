@@ -147,6 +147,7 @@ qemuDomainObjResetJob(qemuDomainObjPrivatePtr priv)
 
     job->active = QEMU_JOB_NONE;
     job->owner = 0;
+    job->nshared = 0;
 }
 
 static void
@@ -1019,10 +1020,86 @@ qemuDomainNestedJobAllowed(qemuDomainObjPrivatePtr priv, enum qemuDomainJob job)
     return !priv->job.asyncJob || (priv->job.mask & JOB_MASK(job)) != 0;
 }
 
+/*
+ * QEMU_JOB_QUERY jobs can be shared by any number of threads; all other
+ * jobs are exclusive.  To avoid starving exclusive jobs, no new thread
+ * may join a shared job once an exclusive job is waiting.  In turn, all
+ * threads which were waiting for a shared job when an exclusive job
+ * finishes get to run before the next exclusive job starts.
+ */
+static bool
+qemuDomainObjJobAvailable(qemuDomainObjPrivatePtr priv, enum qemuDomainJob job)
+{
+    struct qemuDomainJobObj *j = &priv->job;
+
+    if (job == QEMU_JOB_QUERY) {
+        return (j->active == QEMU_JOB_NONE || j->active == QEMU_JOB_QUERY) &&
+               (j->waitExclusive == 0 || j->sharedTurn);
+    }
+
+    return j->active == QEMU_JOB_NONE && !j->sharedTurn;
+}
+
 bool
 qemuDomainJobAllowed(qemuDomainObjPrivatePtr priv, enum qemuDomainJob job)
 {
-    return !priv->job.active && qemuDomainNestedJobAllowed(priv, job);
+    return qemuDomainObjJobAvailable(priv, job) &&
+           qemuDomainNestedJobAllowed(priv, job);
+}
+
+static void
+qemuDomainObjJobWaitBegin(qemuDomainObjPrivatePtr priv,
+                          enum qemuDomainJob job)
+{
+    if (job == QEMU_JOB_QUERY)
+        priv->job.waitShared++;
+    else
+        priv->job.waitExclusive++;
+}
+
+static void
+qemuDomainObjJobWaitEnd(qemuDomainObjPrivatePtr priv,
+                        enum qemuDomainJob job)
+{
+    struct qemuDomainJobObj *j = &priv->job;
+
+    if (job == QEMU_JOB_QUERY) {
+        if (--j->waitShared == 0)
+            j->sharedTurn = false;
+    } else {
+        j->waitExclusive--;
+    }
+}
+
+static void
+qemuDomainObjJobWaitRecord(qemuDomainObjPrivatePtr priv,
+                           unsigned long long start)
+{
+    unsigned long long now;
+    unsigned long long wait;
+    size_t i;
+
+    if (virTimeMillisNow(&now) < 0)
+        return;
+
+    wait = now > start ? now - start : 0;
+    for (i = 0; i < QEMU_DOMAIN_JOB_WAIT_BUCKETS - 1; i++) {
+        if (wait < (1ULL << i))
+            break;
+    }
+    priv->job.waitHist[i]++;
+}
+
+/*
+ * Wakes up threads waiting for a job after the current job was reset
+ */
+static void
+qemuDomainObjJobReleased(qemuDomainObjPrivatePtr priv,
+                         enum qemuDomainJob job)
+{
+    if (job != QEMU_JOB_QUERY && priv->job.waitShared > 0)
+        priv->job.sharedTurn = true;
+    virCondBroadcast(&priv->job.cond);
 }
 
 /* Give up waiting for mutex after 30 seconds */
@@ -1072,17 +1149,41 @@ retry:
             goto error;
     }
 
-    while (priv->job.active) {
-        VIR_DEBUG("Waiting for job (vm=%p name=%s)", obj, obj->def->name);
-        if (virCondWaitUntil(&priv->job.cond, &obj->parent.lock, then) < 0)
-            goto error;
+    if (!qemuDomainObjJobAvailable(priv, job)) {
+        qemuDomainObjJobWaitBegin(priv, job);
+        while (!qemuDomainObjJobAvailable(priv, job)) {
+            VIR_DEBUG("Waiting for job (vm=%p name=%s)",
+                      obj, obj->def->name);
+            if (virCondWaitUntil(&priv->job.cond,
+                                 &obj->parent.lock, then) < 0) {
+                /* Others may have been waiting for us to go first */
+                qemuDomainObjJobWaitEnd(priv, job);
+                virCondBroadcast(&priv->job.cond);
+                goto error;
+            }
+        }
+        qemuDomainObjJobWaitEnd(priv, job);
     }
 
-    /* No job is active but a new async job could have been started while obj
-     * was unlocked, so we need to recheck it. */
+    /* The job is available but a new async job could have been started
+     * while obj was unlocked, so we need to recheck it. */
     if (!nested && !qemuDomainNestedJobAllowed(priv, job))
         goto retry;
 
+    qemuDomainObjJobWaitRecord(priv, now);
+
+    if (job == QEMU_JOB_QUERY && priv->job.active == QEMU_JOB_QUERY) {
+        VIR_DEBUG("Joined shared job: %s (async=%s vm=%p name=%s)",
+                  qemuDomainJobTypeToString(job),
+                  qemuDomainAsyncJobTypeToString(priv->job.asyncJob),
+                  obj, obj->def->name);
+        priv->job.nshared++;
+        /* A shared job has no single owner */
+        priv->job.owner = 0;
+        virObjectUnref(cfg);
+        return 0;
+    }
+
     qemuDomainObjResetJob(priv);
 
     if (job != QEMU_JOB_ASYNC) {
@@ -1092,6 +1193,8 @@ retry:
                   obj, obj->def->name);
         priv->job.active = job;
         priv->job.owner = virThreadSelfID();
+        if (job == QEMU_JOB_QUERY)
+            priv->job.nshared = 1;
     } else {
         VIR_DEBUG("Started async job: %s (vm=%p name=%s)",
                   qemuDomainAsyncJobTypeToString(asyncJob),
@@ -1118,6 +1221,7 @@ error:
              qemuDomainAsyncJobTypeToString(priv->job.asyncJob),
              priv->job.owner, priv->job.asyncOwner);
 
+    priv->job.waitFailed++;
     if (errno == ETIMEDOUT)
         virReportError(VIR_ERR_OPERATION_TIMEOUT,
                        "%s", _("cannot acquire state change lock"));
@@ -1200,6 +1304,15 @@ bool qemuDomainObjEndJob(virQEMUDriverPtr driver, virDomainObjPtr obj)
 
     priv->jobs_queued--;
 
+    if (job == QEMU_JOB_QUERY && priv->job.nshared > 1) {
+        VIR_DEBUG("Leaving shared job: %s (async=%s vm=%p name=%s)",
+                  qemuDomainJobTypeToString(job),
+                  qemuDomainAsyncJobTypeToString(priv->job.asyncJob),
+                  obj, obj->def->name);
+        priv->job.nshared--;
+        return virObjectUnref(obj);
+    }
+
     VIR_DEBUG("Stopping job: %s (async=%s vm=%p name=%s)",
               qemuDomainJobTypeToString(job),
               qemuDomainAsyncJobTypeToString(priv->job.asyncJob),
@@ -1208,7 +1321,7 @@ bool qemuDomainObjEndJob(virQEMUDriverPtr driver, virDomainObjPtr obj)
     qemuDomainObjResetJob(priv);
     if (qemuDomainTrackJob(job))
         qemuDomainObjSaveJob(driver, obj);
-    virCondSignal(&priv->job.cond);
+    qemuDomainObjJobReleased(priv, job);
 
     return virObjectUnref(obj);
 }
@@ -1278,7 +1391,9 @@ qemuDomainObjEnterMonitorInternal(virQEMUDriverPtr driver,
               priv->mon, obj, obj->def->name);
     virObjectLock(priv->mon);
     virObjectRef(priv->mon);
-    ignore_value(virTimeMillisNow(&priv->monStart));
+    /* Threads sharing a query job may be inside the monitor at once */
+    if (priv->monEntered++ == 0)
+        ignore_value(virTimeMillisNow(&priv->monStart));
     virObjectUnlock(obj);
 
     return 0;
@@ -1300,14 +1415,15 @@ qemuDomainObjExitMonitorInternal(virQEMUDriverPtr driver,
     VIR_DEBUG("Exited monitor (mon=%p vm=%p name=%s)",
               priv->mon, obj, obj->def->name);
 
-    priv->monStart = 0;
+    if (--priv->monEntered == 0)
+        priv->monStart = 0;
     if (!hasRefs)
         priv->mon = NULL;
 
     if (priv->job.active == QEMU_JOB_ASYNC_NESTED) {
         qemuDomainObjResetJob(priv);
         qemuDomainObjSaveJob(driver, obj);
-        virCondSignal(&priv->job.cond);
+        qemuDomainObjJobReleased(priv, QEMU_JOB_ASYNC_NESTED);
 
         virObjectUnref(obj);
     }
@@ -2393,6 +2509,9 @@ qemuDomainDetermineDiskChain(virQEMUDriverPtr driver,
 
     if (disk->backingChain) {
         if (force) {
+            /* The chain changed behind our back, typically because a
+             * block job completed, so don't trust the cache either */
+            qemuDomainInvalidateDiskChain(driver, disk);
             virStorageFileFreeMetadata(disk->backingChain);
             disk->backingChain = NULL;
         } else {
@@ -2402,9 +2521,11 @@ qemuDomainDetermineDiskChain(virQEMUDriverPtr driver,
 
     qemuDomainGetImageIds(cfg, vm, disk, &uid, &gid);
 
-    disk->backingChain = virStorageFileGetMetadata(disk->src, disk->format,
-                                                   uid, gid,
-                                                   cfg->allowDiskFormatProbing);
+    disk->backingChain = virStorageFileGetMetadataCached(driver->metadataCache,
+                                                         disk->src,
+                                                         disk->format,
+                                                         uid, gid,
+                                                         cfg->allowDiskFormatProbing);
     if (!disk->backingChain)
         ret = -1;
 
@@ -2413,6 +2534,27 @@ cleanup:
     return ret;
 }
 
+/* Drop the cached metadata of every image in the backing chain of
+ * DISK, as known from the last time it was determined.  */
+void
+qemuDomainInvalidateDiskChain(virQEMUDriverPtr driver,
+                              virDomainDiskDefPtr disk)
+{
+    virStorageFileMetadataPtr meta;
+
+    if (!disk->src ||
+        disk->type == VIR_DOMAIN_DISK_TYPE_NETWORK ||
+        disk->type == VIR_DOMAIN_DISK_TYPE_VOLUME)
+        return;
+
+    virStorageFileMetadataCacheInvalidate(driver->metadataCache, disk->src);
+    for (meta = disk->backingChain; meta; meta = meta->backingMeta) {
+        if (meta->backingStoreIsFile && meta->backingStore)
+            virStorageFileMetadataCacheInvalidate(driver->metadataCache,
+                                                  meta->backingStore);
+    }
+}
+
 int
 qemuDomainUpdateDeviceList(virQEMUDriverPtr driver,
                            virDomainObjPtr vm)
@@ -63,12 +63,13 @@
     (JOB_MASK(QEMU_JOB_DESTROY) |       \
      JOB_MASK(QEMU_JOB_ASYNC))
 
-/* Only 1 job is allowed at any time
+/* Only 1 job is allowed at any time, except for QEMU_JOB_QUERY which
+ * may be shared by several threads at once.
  * A job includes *all* monitor commands, even those just querying
  * information, not merely actions */
 enum qemuDomainJob {
     QEMU_JOB_NONE = 0,  /* Always set to 0 for easy if (jobActive) conditions */
-    QEMU_JOB_QUERY,         /* Doesn't change any state */
+    QEMU_JOB_QUERY,         /* Doesn't change any state, may be shared */
     QEMU_JOB_DESTROY,       /* Destroys the domain (cannot be masked out) */
     QEMU_JOB_SUSPEND,       /* Suspends (stops vCPUs) the domain */
     QEMU_JOB_MODIFY,        /* May change state */
@@ -99,10 +100,22 @@ enum qemuDomainAsyncJob {
 };
 VIR_ENUM_DECL(qemuDomainAsyncJob)
 
+/* Job wait times are counted in buckets of exponentially growing size:
+ * bucket N holds waits shorter than 2^N ms, the last one all the rest */
+# define QEMU_DOMAIN_JOB_WAIT_BUCKETS 16
+
 struct qemuDomainJobObj {
     virCond cond;                       /* Use to coordinate jobs */
     enum qemuDomainJob active;          /* Currently running job */
-    unsigned long long owner;           /* Thread id which set current job */
+    unsigned long long owner;           /* Thread id which set current job,
+                                           0 once a QUERY job is shared */
+    unsigned int nshared;               /* Threads sharing a QUERY job */
+
+    unsigned int waitShared;            /* Threads waiting for a QUERY job */
+    unsigned int waitExclusive;         /* Threads waiting for other jobs */
+    bool sharedTurn;                    /* Waiting QUERY jobs go first */
+    unsigned long long waitHist[QEMU_DOMAIN_JOB_WAIT_BUCKETS];
+    unsigned long long waitFailed;      /* Jobs which could not be started */
 
     virCond asyncCond;                  /* Use to coordinate with async jobs */
     enum qemuDomainAsyncJob asyncJob;   /* Currently active async job */
@@ -133,7 +146,8 @@ struct _qemuDomainObjPrivate {
     virDomainChrSourceDefPtr monConfig;
     bool monJSON;
     bool monError;
-    unsigned long long monStart;
+    unsigned long long monStart;        /* When the monitor got occupied */
+    unsigned int monEntered;            /* Threads inside the monitor */
 
     qemuAgentPtr agent;
     bool agentError;
@@ -359,6 +373,9 @@ int qemuDomainDetermineDiskChain(virQEMUDriverPtr driver,
                                  virDomainDiskDefPtr disk,
                                  bool force);
 
+void qemuDomainInvalidateDiskChain(virQEMUDriverPtr driver,
+                                   virDomainDiskDefPtr disk);
+
 int qemuDomainCleanupAdd(virDomainObjPtr vm,
                          qemuDomainCleanupCallback cb);
 void qemuDomainCleanupRemove(virDomainObjPtr vm,
@@ -68,6 +68,7 @@
 #include "viruuid.h"
 #include "domain_conf.h"
 #include "domain_audit.h"
+#include "domain_autostart.h"
 #include "node_device_conf.h"
 #include "virpci.h"
 #include "virusb.h"
@@ -268,6 +269,7 @@ qemuAutostartDomain(virDomainObjPtr vm,
     int flags = 0;
     virQEMUDriverConfigPtr cfg = virQEMUDriverGetConfig(data->driver);
     int ret = -1;
+    int rc = 0;
 
     if (cfg->autoStartBypassCache)
         flags |= VIR_DOMAIN_START_BYPASS_CACHE;
@@ -285,7 +287,8 @@ qemuAutostartDomain(virDomainObjPtr vm,
             goto cleanup;
         }
 
-        if (qemuDomainObjStart(data->conn, data->driver, vm, flags) < 0) {
+        rc = qemuDomainObjStart(data->conn, data->driver, vm, flags);
+        if (rc < 0) {
             err = virGetLastError();
             VIR_ERROR(_("Failed to autostart VM '%s': %s"),
                       vm->def->name,
@@ -296,7 +299,7 @@ qemuAutostartDomain(virDomainObjPtr vm,
             vm = NULL;
     }
 
-    ret = 0;
+    ret = rc < 0 ? -1 : 0;
 cleanup:
     if (vm)
         virObjectUnlock(vm);
@@ -318,7 +321,12 @@ qemuAutostartDomains(virQEMUDriverPtr driver)
     /* Ignoring NULL conn which is mostly harmless here */
     struct qemuAutostartData data = { driver, conn };
 
-    virDomainObjListForEach(driver->domains, qemuAutostartDomain, &data);
+    ignore_value(virDomainAutostartRun(driver->domains,
+                                       cfg->autoStartMaxConcurrent,
+                                       cfg->autoStartReservedMemory * 1024,
+                                       nodeGetAvailableMemory,
+                                       cfg->autoStartGroups,
+                                       qemuAutostartDomain, &data));
 
     virObjectUnref(conn);
     virObjectUnref(cfg);
@@ -795,6 +803,9 @@ qemuStateInitialize(bool privileged,
     if (!(qemu_driver->closeCallbacks = virCloseCallbacksNew()))
         goto error;
 
+    if (!(qemu_driver->metadataCache = virStorageFileMetadataCacheNew()))
+        goto error;
+
     /* Get all the running persistent or transient configs first */
     if (virDomainObjListLoadAllConfigs(qemu_driver->domains,
                                        cfg->stateDir,
@@ -1003,6 +1014,7 @@ qemuStateCleanup(void) {
     virSysinfoDefFree(qemu_driver->hostsysinfo);
 
     virObjectUnref(qemu_driver->closeCallbacks);
+    virObjectUnref(qemu_driver->metadataCache);
 
     VIR_FREE(qemu_driver->qemuImgBinary);
 
@@ -11524,6 +11536,40 @@ cleanup:
 }
 
 
+static int
+qemuDomainGetJobWaitStats(qemuDomainObjPrivatePtr priv,
+                          virTypedParameterPtr *par,
+                          int *npar,
+                          int *maxpar)
+{
+    char field[VIR_TYPED_PARAM_FIELD_LENGTH];
+    size_t i;
+
+    if (virTypedParamsAddUInt(par, npar, maxpar,
+                              VIR_DOMAIN_JOB_WAIT_COUNT,
+                              QEMU_DOMAIN_JOB_WAIT_BUCKETS) < 0 ||
+        virTypedParamsAddULLong(par, npar, maxpar,
+                                VIR_DOMAIN_JOB_WAIT_FAILED,
+                                priv->job.waitFailed) < 0)
+        return -1;
+
+    for (i = 0; i < QEMU_DOMAIN_JOB_WAIT_BUCKETS; i++) {
+        if (i < QEMU_DOMAIN_JOB_WAIT_BUCKETS - 1) {
+            snprintf(field, sizeof(field), "job_wait.%zu.limit", i);
+            if (virTypedParamsAddULLong(par, npar, maxpar,
+                                        field, 1ULL << i) < 0)
+                return -1;
+        }
+
+        snprintf(field, sizeof(field), "job_wait.%zu.jobs", i);
+        if (virTypedParamsAddULLong(par, npar, maxpar,
+                                    field, priv->job.waitHist[i]) < 0)
+            return -1;
+    }
+
+    return 0;
+}
+
 static int
 qemuDomainGetJobStats(virDomainPtr dom,
                       int *type,
@@ -11555,9 +11601,11 @@ qemuDomainGetJobStats(virDomainPtr dom,
     }
 
     if (!priv->job.asyncJob || priv->job.dump_memory_only) {
+        if (qemuDomainGetJobWaitStats(priv, &par, &npar, &maxpar) < 0)
+            goto cleanup;
         *type = VIR_DOMAIN_JOB_NONE;
-        *params = NULL;
-        *nparams = 0;
+        *params = par;
+        *nparams = npar;
         ret = 0;
         goto cleanup;
     }
@@ -11653,6 +11701,9 @@ qemuDomainGetJobStats(virDomainPtr dom,
             goto cleanup;
     }
 
+    if (qemuDomainGetJobWaitStats(priv, &par, &npar, &maxpar) < 0)
+        goto cleanup;
+
     *type = priv->job.info.type;
     *params = par;
     *nparams = npar;
@@ -12729,6 +12780,7 @@ qemuDomainSnapshotCreateSingleDiskActive(virQEMUDriverPtr driver,
      * recompute it.  Better would be storing the chain ourselves rather than
      * reprobing, but this requires modifying domain_conf and our XML to fully
      * track the chain across libvirtd restarts.  */
+    qemuDomainInvalidateDiskChain(driver, disk);
     virStorageFileFreeMetadata(disk->backingChain);
     disk->backingChain = NULL;
 
@@ -13469,10 +13521,7 @@ cleanup:
                     vm->current_snapshot = snap;
                 other = virDomainSnapshotFindByName(vm->snapshots,
                                                     snap->def->parent);
-                snap->parent = other;
-                other->nchildren++;
-                snap->sibling = other->first_child;
-                other->first_child = snap;
+                virDomainSnapshotSetParent(snap, other);
             }
         } else if (snap) {
             virDomainSnapshotObjListRemove(vm->snapshots, snap);
@@ -14205,7 +14254,6 @@ struct _virQEMUSnapReparent {
     virDomainSnapshotObjPtr parent;
     virDomainObjPtr vm;
     int err;
-    virDomainSnapshotObjPtr last;
 };
 
 static void
@@ -14221,7 +14269,6 @@ qemuDomainSnapshotReparentChildren(void *payload,
     }
 
     VIR_FREE(snap->def->parent);
-    snap->parent = rep->parent;
 
     if (rep->parent->def &&
         VIR_STRDUP(snap->def->parent, rep->parent->def->name) < 0) {
@@ -14229,9 +14276,6 @@ qemuDomainSnapshotReparentChildren(void *payload,
         return;
     }
 
-    if (!snap->sibling)
-        rep->last = snap;
-
     rep->err = qemuDomainSnapshotWriteMetadata(rep->vm, snap,
                                                rep->cfg->snapshotDir);
 }
@@ -14315,16 +14359,13 @@ static int qemuDomainSnapshotDelete(virDomainSnapshotPtr snapshot,
         rep.parent = snap->parent;
         rep.vm = vm;
         rep.err = 0;
-        rep.last = NULL;
         virDomainSnapshotForEachChild(snap,
                                       qemuDomainSnapshotReparentChildren,
                                       &rep);
         if (rep.err < 0)
             goto endjob;
         /* Can't modify siblings during ForEachChild, so do it now.  */
-        snap->parent->nchildren += snap->nchildren;
-        rep.last->sibling = snap->parent->first_child;
-        snap->parent->first_child = snap->first_child;
+        virDomainSnapshotMoveChildren(snap, snap->parent);
     }
 
     if (flags & VIR_DOMAIN_SNAPSHOT_DELETE_CHILDREN_ONLY) {
@@ -14763,6 +14804,8 @@ qemuDomainBlockPivot(virConnectPtr conn,
     disk->src = disk->mirror;
     disk->format = disk->mirrorFormat;
     disk->backingChain = NULL;
+    /* qemu has just been writing to the mirror */
+    virStorageFileMetadataCacheInvalidate(driver->metadataCache, disk->src);
     if (qemuDomainDetermineDiskChain(driver, vm, disk, false) < 0) {
         disk->src = oldsrc;
         disk->format = oldformat;
@@ -717,13 +717,9 @@ qemuPrepareHostdevPCIDevices(virQEMUDriverPtr driver,
 
     /* Loop 3: Now that all the PCI hostdevs have been detached, we
      * can safely reset them */
-    for (i = 0; i < virPCIDeviceListCount(pcidevs); i++) {
-        virPCIDevicePtr dev = virPCIDeviceListGet(pcidevs, i);
-
-        if (virPCIDeviceReset(dev, driver->activePciHostdevs,
+    if (virPCIDeviceListReset(pcidevs, driver->activePciHostdevs,
                               driver->inactivePciHostdevs) < 0)
-            goto reattachdevs;
-    }
+        goto reattachdevs;
 
     /* Loop 4: For SRIOV network devices, Now that we have detached the
      * the network device, set the netdev config */
@@ -1211,7 +1207,8 @@ qemuPrepareHostDevices(virQEMUDriverPtr driver,
 void
 qemuReattachPciDevice(virPCIDevicePtr dev, virQEMUDriverPtr driver)
 {
-    int retries = 100;
+    unsigned int delay = 1;
+    unsigned int waited = 0;
 
     /* If the device is not managed and was attached to guest
      * successfully, it must have been inactive.
@@ -1222,10 +1219,13 @@ qemuReattachPciDevice(virPCIDevicePtr dev, virQEMUDriverPtr driver)
         return;
     }
 
+    /* Wait up to 10 seconds for KVM to release the device, polling
+     * quickly at first since it usually does so right away */
     while (virPCIDeviceWaitForCleanup(dev, "kvm_assigned_device")
-           && retries) {
-        usleep(100*1000);
-        retries--;
+           && waited < 10 * 1000) {
+        usleep(delay * 1000);
+        waited += delay;
+        delay = MIN(delay * 2, 100);
     }
 
     if (virPCIDeviceReattach(dev, driver->activePciHostdevs,
@@ -1295,16 +1295,12 @@ qemuDomainReAttachHostdevDevices(virQEMUDriverPtr driver,
     for (i = 0; i < nhostdevs; i++)
         qemuDomainHostdevNetConfigRestore(hostdevs[i], cfg->stateDir);
 
-    for (i = 0; i < virPCIDeviceListCount(pcidevs); i++) {
-        virPCIDevicePtr dev = virPCIDeviceListGet(pcidevs, i);
-
-        if (virPCIDeviceReset(dev, driver->activePciHostdevs,
+    if (virPCIDeviceListReset(pcidevs, driver->activePciHostdevs,
                               driver->inactivePciHostdevs) < 0) {
-            virErrorPtr err = virGetLastError();
-            VIR_ERROR(_("Failed to reset PCI device: %s"),
-                      err ? err->message : _("unknown error"));
-            virResetError(err);
-        }
+        virErrorPtr err = virGetLastError();
+        VIR_ERROR(_("Failed to reset PCI device: %s"),
+                  err ? err->message : _("unknown error"));
+        virResetError(err);
     }
 
     while (virPCIDeviceListCount(pcidevs) > 0) {
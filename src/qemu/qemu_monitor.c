@@ -65,8 +65,9 @@ struct _qemuMonitor {
     qemuMonitorCallbacksPtr cb;
     void *callbackOpaque;
 
-    /* If there's a command being processed this will be
-     * non-NULL */
+    /* Queue of commands being processed, in the order they are
+     * transmitted. The JSON monitor can have several commands in
+     * flight, the text one only a single one */
     qemuMonitorMessagePtr msg;
 
     /* Buffer incoming data ready for Text/QMP monitor
@@ -365,6 +366,64 @@ error:
 }
 
 
+/* Returns the first queued message with data left to transmit */
+static qemuMonitorMessagePtr
+qemuMonitorNextTxMessage(qemuMonitorPtr mon)
+{
+    qemuMonitorMessagePtr msg;
+
+    for (msg = mon->msg; msg; msg = msg->next) {
+        if (msg->txOffset < msg->txLength)
+            return msg;
+    }
+
+    return NULL;
+}
+
+
+/**
+ * qemuMonitorGetPendingMessage:
+ * @mon: monitor object
+ * @id: command ID of the reply or NULL
+ *
+ * Finds the transmitted message a reply belongs to: the one with
+ * command ID @id, or the oldest one still waiting for its reply if
+ * @id is NULL. Call this function while holding the monitor lock.
+ *
+ * Returns the message or NULL if there is none.
+ */
+qemuMonitorMessagePtr
+qemuMonitorGetPendingMessage(qemuMonitorPtr mon,
+                             const char *id)
+{
+    qemuMonitorMessagePtr msg;
+
+    for (msg = mon->msg; msg; msg = msg->next) {
+        /* Messages are transmitted in order */
+        if (msg->txOffset < msg->txLength)
+            break;
+        if (msg->finished)
+            continue;
+        if (!id || STREQ_NULLABLE(msg->id, id))
+            return msg;
+    }
+
+    return NULL;
+}
+
+
+/* Wakes up all threads waiting for a reply after a fatal error */
+static void
+qemuMonitorFinishMessages(qemuMonitorPtr mon)
+{
+    qemuMonitorMessagePtr msg;
+
+    for (msg = mon->msg; msg; msg = msg->next)
+        msg->finished = 1;
+    virCondBroadcast(&mon->notify);
+}
+
+
 /* This method processes data that has been received
  * from the monitor. Looking for async events and
  * replies/errors.
@@ -397,8 +456,7 @@ qemuMonitorIOProcess(qemuMonitorPtr mon)
 
     if (mon->json)
         len = qemuMonitorJSONIOProcess(mon,
-                                       mon->buffer, mon->bufferOffset,
-                                       msg);
+                                       mon->buffer, mon->bufferOffset);
     else
         len = qemuMonitorTextIOProcess(mon,
                                        mon->buffer, mon->bufferOffset,
@@ -420,7 +478,8 @@ qemuMonitorIOProcess(qemuMonitorPtr mon)
 #if DEBUG_IO
     VIR_DEBUG("Process done %d used %d", (int)mon->bufferOffset, len);
 #endif
-    if (msg && msg->finished)
+    /* Replies may complete any of the queued messages */
+    if (len && mon->msg)
         virCondBroadcast(&mon->notify);
     return len;
 }
@@ -474,50 +533,56 @@ qemuMonitorIOWriteWithFD(qemuMonitorPtr mon,
 static int
 qemuMonitorIOWrite(qemuMonitorPtr mon)
 {
+    qemuMonitorMessagePtr msg;
+    int total = 0;
     int done;
 
-    /* If no active message, or fully transmitted, the no-op */
-    if (!mon->msg || mon->msg->txOffset == mon->msg->txLength)
-        return 0;
-
-    if (mon->msg->txFD != -1 && !mon->hasSendFD) {
-        virReportError(VIR_ERR_INTERNAL_ERROR, "%s",
-                       _("Monitor does not support sending of file descriptors"));
-        return -1;
-    }
-
-    if (mon->msg->txFD == -1)
-        done = write(mon->fd,
-                     mon->msg->txBuffer + mon->msg->txOffset,
-                     mon->msg->txLength - mon->msg->txOffset);
-    else
-        done = qemuMonitorIOWriteWithFD(mon,
-                                        mon->msg->txBuffer + mon->msg->txOffset,
-                                        mon->msg->txLength - mon->msg->txOffset,
-                                        mon->msg->txFD);
-
-    PROBE(QEMU_MONITOR_IO_WRITE,
-          "mon=%p buf=%s len=%d ret=%d errno=%d",
-          mon,
-          mon->msg->txBuffer + mon->msg->txOffset,
-          mon->msg->txLength - mon->msg->txOffset,
-          done, errno);
+    /* Send as many of the queued messages as the socket takes */
+    while ((msg = qemuMonitorNextTxMessage(mon))) {
+        if (msg->txFD != -1 && !mon->hasSendFD) {
+            virReportError(VIR_ERR_INTERNAL_ERROR, "%s",
+                           _("Monitor does not support sending of file descriptors"));
+            return -1;
+        }
 
-    if (mon->msg->txFD != -1)
-        PROBE(QEMU_MONITOR_IO_SEND_FD,
-              "mon=%p fd=%d ret=%d errno=%d",
-              mon, mon->msg->txFD, done, errno);
+        if (msg->txFD == -1)
+            done = write(mon->fd,
+                         msg->txBuffer + msg->txOffset,
+                         msg->txLength - msg->txOffset);
+        else
+            done = qemuMonitorIOWriteWithFD(mon,
+                                            msg->txBuffer + msg->txOffset,
+                                            msg->txLength - msg->txOffset,
+                                            msg->txFD);
+
+        PROBE(QEMU_MONITOR_IO_WRITE,
+              "mon=%p buf=%s len=%d ret=%d errno=%d",
+              mon,
+              msg->txBuffer + msg->txOffset,
+              msg->txLength - msg->txOffset,
+              done, errno);
+
+        if (msg->txFD != -1)
+            PROBE(QEMU_MONITOR_IO_SEND_FD,
+                  "mon=%p fd=%d ret=%d errno=%d",
+                  mon, msg->txFD, done, errno);
+
+        if (done < 0) {
+            if (errno == EAGAIN)
+                return total;
 
-    if (done < 0) {
-        if (errno == EAGAIN)
-            return 0;
+            virReportSystemError(errno, "%s",
+                                 _("Unable to write to monitor"));
+            return -1;
+        }
+        msg->txOffset += done;
+        total += done;
 
-        virReportSystemError(errno, "%s",
-                             _("Unable to write to monitor"));
-        return -1;
+        if (msg->txOffset < msg->txLength)
+            break;
     }
-    mon->msg->txOffset += done;
-    return done;
+
+    return total;
 }
 
 /*
@@ -584,8 +649,7 @@ static void qemuMonitorUpdateWatch(qemuMonitorPtr mon)
     if (mon->lastError.code == VIR_ERR_OK) {
         events |= VIR_EVENT_HANDLE_READABLE;
 
-        if ((mon->msg && mon->msg->txOffset < mon->msg->txLength) &&
-            !mon->waitGreeting)
+        if (qemuMonitorNextTxMessage(mon) && !mon->waitGreeting)
             events |= VIR_EVENT_HANDLE_WRITABLE;
     }
 
@@ -708,12 +772,10 @@ qemuMonitorIO(int watch, int fd, int events, void *opaque) {
         }
 
         VIR_DEBUG("Error on monitor %s", NULLSTR(mon->lastError.message));
-        /* If IO process resulted in an error & we have a message,
-         * then wakeup that waiter */
-        if (mon->msg && !mon->msg->finished) {
-            mon->msg->finished = 1;
-            virCondSignal(&mon->notify);
-        }
+        /* If IO process resulted in an error & we have messages,
+         * then wakeup their waiters */
+        if (mon->msg)
+            qemuMonitorFinishMessages(mon);
     }
 
     qemuMonitorUpdateWatch(mon);
@@ -726,7 +788,7 @@ qemuMonitorIO(int watch, int fd, int events, void *opaque) {
         virDomainObjPtr vm = mon->vm;
 
         /* Make sure anyone waiting wakes up now */
-        virCondSignal(&mon->notify);
+        virCondBroadcast(&mon->notify);
         virObjectUnlock(mon);
         VIR_DEBUG("Triggering EOF callback");
         (eofNotify)(mon, vm, mon->callbackOpaque);
@@ -736,7 +798,7 @@ qemuMonitorIO(int watch, int fd, int events, void *opaque) {
         virDomainObjPtr vm = mon->vm;
 
         /* Make sure anyone waiting wakes up now */
-        virCondSignal(&mon->notify);
+        virCondBroadcast(&mon->notify);
         virObjectUnlock(mon);
         VIR_DEBUG("Triggering error callback");
         (errorNotify)(mon, vm, mon->callbackOpaque);
@@ -920,8 +982,7 @@ void qemuMonitorClose(qemuMonitorPtr mon)
                 virResetLastError();
             }
         }
-        mon->msg->finished = 1;
-        virCondSignal(&mon->notify);
+        qemuMonitorFinishMessages(mon);
     }
 
     virObjectUnlock(mon);
@@ -938,10 +999,74 @@ char *qemuMonitorNextCommandID(qemuMonitorPtr mon)
 }
 
 
-int qemuMonitorSend(qemuMonitorPtr mon,
-                    qemuMonitorMessagePtr msg)
+static void
+qemuMonitorQueueMessage(qemuMonitorPtr mon,
+                        qemuMonitorMessagePtr msg)
+{
+    qemuMonitorMessagePtr *tail = &mon->msg;
+
+    while (*tail)
+        tail = &(*tail)->next;
+    msg->next = NULL;
+    *tail = msg;
+}
+
+
+static void
+qemuMonitorUnqueueMessage(qemuMonitorPtr mon,
+                          qemuMonitorMessagePtr msg)
+{
+    qemuMonitorMessagePtr *tmp = &mon->msg;
+
+    while (*tmp && *tmp != msg)
+        tmp = &(*tmp)->next;
+    if (*tmp)
+        *tmp = msg->next;
+    msg->next = NULL;
+}
+
+
+/**
+ * qemuMonitorSendBatch:
+ * @mon: monitor object
+ * @msgs: messages to send
+ * @nmsgs: number of messages in @msgs
+ *
+ * Queues all of @msgs for transmission at once and waits until every
+ * one of them got its reply. On the JSON monitor the commands are
+ * pipelined and their replies matched by command ID, so this takes a
+ * single round trip through the event loop rather than one per
+ * command. The text monitor sends the commands one after another.
+ *
+ * Returns 0 on success, -1 on error.
+ */
+int
+qemuMonitorSendBatch(qemuMonitorPtr mon,
+                     qemuMonitorMessagePtr *msgs,
+                     size_t nmsgs)
 {
     int ret = -1;
+    size_t i;
+
+    if (!mon->json) {
+        if (nmsgs > 1) {
+            for (i = 0; i < nmsgs; i++) {
+                if (qemuMonitorSendBatch(mon, &msgs[i], 1) < 0)
+                    return -1;
+            }
+            return 0;
+        }
+
+        /* The text monitor has no way to match replies to commands, so
+         * threads sharing a query job have to take turns */
+        while (mon->msg) {
+            if (virCondWait(&mon->notify, &mon->parent.lock) < 0) {
+                virReportError(VIR_ERR_INTERNAL_ERROR, "%s",
+                               _("Unable to wait on monitor condition"));
+                return -1;
+            }
+        }
+    }
 
     /* Check whether qemu quit unexpectedly */
     if (mon->lastError.code != VIR_ERR_OK) {
@@ -951,18 +1076,22 @@ int qemuMonitorSend(qemuMonitorPtr mon,
         return -1;
     }
 
-    mon->msg = msg;
-    qemuMonitorUpdateWatch(mon);
+    for (i = 0; i < nmsgs; i++) {
+        qemuMonitorQueueMessage(mon, msgs[i]);
 
-    PROBE(QEMU_MONITOR_SEND_MSG,
-          "mon=%p msg=%s fd=%d",
-          mon, mon->msg->txBuffer, mon->msg->txFD);
+        PROBE(QEMU_MONITOR_SEND_MSG,
+              "mon=%p msg=%s fd=%d",
+              mon, msgs[i]->txBuffer, msgs[i]->txFD);
+    }
+    qemuMonitorUpdateWatch(mon);
 
-    while (!mon->msg->finished) {
-        if (virCondWait(&mon->notify, &mon->parent.lock) < 0) {
-            virReportError(VIR_ERR_INTERNAL_ERROR, "%s",
-                           _("Unable to wait on monitor condition"));
-            goto cleanup;
+    for (i = 0; i < nmsgs; i++) {
+        while (!msgs[i]->finished) {
+            if (virCondWait(&mon->notify, &mon->parent.lock) < 0) {
+                virReportError(VIR_ERR_INTERNAL_ERROR, "%s",
+                               _("Unable to wait on monitor condition"));
+                goto cleanup;
+            }
         }
     }
 
@@ -976,13 +1105,22 @@ int qemuMonitorSend(qemuMonitorPtr mon,
     ret = 0;
 
 cleanup:
-    mon->msg = NULL;
+    for (i = 0; i < nmsgs; i++)
+        qemuMonitorUnqueueMessage(mon, msgs[i]);
     qemuMonitorUpdateWatch(mon);
+    virCondBroadcast(&mon->notify);
 
     return ret;
 }
 
 
+int qemuMonitorSend(qemuMonitorPtr mon,
+                    qemuMonitorMessagePtr msg)
+{
+    return qemuMonitorSendBatch(mon, &msg, 1);
+}
+
+
 virJSONValuePtr
 qemuMonitorGetOptions(qemuMonitorPtr mon)
 {
@@ -3684,6 +3822,45 @@ int qemuMonitorGetObjectProps(qemuMonitorPtr mon,
 }
 
 
+/**
+ * qemuMonitorGetObjectPropsBatch:
+ * @mon: monitor object
+ * @types: object types to query
+ * @ntypes: number of elements in @types
+ * @props: filled with a NULL-terminated list of properties per type
+ * @nprops: filled with the number of properties per type
+ *
+ * Like qemuMonitorGetObjectProps but queries all of @types at once.
+ * Unknown types get no properties.
+ *
+ * Returns 0 on success, -1 on error.
+ */
+int qemuMonitorGetObjectPropsBatch(qemuMonitorPtr mon,
+                                   const char **types,
+                                   size_t ntypes,
+                                   char ***props,
+                                   int *nprops)
+{
+    VIR_DEBUG("mon=%p types=%p ntypes=%zu props=%p",
+              mon, types, ntypes, props);
+
+    if (!mon) {
+        virReportError(VIR_ERR_INVALID_ARG, "%s",
+                       _("monitor must not be NULL"));
+        return -1;
+    }
+
+    if (!mon->json) {
+        virReportError(VIR_ERR_OPERATION_UNSUPPORTED, "%s",
+                       _("JSON monitor is required"));
+        return -1;
+    }
+
+    return qemuMonitorJSONGetObjectPropsBatch(mon, types, ntypes,
+                                              props, nprops);
+}
+
+
 char *qemuMonitorGetTargetArch(qemuMonitorPtr mon)
 {
     VIR_DEBUG("mon=%p",
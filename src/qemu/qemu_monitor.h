@@ -66,6 +66,12 @@ struct _qemuMonitorMessage {
 
     qemuMonitorPasswordHandler passwordHandler;
     void *passwordOpaque;
+
+    /* Used by the JSON monitor to match the reply, may be NULL */
+    char *id;
+
+    /* Next message in the queue of the monitor */
+    qemuMonitorMessagePtr next;
 };
 
 
@@ -218,6 +224,11 @@ int qemuMonitorSetLink(qemuMonitorPtr mon,
 char *qemuMonitorNextCommandID(qemuMonitorPtr mon);
 int qemuMonitorSend(qemuMonitorPtr mon,
                     qemuMonitorMessagePtr msg);
+int qemuMonitorSendBatch(qemuMonitorPtr mon,
+                         qemuMonitorMessagePtr *msgs,
+                         size_t nmsgs);
+qemuMonitorMessagePtr qemuMonitorGetPendingMessage(qemuMonitorPtr mon,
+                                                   const char *id);
 virJSONValuePtr qemuMonitorGetOptions(qemuMonitorPtr mon)
     ATTRIBUTE_NONNULL(1);
 void qemuMonitorSetOptions(qemuMonitorPtr mon, virJSONValuePtr options)
@@ -740,6 +751,11 @@ int qemuMonitorGetObjectTypes(qemuMonitorPtr mon,
 int qemuMonitorGetObjectProps(qemuMonitorPtr mon,
                               const char *type,
                               char ***props);
+int qemuMonitorGetObjectPropsBatch(qemuMonitorPtr mon,
+                                   const char **types,
+                                   size_t ntypes,
+                                   char ***props,
+                                   int *nprops);
 char *qemuMonitorGetTargetArch(qemuMonitorPtr mon);
 
 int qemuMonitorNBDServerStart(qemuMonitorPtr mon,
@@ -148,15 +148,16 @@ qemuMonitorJSONIOProcessEvent(qemuMonitorPtr mon,
 
 static int
 qemuMonitorJSONIOProcessLine(qemuMonitorPtr mon,
-                             const char *line,
-                             qemuMonitorMessagePtr msg)
+                             const char *line)
 {
     virJSONValuePtr obj = NULL;
+    qemuMonitorMessagePtr msg;
+    const char *id;
     int ret = -1;
 
     VIR_DEBUG("Line [%s]", line);
 
-    if (!(obj = virJSONValueFromString(line)))
+    if (!(obj = virJSONValueFromStringArena(line)))
         goto cleanup;
 
     if (obj->type != VIR_JSON_TYPE_OBJECT) {
@@ -175,7 +176,17 @@ qemuMonitorJSONIOProcessLine(qemuMonitorPtr mon,
                virJSONValueObjectHasKey(obj, "return") == 1) {
         PROBE(QEMU_MONITOR_RECV_REPLY,
               "mon=%p reply=%s", mon, line);
-        if (msg) {
+        /* Several commands may be in flight; QEMU echoes their "id"
+         * in the reply unless it failed to parse the command. Since
+         * QEMU handles commands in order, a reply without an "id"
+         * belongs to the oldest one */
+        id = virJSONValueObjectGetString(obj, "id");
+        msg = qemuMonitorGetPendingMessage(mon, id);
+        if (!msg && id) {
+            /* Late reply to a command nobody waits for anymore */
+            VIR_DEBUG("Ignoring reply to command with id '%s'", id);
+            ret = 0;
+        } else if (msg) {
             msg->rxObject = obj;
             msg->finished = 1;
             obj = NULL;
@@ -196,8 +207,7 @@ cleanup:
 
 int qemuMonitorJSONIOProcess(qemuMonitorPtr mon,
                              const char *data,
-                             size_t len,
-                             qemuMonitorMessagePtr msg)
+                             size_t len)
 {
     int used = 0;
     /*VIR_DEBUG("Data %d bytes [%s]", len, data);*/
@@ -212,7 +222,7 @@ int qemuMonitorJSONIOProcess(qemuMonitorPtr mon,
                 return -1;
             used += got + strlen(LINE_ENDING);
             line[got] = '\0'; /* kill \n */
-            if (qemuMonitorJSONIOProcessLine(mon, line, msg) < 0) {
+            if (qemuMonitorJSONIOProcessLine(mon, line) < 0) {
                 VIR_FREE(line);
                 return -1;
             }
@@ -228,26 +238,20 @@ int qemuMonitorJSONIOProcess(qemuMonitorPtr mon,
 }
 
 static int
-qemuMonitorJSONCommandWithFd(qemuMonitorPtr mon,
-                             virJSONValuePtr cmd,
-                             int scm_fd,
-                             virJSONValuePtr *reply)
+qemuMonitorJSONMessageInit(qemuMonitorPtr mon,
+                           qemuMonitorMessagePtr msg,
+                           virJSONValuePtr cmd,
+                           int scm_fd)
 {
-    int ret = -1;
-    qemuMonitorMessage msg;
     char *cmdstr = NULL;
-    char *id = NULL;
-    virJSONValuePtr exe;
-
-    *reply = NULL;
+    int ret = -1;
 
-    memset(&msg, 0, sizeof(msg));
+    memset(msg, 0, sizeof(*msg));
 
-    exe = virJSONValueObjectGet(cmd, "execute");
-    if (exe) {
-        if (!(id = qemuMonitorNextCommandID(mon)))
+    if (virJSONValueObjectGet(cmd, "execute")) {
+        if (!(msg->id = qemuMonitorNextCommandID(mon)))
             goto cleanup;
-        if (virJSONValueObjectAppendString(cmd, "id", id) < 0) {
+        if (virJSONValueObjectAppendString(cmd, "id", msg->id) < 0) {
             virReportError(VIR_ERR_INTERNAL_ERROR, "%s",
                            _("Unable to append command 'id' string"));
             goto cleanup;
@@ -256,34 +260,132 @@ qemuMonitorJSONCommandWithFd(qemuMonitorPtr mon,
 
     if (!(cmdstr = virJSONValueToString(cmd, false)))
         goto cleanup;
-    if (virAsprintf(&msg.txBuffer, "%s\r\n", cmdstr) < 0)
+    if (virAsprintf(&msg->txBuffer, "%s\r\n", cmdstr) < 0)
         goto cleanup;
-    msg.txLength = strlen(msg.txBuffer);
-    msg.txFD = scm_fd;
+    msg->txLength = strlen(msg->txBuffer);
+    msg->txFD = scm_fd;
 
     VIR_DEBUG("Send command '%s' for write with FD %d", cmdstr, scm_fd);
 
-    ret = qemuMonitorSend(mon, &msg);
+    ret = 0;
 
-    VIR_DEBUG("Receive command reply ret=%d rxObject=%p",
-              ret, msg.rxObject);
+cleanup:
+    VIR_FREE(cmdstr);
+    return ret;
+}
 
 
-    if (ret == 0) {
-        if (!msg.rxObject) {
-            virReportError(VIR_ERR_INTERNAL_ERROR, "%s",
-                           _("Missing monitor reply object"));
-            ret = -1;
-        } else {
-            *reply = msg.rxObject;
-        }
+static void
+qemuMonitorJSONMessageClear(qemuMonitorMessagePtr msg)
+{
+    VIR_FREE(msg->id);
+    VIR_FREE(msg->txBuffer);
+    virJSONValueFree(msg->rxObject);
+    msg->rxObject = NULL;
+}
+
+
+static int
+qemuMonitorJSONMessageTakeReply(qemuMonitorMessagePtr msg,
+                                virJSONValuePtr *reply)
+{
+    VIR_DEBUG("Receive command reply rxObject=%p", msg->rxObject);
+
+    if (!msg->rxObject) {
+        virReportError(VIR_ERR_INTERNAL_ERROR, "%s",
+                       _("Missing monitor reply object"));
+        return -1;
     }
 
+    *reply = msg->rxObject;
+    msg->rxObject = NULL;
+    return 0;
+}
+
+
+static int
+qemuMonitorJSONCommandWithFd(qemuMonitorPtr mon,
+                             virJSONValuePtr cmd,
+                             int scm_fd,
+                             virJSONValuePtr *reply)
+{
+    int ret = -1;
+    qemuMonitorMessage msg;
+
+    *reply = NULL;
+
+    if (qemuMonitorJSONMessageInit(mon, &msg, cmd, scm_fd) < 0)
+        goto cleanup;
+
+    if (qemuMonitorSend(mon, &msg) < 0)
+        goto cleanup;
+
+    ret = qemuMonitorJSONMessageTakeReply(&msg, reply);
+
 cleanup:
-    VIR_FREE(id);
-    VIR_FREE(cmdstr);
-    VIR_FREE(msg.txBuffer);
+    qemuMonitorJSONMessageClear(&msg);
+    return ret;
+}
+
+
+/**
+ * qemuMonitorJSONCommandBatch:
+ * @mon: monitor object
+ * @cmds: commands to run
+ * @ncmds: number of commands in @cmds
+ * @replies: array of @ncmds elements to be filled with the replies
+ *
+ * Sends all of @cmds to QEMU without waiting for the replies in
+ * between. On success, the reply to @cmds[i] is stored in @replies[i]
+ * and has to be checked for errors and freed by the caller.
+ *
+ * Returns 0 on success, -1 on error.
+ */
+int
+qemuMonitorJSONCommandBatch(qemuMonitorPtr mon,
+                            virJSONValuePtr *cmds,
+                            size_t ncmds,
+                            virJSONValuePtr *replies)
+{
+    qemuMonitorMessagePtr msgs = NULL;
+    qemuMonitorMessagePtr *queue = NULL;
+    size_t i;
+    int ret = -1;
 
+    memset(replies, 0, sizeof(*replies) * ncmds);
+
+    if (VIR_ALLOC_N(msgs, ncmds) < 0 ||
+        VIR_ALLOC_N(queue, ncmds) < 0)
+        goto cleanup;
+
+    for (i = 0; i < ncmds; i++) {
+        if (qemuMonitorJSONMessageInit(mon, &msgs[i], cmds[i], -1) < 0)
+            goto cleanup;
+        queue[i] = &msgs[i];
+    }
+
+    if (qemuMonitorSendBatch(mon, queue, ncmds) < 0)
+        goto cleanup;
+
+    for (i = 0; i < ncmds; i++) {
+        if (qemuMonitorJSONMessageTakeReply(&msgs[i], &replies[i]) < 0)
+            goto cleanup;
+    }
+
+    ret = 0;
+
+cleanup:
+    if (msgs) {
+        for (i = 0; i < ncmds; i++) {
+            if (ret < 0) {
+                virJSONValueFree(replies[i]);
+                replies[i] = NULL;
+            }
+            qemuMonitorJSONMessageClear(&msgs[i]);
+        }
+    }
+    VIR_FREE(queue);
+    VIR_FREE(msgs);
     return ret;
 }
 
@@ -4786,39 +4888,26 @@ cleanup:
 #undef MAKE_SET_CMD
 
 
-int qemuMonitorJSONGetObjectProps(qemuMonitorPtr mon,
-                                  const char *type,
-                                  char ***props)
+/* Returns the number of properties, 0 if @type is not known
+ * or -1 on error */
+static int
+qemuMonitorJSONParseObjectProps(virJSONValuePtr cmd,
+                                virJSONValuePtr reply,
+                                char ***props)
 {
-    int ret;
-    virJSONValuePtr cmd;
-    virJSONValuePtr reply = NULL;
     virJSONValuePtr data;
     char **proplist = NULL;
     int n = 0;
     size_t i;
+    int ret = -1;
 
     *props = NULL;
 
-    if (!(cmd = qemuMonitorJSONMakeCommand("device-list-properties",
-                                           "s:typename", type,
-                                           NULL)))
-        return -1;
-
-    ret = qemuMonitorJSONCommand(mon, cmd, &reply);
-
-    if (ret == 0 &&
-        qemuMonitorJSONHasError(reply, "DeviceNotFound")) {
-        goto cleanup;
-    }
-
-    if (ret == 0)
-        ret = qemuMonitorJSONCheckError(cmd, reply);
-
-    if (ret < 0)
-        goto cleanup;
+    if (qemuMonitorJSONHasError(reply, "DeviceNotFound"))
+        return 0;
 
-    ret = -1;
+    if (qemuMonitorJSONCheckError(cmd, reply) < 0)
+        return -1;
 
     if (!(data = virJSONValueObjectGet(reply, "return"))) {
         virReportError(VIR_ERR_INTERNAL_ERROR, "%s",
@@ -4856,12 +4945,88 @@ int qemuMonitorJSONGetObjectProps(qemuMonitorPtr mon,
 cleanup:
     if (ret < 0)
         virStringFreeList(proplist);
+    return ret;
+}
+
+
+int qemuMonitorJSONGetObjectProps(qemuMonitorPtr mon,
+                                  const char *type,
+                                  char ***props)
+{
+    int ret = -1;
+    virJSONValuePtr cmd;
+    virJSONValuePtr reply = NULL;
+
+    *props = NULL;
+
+    if (!(cmd = qemuMonitorJSONMakeCommand("device-list-properties",
+                                           "s:typename", type,
+                                           NULL)))
+        return -1;
+
+    if (qemuMonitorJSONCommand(mon, cmd, &reply) < 0)
+        goto cleanup;
+
+    ret = qemuMonitorJSONParseObjectProps(cmd, reply, props);
+
+cleanup:
     virJSONValueFree(cmd);
     virJSONValueFree(reply);
     return ret;
 }
 
 
+int qemuMonitorJSONGetObjectPropsBatch(qemuMonitorPtr mon,
+                                       const char **types,
+                                       size_t ntypes,
+                                       char ***props,
+                                       int *nprops)
+{
+    virJSONValuePtr *cmds = NULL;
+    virJSONValuePtr *replies = NULL;
+    size_t i;
+    int ret = -1;
+
+    memset(props, 0, sizeof(*props) * ntypes);
+
+    if (VIR_ALLOC_N(cmds, ntypes) < 0 ||
+        VIR_ALLOC_N(replies, ntypes) < 0)
+        goto cleanup;
+
+    for (i = 0; i < ntypes; i++) {
+        if (!(cmds[i] = qemuMonitorJSONMakeCommand("device-list-properties",
+                                                   "s:typename", types[i],
+                                                   NULL)))
+            goto cleanup;
+    }
+
+    if (qemuMonitorJSONCommandBatch(mon, cmds, ntypes, replies) < 0)
+        goto cleanup;
+
+    for (i = 0; i < ntypes; i++) {
+        if ((nprops[i] = qemuMonitorJSONParseObjectProps(cmds[i],
+                                                         replies[i],
+                                                         &props[i])) < 0)
+            goto cleanup;
+    }
+
+    ret = 0;
+
+cleanup:
+    for (i = 0; ret < 0 && i < ntypes; i++) {
+        virStringFreeList(props[i]);
+        props[i] = NULL;
+    }
+    for (i = 0; cmds && i < ntypes; i++)
+        virJSONValueFree(cmds[i]);
+    for (i = 0; replies && i < ntypes; i++)
+        virJSONValueFree(replies[i]);
+    VIR_FREE(cmds);
+    VIR_FREE(replies);
+    return ret;
+}
+
+
 char *
 qemuMonitorJSONGetTargetArch(qemuMonitorPtr mon)
 {
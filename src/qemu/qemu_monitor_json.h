@@ -33,8 +33,12 @@
 
 int qemuMonitorJSONIOProcess(qemuMonitorPtr mon,
                              const char *data,
-                             size_t len,
-                             qemuMonitorMessagePtr msg);
+                             size_t len);
+
+int qemuMonitorJSONCommandBatch(qemuMonitorPtr mon,
+                                virJSONValuePtr *cmds,
+                                size_t ncmds,
+                                virJSONValuePtr *replies);
 
 int qemuMonitorJSONHumanCommandWithFd(qemuMonitorPtr mon,
                                       const char *cmd,
@@ -402,6 +406,12 @@ int qemuMonitorJSONGetObjectProps(qemuMonitorPtr mon,
                                   const char *type,
                                   char ***props)
     ATTRIBUTE_NONNULL(2) ATTRIBUTE_NONNULL(3);
+int qemuMonitorJSONGetObjectPropsBatch(qemuMonitorPtr mon,
+                                       const char **types,
+                                       size_t ntypes,
+                                       char ***props,
+                                       int *nprops)
+    ATTRIBUTE_NONNULL(2) ATTRIBUTE_NONNULL(4) ATTRIBUTE_NONNULL(5);
 char *qemuMonitorJSONGetTargetArch(qemuMonitorPtr mon);
 
 int qemuMonitorJSONNBDServerStart(qemuMonitorPtr mon,
@@ -3571,6 +3571,94 @@ cleanup:
 }
 
 
+/* Phases of qemuProcessStart, timed separately so that the log shows
+ * where the start up time of a domain goes */
+enum qemuProcessStartPhase {
+    QEMU_PROCESS_START_PHASE_PREPARE,
+    QEMU_PROCESS_START_PHASE_COMMAND,
+    QEMU_PROCESS_START_PHASE_SPAWN,
+    QEMU_PROCESS_START_PHASE_CGROUP,
+    QEMU_PROCESS_START_PHASE_LABEL,
+    QEMU_PROCESS_START_PHASE_MONITOR,
+    QEMU_PROCESS_START_PHASE_SETUP,
+    QEMU_PROCESS_START_PHASE_RESUME,
+
+    QEMU_PROCESS_START_PHASE_LAST
+};
+
+VIR_ENUM_DECL(qemuProcessStartPhase)
+VIR_ENUM_IMPL(qemuProcessStartPhase, QEMU_PROCESS_START_PHASE_LAST,
+              "prepare",
+              "command",
+              "spawn",
+              "cgroup",
+              "label",
+              "monitor",
+              "setup",
+              "resume")
+
+typedef struct _qemuProcessStartTimer qemuProcessStartTimer;
+typedef qemuProcessStartTimer *qemuProcessStartTimerPtr;
+struct _qemuProcessStartTimer {
+    int phase;
+    unsigned long long start; /* of the current phase */
+    unsigned long long elapsed[QEMU_PROCESS_START_PHASE_LAST];
+};
+
+static void
+qemuProcessStartTimerInit(qemuProcessStartTimerPtr timer)
+{
+    memset(timer, 0, sizeof(*timer));
+    timer->phase = QEMU_PROCESS_START_PHASE_PREPARE;
+    ignore_value(virTimeMillisNow(&timer->start));
+}
+
+/* Account the time since the last mark to the current phase and
+ * move on to @phase */
+static void
+qemuProcessStartTimerMark(qemuProcessStartTimerPtr timer,
+                          int phase)
+{
+    unsigned long long now;
+
+    if (virTimeMillisNow(&now) == 0) {
+        timer->elapsed[timer->phase] += now - timer->start;
+        timer->start = now;
+    }
+    timer->phase = phase;
+}
+
+static void
+qemuProcessStartTimerReport(qemuProcessStartTimerPtr timer,
+                            virDomainObjPtr vm,
+                            bool success)
+{
+    virBuffer buf = VIR_BUFFER_INITIALIZER;
+    unsigned long long total = 0;
+    char *str;
+    size_t i;
+
+    qemuProcessStartTimerMark(timer, timer->phase);
+
+    for (i = 0; i < QEMU_PROCESS_START_PHASE_LAST; i++) {
+        virBufferAsprintf(&buf, " %s=%llums",
+                          qemuProcessStartPhaseTypeToString(i),
+                          timer->elapsed[i]);
+        total += timer->elapsed[i];
+    }
+
+    if (virBufferError(&buf)) {
+        virBufferFreeAndReset(&buf);
+        return;
+    }
+    str = virBufferContentAndReset(&buf);
+
+    VIR_INFO("%s domain %s in %llums:%s",
+             success ? "Started" : "Failed to start",
+             vm->def->name, total, NULLSTR(str));
+    VIR_FREE(str);
+}
+
 int qemuProcessStart(virConnectPtr conn,
                      virQEMUDriverPtr driver,
                      virDomainObjPtr vm,
@@ -3596,6 +3684,9 @@ int qemuProcessStart(virConnectPtr conn,
     unsigned int stop_flags;
     virQEMUDriverConfigPtr cfg;
     virCapsPtr caps = NULL;
+    qemuProcessStartTimer timer;
+
+    qemuProcessStartTimerInit(&timer);
 
     VIR_DEBUG("vm=%p name=%s id=%d pid=%llu",
               vm, vm->def->name, vm->def->id,
@@ -3847,6 +3938,7 @@ int qemuProcessStart(virConnectPtr conn,
             goto cleanup;
     }
 
+    qemuProcessStartTimerMark(&timer, QEMU_PROCESS_START_PHASE_COMMAND);
     VIR_DEBUG("Building emulator command line");
     if (!(cmd = qemuBuildCommandLine(conn, driver, vm->def, priv->monConfig,
                                      priv->monJSON, priv->qemuCaps,
@@ -3922,6 +4014,7 @@ int qemuProcessStart(virConnectPtr conn,
     virCommandSetMaxProcesses(cmd, cfg->maxProcesses);
     virCommandSetMaxFiles(cmd, cfg->maxFiles);
 
+    qemuProcessStartTimerMark(&timer, QEMU_PROCESS_START_PHASE_SPAWN);
     VIR_DEBUG("Setting up security labelling");
     if (virSecurityManagerSetChildProcessLabel(driver->securityManager,
                                                vm->def, cmd) < 0) {
@@ -3966,6 +4059,7 @@ int qemuProcessStart(virConnectPtr conn,
         goto cleanup;
     }
 
+    qemuProcessStartTimerMark(&timer, QEMU_PROCESS_START_PHASE_CGROUP);
     VIR_DEBUG("Setting up domain cgroup (if required)");
     if (qemuSetupCgroup(driver, vm, nodemask) < 0)
         goto cleanup;
@@ -3976,6 +4070,7 @@ int qemuProcessStart(virConnectPtr conn,
         qemuProcessInitCpuAffinity(driver, vm, nodemask) < 0)
         goto cleanup;
 
+    qemuProcessStartTimerMark(&timer, QEMU_PROCESS_START_PHASE_LABEL);
     VIR_DEBUG("Setting domain security labels");
     if (virSecurityManagerSetAllLabel(driver->securityManager,
                                       vm->def, stdin_path) < 0)
@@ -4005,6 +4100,7 @@ int qemuProcessStart(virConnectPtr conn,
             goto cleanup;
     }
 
+    qemuProcessStartTimerMark(&timer, QEMU_PROCESS_START_PHASE_MONITOR);
     VIR_DEBUG("Labelling done, completing handshake to child");
     if (virCommandHandshakeNotify(cmd) < 0) {
         goto cleanup;
@@ -4035,6 +4131,7 @@ int qemuProcessStart(virConnectPtr conn,
         priv->agentError = true;
     }
 
+    qemuProcessStartTimerMark(&timer, QEMU_PROCESS_START_PHASE_SETUP);
     VIR_DEBUG("Detecting if required emulator features are present");
     if (!qemuProcessVerifyGuestCPU(driver, vm))
         goto cleanup;
@@ -4108,6 +4205,7 @@ int qemuProcessStart(virConnectPtr conn,
     }
     qemuDomainObjExitMonitor(driver, vm);
 
+    qemuProcessStartTimerMark(&timer, QEMU_PROCESS_START_PHASE_RESUME);
     if (!(flags & VIR_QEMU_PROCESS_START_PAUSED)) {
         VIR_DEBUG("Starting domain CPUs");
         /* Allow the CPUS to start executing */
@@ -4154,6 +4252,8 @@ int qemuProcessStart(virConnectPtr conn,
     /* unset reporting errors from qemu log */
     qemuMonitorSetDomainLog(priv->mon, -1);
 
+    qemuProcessStartTimerReport(&timer, vm, true);
+
     virCommandFree(cmd);
     VIR_FORCE_CLOSE(logfile);
     virObjectUnref(cfg);
@@ -4171,6 +4271,7 @@ cleanup:
     VIR_FORCE_CLOSE(logfile);
     if (priv->mon)
         qemuMonitorSetDomainLog(priv->mon, -1);
+    qemuProcessStartTimerReport(&timer, vm, false);
     qemuProcessStop(driver, vm, VIR_DOMAIN_SHUTOFF_FAILED, stop_flags);
     virObjectUnref(cfg);
     virObjectUnref(caps);
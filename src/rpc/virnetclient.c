@@ -314,6 +314,7 @@ static virNetClientPtr virNetClientNew(virNetSocketPtr sock,
         goto error;
 
     client->sock = sock;
+    virNetSocketSetReadAhead(client->sock, true);
     client->wakeupReadFD = wakeupFD[0];
     client->wakeupSendFD = wakeupFD[1];
     wakeupFD[0] = wakeupFD[1] = -1;
@@ -1058,7 +1059,8 @@ static int virNetClientCallDispatchStream(virNetClientPtr client)
     /* Status is either
      *   - REMOTE_OK - no payload for streams
      *   - REMOTE_ERROR - followed by a remote_error struct
-     *   - REMOTE_CONTINUE - followed by a raw data packet
+     *   - REMOTE_CONTINUE - followed by a raw data packet, or by
+     *                       a virNetStreamHole for hole packets
      */
     switch (client->msg.header.status) {
     case VIR_NET_CONTINUE: {
@@ -1140,6 +1142,7 @@ virNetClientCallDispatch(virNetClientPtr client)
         return virNetClientCallDispatchMessage(client);
 
     case VIR_NET_STREAM: /* Stream protocol */
+    case VIR_NET_STREAM_HOLE: /* Holes in sparse streams */
         return virNetClientCallDispatchStream(client);
 
     default:
@@ -1317,15 +1320,14 @@ virNetClientIOHandleInput(virNetClientPtr client)
                  * incoming async events, or replies for other
                  * thread's RPC calls. We want to get out & let
                  * any other thread take over as soon as we've
-                 * got our reply. When SASL is active though, we
-                 * may have read more data off the wire than we
-                 * initially wanted & cached it in memory. In this
-                 * case, poll() would not detect that there is more
-                 * ready todo.
+                 * got our reply. The socket reads ahead though, and
+                 * SASL may have decoded more data than we initially
+                 * wanted, so further messages can be cached in
+                 * memory. In this case, poll() would not detect that
+                 * there is more ready todo.
                  *
-                 * So if SASL is active *and* some SASL data is
-                 * already cached, then we'll process that now,
-                 * before returning.
+                 * So if some data is already cached, then we'll
+                 * process all of it now, before returning.
                  */
                 if (ret == 0 &&
                     virNetSocketHasCachedData(client->sock))
@@ -31,6 +31,15 @@
 
 #define VIR_FROM_THIS VIR_FROM_RPC
 
+/* A hole received on a sparse stream, located @at bytes into
+ * the incoming data buffer */
+typedef struct _virNetClientStreamHole virNetClientStreamHole;
+typedef virNetClientStreamHole *virNetClientStreamHolePtr;
+struct _virNetClientStreamHole {
+    size_t at;
+    unsigned long long length;
+};
+
 struct _virNetClientStream {
     virObjectLockable parent;
 
@@ -52,6 +61,10 @@ struct _virNetClientStream {
     size_t incomingLength;
     bool incomingEOF;
 
+    /* holes interleaved with the incoming data, in stream order */
+    virNetClientStreamHolePtr holes;
+    size_t nholes;
+
     virNetClientStreamEventCallback cb;
     void *cbOpaque;
     virFreeCallback cbFree;
@@ -84,9 +97,10 @@ virNetClientStreamEventTimerUpdate(virNetClientStreamPtr st)
     if (!st->cb)
         return;
 
-    VIR_DEBUG("Check timer offset=%zu %d", st->incomingOffset, st->cbEvents);
+    VIR_DEBUG("Check timer offset=%zu holes=%zu %d",
+              st->incomingOffset, st->nholes, st->cbEvents);
 
-    if (((st->incomingOffset || st->incomingEOF) &&
+    if (((st->incomingOffset || st->nholes || st->incomingEOF) &&
          (st->cbEvents & VIR_STREAM_EVENT_READABLE)) ||
         (st->cbEvents & VIR_STREAM_EVENT_WRITABLE)) {
         VIR_DEBUG("Enabling event timer");
@@ -108,7 +122,7 @@ virNetClientStreamEventTimer(int timer ATTRIBUTE_UNUSED, void *opaque)
 
     if (st->cb &&
         (st->cbEvents & VIR_STREAM_EVENT_READABLE) &&
-        (st->incomingOffset || st->incomingEOF))
+        (st->incomingOffset || st->nholes || st->incomingEOF))
         events |= VIR_STREAM_EVENT_READABLE;
     if (st->cb &&
         (st->cbEvents & VIR_STREAM_EVENT_WRITABLE))
@@ -160,6 +174,7 @@ void virNetClientStreamDispose(void *obj)
 
     virResetError(&st->err);
     VIR_FREE(st->incoming);
+    VIR_FREE(st->holes);
     virObjectUnref(st->prog);
 }
 
@@ -259,6 +274,34 @@ cleanup:
 }
 
 
+static int
+virNetClientStreamQueueHole(virNetClientStreamPtr st,
+                            virNetMessagePtr msg)
+{
+    virNetStreamHole data;
+    virNetClientStreamHole hole;
+
+    memset(&data, 0, sizeof(data));
+    if (virNetMessageDecodePayload(msg, (xdrproc_t)xdr_virNetStreamHole,
+                                   &data) < 0)
+        return -1;
+
+    if (data.length <= 0)
+        return 0;
+
+    /* Merge with a hole right before this one */
+    if (st->nholes &&
+        st->holes[st->nholes - 1].at == st->incomingOffset) {
+        st->holes[st->nholes - 1].length += data.length;
+        return 0;
+    }
+
+    hole.at = st->incomingOffset;
+    hole.length = data.length;
+    return VIR_APPEND_ELEMENT(st->holes, st->nholes, hole);
+}
+
+
 int virNetClientStreamQueuePacket(virNetClientStreamPtr st,
                                   virNetMessagePtr msg)
 {
@@ -267,7 +310,12 @@ int virNetClientStreamQueuePacket(virNetClientStreamPtr st,
 
     virObjectLock(st);
     need = msg->bufferLength - msg->bufferOffset;
-    if (need) {
+    if (msg->header.type == VIR_NET_STREAM_HOLE) {
+        if (virNetClientStreamQueueHole(st, msg) < 0) {
+            VIR_DEBUG("Failed to queue stream hole");
+            goto cleanup;
+        }
+    } else if (need) {
         size_t avail = st->incomingLength - st->incomingOffset;
         if (need > avail) {
             size_t extra = need - avail;
@@ -287,8 +335,8 @@ int virNetClientStreamQueuePacket(virNetClientStreamPtr st,
         st->incomingEOF = true;
     }
 
-    VIR_DEBUG("Stream incoming data offset %zu length %zu EOF %d",
-              st->incomingOffset, st->incomingLength,
+    VIR_DEBUG("Stream incoming data offset %zu length %zu holes %zu EOF %d",
+              st->incomingOffset, st->incomingLength, st->nholes,
               st->incomingEOF);
     virNetClientStreamEventTimerUpdate(st);
 
@@ -353,17 +401,65 @@ error:
     return -1;
 }
 
+int virNetClientStreamSendHole(virNetClientStreamPtr st,
+                               virNetClientPtr client,
+                               long long length,
+                               unsigned int flags)
+{
+    virNetMessagePtr msg;
+    virNetStreamHole data;
+
+    VIR_DEBUG("st=%p length=%lld flags=%x", st, length, flags);
+
+    memset(&data, 0, sizeof(data));
+    data.length = length;
+    data.flags = flags;
+
+    if (!(msg = virNetMessageNew(false)))
+        return -1;
+
+    virObjectLock(st);
+
+    msg->header.prog = virNetClientProgramGetProgram(st->prog);
+    msg->header.vers = virNetClientProgramGetVersion(st->prog);
+    msg->header.status = VIR_NET_CONTINUE;
+    msg->header.type = VIR_NET_STREAM_HOLE;
+    msg->header.serial = st->serial;
+    msg->header.proc = st->proc;
+
+    virObjectUnlock(st);
+
+    if (virNetMessageEncodeHeader(msg) < 0 ||
+        virNetMessageEncodePayload(msg, (xdrproc_t)xdr_virNetStreamHole,
+                                   &data) < 0)
+        goto error;
+
+    /* Like data packets, holes are async fire&forget */
+    if (virNetClientSendNoReply(client, msg) < 0)
+        goto error;
+
+    virNetMessageFree(msg);
+    return 0;
+
+error:
+    virNetMessageFree(msg);
+    return -1;
+}
+
+
 int virNetClientStreamRecvPacket(virNetClientStreamPtr st,
                                  virNetClientPtr client,
                                  char *data,
                                  size_t nbytes,
-                                 bool nonblock)
+                                 bool nonblock,
+                                 unsigned int flags)
 {
     int rv = -1;
-    VIR_DEBUG("st=%p client=%p data=%p nbytes=%zu nonblock=%d",
-              st, client, data, nbytes, nonblock);
+    size_t i;
+    VIR_DEBUG("st=%p client=%p data=%p nbytes=%zu nonblock=%d flags=%x",
+              st, client, data, nbytes, nonblock, flags);
     virObjectLock(st);
-    if (!st->incomingOffset && !st->incomingEOF) {
+    if (!st->incomingOffset && !st->nholes && !st->incomingEOF) {
         virNetMessagePtr msg;
         int ret;
 
@@ -393,11 +489,31 @@ int virNetClientStreamRecvPacket(virNetClientStreamPtr st,
             goto cleanup;
     }
 
-    VIR_DEBUG("After IO %zu", st->incomingOffset);
-    if (st->incomingOffset) {
+    VIR_DEBUG("After IO %zu holes %zu", st->incomingOffset, st->nholes);
+    if (st->nholes && st->holes[0].at == 0) {
+        int want;
+
+        if (flags & VIR_STREAM_RECV_STOP_AT_HOLE) {
+            rv = -3;
+            goto done;
+        }
+
+        /* Read the hole back as zeroes */
+        want = MIN(nbytes, st->holes[0].length);
+        memset(data, 0, want);
+        st->holes[0].length -= want;
+        if (!st->holes[0].length)
+            VIR_DELETE_ELEMENT(st->holes, 0, st->nholes);
+        rv = want;
+    } else if (st->incomingOffset) {
         int want = st->incomingOffset;
         if (want > nbytes)
             want = nbytes;
+        /* Stop at the next hole */
+        if (st->nholes && want > st->holes[0].at)
+            want = st->holes[0].at;
+        for (i = 0; i < st->nholes; i++)
+            st->holes[i].at -= want;
         memcpy(data, st->incoming, want);
         if (want < st->incomingOffset) {
             memmove(st->incoming, st->incoming + want, st->incomingOffset - want);
@@ -411,6 +527,7 @@ int virNetClientStreamRecvPacket(virNetClientStreamPtr st,
         rv = 0;
     }
 
+done:
     virNetClientStreamEventTimerUpdate(st);
 
 cleanup:
@@ -419,6 +536,27 @@ cleanup:
 }
 
 
+int virNetClientStreamRecvHole(virNetClientStreamPtr st,
+                               long long *length)
+{
+    virObjectLock(st);
+
+    *length = 0;
+    if (st->nholes && st->holes[0].at == 0) {
+        *length = MIN(st->holes[0].length, LLONG_MAX);
+        st->holes[0].length -= *length;
+        if (!st->holes[0].length)
+            VIR_DELETE_ELEMENT(st->holes, 0, st->nholes);
+    }
+
+    VIR_DEBUG("st=%p length=%lld", st, *length);
+
+    virNetClientStreamEventTimerUpdate(st);
+    virObjectUnlock(st);
+    return 0;
+}
+
+
 int virNetClientStreamEventAddCallback(virNetClientStreamPtr st,
                                        int events,
                                        virNetClientStreamEventCallback cb,
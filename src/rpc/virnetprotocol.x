@@ -107,6 +107,9 @@ const VIR_NET_MESSAGE_NUM_FDS_MAX = 32;
  *  - type == VIR_NET_STREAM
  *      * serial matches that from the corresponding VIR_NET_CALL
  *
+ *  - type == VIR_NET_STREAM_HOLE
+ *      * serial matches that from the corresponding VIR_NET_CALL
+ *
  * and the 'status' field varies according to:
  *
  *  - type == VIR_NET_CALL
@@ -124,6 +127,9 @@ const VIR_NET_MESSAGE_NUM_FDS_MAX = 32;
  *     * VIR_NET_OK if stream is complete
  *     * VIR_NET_ERROR if stream had an error
  *
+ *  - type == VIR_NET_STREAM_HOLE
+ *     * VIR_NET_CONTINUE always
+ *
  * Payload varies according to type and status:
  *
  *  - type == VIR_NET_CALL
@@ -147,6 +153,10 @@ const VIR_NET_MESSAGE_NUM_FDS_MAX = 32;
  *     * status == VIR_NET_OK
  *          <empty>
  *
+ *  - type == VIR_NET_STREAM_HOLE
+ *     * status == VIR_NET_CONTINUE
+ *          virNetStreamHole  size of the hole in the stream data
+ *
  *  - type == VIR_NET_CALL_WITH_FDS
  *          int8 - number of FDs
  *          XXX_args  for procedure
@@ -171,7 +181,9 @@ enum virNetMessageType {
     /* client -> server. args from a method call, with passed FDs */
     VIR_NET_CALL_WITH_FDS = 4,
     /* server -> client. reply/error from a method call, with passed FDs */
-    VIR_NET_REPLY_WITH_FDS = 5
+    VIR_NET_REPLY_WITH_FDS = 5,
+    /* either direction. hole in the stream data of a sparse stream */
+    VIR_NET_STREAM_HOLE = 6
 };
 
 enum virNetMessageStatus {
@@ -251,3 +263,10 @@ struct virNetMessageError {
     int int2;
     virNetMessageNetwork net; /* unused */
 };
+
+/* Payload of VIR_NET_STREAM_HOLE messages: the stream skips @length
+ * bytes which read back as zeroes.  No flags are defined yet. */
+struct virNetStreamHole {
+    hyper length;
+    unsigned int flags;
+};
@@ -27,7 +27,8 @@
 #include <string.h>
 #include <fcntl.h>
 
-#include "virnetserver.h"
+#define __VIR_NET_SERVER_ALLOW_INCLUDE_PRIV_H__
+#include "virnetserverpriv.h"
 #include "virlog.h"
 #include "viralloc.h"
 #include "virerror.h"
@@ -39,6 +40,7 @@
 #include "virdbus.h"
 #include "virstring.h"
 #include "virsystemd.h"
+#include "virtime.h"
 
 #ifndef SA_SIGINFO
 # define SA_SIGINFO 0
@@ -46,6 +48,11 @@
 
 #define VIR_FROM_THIS VIR_FROM_RPC
 
+#define VIR_NET_SERVER_CLIENT_WEIGHT(weight)                 \
+    ((weight) < 1 ? 1 :                                      \
+     (weight) > VIR_NET_SERVER_CLIENT_WEIGHT_MAX ?           \
+     VIR_NET_SERVER_CLIENT_WEIGHT_MAX : (weight))
+
 typedef struct _virNetServerSignal virNetServerSignal;
 typedef virNetServerSignal *virNetServerSignalPtr;
 
@@ -56,13 +63,21 @@ struct _virNetServerSignal {
     void *opaque;
 };
 
-typedef struct _virNetServerJob virNetServerJob;
-typedef virNetServerJob *virNetServerJobPtr;
+/* High priority calls are run in arrival order, so that they
+ * keep the priority workers busy for as short a time as possible */
+typedef struct _virNetServerPrioLane virNetServerPrioLane;
+struct _virNetServerPrioLane {
+    virNetServerJobPtr head;
+    virNetServerJobPtr tail;
+};
 
-struct _virNetServerJob {
-    virNetServerClientPtr client;
-    virNetMessagePtr msg;
-    virNetServerProgramPtr prog;
+/* Other calls are shared out between clients with calls waiting,
+ * round robin, each client getting its weight of calls per round */
+typedef struct _virNetServerFairLane virNetServerFairLane;
+struct _virNetServerFairLane {
+    size_t nqueues;
+    virNetServerClientQueuePtr *queues;
+    size_t next;
 };
 
 struct _virNetServer {
@@ -70,6 +85,21 @@ struct _virNetServer {
 
     virThreadPoolPtr workers;
 
+    /* Calls are queued here rather than in the thread pool, which
+     * is only told which lane a worker should take its next call
+     * from. Protected by callLock rather than the server lock, so
+     * that workers picking up calls do not contend with the event
+     * loop thread */
+    virMutex callLock;
+    virNetServerPrioLane prioCalls;
+    virNetServerFairLane fairCalls;
+    size_t nqueues;
+    virNetServerClientQueuePtr *queues;
+    unsigned int weightReadonly;
+    unsigned int weightReadWrite;
+    unsigned int weightLocal;
+    unsigned int weightRemote;
+
     bool privileged;
 
     size_t nsignals;
@@ -176,10 +206,138 @@ cleanup:
     return ret;
 }
 
+static void virNetServerJobFree(virNetServerJobPtr job)
+{
+    virObjectUnref(job->prog);
+    virNetMessageFree(job->msg);
+    virObjectUnref(job->client);
+    VIR_FREE(job);
+}
+
+/*
+ * @srv: server with callLock held
+ */
+int virNetServerQueueJob(virNetServerPtr srv,
+                         virNetServerJobPtr job,
+                         bool priority)
+{
+    virNetServerClientQueuePtr queue = job->queue;
+
+    if (priority) {
+        if (srv->prioCalls.tail)
+            srv->prioCalls.tail->next = job;
+        else
+            srv->prioCalls.head = job;
+        srv->prioCalls.tail = job;
+    } else {
+        if (queue->tail) {
+            queue->tail->next = job;
+        } else {
+            /* Join the end of the current round */
+            if (VIR_APPEND_ELEMENT_COPY(srv->fairCalls.queues,
+                                        srv->fairCalls.nqueues, queue) < 0)
+                return -1;
+            queue->credit = queue->weight;
+            queue->head = job;
+        }
+        queue->tail = job;
+    }
+
+    ignore_value(virTimeMillisNowRaw(&job->queued));
+    if (++queue->stats.depth > queue->stats.maxDepth)
+        queue->stats.maxDepth = queue->stats.depth;
+
+    return 0;
+}
+
+/*
+ * @srv: server with callLock held
+ */
+static void virNetServerFreeClientQueue(virNetServerPtr srv,
+                                        virNetServerClientQueuePtr queue)
+{
+    size_t i;
+
+    for (i = 0; i < srv->nqueues; i++) {
+        if (srv->queues[i] == queue) {
+            VIR_DELETE_ELEMENT(srv->queues, i, srv->nqueues);
+            break;
+        }
+    }
+    VIR_FREE(queue);
+}
+
+/*
+ * @srv: server with callLock held
+ *
+ * Returns the next call to run from the given lane, or NULL
+ */
+virNetServerJobPtr virNetServerTakeJob(virNetServerPtr srv,
+                                       bool priority)
+{
+    virNetServerFairLane *fair = &srv->fairCalls;
+    virNetServerClientQueuePtr queue;
+    virNetServerJobPtr job;
+    unsigned long long now;
+
+    if (priority) {
+        if (!(job = srv->prioCalls.head))
+            return NULL;
+        if (!(srv->prioCalls.head = job->next))
+            srv->prioCalls.tail = NULL;
+        queue = job->queue;
+    } else {
+        if (!fair->nqueues)
+            return NULL;
+        if (fair->next >= fair->nqueues)
+            fair->next = 0;
+
+        queue = fair->queues[fair->next];
+        job = queue->head;
+        if (!(queue->head = job->next)) {
+            /* Out of the lane until it has calls waiting again;
+             * the client after it takes its slot and its turn */
+            queue->tail = NULL;
+            VIR_DELETE_ELEMENT(fair->queues, fair->next, fair->nqueues);
+        } else if (--queue->credit == 0) {
+            queue->credit = queue->weight;
+            fair->next++;
+        }
+    }
+    job->next = NULL;
+    job->queue = NULL;
+
+    queue->stats.depth--;
+    queue->stats.calls++;
+    if (virTimeMillisNowRaw(&now) == 0 && now > job->queued) {
+        unsigned long long wait = now - job->queued;
+
+        queue->stats.waitTotal += wait;
+        if (wait > queue->stats.waitMax)
+            queue->stats.waitMax = wait;
+    }
+
+    if (queue->removed && queue->stats.depth == 0)
+        virNetServerFreeClientQueue(srv, queue);
+
+    return job;
+}
+
+/*
+ * The thread pool does not know about individual calls, only
+ * which lane the worker it wakes should take the next one from
+ */
 static void virNetServerHandleJob(void *jobOpaque, void *opaque)
 {
     virNetServerPtr srv = opaque;
-    virNetServerJobPtr job = jobOpaque;
+    virNetServerJobPtr job;
+
+    virMutexLock(&srv->callLock);
+    job = virNetServerTakeJob(srv, jobOpaque == &srv->prioCalls);
+    virMutexUnlock(&srv->callLock);
+
+    if (!job)
+        return;
 
     VIR_DEBUG("server=%p client=%p message=%p prog=%p",
               srv, job->client, job->msg, job->prog);
@@ -204,7 +362,8 @@ static int virNetServerDispatchNewMessage(virNetServerClientPtr client,
                                           virNetMessagePtr msg,
                                           void *opaque)
 {
-    virNetServerPtr srv = opaque;
+    virNetServerClientQueuePtr queue = opaque;
+    virNetServerPtr srv = queue->srv;
     virNetServerProgramPtr prog = NULL;
     unsigned int priority = 0;
     size_t i;
@@ -229,6 +388,7 @@ static int virNetServerDispatchNewMessage(virNetServerClientPtr client,
 
         job->client = client;
         job->msg = msg;
+        job->queue = queue;
 
         if (prog) {
             virObjectRef(prog);
@@ -236,7 +396,15 @@ static int virNetServerDispatchNewMessage(virNetServerClientPtr client,
             priority = virNetServerProgramGetPriority(prog, msg->header.proc);
         }
 
-        ret = virThreadPoolSendJob(srv->workers, priority, job);
+        /* A worker woken early blocks on callLock until the
+         * call is queued. One woken for a call we then fail
+         * to queue simply finds nothing to do */
+        virMutexLock(&srv->callLock);
+        if ((ret = virThreadPoolSendJob(srv->workers, priority,
+                                        priority ? (void *)&srv->prioCalls :
+                                                   (void *)&srv->fairCalls)) == 0)
+            ret = virNetServerQueueJob(srv, job, priority != 0);
+        virMutexUnlock(&srv->callLock);
 
         if (ret < 0) {
             VIR_FREE(job);
@@ -253,9 +421,86 @@ cleanup:
 }
 
 
+/*
+ * @srv: a locked server object
+ *
+ * Each factor is at most VIR_NET_SERVER_CLIENT_WEIGHT_MAX, so
+ * their product cannot overflow
+ */
+unsigned int virNetServerGetClientWeight(virNetServerPtr srv,
+                                         bool readonly,
+                                         bool local)
+{
+    return (readonly ? srv->weightReadonly : srv->weightReadWrite) *
+        (local ? srv->weightLocal : srv->weightRemote);
+}
+
+
+/*
+ * @srv: a locked server object
+ */
+static virNetServerClientQueuePtr
+virNetServerAddClientQueue(virNetServerPtr srv,
+                           virNetServerClientPtr client)
+{
+    virNetServerClientQueuePtr queue;
+
+    if (VIR_ALLOC(queue) < 0)
+        return NULL;
+
+    queue->srv = srv;
+    queue->client = client;
+    queue->weight =
+        virNetServerGetClientWeight(srv,
+                                    virNetServerClientGetReadonly(client),
+                                    virNetServerClientIsLocal(client));
+
+    virMutexLock(&srv->callLock);
+    if (VIR_APPEND_ELEMENT_COPY(srv->queues, srv->nqueues, queue) < 0)
+        VIR_FREE(queue);
+    virMutexUnlock(&srv->callLock);
+
+    return queue;
+}
+
+
+/*
+ * Forget about the calls queue of a client leaving the server.
+ * Calls it still has waiting are run as normal, the queue being
+ * freed along with the last of them
+ */
+static void virNetServerRemoveClientQueue(virNetServerPtr srv,
+                                          virNetServerClientPtr client)
+{
+    size_t i;
+
+    virMutexLock(&srv->callLock);
+    for (i = 0; i < srv->nqueues; i++) {
+        virNetServerClientQueuePtr queue = srv->queues[i];
+
+        if (queue->client != client || queue->removed)
+            continue;
+
+        VIR_DEBUG("client=%p calls=%llu maxDepth=%zu "
+                  "waitTotal=%llu waitMax=%llu",
+                  client, queue->stats.calls, queue->stats.maxDepth,
+                  queue->stats.waitTotal, queue->stats.waitMax);
+
+        if (queue->stats.depth)
+            queue->removed = true;
+        else
+            virNetServerFreeClientQueue(srv, queue);
+        break;
+    }
+    virMutexUnlock(&srv->callLock);
+}
+
+
 static int virNetServerAddClient(virNetServerPtr srv,
                                  virNetServerClientPtr client)
 {
+    virNetServerClientQueuePtr queue;
+
     virObjectLock(srv);
 
     if (srv->nclients >= srv->nclients_max) {
@@ -268,8 +513,13 @@ static int virNetServerAddClient(virNetServerPtr srv,
     if (virNetServerClientInit(client) < 0)
         goto error;
 
-    if (VIR_EXPAND_N(srv->clients, srv->nclients, 1) < 0)
+    if (!(queue = virNetServerAddClientQueue(srv, client)))
         goto error;
+
+    if (VIR_EXPAND_N(srv->clients, srv->nclients, 1) < 0) {
+        virNetServerRemoveClientQueue(srv, client);
+        goto error;
+    }
     srv->clients[srv->nclients-1] = client;
     virObjectRef(client);
 
@@ -281,7 +531,7 @@ static int virNetServerAddClient(virNetServerPtr srv,
 
     virNetServerClientSetDispatcher(client,
                                     virNetServerDispatchNewMessage,
-                                    srv);
+                                    queue);
 
     virNetServerClientInitKeepAlive(client, srv->keepaliveInterval,
                                     srv->keepaliveCount);
@@ -374,6 +624,14 @@ virNetServerPtr virNetServerNew(size_t min_workers,
     if (!(srv = virObjectLockableNew(virNetServerClass)))
         return NULL;
 
+    if (virMutexInit(&srv->callLock) < 0) {
+        virReportError(VIR_ERR_INTERNAL_ERROR, "%s",
+                       _("cannot initialize mutex"));
+        goto error;
+    }
+    srv->weightReadonly = srv->weightReadWrite = 1;
+    srv->weightLocal = srv->weightRemote = 1;
+
     if (max_workers &&
         !(srv->workers = virThreadPoolNew(min_workers, max_workers,
                                           priority_workers,
@@ -1138,6 +1396,7 @@ void virNetServerRun(virNetServerPtr srv)
                     VIR_FREE(srv->clients);
                     srv->nclients = 0;
                 }
+                virNetServerRemoveClientQueue(srv, client);
 
                 /* Enable services if we can accept a new client.
                  * The new client can be accepted if we are at the limit. */
@@ -1174,6 +1433,7 @@ void virNetServerQuit(virNetServerPtr srv)
 void virNetServerDispose(void *obj)
 {
     virNetServerPtr srv = obj;
+    virNetServerJobPtr job;
     size_t i;
 
     VIR_FORCE_CLOSE(srv->autoShutdownInhibitFd);
@@ -1183,6 +1443,23 @@ void virNetServerDispose(void *obj)
 
     virThreadPoolFree(srv->workers);
 
+    /* No workers are left to run calls still queued */
+    while ((job = srv->prioCalls.head)) {
+        srv->prioCalls.head = job->next;
+        virNetServerJobFree(job);
+    }
+    for (i = 0; i < srv->fairCalls.nqueues; i++) {
+        while ((job = srv->fairCalls.queues[i]->head)) {
+            srv->fairCalls.queues[i]->head = job->next;
+            virNetServerJobFree(job);
+        }
+    }
+    VIR_FREE(srv->fairCalls.queues);
+    for (i = 0; i < srv->nqueues; i++)
+        VIR_FREE(srv->queues[i]);
+    VIR_FREE(srv->queues);
+    virMutexDestroy(&srv->callLock);
+
     for (i = 0; i < srv->nsignals; i++) {
         sigaction(srv->signals[i]->signum, &srv->signals[i]->oldaction, NULL);
         VIR_FREE(srv->signals[i]);
@@ -1235,3 +1512,34 @@ bool virNetServerKeepAliveRequired(virNetServerPtr srv)
     virObjectUnlock(srv);
     return required;
 }
+
+
+/**
+ * virNetServerSetClientWeights:
+ * @srv: the server
+ * @readonly: weight of clients on read-only sockets
+ * @readwrite: weight of clients on read-write sockets
+ * @local: weight of clients on local sockets
+ * @remote: weight of clients on remote sockets
+ *
+ * When more calls are waiting than there are free workers, they are
+ * taken from each client in turn, a client getting as many calls run
+ * per turn as its weight. That is the product of the weight for its
+ * access mode and the one for its transport. Weights are brought into
+ * the range 1 to VIR_NET_SERVER_CLIENT_WEIGHT_MAX. Affects clients
+ * which connect from now on.
+ */
+void virNetServerSetClientWeights(virNetServerPtr srv,
+                                  unsigned int readonly,
+                                  unsigned int readwrite,
+                                  unsigned int local,
+                                  unsigned int remote)
+{
+    virObjectLock(srv);
+    srv->weightReadonly = VIR_NET_SERVER_CLIENT_WEIGHT(readonly);
+    srv->weightReadWrite = VIR_NET_SERVER_CLIENT_WEIGHT(readwrite);
+    srv->weightLocal = VIR_NET_SERVER_CLIENT_WEIGHT(local);
+    srv->weightRemote = VIR_NET_SERVER_CLIENT_WEIGHT(remote);
+    virObjectUnlock(srv);
+}
+
@@ -97,4 +97,14 @@ void virNetServerClose(virNetServerPtr srv);
 
 bool virNetServerKeepAliveRequired(virNetServerPtr srv);
 
+/* Largest weight for any one kind of client, so that the product
+ * of the weights for access mode and transport stays reasonable */
+# define VIR_NET_SERVER_CLIENT_WEIGHT_MAX 100
+
+void virNetServerSetClientWeights(virNetServerPtr srv,
+                                  unsigned int readonly,
+                                  unsigned int readwrite,
+                                  unsigned int local,
+                                  unsigned int remote);
+
 #endif
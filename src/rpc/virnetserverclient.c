@@ -359,6 +359,7 @@ virNetServerClientNewInternal(virNetSocketPtr sock,
         return NULL;
 
     client->sock = virObjectRef(sock);
+    virNetSocketSetReadAhead(client->sock, true);
     client->auth = auth;
     client->readonly = readonly;
 #ifdef WITH_GNUTLS
@@ -1144,11 +1145,9 @@ readmore:
             return;
         }
 
-        virNetServerClientUpdateEvent(client);
-
         /* Try and read payload immediately instead of going back
            into poll() because chances are the data is already
-           waiting for us */
+           waiting for us, if not read ahead into memory */
         goto readmore;
     } else {
         /* Grab the completed message */
@@ -1264,6 +1263,14 @@ readmore:
                 }
             }
         }
+
+        /* The socket reads ahead in large chunks, so further
+         * messages may already be sitting in memory. Carve them
+         * out now rather than going round the event loop again */
+        if (client->rx && !client->wantClose && !client->delayedClose &&
+            virNetSocketHasCachedData(client->sock))
+            goto readmore;
+
         virNetServerClientUpdateEvent(client);
     }
 }
@@ -0,0 +1,81 @@
+/*
+ * virnetserverpriv.h: generic network RPC server, internals
+ *
+ * Copyright (C) 2006-2014 Red Hat, Inc.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library.  If not, see
+ * <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef __VIR_NET_SERVER_ALLOW_INCLUDE_PRIV_H__
+# error "virnetserverpriv.h may only be included by virnetserver.c or its test suite"
+#endif
+
+#ifndef __VIR_NET_SERVER_PRIV_H__
+# define __VIR_NET_SERVER_PRIV_H__
+
+# include "virnetserver.h"
+
+typedef struct _virNetServerJob virNetServerJob;
+typedef virNetServerJob *virNetServerJobPtr;
+
+typedef struct _virNetServerClientQueue virNetServerClientQueue;
+typedef virNetServerClientQueue *virNetServerClientQueuePtr;
+
+struct _virNetServerJob {
+    virNetServerClientPtr client;
+    virNetMessagePtr msg;
+    virNetServerProgramPtr prog;
+
+    virNetServerClientQueuePtr queue;
+    unsigned long long queued;
+    virNetServerJobPtr next;
+};
+
+typedef struct _virNetServerClientQueueStats virNetServerClientQueueStats;
+struct _virNetServerClientQueueStats {
+    size_t depth;                  /* Calls waiting for a worker now */
+    size_t maxDepth;               /* Most calls ever waiting at once */
+    unsigned long long calls;      /* Calls handed to a worker */
+    unsigned long long waitTotal;  /* Time those calls waited, in ms */
+    unsigned long long waitMax;    /* Longest wait of a single call, in ms */
+};
+
+/* Calls from a single client waiting for a worker thread */
+struct _virNetServerClientQueue {
+    virNetServerPtr srv;
+    virNetServerClientPtr client;
+
+    unsigned int weight; /* Calls run per round of the fair lane */
+    unsigned int credit; /* Calls left to run in this round */
+    bool removed; /* Client is gone, free once drained */
+
+    virNetServerJobPtr head;
+    virNetServerJobPtr tail;
+
+    virNetServerClientQueueStats stats;
+};
+
+unsigned int virNetServerGetClientWeight(virNetServerPtr srv,
+                                         bool readonly,
+                                         bool local);
+
+int virNetServerQueueJob(virNetServerPtr srv,
+                         virNetServerJobPtr job,
+                         bool priority);
+
+virNetServerJobPtr virNetServerTakeJob(virNetServerPtr srv,
+                                       bool priority);
+
+#endif /* __VIR_NET_SERVER_PRIV_H__ */
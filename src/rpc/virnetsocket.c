@@ -61,6 +61,12 @@
 
 #define VIR_FROM_THIS VIR_FROM_RPC
 
+/* How much to read off the wire when the caller asks for less */
+#define VIR_NET_SOCKET_READ_AHEAD (64 * 1024)
+
+/* Most descriptors accepted along with a single read */
+#define VIR_NET_SOCKET_MAX_RECV_FDS 16
+
 
 struct _virNetSocket {
     virObjectLockable parent;
@@ -98,6 +104,15 @@ struct _virNetSocket {
 #if WITH_SSH2
     virNetSSHSessionPtr sshSession;
 #endif
+
+    /* Data read off the wire ahead of the caller asking for it,
+     * and any file descriptors which arrived along with it */
+    bool readAhead;
+    char *rxBuffer;
+    size_t rxBufferLength;
+    size_t rxBufferOffset;
+    int *rxFDs;
+    size_t nrxFDs;
 };
 
 
@@ -972,6 +987,11 @@ virJSONValuePtr virNetSocketPreExecRestart(virNetSocketPtr sock)
         goto error;
     }
 #endif
+    if (sock->rxBuffer) {
+        virReportError(VIR_ERR_OPERATION_INVALID, "%s",
+                       _("Unable to save socket state with unread data buffered"));
+        goto error;
+    }
 
     if (!(object = virJSONValueNewObject()))
         goto error;
@@ -1015,6 +1035,7 @@ error:
 void virNetSocketDispose(void *obj)
 {
     virNetSocketPtr sock = obj;
+    size_t i;
 
     PROBE(RPC_SOCKET_DISPOSE,
           "sock=%p", sock);
@@ -1046,6 +1067,11 @@ void virNetSocketDispose(void *obj)
     virObjectUnref(sock->sshSession);
 #endif
 
+    VIR_FREE(sock->rxBuffer);
+    for (i = 0; i < sock->nrxFDs; i++)
+        VIR_FORCE_CLOSE(sock->rxFDs[i]);
+    VIR_FREE(sock->rxFDs);
+
     VIR_FORCE_CLOSE(sock->fd);
     VIR_FORCE_CLOSE(sock->errfd);
 
@@ -1366,6 +1392,10 @@ bool virNetSocketHasCachedData(virNetSocketPtr sock ATTRIBUTE_UNUSED)
     if (sock->saslDecoded)
         hasCached = true;
 #endif
+
+    if (sock->rxBuffer)
+        hasCached = true;
+
     virObjectUnlock(sock);
     return hasCached;
 }
@@ -1399,6 +1429,72 @@ bool virNetSocketHasPendingData(virNetSocketPtr sock ATTRIBUTE_UNUSED)
 }
 
 
+#ifdef HAVE_SYS_UN_H
+/*
+ * Read from a UNIX socket keeping any file descriptors the peer
+ * passed along with the data. A plain read() would make the kernel
+ * close them, which matters once we read ahead of the message the
+ * caller is after: the byte carrying a descriptor directly follows
+ * the message it belongs to. The kernel ends the read at that byte.
+ */
+static ssize_t virNetSocketRecvUNIX(virNetSocketPtr sock, char *buf, size_t len)
+{
+    struct msghdr msg;
+    struct iovec iov;
+    struct cmsghdr *cmsg;
+    char control[CMSG_SPACE(sizeof(int) * VIR_NET_SOCKET_MAX_RECV_FDS)];
+    int flags = 0;
+    ssize_t ret;
+
+    memset(&msg, 0, sizeof(msg));
+    iov.iov_base = buf;
+    iov.iov_len = len;
+    msg.msg_iov = &iov;
+    msg.msg_iovlen = 1;
+    msg.msg_control = control;
+    msg.msg_controllen = sizeof(control);
+# ifdef MSG_CMSG_CLOEXEC
+    flags |= MSG_CMSG_CLOEXEC;
+# endif
+
+    if ((ret = recvmsg(sock->fd, &msg, flags)) <= 0)
+        return ret;
+
+    for (cmsg = CMSG_FIRSTHDR(&msg); cmsg; cmsg = CMSG_NXTHDR(&msg, cmsg)) {
+        int *fds = (int *)CMSG_DATA(cmsg);
+        size_t nfds;
+        size_t i;
+
+        if (cmsg->cmsg_level != SOL_SOCKET ||
+            cmsg->cmsg_type != SCM_RIGHTS)
+            continue;
+
+        nfds = (cmsg->cmsg_len - CMSG_LEN(0)) / sizeof(int);
+        if (VIR_EXPAND_N_QUIET(sock->rxFDs, sock->nrxFDs, nfds) < 0) {
+            for (i = 0; i < nfds; i++)
+                VIR_FORCE_CLOSE(fds[i]);
+            errno = ENOMEM;
+            return -1;
+        }
+
+        for (i = 0; i < nfds; i++) {
+# ifndef MSG_CMSG_CLOEXEC
+            ignore_value(virSetCloseExec(fds[i]));
+# endif
+            sock->rxFDs[sock->nrxFDs - nfds + i] = fds[i];
+        }
+    }
+
+    if (msg.msg_flags & MSG_CTRUNC) {
+        errno = EMSGSIZE;
+        return -1;
+    }
+
+    return ret;
+}
+#endif
+
+
 static ssize_t virNetSocketReadWire(virNetSocketPtr sock, char *buf, size_t len)
 {
     char *errout = NULL;
@@ -1417,7 +1513,12 @@ reread:
         ret = virNetTLSSessionRead(sock->tlsSession, buf, len);
     } else {
 #endif
-        ret = read(sock->fd, buf, len);
+#ifdef HAVE_SYS_UN_H
+        if (sock->localAddr.data.sa.sa_family == AF_UNIX)
+            ret = virNetSocketRecvUNIX(sock, buf, len);
+        else
+#endif
+            ret = read(sock->fd, buf, len);
 #if WITH_GNUTLS
     }
 #endif
@@ -1598,20 +1699,93 @@ static ssize_t virNetSocketWriteSASL(virNetSocketPtr sock, const char *buf, size
 }
 #endif
 
-ssize_t virNetSocketRead(virNetSocketPtr sock, char *buf, size_t len)
+static ssize_t virNetSocketReadInternal(virNetSocketPtr sock, char *buf, size_t len)
 {
-    ssize_t ret;
-    virObjectLock(sock);
 #if WITH_SASL
     if (sock->saslSession)
-        ret = virNetSocketReadSASL(sock, buf, len);
-    else
+        return virNetSocketReadSASL(sock, buf, len);
 #endif
-        ret = virNetSocketReadWire(sock, buf, len);
+    return virNetSocketReadWire(sock, buf, len);
+}
+
+
+/*
+ * Hand out data previously read ahead, releasing the
+ * buffer once it has all been consumed
+ */
+static size_t virNetSocketReadBuffered(virNetSocketPtr sock, char *buf, size_t len)
+{
+    size_t got = sock->rxBufferLength - sock->rxBufferOffset;
+
+    if (len > got)
+        len = got;
+
+    memcpy(buf, sock->rxBuffer + sock->rxBufferOffset, len);
+    sock->rxBufferOffset += len;
+
+    if (sock->rxBufferOffset == sock->rxBufferLength) {
+        VIR_FREE(sock->rxBuffer);
+        sock->rxBufferOffset = sock->rxBufferLength = 0;
+    }
+
+    return len;
+}
+
+
+/*
+ * RPC callers typically ask for a 4 byte length word followed by
+ * the message payload. Rather than issuing a read() for each of
+ * those, when read ahead is enabled small reads pull in up to
+ * VIR_NET_SOCKET_READ_AHEAD bytes at once and are served from that
+ * buffer until it drains, so a burst of messages costs a single
+ * syscall. Large reads bypass the buffer to avoid copying bulk
+ * stream data twice.
+ */
+ssize_t virNetSocketRead(virNetSocketPtr sock, char *buf, size_t len)
+{
+    ssize_t ret;
+    virObjectLock(sock);
+
+    if (sock->rxBuffer) {
+        ret = virNetSocketReadBuffered(sock, buf, len);
+    } else if (!sock->readAhead || len >= VIR_NET_SOCKET_READ_AHEAD) {
+        ret = virNetSocketReadInternal(sock, buf, len);
+    } else {
+        if (VIR_ALLOC_N(sock->rxBuffer, VIR_NET_SOCKET_READ_AHEAD) < 0) {
+            ret = -1;
+            goto cleanup;
+        }
+
+        ret = virNetSocketReadInternal(sock, sock->rxBuffer,
+                                       VIR_NET_SOCKET_READ_AHEAD);
+        if (ret <= 0) {
+            VIR_FREE(sock->rxBuffer);
+            goto cleanup;
+        }
+
+        sock->rxBufferLength = ret;
+        sock->rxBufferOffset = 0;
+        ret = virNetSocketReadBuffered(sock, buf, len);
+    }
+
+cleanup:
     virObjectUnlock(sock);
     return ret;
 }
 
+/*
+ * Enable reading ahead of what virNetSocketRead callers ask for.
+ * Since poll() cannot see data buffered in memory, callers must
+ * check virNetSocketHasCachedData before waiting for more input.
+ */
+void virNetSocketSetReadAhead(virNetSocketPtr sock,
+                              bool readAhead)
+{
+    virObjectLock(sock);
+    sock->readAhead = readAhead;
+    virObjectUnlock(sock);
+}
+
 ssize_t virNetSocketWrite(virNetSocketPtr sock, const char *buf, size_t len)
 {
     ssize_t ret;
@@ -1675,7 +1849,21 @@ int virNetSocketRecvFD(virNetSocketPtr sock, int *fd)
     }
     virObjectLock(sock);
 
-    if ((*fd = recvfd(sock->fd, O_CLOEXEC)) < 0) {
+    /* The byte carrying the descriptor may already have
+     * been read ahead, along with the descriptor itself */
+    if (sock->rxBuffer) {
+        char c;
+
+        if (sock->nrxFDs == 0) {
+            virReportError(VIR_ERR_RPC, "%s",
+                           _("Expected file descriptor, but got data"));
+            goto cleanup;
+        }
+
+        ignore_value(virNetSocketReadBuffered(sock, &c, 1));
+        *fd = sock->rxFDs[0];
+        VIR_DELETE_ELEMENT(sock->rxFDs, 0, sock->nrxFDs);
+    } else if ((*fd = recvfd(sock->fd, O_CLOEXEC)) < 0) {
         if (errno == EAGAIN)
             ret = 0;
         else
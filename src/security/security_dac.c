@@ -886,65 +886,135 @@ virSecurityDACSetChardevCallback(virDomainDefPtr def ATTRIBUTE_UNUSED,
 }
 
 
+/* Image ownership is applied in batches through
+ * virSecurityManagerLabelJobs, with all jobs sharing these ids */
+typedef struct _virSecurityDACImageIds virSecurityDACImageIds;
+typedef virSecurityDACImageIds *virSecurityDACImageIdsPtr;
+struct _virSecurityDACImageIds {
+    uid_t user;
+    gid_t group;
+};
+
+static int
+virSecurityDACApplyOwnership(virSecurityManagerPtr mgr ATTRIBUTE_UNUSED,
+                             const char *path,
+                             void *data)
+{
+    virSecurityDACImageIdsPtr ids = data;
+
+    return virSecurityDACSetOwnership(path, ids->user, ids->group);
+}
+
+static int
+virSecurityDACUndoOwnership(virSecurityManagerPtr mgr ATTRIBUTE_UNUSED,
+                            const char *path,
+                            void *data ATTRIBUTE_UNUSED)
+{
+    return virSecurityDACRestoreSecurityFileLabel(path);
+}
+
+static int
+virSecurityDACQueueSecurityFileLabel(virDomainDiskDefPtr disk,
+                                     const char *path,
+                                     size_t depth,
+                                     void *opaque)
+{
+    void **params = opaque;
+    virSecurityManagerLabelJobsPtr jobs = params[0];
+    virSecurityDACImageIdsPtr ids = params[1];
+
+    /* Mirror virSecurityDACRestoreSecurityImageLabelInt, which only
+     * ever gives back the top image of disks that are not shared */
+    if (virSecurityManagerLabelJobsAdd(jobs, path, ids,
+                                       depth == 0 &&
+                                       !disk->readonly &&
+                                       !disk->shared) < 0)
+        return -1;
+    return 0;
+}
+
 static int
 virSecurityDACSetSecurityAllLabel(virSecurityManagerPtr mgr,
                                   virDomainDefPtr def,
                                   const char *stdin_path ATTRIBUTE_UNUSED)
 {
     virSecurityDACDataPtr priv = virSecurityManagerGetPrivateData(mgr);
+    virSecurityManagerLabelJobsPtr jobs = NULL;
+    virSecurityDACImageIds ids;
+    void *params[2];
     size_t i;
-    uid_t user;
-    gid_t group;
+    int ret = -1;
 
     if (!priv->dynamicOwnership)
         return 0;
 
+    if (virSecurityDACGetImageIds(def, priv, &ids.user, &ids.group))
+        return -1;
+
+    if (!(jobs = virSecurityManagerLabelJobsNew(mgr,
+                                                virSecurityDACApplyOwnership,
+                                                virSecurityDACUndoOwnership,
+                                                NULL)))
+        return -1;
+
+    /* Disk images, their backing chains and the boot files are
+     * usually what lives on slow shared storage, so they are
+     * relabelled in one parallel batch */
+    params[0] = jobs;
+    params[1] = &ids;
     for (i = 0; i < def->ndisks; i++) {
         /* XXX fixme - we need to recursively label the entire tree :-( */
-        if (def->disks[i]->type == VIR_DOMAIN_DISK_TYPE_DIR)
+        if (def->disks[i]->type == VIR_DOMAIN_DISK_TYPE_DIR ||
+            def->disks[i]->type == VIR_DOMAIN_DISK_TYPE_NETWORK)
             continue;
-        if (virSecurityDACSetSecurityImageLabel(mgr,
-                                                def,
-                                                def->disks[i]) < 0)
-            return -1;
+        if (virDomainDiskDefForeachPath(def->disks[i],
+                                        false,
+                                        virSecurityDACQueueSecurityFileLabel,
+                                        params) < 0)
+            goto cleanup;
     }
+
+    if (def->os.kernel &&
+        virSecurityManagerLabelJobsAdd(jobs, def->os.kernel, &ids, true) < 0)
+        goto cleanup;
+
+    if (def->os.initrd &&
+        virSecurityManagerLabelJobsAdd(jobs, def->os.initrd, &ids, true) < 0)
+        goto cleanup;
+
+    if (def->os.dtb &&
+        virSecurityManagerLabelJobsAdd(jobs, def->os.dtb, &ids, true) < 0)
+        goto cleanup;
+
+    if (virSecurityManagerLabelJobsRun(jobs) < 0)
+        goto cleanup;
+
     for (i = 0; i < def->nhostdevs; i++) {
         if (virSecurityDACSetSecurityHostdevLabel(mgr,
                                                   def,
                                                   def->hostdevs[i],
                                                   NULL) < 0)
-            return -1;
+            goto cleanup;
     }
 
     if (virDomainChrDefForeach(def,
                                true,
                                virSecurityDACSetChardevCallback,
                                mgr) < 0)
-        return -1;
+        goto cleanup;
 
     if (def->tpm) {
         if (virSecurityDACSetSecurityTPMFileLabel(mgr,
                                                   def,
                                                   def->tpm) < 0)
-            return -1;
+            goto cleanup;
     }
 
-    if (virSecurityDACGetImageIds(def, priv, &user, &group))
-        return -1;
+    ret = 0;
 
-    if (def->os.kernel &&
-        virSecurityDACSetOwnership(def->os.kernel, user, group) < 0)
-        return -1;
-
-    if (def->os.initrd &&
-        virSecurityDACSetOwnership(def->os.initrd, user, group) < 0)
-        return -1;
-
-    if (def->os.dtb &&
-        virSecurityDACSetOwnership(def->os.dtb, user, group) < 0)
-        return -1;
-
-    return 0;
+cleanup:
+    virSecurityManagerLabelJobsFree(jobs);
+    return ret;
 }
 
 
@@ -30,6 +30,9 @@
 #include "viralloc.h"
 #include "virobject.h"
 #include "virlog.h"
+#include "virhash.h"
+#include "virstring.h"
+#include "virthread.h"
 
 #define VIR_FROM_THIS VIR_FROM_SECURITY
 
@@ -753,3 +756,226 @@ int virSecurityManagerSetHugepages(virSecurityManagerPtr mgr,
 
     return 0;
 }
+
+
+/* Upper bound on the threads used to apply one batch of labels */
+#define VIR_SECURITY_MANAGER_LABEL_WORKERS 8
+
+typedef struct _virSecurityManagerLabelJob virSecurityManagerLabelJob;
+typedef virSecurityManagerLabelJob *virSecurityManagerLabelJobPtr;
+struct _virSecurityManagerLabelJob {
+    char *path;
+    void *data;
+    bool restore;
+    bool applied;
+    int result;
+};
+
+struct _virSecurityManagerLabelJobs {
+    virSecurityManagerPtr mgr;
+    virSecurityManagerLabelFunc apply;
+    virSecurityManagerLabelFunc undo;
+    virFreeCallback dataFree;
+
+    virHashTablePtr paths; /* path -> job index + 1 */
+    virSecurityManagerLabelJobPtr jobs;
+    size_t njobs;
+
+    /* Shared with the workers while running */
+    virMutex lock;
+    size_t next;
+    bool failed;
+    virErrorPtr error;
+};
+
+virSecurityManagerLabelJobsPtr
+virSecurityManagerLabelJobsNew(virSecurityManagerPtr mgr,
+                               virSecurityManagerLabelFunc apply,
+                               virSecurityManagerLabelFunc undo,
+                               virFreeCallback dataFree)
+{
+    virSecurityManagerLabelJobsPtr jobs;
+
+    if (VIR_ALLOC(jobs) < 0)
+        return NULL;
+
+    if (virMutexInit(&jobs->lock) < 0) {
+        virReportSystemError(errno, "%s", _("unable to init mutex"));
+        VIR_FREE(jobs);
+        return NULL;
+    }
+
+    if (!(jobs->paths = virHashCreate(32, NULL))) {
+        virMutexDestroy(&jobs->lock);
+        VIR_FREE(jobs);
+        return NULL;
+    }
+
+    jobs->mgr = mgr;
+    jobs->apply = apply;
+    jobs->undo = undo;
+    jobs->dataFree = dataFree;
+    return jobs;
+}
+
+void
+virSecurityManagerLabelJobsFree(virSecurityManagerLabelJobsPtr jobs)
+{
+    size_t i;
+
+    if (!jobs)
+        return;
+
+    for (i = 0; i < jobs->njobs; i++) {
+        VIR_FREE(jobs->jobs[i].path);
+        if (jobs->dataFree)
+            jobs->dataFree(jobs->jobs[i].data);
+    }
+    VIR_FREE(jobs->jobs);
+    virHashFree(jobs->paths);
+    virFreeError(jobs->error);
+    virMutexDestroy(&jobs->lock);
+    VIR_FREE(jobs);
+}
+
+/* Queue @path to be labelled with @data, which the job list owns from
+ * now on, even on failure.  Queueing a path twice keeps a single job
+ * carrying the most recent @data, so that the outcome matches labelling
+ * the paths one after another.  If @restore is true, a failure of the
+ * batch undoes this label again.  Return the index of the job, for use
+ * with virSecurityManagerLabelJobsGetResult, or -1 on error.  */
+ssize_t
+virSecurityManagerLabelJobsAdd(virSecurityManagerLabelJobsPtr jobs,
+                               const char *path,
+                               void *data,
+                               bool restore)
+{
+    virSecurityManagerLabelJobPtr job;
+    void *entry = virHashLookup(jobs->paths, path);
+    size_t idx = (uintptr_t)entry;
+
+    if (idx) {
+        job = &jobs->jobs[idx - 1];
+        if (jobs->dataFree)
+            jobs->dataFree(job->data);
+        job->data = data;
+        job->restore = restore;
+        return idx - 1;
+    }
+
+    if (VIR_EXPAND_N(jobs->jobs, jobs->njobs, 1) < 0)
+        goto error;
+    job = &jobs->jobs[jobs->njobs - 1];
+
+    if (VIR_STRDUP(job->path, path) < 0 ||
+        virHashAddEntry(jobs->paths, path,
+                        (void *)(uintptr_t)jobs->njobs) < 0) {
+        VIR_FREE(job->path);
+        jobs->njobs--;
+        goto error;
+    }
+    job->data = data;
+    job->restore = restore;
+
+    return jobs->njobs - 1;
+
+error:
+    if (jobs->dataFree)
+        jobs->dataFree(data);
+    return -1;
+}
+
+/* Return what the apply callback returned for job @idx */
+int
+virSecurityManagerLabelJobsGetResult(virSecurityManagerLabelJobsPtr jobs,
+                                     size_t idx)
+{
+    return jobs->jobs[idx].result;
+}
+
+static void
+virSecurityManagerLabelJobsWorker(void *opaque)
+{
+    virSecurityManagerLabelJobsPtr jobs = opaque;
+    virSecurityManagerLabelJobPtr job;
+
+    while (true) {
+        virMutexLock(&jobs->lock);
+        if (jobs->failed || jobs->next == jobs->njobs) {
+            virMutexUnlock(&jobs->lock);
+            break;
+        }
+        job = &jobs->jobs[jobs->next++];
+        virMutexUnlock(&jobs->lock);
+
+        job->result = jobs->apply(jobs->mgr, job->path, job->data);
+
+        virMutexLock(&jobs->lock);
+        if (job->result < 0) {
+            if (!jobs->failed)
+                jobs->error = virSaveLastError();
+            jobs->failed = true;
+        } else {
+            job->applied = true;
+        }
+        virMutexUnlock(&jobs->lock);
+    }
+}
+
+/* Apply all queued labels, spreading the paths over a bounded number
+ * of threads since relabelling network file systems is dominated by
+ * round trip latency.  If any label fails, no further jobs are started
+ * and every label that was applied with @restore set is undone before
+ * the first error is reported.  Return 0 on success, -1 on failure.  */
+int
+virSecurityManagerLabelJobsRun(virSecurityManagerLabelJobsPtr jobs)
+{
+    virThread threads[VIR_SECURITY_MANAGER_LABEL_WORKERS];
+    size_t nthreads = MIN(jobs->njobs, VIR_SECURITY_MANAGER_LABEL_WORKERS);
+    size_t i;
+    char ebuf[1024];
+
+    jobs->next = 0;
+    jobs->failed = false;
+
+    VIR_DEBUG("Applying %zu labels with up to %zu threads",
+              jobs->njobs, nthreads);
+
+    if (nthreads <= 1) {
+        virSecurityManagerLabelJobsWorker(jobs);
+    } else {
+        for (i = 0; i < nthreads; i++) {
+            if (virThreadCreate(&threads[i], true,
+                                virSecurityManagerLabelJobsWorker,
+                                jobs) < 0) {
+                VIR_WARN("Unable to create labelling thread: %s",
+                         virStrerror(errno, ebuf, sizeof(ebuf)));
+                break;
+            }
+        }
+        nthreads = i;
+
+        /* Whatever the threads did not get to is done here */
+        virSecurityManagerLabelJobsWorker(jobs);
+
+        for (i = 0; i < nthreads; i++)
+            virThreadJoin(&threads[i]);
+    }
+
+    if (!jobs->failed)
+        return 0;
+
+    for (i = 0; i < jobs->njobs; i++) {
+        if (!jobs->jobs[i].applied || !jobs->jobs[i].restore ||
+            !jobs->undo)
+            continue;
+        VIR_DEBUG("Rolling back label on '%s'", jobs->jobs[i].path);
+        ignore_value(jobs->undo(jobs->mgr, jobs->jobs[i].path,
+                                jobs->jobs[i].data));
+        jobs->jobs[i].applied = false;
+    }
+
+    if (jobs->error)
+        virSetError(jobs->error);
+    return -1;
+}
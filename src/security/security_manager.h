@@ -125,4 +125,29 @@ int virSecurityManagerSetHugepages(virSecurityManagerPtr mgr,
                                   virDomainDefPtr sec,
                                   const char *hugepages_path);
 
+typedef struct _virSecurityManagerLabelJobs virSecurityManagerLabelJobs;
+typedef virSecurityManagerLabelJobs *virSecurityManagerLabelJobsPtr;
+
+/* Apply or undo the label described by @data on @path.  Apply may
+ * return a positive value to tell the caller something about the
+ * outcome, which is made available by
+ * virSecurityManagerLabelJobsGetResult.  */
+typedef int (*virSecurityManagerLabelFunc)(virSecurityManagerPtr mgr,
+                                           const char *path,
+                                           void *data);
+
+virSecurityManagerLabelJobsPtr
+virSecurityManagerLabelJobsNew(virSecurityManagerPtr mgr,
+                               virSecurityManagerLabelFunc apply,
+                               virSecurityManagerLabelFunc undo,
+                               virFreeCallback dataFree);
+void virSecurityManagerLabelJobsFree(virSecurityManagerLabelJobsPtr jobs);
+ssize_t virSecurityManagerLabelJobsAdd(virSecurityManagerLabelJobsPtr jobs,
+                                       const char *path,
+                                       void *data,
+                                       bool restore);
+int virSecurityManagerLabelJobsGetResult(virSecurityManagerLabelJobsPtr jobs,
+                                         size_t idx);
+int virSecurityManagerLabelJobsRun(virSecurityManagerLabelJobsPtr jobs);
+
 #endif /* VIR_SECURITY_MANAGER_H__ */
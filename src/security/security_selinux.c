@@ -2251,6 +2251,157 @@ virSecuritySELinuxSetSecuritySmartcardCallback(virDomainDefPtr def,
 }
 
 
+/* One file context change of a virSecurityManagerLabelJobs batch */
+typedef struct _virSecuritySELinuxFileconJob virSecuritySELinuxFileconJob;
+typedef virSecuritySELinuxFileconJob *virSecuritySELinuxFileconJobPtr;
+struct _virSecuritySELinuxFileconJob {
+    char *tcon; /* borrowed from the domain or driver */
+    bool optional;
+};
+
+/* The label jobs queued for the disks of a domain */
+typedef struct _virSecuritySELinuxDiskJobs virSecuritySELinuxDiskJobs;
+typedef virSecuritySELinuxDiskJobs *virSecuritySELinuxDiskJobsPtr;
+struct _virSecuritySELinuxDiskJobs {
+    virSecurityManagerLabelJobsPtr jobs;
+    virSecuritySELinuxCallbackDataPtr cbdata;
+    size_t *disks;
+    ssize_t *idx;
+    size_t nidx;
+    size_t disk;
+};
+
+static void
+virSecuritySELinuxFileconJobFree(void *opaque)
+{
+    virSecuritySELinuxFileconJobPtr job = opaque;
+
+    VIR_FREE(job);
+}
+
+static int
+virSecuritySELinuxApplyFilecon(virSecurityManagerPtr mgr ATTRIBUTE_UNUSED,
+                               const char *path,
+                               void *opaque)
+{
+    virSecuritySELinuxFileconJobPtr job = opaque;
+
+    return virSecuritySELinuxSetFileconHelper(path, job->tcon, job->optional);
+}
+
+static int
+virSecuritySELinuxUndoFilecon(virSecurityManagerPtr mgr,
+                              const char *path,
+                              void *opaque ATTRIBUTE_UNUSED)
+{
+    return virSecuritySELinuxRestoreSecurityFileLabel(mgr, path);
+}
+
+static ssize_t
+virSecuritySELinuxQueueFilecon(virSecurityManagerLabelJobsPtr jobs,
+                               const char *path,
+                               char *tcon,
+                               bool optional,
+                               bool restore)
+{
+    virSecuritySELinuxFileconJobPtr job;
+
+    if (VIR_ALLOC(job) < 0)
+        return -1;
+    job->tcon = tcon;
+    job->optional = optional;
+
+    return virSecurityManagerLabelJobsAdd(jobs, path, job, restore);
+}
+
+/* Queue the same label virSecuritySELinuxSetSecurityFileLabel would
+ * apply to @path, remembering which disk it belongs to */
+static int
+virSecuritySELinuxQueueSecurityFileLabel(virDomainDiskDefPtr disk,
+                                         const char *path,
+                                         size_t depth,
+                                         void *opaque)
+{
+    virSecuritySELinuxDiskJobsPtr diskjobs = opaque;
+    virSecurityLabelDefPtr secdef = diskjobs->cbdata->secdef;
+    virSecuritySELinuxDataPtr data =
+        virSecurityManagerGetPrivateData(diskjobs->cbdata->manager);
+    virSecurityDeviceLabelDefPtr disk_seclabel;
+    char *tcon;
+    bool optional = true;
+    ssize_t idx;
+
+    disk_seclabel = virDomainDiskDefGetSecurityLabelDef(disk,
+                                                        SECURITY_SELINUX_NAME);
+
+    if (disk_seclabel && disk_seclabel->norelabel)
+        return 0;
+
+    if (disk_seclabel && disk_seclabel->label) {
+        tcon = disk_seclabel->label;
+        optional = false;
+    } else if (depth == 0) {
+        if (disk->shared)
+            tcon = data->file_context;
+        else if (disk->readonly)
+            tcon = data->content_context;
+        else if (secdef->imagelabel)
+            tcon = secdef->imagelabel;
+        else
+            return 0;
+    } else {
+        tcon = data->content_context;
+    }
+
+    /* Only the top image of a private disk is restored on shutdown */
+    if ((idx = virSecuritySELinuxQueueFilecon(diskjobs->jobs, path, tcon,
+                                              optional,
+                                              depth == 0 &&
+                                              !disk->readonly &&
+                                              !disk->shared)) < 0)
+        return -1;
+
+    if (VIR_EXPAND_N(diskjobs->disks, diskjobs->nidx, 1) < 0 ||
+        VIR_REALLOC_N(diskjobs->idx, diskjobs->nidx) < 0)
+        return -1;
+    diskjobs->disks[diskjobs->nidx - 1] = diskjobs->disk;
+    diskjobs->idx[diskjobs->nidx - 1] = idx;
+    return 0;
+}
+
+/* If a disk label could not be set, but virt_use_nfs let us proceed
+ * anyway, record that we don't need to relabel later */
+static int
+virSecuritySELinuxMarkLabelskip(virDomainDefPtr def,
+                                virSecuritySELinuxDiskJobsPtr diskjobs)
+{
+    virSecurityDeviceLabelDefPtr disk_seclabel;
+    virDomainDiskDefPtr disk;
+    size_t i;
+
+    for (i = 0; i < diskjobs->nidx; i++) {
+        if (virSecurityManagerLabelJobsGetResult(diskjobs->jobs,
+                                                 diskjobs->idx[i]) != 1)
+            continue;
+
+        disk = def->disks[diskjobs->disks[i]];
+        if (virDomainDiskDefGetSecurityLabelDef(disk, SECURITY_SELINUX_NAME))
+            continue;
+
+        if (!(disk_seclabel =
+              virDomainDiskDefGenSecurityLabelDef(SECURITY_SELINUX_NAME)))
+            return -1;
+        disk_seclabel->labelskip = true;
+        if (VIR_APPEND_ELEMENT(disk->seclabels, disk->nseclabels,
+                               disk_seclabel) < 0) {
+            virSecurityDeviceLabelDefFree(disk_seclabel);
+            return -1;
+        }
+    }
+
+    return 0;
+}
+
 static int
 virSecuritySELinuxSetSecurityAllLabel(virSecurityManagerPtr mgr,
                                       virDomainDefPtr def,
@@ -2259,6 +2410,9 @@ virSecuritySELinuxSetSecurityAllLabel(virSecurityManagerPtr mgr,
     size_t i;
     virSecuritySELinuxDataPtr data = virSecurityManagerGetPrivateData(mgr);
     virSecurityLabelDefPtr secdef;
+    virSecuritySELinuxCallbackData cbdata;
+    virSecuritySELinuxDiskJobs diskjobs;
+    int ret = -1;
 
     secdef = virDomainDefGetSecurityLabelDef(def, SECURITY_SELINUX_NAME);
     if (secdef == NULL)
@@ -2267,6 +2421,19 @@ virSecuritySELinuxSetSecurityAllLabel(virSecurityManagerPtr mgr,
     if (secdef->norelabel || data->skipAllLabel)
         return 0;
 
+    cbdata.manager = mgr;
+    cbdata.secdef = secdef;
+    memset(&diskjobs, 0, sizeof(diskjobs));
+    diskjobs.cbdata = &cbdata;
+    if (!(diskjobs.jobs =
+          virSecurityManagerLabelJobsNew(mgr,
+                                         virSecuritySELinuxApplyFilecon,
+                                         virSecuritySELinuxUndoFilecon,
+                                         virSecuritySELinuxFileconJobFree)))
+        return -1;
+
+    /* Disk images, their backing chains and the boot files are
+     * relabelled in one parallel batch */
     for (i = 0; i < def->ndisks; i++) {
         /* XXX fixme - we need to recursively label the entire tree :-( */
         if (def->disks[i]->type == VIR_DOMAIN_DISK_TYPE_DIR) {
@@ -2274,57 +2441,78 @@ virSecuritySELinuxSetSecurityAllLabel(virSecurityManagerPtr mgr,
                      def->disks[i]->src, def->disks[i]->dst);
             continue;
         }
-        if (virSecuritySELinuxSetSecurityImageLabel(mgr,
-                                         def, def->disks[i]) < 0)
-            return -1;
+        if (def->disks[i]->type == VIR_DOMAIN_DISK_TYPE_NETWORK)
+            continue;
+        diskjobs.disk = i;
+        if (virDomainDiskDefForeachPath(def->disks[i],
+                                        true,
+                                        virSecuritySELinuxQueueSecurityFileLabel,
+                                        &diskjobs) < 0)
+            goto cleanup;
     }
     /* XXX fixme process  def->fss if relabel == true */
 
+    if (def->os.kernel &&
+        virSecuritySELinuxQueueFilecon(diskjobs.jobs, def->os.kernel,
+                                       data->content_context,
+                                       false, true) < 0)
+        goto cleanup;
+
+    if (def->os.initrd &&
+        virSecuritySELinuxQueueFilecon(diskjobs.jobs, def->os.initrd,
+                                       data->content_context,
+                                       false, true) < 0)
+        goto cleanup;
+
+    if (def->os.dtb &&
+        virSecuritySELinuxQueueFilecon(diskjobs.jobs, def->os.dtb,
+                                       data->content_context,
+                                       false, true) < 0)
+        goto cleanup;
+
+    if (virSecurityManagerLabelJobsRun(diskjobs.jobs) < 0 ||
+        virSecuritySELinuxMarkLabelskip(def, &diskjobs) < 0)
+        goto cleanup;
+
     for (i = 0; i < def->nhostdevs; i++) {
         if (virSecuritySELinuxSetSecurityHostdevLabel(mgr,
                                                       def,
                                                       def->hostdevs[i],
                                                       NULL) < 0)
-            return -1;
+            goto cleanup;
     }
     if (def->tpm) {
         if (virSecuritySELinuxSetSecurityTPMFileLabel(mgr, def,
                                                       def->tpm) < 0)
-            return -1;
+            goto cleanup;
     }
 
     if (virDomainChrDefForeach(def,
                                true,
                                virSecuritySELinuxSetSecurityChardevCallback,
                                NULL) < 0)
-        return -1;
+        goto cleanup;
 
     if (virDomainSmartcardDefForeach(def,
                                      true,
                                      virSecuritySELinuxSetSecuritySmartcardCallback,
                                      mgr) < 0)
-        return -1;
-
-    if (def->os.kernel &&
-        virSecuritySELinuxSetFilecon(def->os.kernel, data->content_context) < 0)
-        return -1;
-
-    if (def->os.initrd &&
-        virSecuritySELinuxSetFilecon(def->os.initrd, data->content_context) < 0)
-        return -1;
-
-    if (def->os.dtb &&
-        virSecuritySELinuxSetFilecon(def->os.dtb, data->content_context) < 0)
-        return -1;
+        goto cleanup;
 
     if (stdin_path) {
         if (virSecuritySELinuxSetFilecon(stdin_path, data->content_context) < 0 &&
             virStorageFileIsSharedFSType(stdin_path,
                                          VIR_STORAGE_FILE_SHFS_NFS) != 1)
-            return -1;
+            goto cleanup;
     }
 
-    return 0;
+    ret = 0;
+
+cleanup:
+    virSecurityManagerLabelJobsFree(diskjobs.jobs);
+    VIR_FREE(diskjobs.disks);
+    VIR_FREE(diskjobs.idx);
+    return ret;
 }
 
 static int
@@ -35,11 +35,15 @@
 #endif
 #include <errno.h>
 #include <string.h>
+#ifdef __linux__
+# include <sys/ioctl.h>
+# include <linux/fs.h>
+#endif
 
 #include "virerror.h"
 #include "datatypes.h"
 #include "driver.h"
-#include "storage_driver.h"
+#include "storage_driverpriv.h"
 #include "storage_conf.h"
 #include "viralloc.h"
 #include "storage_backend.h"
@@ -49,6 +53,8 @@
 #include "configmake.h"
 #include "virstring.h"
 #include "viraccessapicheck.h"
+#include "viratomic.h"
+#include "virtime.h"
 
 #define VIR_FROM_THIS VIR_FROM_STORAGE
 
@@ -65,6 +71,92 @@ static void storageDriverUnlock(virStorageDriverStatePtr driver)
     virMutexUnlock(&driver->lock);
 }
 
+
+/*
+ * The volume path index lets storageVolLookupByPath go straight to
+ * the right pool instead of locking every pool and computing stable
+ * paths along the way.  Entries are only hints: they are checked
+ * against the pool, and a miss falls back to the full scan.  Failing
+ * to update the index is therefore never fatal.
+ */
+static void
+storageDriverVolPathFree(void *payload,
+                         const void *name ATTRIBUTE_UNUSED)
+{
+    VIR_FREE(payload);
+}
+
+static void
+storageDriverVolPathAdd(virStorageDriverStatePtr driver,
+                        virStoragePoolObjPtr pool,
+                        const char *path)
+{
+    char *name = NULL;
+
+    if (!path)
+        return;
+
+    virMutexLock(&driver->volPathsLock);
+    if (VIR_STRDUP(name, pool->def->name) < 0 ||
+        virHashUpdateEntry(driver->volPaths, path, name) < 0) {
+        VIR_FREE(name);
+        virResetLastError();
+    }
+    virMutexUnlock(&driver->volPathsLock);
+}
+
+static void
+storageDriverVolPathRemove(virStorageDriverStatePtr driver,
+                           virStoragePoolObjPtr pool,
+                           const char *path)
+{
+    const char *name;
+
+    if (!path)
+        return;
+
+    virMutexLock(&driver->volPathsLock);
+    if ((name = virHashLookup(driver->volPaths, path)) &&
+        STREQ(name, pool->def->name))
+        ignore_value(virHashRemoveEntry(driver->volPaths, path));
+    virMutexUnlock(&driver->volPathsLock);
+}
+
+static char *
+storageDriverVolPathLookup(virStorageDriverStatePtr driver,
+                           const char *path)
+{
+    char *ret = NULL;
+
+    virMutexLock(&driver->volPathsLock);
+    ignore_value(VIR_STRDUP_QUIET(ret, virHashLookup(driver->volPaths, path)));
+    virMutexUnlock(&driver->volPathsLock);
+
+    return ret;
+}
+
+static void
+storageDriverPoolIndexVols(virStorageDriverStatePtr driver,
+                           virStoragePoolObjPtr pool)
+{
+    size_t i;
+
+    for (i = 0; i < pool->volumes.count; i++)
+        storageDriverVolPathAdd(driver, pool,
+                                pool->volumes.objs[i]->target.path);
+}
+
+static void
+storageDriverPoolUnindexVols(virStorageDriverStatePtr driver,
+                             virStoragePoolObjPtr pool)
+{
+    size_t i;
+
+    for (i = 0; i < pool->volumes.count; i++)
+        storageDriverVolPathRemove(driver, pool,
+                                   pool->volumes.objs[i]->target.path);
+}
+
 static void
 storageDriverAutostart(virStorageDriverStatePtr driver) {
     size_t i;
@@ -126,6 +218,7 @@ storageDriverAutostart(virStorageDriverStatePtr driver) {
                 continue;
             }
             pool->active = 1;
+            storageDriverPoolIndexVols(driver, pool);
         }
         virStoragePoolObjUnlock(pool);
     }
@@ -152,8 +245,16 @@ storageStateInitialize(bool privileged,
         VIR_FREE(driverState);
         return -1;
     }
+    if (virMutexInit(&driverState->volPathsLock) < 0) {
+        virMutexDestroy(&driverState->lock);
+        VIR_FREE(driverState);
+        return -1;
+    }
     storageDriverLock(driverState);
 
+    if (!(driverState->volPaths = virHashCreate(256, storageDriverVolPathFree)))
+        goto error;
+
     if (privileged) {
         if (VIR_STRDUP(base, SYSCONFDIR "/libvirt") < 0)
             goto error;
@@ -247,7 +348,9 @@ storageStateCleanup(void) {
 
     VIR_FREE(driverState->configDir);
     VIR_FREE(driverState->autostartDir);
+    virHashFree(driverState->volPaths);
     storageDriverUnlock(driverState);
+    virMutexDestroy(&driverState->volPathsLock);
     virMutexDestroy(&driverState->lock);
     VIR_FREE(driverState);
 
@@ -621,6 +724,7 @@ storagePoolCreateXML(virConnectPtr conn,
     }
     VIR_INFO("Creating storage pool '%s'", pool->def->name);
     pool->active = 1;
+    storageDriverPoolIndexVols(driver, pool);
 
     ret = virGetStoragePool(conn, pool->def->name, pool->def->uuid,
                             NULL, NULL);
@@ -783,6 +887,7 @@ storagePoolCreate(virStoragePoolPtr obj,
 
     VIR_INFO("Starting up storage pool '%s'", pool->def->name);
     pool->active = 1;
+    storageDriverPoolIndexVols(driver, pool);
     ret = 0;
 
 cleanup:
@@ -873,6 +978,7 @@ storagePoolDestroy(virStoragePoolPtr obj) {
         backend->stopPool(obj->conn, pool) < 0)
         goto cleanup;
 
+    storageDriverPoolUnindexVols(driver, pool);
     virStoragePoolObjClearVols(pool);
 
     pool->active = 0;
@@ -989,6 +1095,7 @@ storagePoolRefresh(virStoragePoolPtr obj,
         goto cleanup;
     }
 
+    storageDriverPoolUnindexVols(driver, pool);
     virStoragePoolObjClearVols(pool);
     if (backend->refreshPool(obj->conn, pool) < 0) {
         if (backend->stopPool)
@@ -1002,6 +1109,7 @@ storagePoolRefresh(virStoragePoolPtr obj,
         }
         goto cleanup;
     }
+    storageDriverPoolIndexVols(driver, pool);
     ret = 0;
 
 cleanup:
@@ -1432,56 +1540,86 @@ cleanup:
     return ret;
 }
 
+/* Look for @cleanpath in @pool, which must be locked.  Returns 0 if
+ * there's no such volume or it was found and *@ret is set, -1 on error */
+static int
+storageVolLookupByPathInPool(virConnectPtr conn,
+                             virStoragePoolObjPtr pool,
+                             const char *cleanpath,
+                             virStorageVolPtr *ret)
+{
+    virStorageVolDefPtr vol;
+    char *stable_path;
+
+    if (!virStoragePoolObjIsActive(pool))
+        return 0;
+
+    if (!(vol = virStorageVolDefFindByPath(pool, cleanpath))) {
+        stable_path = virStorageBackendStablePath(pool, cleanpath, false);
+        if (stable_path == NULL) {
+            /* Don't break the whole lookup process if it fails on
+             * getting the stable path for some of the pools.
+             */
+            VIR_WARN("Failed to get stable path for pool '%s'",
+                     pool->def->name);
+            return 0;
+        }
+
+        vol = virStorageVolDefFindByPath(pool, stable_path);
+        VIR_FREE(stable_path);
+    }
+
+    if (!vol)
+        return 0;
+
+    if (virStorageVolLookupByPathEnsureACL(conn, pool->def, vol) < 0)
+        return -1;
+
+    *ret = virGetStorageVol(conn, pool->def->name, vol->name, vol->key,
+                            NULL, NULL);
+    return 0;
+}
+
 static virStorageVolPtr
 storageVolLookupByPath(virConnectPtr conn,
                        const char *path) {
     virStorageDriverStatePtr driver = conn->storagePrivateData;
+    virStoragePoolObjPtr pool;
     size_t i;
     virStorageVolPtr ret = NULL;
     char *cleanpath;
+    char *poolname = NULL;
+    int rc;
 
     cleanpath = virFileSanitizePath(path);
     if (!cleanpath)
         return NULL;
 
     storageDriverLock(driver);
-    for (i = 0; i < driver->pools.count && !ret; i++) {
-        virStoragePoolObjLock(driver->pools.objs[i]);
-        if (virStoragePoolObjIsActive(driver->pools.objs[i])) {
-            virStorageVolDefPtr vol;
-            char *stable_path;
-
-            stable_path = virStorageBackendStablePath(driver->pools.objs[i],
-                                                      cleanpath,
-                                                      false);
-            if (stable_path == NULL) {
-                /* Don't break the whole lookup process if it fails on
-                 * getting the stable path for some of the pools.
-                 */
-                VIR_WARN("Failed to get stable path for pool '%s'",
-                         driver->pools.objs[i]->def->name);
-                virStoragePoolObjUnlock(driver->pools.objs[i]);
-                continue;
-            }
-
-            vol = virStorageVolDefFindByPath(driver->pools.objs[i],
-                                             stable_path);
-            VIR_FREE(stable_path);
 
-            if (vol) {
-                if (virStorageVolLookupByPathEnsureACL(conn, driver->pools.objs[i]->def, vol) < 0) {
-                    virStoragePoolObjUnlock(driver->pools.objs[i]);
-                    goto cleanup;
-                }
+    /* Try the pool this path was last seen in first */
+    if ((poolname = storageDriverVolPathLookup(driver, cleanpath)) &&
+        (pool = virStoragePoolObjFindByName(&driver->pools, poolname))) {
+        rc = storageVolLookupByPathInPool(conn, pool, cleanpath, &ret);
+        virStoragePoolObjUnlock(pool);
+        if (rc < 0)
+            goto cleanup;
+    }
 
-                ret = virGetStorageVol(conn,
-                                       driver->pools.objs[i]->def->name,
-                                       vol->name,
-                                       vol->key,
-                                       NULL, NULL);
-            }
+    for (i = 0; i < driver->pools.count && !ret; i++) {
+        pool = driver->pools.objs[i];
+        virStoragePoolObjLock(pool);
+        if (poolname && STREQ(pool->def->name, poolname)) {
+            virStoragePoolObjUnlock(pool);
+            continue;
         }
-        virStoragePoolObjUnlock(driver->pools.objs[i]);
+
+        rc = storageVolLookupByPathInPool(conn, pool, cleanpath, &ret);
+        if (ret)
+            storageDriverVolPathAdd(driver, pool, cleanpath);
+        virStoragePoolObjUnlock(pool);
+        if (rc < 0)
+            goto cleanup;
     }
 
     if (!ret)
@@ -1490,11 +1628,26 @@ storageVolLookupByPath(virConnectPtr conn,
 
 cleanup:
     VIR_FREE(cleanpath);
+    VIR_FREE(poolname);
     storageDriverUnlock(driver);
     return ret;
 }
 
 
+static int
+storageVolCheckNotWiping(virStorageVolDefPtr vol)
+{
+    if (vol->wiping) {
+        virReportError(VIR_ERR_OPERATION_INVALID,
+                       _("volume '%s' is being wiped."),
+                       vol->name);
+        return -1;
+    }
+
+    return 0;
+}
+
+
 static int
 storageVolDelete(virStorageVolPtr obj,
                  unsigned int flags)
@@ -1503,7 +1656,6 @@ storageVolDelete(virStorageVolPtr obj,
     virStoragePoolObjPtr pool;
     virStorageBackendPtr backend;
     virStorageVolDefPtr vol = NULL;
-    size_t i;
     int ret = -1;
 
     storageDriverLock(driver);
@@ -1545,6 +1697,18 @@ storageVolDelete(virStorageVolPtr obj,
         goto cleanup;
     }
 
+    /* The volume's contents are about to go away anyway, so there
+     * is no point in finishing a wipe; stop it and let the caller
+     * retry once it has */
+    if (vol->wiping) {
+        virAtomicIntSet(&vol->wipeAbort, 1);
+        virReportError(VIR_ERR_OPERATION_INVALID,
+                       _("volume '%s' is being wiped; the wipe has been "
+                         "cancelled, retry once it has stopped"),
+                       vol->name);
+        goto cleanup;
+    }
+
     if (!backend->deleteVol) {
         virReportError(VIR_ERR_NO_SUPPORT,
                        "%s", _("storage pool does not support vol deletion"));
@@ -1559,16 +1723,11 @@ storageVolDelete(virStorageVolPtr obj,
     pool->def->allocation -= vol->allocation;
     pool->def->available += vol->allocation;
 
-    for (i = 0; i < pool->volumes.count; i++) {
-        if (pool->volumes.objs[i] == vol) {
-            VIR_INFO("Deleting volume '%s' from storage pool '%s'",
-                     vol->name, pool->def->name);
-            virStorageVolDefFree(vol);
-
-            VIR_DELETE_ELEMENT(pool->volumes.objs, i, pool->volumes.count);
-            break;
-        }
-    }
+    VIR_INFO("Deleting volume '%s' from storage pool '%s'",
+             vol->name, pool->def->name);
+    storageDriverVolPathRemove(driver, pool, vol->target.path);
+    virStoragePoolObjRemoveVol(pool, vol);
+    virStorageVolDefFree(vol);
     ret = 0;
 
 cleanup:
@@ -1624,10 +1783,6 @@ storageVolCreateXML(virStoragePoolPtr obj,
         goto cleanup;
     }
 
-    if (VIR_REALLOC_N(pool->volumes.objs,
-                      pool->volumes.count+1) < 0)
-        goto cleanup;
-
     if (!backend->createVol) {
         virReportError(VIR_ERR_NO_SUPPORT,
                        "%s", _("storage pool does not support volume "
@@ -1642,13 +1797,16 @@ storageVolCreateXML(virStoragePoolPtr obj,
         goto cleanup;
     }
 
-    pool->volumes.objs[pool->volumes.count++] = voldef;
+    if (virStoragePoolObjAddVol(pool, voldef) < 0)
+        goto cleanup;
+
     volobj = virGetStorageVol(obj->conn, pool->def->name, voldef->name,
                               voldef->key, NULL, NULL);
     if (!volobj) {
-        pool->volumes.count--;
+        virStoragePoolObjRemoveVol(pool, voldef);
         goto cleanup;
     }
+    storageDriverVolPathAdd(driver, pool, voldef->target.path);
 
     if (VIR_ALLOC(buildvoldef) < 0) {
         voldef = NULL;
@@ -1805,12 +1963,11 @@ storageVolCreateXMLFrom(virStoragePoolPtr obj,
         goto cleanup;
     }
 
-    if (backend->refreshVol &&
-        backend->refreshVol(obj->conn, pool, origvol) < 0)
+    if (storageVolCheckNotWiping(origvol) < 0)
         goto cleanup;
 
-    if (VIR_REALLOC_N(pool->volumes.objs,
-                      pool->volumes.count+1) < 0)
+    if (backend->refreshVol &&
+        backend->refreshVol(obj->conn, pool, origvol) < 0)
         goto cleanup;
 
     /* 'Define' the new volume so we get async progress reporting.
@@ -1821,13 +1978,16 @@ storageVolCreateXMLFrom(virStoragePoolPtr obj,
         goto cleanup;
     }
 
-    pool->volumes.objs[pool->volumes.count++] = newvol;
+    if (virStoragePoolObjAddVol(pool, newvol) < 0)
+        goto cleanup;
+
     volobj = virGetStorageVol(obj->conn, pool->def->name, newvol->name,
                               newvol->key, NULL, NULL);
     if (!volobj) {
-        pool->volumes.count--;
+        virStoragePoolObjRemoveVol(pool, newvol);
         goto cleanup;
     }
+    storageDriverVolPathAdd(driver, pool, newvol->target.path);
 
     /* Drop the pool lock during volume allocation */
     pool->asyncjobs++;
@@ -1899,7 +2059,7 @@ storageVolDownload(virStorageVolPtr obj,
     virStorageVolDefPtr vol = NULL;
     int ret = -1;
 
-    virCheckFlags(0, -1);
+    virCheckFlags(VIR_STORAGE_VOL_DOWNLOAD_SPARSE_STREAM, -1);
 
     storageDriverLock(driver);
     pool = virStoragePoolObjFindByName(&driver->pools, obj->pool);
@@ -1937,12 +2097,22 @@ storageVolDownload(virStorageVolPtr obj,
         goto out;
     }
 
-    if (virFDStreamOpenFile(stream,
-                            vol->target.path,
-                            offset, length,
-                            O_RDONLY) < 0)
+    if (storageVolCheckNotWiping(vol) < 0)
         goto out;
 
+    if (flags & VIR_STORAGE_VOL_DOWNLOAD_SPARSE_STREAM) {
+        if (virFDStreamOpenSparseFile(stream,
+                                      vol->target.path,
+                                      offset, length,
+                                      O_RDONLY) < 0)
+            goto out;
+    } else if (virFDStreamOpenFile(stream,
+                                   vol->target.path,
+                                   offset, length,
+                                   O_RDONLY) < 0) {
+        goto out;
+    }
+
     ret = 0;
 
 out:
@@ -1965,7 +2135,7 @@ storageVolUpload(virStorageVolPtr obj,
     virStorageVolDefPtr vol = NULL;
     int ret = -1;
 
-    virCheckFlags(0, -1);
+    virCheckFlags(VIR_STORAGE_VOL_UPLOAD_SPARSE_STREAM, -1);
 
     storageDriverLock(driver);
     pool = virStoragePoolObjFindByName(&driver->pools, obj->pool);
@@ -2003,13 +2173,23 @@ storageVolUpload(virStorageVolPtr obj,
         goto out;
     }
 
+    if (storageVolCheckNotWiping(vol) < 0)
+        goto out;
+
     /* Not using O_CREAT because the file is required to
      * already exist at this point */
-    if (virFDStreamOpenFile(stream,
-                            vol->target.path,
-                            offset, length,
-                            O_WRONLY) < 0)
+    if (flags & VIR_STORAGE_VOL_UPLOAD_SPARSE_STREAM) {
+        if (virFDStreamOpenSparseFile(stream,
+                                      vol->target.path,
+                                      offset, length,
+                                      O_WRONLY) < 0)
+            goto out;
+    } else if (virFDStreamOpenFile(stream,
+                                   vol->target.path,
+                                   offset, length,
+                                   O_WRONLY) < 0) {
         goto out;
+    }
 
     ret = 0;
 
@@ -2075,6 +2255,9 @@ storageVolResize(virStorageVolPtr obj,
         goto out;
     }
 
+    if (storageVolCheckNotWiping(vol) < 0)
+        goto out;
+
     if (flags & VIR_STORAGE_VOL_RESIZE_DELTA) {
         abs_capacity = vol->capacity + capacity;
         flags &= ~VIR_STORAGE_VOL_RESIZE_DELTA;
@@ -2145,7 +2328,7 @@ out:
  * appear as if it were zero-filled.
  */
 static int
-storageVolZeroSparseFile(virStorageVolDefPtr vol,
+storageVolZeroSparseFile(const char *path,
                          off_t size,
                          int fd)
 {
@@ -2156,7 +2339,7 @@ storageVolZeroSparseFile(virStorageVolDefPtr vol,
         virReportSystemError(errno,
                              _("Failed to truncate volume with "
                                "path '%s' to 0 bytes"),
-                             vol->target.path);
+                             path);
         goto out;
     }
 
@@ -2165,7 +2348,7 @@ storageVolZeroSparseFile(virStorageVolDefPtr vol,
         virReportSystemError(errno,
                              _("Failed to truncate volume with "
                                "path '%s' to %ju bytes"),
-                             vol->target.path, (uintmax_t)size);
+                             path, (uintmax_t)size);
     }
 
 out:
@@ -2173,14 +2356,65 @@ out:
 }
 
 
+/* Size of the buffer written out when a volume cannot be zeroed
+ * without writing it */
+#define STORAGE_WIPE_BUFFER_SIZE (1024 * 1024)
+
+/* Amount zeroed per discard/zeroout/fallocate call, so that progress
+ * can be reported and the wipe stopped in between */
+#define STORAGE_WIPE_OFFLOAD_CHUNK (1024ULL * 1024 * 1024)
+
+/* Minimum time between two progress reports, in milliseconds */
+#define STORAGE_WIPE_REPORT_INTERVAL (10 * 1000)
+
+typedef struct _virStorageWipeJob virStorageWipeJob;
+typedef virStorageWipeJob *virStorageWipeJobPtr;
+struct _virStorageWipeJob {
+    const char *path;
+    int *wipeAbort;
+    unsigned long long total;
+    unsigned long long done;
+    unsigned long long lastReport;
+};
+
+/* Account for @bytes more having been wiped. Returns -1 with an
+ * error reported if the wipe has been cancelled meanwhile */
+static int
+storageWipeJobUpdate(virStorageWipeJobPtr job,
+                     unsigned long long bytes)
+{
+    unsigned long long now;
+
+    job->done += bytes;
+
+    if (virAtomicIntGet(job->wipeAbort)) {
+        virReportError(VIR_ERR_OPERATION_ABORTED,
+                       _("wipe of volume '%s' was cancelled after "
+                         "%llu of %llu bytes"),
+                       job->path, job->done, job->total);
+        return -1;
+    }
+
+    if (virTimeMillisNow(&now) == 0 &&
+        now - job->lastReport >= STORAGE_WIPE_REPORT_INTERVAL) {
+        VIR_INFO("Wiped %llu of %llu bytes of volume '%s'",
+                 job->done, job->total, job->path);
+        job->lastReport = now;
+    }
+
+    return 0;
+}
+
+
 static int
-storageWipeExtent(virStorageVolDefPtr vol,
+storageWipeExtent(const char *path,
                   int fd,
                   off_t extent_start,
                   off_t extent_length,
                   char *writebuf,
                   size_t writebuf_length,
-                  size_t *bytes_wiped)
+                  size_t *bytes_wiped,
+                  virStorageWipeJobPtr job)
 {
     int ret = -1, written = 0;
     off_t remaining = 0;
@@ -2189,11 +2423,11 @@ storageWipeExtent(virStorageVolDefPtr vol,
     VIR_DEBUG("extent logical start: %ju len: %ju",
               (uintmax_t)extent_start, (uintmax_t)extent_length);
 
-    if ((ret = lseek(fd, extent_start, SEEK_SET)) < 0) {
+    if (lseek(fd, extent_start, SEEK_SET) < 0) {
         virReportSystemError(errno,
                              _("Failed to seek to position %ju in volume "
                                "with path '%s'"),
-                             (uintmax_t)extent_start, vol->target.path);
+                             (uintmax_t)extent_start, path);
         goto out;
     }
 
@@ -2206,25 +2440,28 @@ storageWipeExtent(virStorageVolDefPtr vol,
             virReportSystemError(errno,
                                  _("Failed to write %zu bytes to "
                                    "storage volume with path '%s'"),
-                                 write_size, vol->target.path);
+                                 write_size, path);
 
             goto out;
         }
 
         *bytes_wiped += written;
         remaining -= written;
+
+        if (storageWipeJobUpdate(job, written) < 0)
+            goto out;
     }
 
     if (fdatasync(fd) < 0) {
         ret = -errno;
         virReportSystemError(errno,
                              _("cannot sync data to volume with path '%s'"),
-                             vol->target.path);
+                             path);
         goto out;
     }
 
     VIR_DEBUG("Wrote %zu bytes to volume with path '%s'",
-              *bytes_wiped, vol->target.path);
+              *bytes_wiped, path);
 
     ret = 0;
 
@@ -2233,8 +2470,127 @@ out:
 }
 
 
+/* Zero the first @length bytes of @fd without writing them, by asking
+ * the block device to discard or zero them, or the filesystem to
+ * convert them to unwritten extents.
+ *
+ * Returns 0 on success, 1 if neither is supported for @fd and the
+ * caller has to write zeroes itself, -1 on error.
+ */
 static int
-storageVolWipeInternal(virStorageVolDefPtr def,
+storageWipeZeroOffload(const char *path,
+                       int fd,
+                       struct stat *st,
+                       off_t length,
+                       virStorageWipeJobPtr job)
+{
+    off_t offset;
+    off_t chunk;
+
+#if defined(BLKZEROOUT) && defined(BLKDISCARD) && defined(BLKDISCARDZEROES)
+    if (S_ISBLK(st->st_mode) && length % 512 == 0) {
+        unsigned int discardZeroes = 0;
+        unsigned long request = BLKZEROOUT;
+        const char *requestName = "BLKZEROOUT";
+
+        /* Discarding is cheaper than zeroing, but only good enough if
+         * the device guarantees that discarded blocks read as zero */
+        if (ioctl(fd, BLKDISCARDZEROES, &discardZeroes) == 0 &&
+            discardZeroes) {
+            request = BLKDISCARD;
+            requestName = "BLKDISCARD";
+        }
+
+        for (offset = 0; offset < length; offset += chunk) {
+            uint64_t range[2];
+
+            chunk = MIN(length - offset, STORAGE_WIPE_OFFLOAD_CHUNK);
+            range[0] = offset;
+            range[1] = chunk;
+
+            if (ioctl(fd, request, range) < 0) {
+                if (offset == 0 &&
+                    (errno == ENOTTY || errno == EOPNOTSUPP ||
+                     errno == EINVAL)) {
+                    VIR_DEBUG("%s not supported for volume '%s'",
+                              requestName, path);
+                    return 1;
+                }
+                virReportSystemError(errno,
+                                     _("%s failed at offset %ju on "
+                                       "volume with path '%s'"),
+                                     requestName, (uintmax_t)offset,
+                                     path);
+                return -1;
+            }
+
+            if (storageWipeJobUpdate(job, chunk) < 0)
+                return -1;
+        }
+
+        VIR_DEBUG("Zeroed %ju bytes of volume '%s' with %s",
+                  (uintmax_t)length, path, requestName);
+        return 0;
+    }
+#endif
+
+#if HAVE_FALLOCATE - 0 && defined(FALLOC_FL_ZERO_RANGE)
+    if (S_ISREG(st->st_mode)) {
+        for (offset = 0; offset < length; offset += chunk) {
+            chunk = MIN(length - offset, STORAGE_WIPE_OFFLOAD_CHUNK);
+
+            if (fallocate(fd, FALLOC_FL_ZERO_RANGE, offset, chunk) < 0) {
+                if (offset == 0 &&
+                    (errno == ENOSYS || errno == EOPNOTSUPP)) {
+                    VIR_DEBUG("FALLOC_FL_ZERO_RANGE not supported for "
+                              "volume '%s'", path);
+                    return 1;
+                }
+                virReportSystemError(errno,
+                                     _("cannot zero range at offset %ju in "
+                                       "volume with path '%s'"),
+                                     (uintmax_t)offset, path);
+                return -1;
+            }
+
+            if (storageWipeJobUpdate(job, chunk) < 0)
+                return -1;
+        }
+
+        if (fdatasync(fd) < 0) {
+            virReportSystemError(errno,
+                                 _("cannot sync data to volume with path '%s'"),
+                                 path);
+            return -1;
+        }
+
+        VIR_DEBUG("Zeroed %ju bytes of volume '%s' with fallocate",
+                  (uintmax_t)length, path);
+        return 0;
+    }
+#endif
+
+    return 1;
+}
+
+
+/**
+ * storageVolWipeInternal:
+ * @path: volume to wipe
+ * @allocation: number of bytes to zero
+ * @wipeAbort: flag to set atomically to stop the wipe
+ * @algorithm: one of virStorageVolWipeAlgorithm
+ *
+ * Wipe the volume at @path. This runs without the pool lock held, so
+ * it must not look at the volume definition; the caller passes in
+ * what is needed instead.
+ *
+ * Returns 0 on success, -1 on error or if the wipe was stopped.
+ */
+int
+storageVolWipeInternal(const char *path,
+                       unsigned long long allocation,
+                       int *wipeAbort,
                        unsigned int algorithm)
 {
     int ret = -1, fd = -1;
@@ -2242,22 +2598,29 @@ storageVolWipeInternal(virStorageVolDefPtr def,
     char *writebuf = NULL;
     size_t bytes_wiped = 0;
     virCommandPtr cmd = NULL;
+    virStorageWipeJob job;
 
     VIR_DEBUG("Wiping volume with path '%s' and algorithm %u",
-              def->target.path, algorithm);
+              path, algorithm);
+
+    memset(&job, 0, sizeof(job));
+    job.path = path;
+    job.wipeAbort = wipeAbort;
+    job.total = allocation;
+    ignore_value(virTimeMillisNow(&job.lastReport));
 
-    fd = open(def->target.path, O_RDWR);
+    fd = open(path, O_RDWR);
     if (fd == -1) {
         virReportSystemError(errno,
                              _("Failed to open storage volume with path '%s'"),
-                             def->target.path);
+                             path);
         goto out;
     }
 
     if (fstat(fd, &st) == -1) {
         virReportSystemError(errno,
                              _("Failed to stat storage volume with path '%s'"),
-                             def->target.path);
+                             path);
         goto out;
     }
 
@@ -2295,7 +2658,7 @@ storageVolWipeInternal(virStorageVolDefPtr def,
         }
         cmd = virCommandNew(SCRUB);
         virCommandAddArgList(cmd, "-f", "-p", alg_char,
-                             def->target.path, NULL);
+                             path, NULL);
 
         if (virCommandRun(cmd, NULL) < 0)
             goto out;
@@ -2304,19 +2667,24 @@ storageVolWipeInternal(virStorageVolDefPtr def,
         goto out;
     } else {
         if (S_ISREG(st.st_mode) && st.st_blocks < (st.st_size / DEV_BSIZE)) {
-            ret = storageVolZeroSparseFile(def, st.st_size, fd);
+            ret = storageVolZeroSparseFile(path, st.st_size, fd);
         } else {
+            ret = storageWipeZeroOffload(path, fd, &st, allocation, &job);
+            if (ret != 1)
+                goto out;
+            ret = -1;
 
-            if (VIR_ALLOC_N(writebuf, st.st_blksize) < 0)
+            if (VIR_ALLOC_N(writebuf, STORAGE_WIPE_BUFFER_SIZE) < 0)
                 goto out;
 
-            ret = storageWipeExtent(def,
+            ret = storageWipeExtent(path,
                                     fd,
                                     0,
-                                    def->allocation,
+                                    allocation,
                                     writebuf,
-                                    st.st_blksize,
-                                    &bytes_wiped);
+                                    STORAGE_WIPE_BUFFER_SIZE,
+                                    &bytes_wiped,
+                                    &job);
         }
     }
 
@@ -2336,7 +2704,10 @@ storageVolWipePattern(virStorageVolPtr obj,
     virStorageDriverStatePtr driver = obj->conn->storagePrivateData;
     virStoragePoolObjPtr pool = NULL;
     virStorageVolDefPtr vol = NULL;
+    char *path = NULL;
+    unsigned long long allocation;
     int ret = -1;
+    int wiperet;
 
     virCheckFlags(0, -1);
 
@@ -2383,13 +2754,40 @@ storageVolWipePattern(virStorageVolPtr obj,
         goto out;
     }
 
-    if (storageVolWipeInternal(vol, algorithm) == -1) {
+    if (storageVolCheckNotWiping(vol) < 0)
+        goto out;
+
+    if (VIR_STRDUP(path, vol->target.path) < 0)
+        goto out;
+    allocation = vol->allocation;
+
+    /* Drop the pool lock while wiping, which can take hours. Being
+     * wiped keeps @vol around, but its definition may only be read
+     * with the pool locked, so the wipe works on copies of what it
+     * needs and only touches the abort flag */
+    pool->asyncjobs++;
+    vol->wiping = 1;
+    vol->wipeAbort = 0;
+    virStoragePoolObjUnlock(pool);
+
+    wiperet = storageVolWipeInternal(path, allocation,
+                                     &vol->wipeAbort, algorithm);
+
+    storageDriverLock(driver);
+    virStoragePoolObjLock(pool);
+    storageDriverUnlock(driver);
+
+    vol->wiping = 0;
+    pool->asyncjobs--;
+
+    if (wiperet == -1) {
         goto out;
     }
 
     ret = 0;
 
 out:
+    VIR_FREE(path);
     if (pool) {
         virStoragePoolObjUnlock(pool);
     }
@@ -1243,10 +1243,6 @@ testOpenVolumesForPool(const char *file,
         if (!def)
             goto error;
 
-        if (VIR_REALLOC_N(pool->volumes.objs,
-                          pool->volumes.count+1) < 0)
-            goto error;
-
         if (def->target.path == NULL) {
             if (virAsprintf(&def->target.path, "%s/%s",
                             pool->def->target.path,
@@ -1257,11 +1253,13 @@ testOpenVolumesForPool(const char *file,
         if (!def->key && VIR_STRDUP(def->key, def->target.path) < 0)
             goto error;
 
+        if (virStoragePoolObjAddVol(pool, def) < 0)
+            goto error;
+
         pool->def->allocation += def->allocation;
         pool->def->available = (pool->def->capacity -
                                 pool->def->allocation);
 
-        pool->volumes.objs[pool->volumes.count++] = def;
         def = NULL;
     }
 
@@ -4278,10 +4276,8 @@ static int testInterfaceChangeRollback(virConnectPtr conn,
     }
 
     virInterfaceObjListFree(&privconn->ifaces);
-    privconn->ifaces.count = privconn->backupIfaces.count;
-    privconn->ifaces.objs = privconn->backupIfaces.objs;
-    privconn->backupIfaces.count = 0;
-    privconn->backupIfaces.objs = NULL;
+    privconn->ifaces = privconn->backupIfaces;
+    memset(&privconn->backupIfaces, 0, sizeof(privconn->backupIfaces));
 
     privconn->transaction_running = false;
 
@@ -5459,10 +5455,6 @@ testStorageVolCreateXML(virStoragePoolPtr pool,
         goto cleanup;
     }
 
-    if (VIR_REALLOC_N(privpool->volumes.objs,
-                      privpool->volumes.count+1) < 0)
-        goto cleanup;
-
     if (virAsprintf(&privvol->target.path, "%s/%s",
                     privpool->def->target.path,
                     privvol->name) == -1)
@@ -5471,12 +5463,13 @@ testStorageVolCreateXML(virStoragePoolPtr pool,
     if (VIR_STRDUP(privvol->key, privvol->target.path) < 0)
         goto cleanup;
 
+    if (virStoragePoolObjAddVol(privpool, privvol) < 0)
+        goto cleanup;
+
     privpool->def->allocation += privvol->allocation;
     privpool->def->available = (privpool->def->capacity -
                                 privpool->def->allocation);
 
-    privpool->volumes.objs[privpool->volumes.count++] = privvol;
-
     ret = virGetStorageVol(pool->conn, privpool->def->name,
                            privvol->name, privvol->key,
                            NULL, NULL);
@@ -5547,10 +5540,6 @@ testStorageVolCreateXMLFrom(virStoragePoolPtr pool,
     privpool->def->available = (privpool->def->capacity -
                                 privpool->def->allocation);
 
-    if (VIR_REALLOC_N(privpool->volumes.objs,
-                      privpool->volumes.count+1) < 0)
-        goto cleanup;
-
     if (virAsprintf(&privvol->target.path, "%s/%s",
                     privpool->def->target.path,
                     privvol->name) == -1)
@@ -5559,12 +5548,13 @@ testStorageVolCreateXMLFrom(virStoragePoolPtr pool,
     if (VIR_STRDUP(privvol->key, privvol->target.path) < 0)
         goto cleanup;
 
+    if (virStoragePoolObjAddVol(privpool, privvol) < 0)
+        goto cleanup;
+
     privpool->def->allocation += privvol->allocation;
     privpool->def->available = (privpool->def->capacity -
                                 privpool->def->allocation);
 
-    privpool->volumes.objs[privpool->volumes.count++] = privvol;
-
     ret = virGetStorageVol(pool->conn, privpool->def->name,
                            privvol->name, privvol->key,
                            NULL, NULL);
@@ -5584,7 +5574,6 @@ testStorageVolDelete(virStorageVolPtr vol,
     testConnPtr privconn = vol->conn->privateData;
     virStoragePoolObjPtr privpool;
     virStorageVolDefPtr privvol;
-    size_t i;
     int ret = -1;
 
     virCheckFlags(0, -1);
@@ -5620,25 +5609,8 @@ testStorageVolDelete(virStorageVolPtr vol,
     privpool->def->available = (privpool->def->capacity -
                                 privpool->def->allocation);
 
-    for (i = 0; i < privpool->volumes.count; i++) {
-        if (privpool->volumes.objs[i] == privvol) {
-            virStorageVolDefFree(privvol);
-
-            if (i < (privpool->volumes.count - 1))
-                memmove(privpool->volumes.objs + i,
-                        privpool->volumes.objs + i + 1,
-                        sizeof(*(privpool->volumes.objs)) *
-                                (privpool->volumes.count - (i + 1)));
-
-            if (VIR_REALLOC_N(privpool->volumes.objs,
-                              privpool->volumes.count - 1) < 0) {
-                ; /* Failure to reduce memory allocation isn't fatal */
-            }
-            privpool->volumes.count--;
-
-            break;
-        }
-    }
+    virStoragePoolObjRemoveVol(privpool, privvol);
+    virStorageVolDefFree(privvol);
     ret = 0;
 
 cleanup:
@@ -5789,6 +5761,94 @@ cleanup:
     return ret;
 }
 
+/* Test volumes have no backing data: downloads produce zeroes and
+ * uploads are discarded, both limited to the volume capacity.  */
+static int
+testStorageVolStream(virStorageVolPtr vol,
+                     virStreamPtr stream,
+                     unsigned long long offset,
+                     unsigned long long length,
+                     bool upload)
+{
+    testConnPtr privconn = vol->conn->privateData;
+    virStoragePoolObjPtr privpool;
+    virStorageVolDefPtr privvol;
+    const char *path;
+    int ret = -1;
+
+    testDriverLock(privconn);
+    privpool = virStoragePoolObjFindByName(&privconn->pools,
+                                           vol->pool);
+    testDriverUnlock(privconn);
+
+    if (privpool == NULL) {
+        virReportError(VIR_ERR_INVALID_ARG, __FUNCTION__);
+        goto cleanup;
+    }
+
+    privvol = virStorageVolDefFindByName(privpool, vol->name);
+
+    if (privvol == NULL) {
+        virReportError(VIR_ERR_NO_STORAGE_VOL,
+                       _("no storage vol with matching name '%s'"),
+                       vol->name);
+        goto cleanup;
+    }
+
+    if (!virStoragePoolObjIsActive(privpool)) {
+        virReportError(VIR_ERR_OPERATION_INVALID,
+                       _("storage pool '%s' is not active"), vol->pool);
+        goto cleanup;
+    }
+
+    if (offset > privvol->capacity) {
+        virReportError(VIR_ERR_INVALID_ARG,
+                       _("offset %llu is beyond the end of volume '%s'"),
+                       offset, vol->name);
+        goto cleanup;
+    }
+
+    if (!length || length > privvol->capacity - offset)
+        length = privvol->capacity - offset;
+
+    /* Reading /dev/null gives an empty stream once nothing is left */
+    path = upload || !length ? "/dev/null" : "/dev/zero";
+    if (virFDStreamOpenFile(stream, path, 0, length,
+                            upload ? O_WRONLY : O_RDONLY) < 0)
+        goto cleanup;
+
+    ret = 0;
+
+cleanup:
+    if (privpool)
+        virStoragePoolObjUnlock(privpool);
+    return ret;
+}
+
+static int
+testStorageVolDownload(virStorageVolPtr vol,
+                       virStreamPtr stream,
+                       unsigned long long offset,
+                       unsigned long long length,
+                       unsigned int flags)
+{
+    virCheckFlags(0, -1);
+
+    return testStorageVolStream(vol, stream, offset, length, false);
+}
+
+static int
+testStorageVolUpload(virStorageVolPtr vol,
+                     virStreamPtr stream,
+                     unsigned long long offset,
+                     unsigned long long length,
+                     unsigned int flags)
+{
+    virCheckFlags(0, -1);
+
+    return testStorageVolStream(vol, stream, offset, length, true);
+}
+
 
 /* Node device implementations */
 static virDrvOpenStatus testNodeDeviceOpen(virConnectPtr conn,
@@ -6960,10 +7020,7 @@ cleanup:
                 vm->current_snapshot = snap;
             other = virDomainSnapshotFindByName(vm->snapshots,
                                                 snap->def->parent);
-            snap->parent = other;
-            other->nchildren++;
-            snap->sibling = other->first_child;
-            other->first_child = snap;
+            virDomainSnapshotSetParent(snap, other);
         }
         virObjectUnlock(vm);
     }
@@ -7003,7 +7060,6 @@ struct _testSnapReparentData {
     virDomainSnapshotObjPtr parent;
     virDomainObjPtr vm;
     int err;
-    virDomainSnapshotObjPtr last;
 };
 
 static void
@@ -7019,16 +7075,12 @@ testDomainSnapshotReparentChildren(void *payload,
     }
 
     VIR_FREE(snap->def->parent);
-    snap->parent = rep->parent;
 
     if (rep->parent->def &&
         VIR_STRDUP(snap->def->parent, rep->parent->def->name) < 0) {
         rep->err = -1;
         return;
     }
-
-    if (!snap->sibling)
-        rep->last = snap;
 }
 
 static int
@@ -7068,7 +7120,6 @@ testDomainSnapshotDelete(virDomainSnapshotPtr snapshot,
         rep.parent = snap->parent;
         rep.vm = vm;
         rep.err = 0;
-        rep.last = NULL;
         virDomainSnapshotForEachChild(snap,
                                       testDomainSnapshotReparentChildren,
                                       &rep);
@@ -7076,9 +7127,7 @@ testDomainSnapshotDelete(virDomainSnapshotPtr snapshot,
             goto cleanup;
 
         /* Can't modify siblings during ForEachChild, so do it now.  */
-        snap->parent->nchildren += snap->nchildren;
-        rep.last->sibling = snap->parent->first_child;
-        snap->parent->first_child = snap->first_child;
+        virDomainSnapshotMoveChildren(snap, snap->parent);
     }
 
     if (flags & VIR_DOMAIN_SNAPSHOT_DELETE_CHILDREN_ONLY) {
@@ -7510,6 +7559,8 @@ static virStorageDriver testStorageDriver = {
     .storageVolGetInfo = testStorageVolGetInfo, /* 0.5.0 */
     .storageVolGetXMLDesc = testStorageVolGetXMLDesc, /* 0.5.0 */
     .storageVolGetPath = testStorageVolGetPath, /* 0.5.0 */
+    .storageVolDownload = testStorageVolDownload, /* 1.2.3 */
+    .storageVolUpload = testStorageVolUpload, /* 1.2.3 */
     .storagePoolIsActive = testStoragePoolIsActive, /* 0.7.3 */
     .storagePoolIsPersistent = testStoragePoolIsPersistent, /* 0.7.3 */
 };
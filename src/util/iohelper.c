@@ -23,6 +23,7 @@
  *   - Read existing file
  *   - Write existing file
  *   - Create & write new file
+ *   - Sparse read & write, framed as described in fdstream.h
  */
 
 #include <config.h>
@@ -41,6 +42,7 @@
 #include "configmake.h"
 #include "virrandom.h"
 #include "virstring.h"
+#include "fdstream.h"
 
 #define VIR_FROM_THIS VIR_FROM_STORAGE
 
@@ -73,8 +75,134 @@ cleanup:
     return fd;
 }
 
+/* Copy @fd to stdout, sending holes found in it as such rather
+ * than as zeroes */
 static int
-runIO(const char *path, int fd, int oflags, unsigned long long length)
+runIOSparseRead(const char *path, int fd, char *buf, size_t buflen,
+                unsigned long long length)
+{
+    virFDStreamSparseHeader hdr;
+    unsigned long long total = 0;
+    unsigned long long section;
+    bool inData;
+    ssize_t got;
+
+    memset(&hdr, 0, sizeof(hdr));
+
+    while (!length || total < length) {
+        if (virFileInData(fd, &inData, &section) < 0) {
+            virReportSystemError(errno, _("Unable to find data in %s"),
+                                 path);
+            return -1;
+        }
+        if (section == 0)
+            break; /* End of file */
+
+        if (length && (length - total) < section)
+            section = length - total;
+
+        if (!inData) {
+            hdr.type = VIR_FDSTREAM_SPARSE_HOLE;
+            hdr.length = section;
+            if (safewrite(STDOUT_FILENO, &hdr, sizeof(hdr)) < 0) {
+                virReportSystemError(errno, "%s", _("Unable to write stdout"));
+                return -1;
+            }
+            if (lseek(fd, section, SEEK_CUR) < 0) {
+                virReportSystemError(errno, _("Unable to seek %s"), path);
+                return -1;
+            }
+            total += section;
+            continue;
+        }
+
+        while (section) {
+            if ((got = saferead(fd, buf, MIN(buflen, section))) < 0) {
+                virReportSystemError(errno, _("Unable to read %s"), path);
+                return -1;
+            }
+            if (got == 0)
+                return 0; /* File shrunk under us */
+
+            hdr.type = VIR_FDSTREAM_SPARSE_DATA;
+            hdr.length = got;
+            if (safewrite(STDOUT_FILENO, &hdr, sizeof(hdr)) < 0 ||
+                safewrite(STDOUT_FILENO, buf, got) < 0) {
+                virReportSystemError(errno, "%s", _("Unable to write stdout"));
+                return -1;
+            }
+            section -= got;
+            total += got;
+        }
+    }
+
+    return 0;
+}
+
+/* Copy stdin to @fd, punching out the holes it tells about */
+static int
+runIOSparseWrite(const char *path, int fd, char *buf, size_t buflen)
+{
+    virFDStreamSparseHeader hdr;
+    unsigned long long remaining;
+    ssize_t got;
+
+    while (1) {
+        if ((got = saferead(STDIN_FILENO, &hdr, sizeof(hdr))) < 0) {
+            virReportSystemError(errno, "%s", _("Unable to read stdin"));
+            return -1;
+        }
+        if (got == 0)
+            break; /* End of stream */
+        if (got != sizeof(hdr))
+            goto truncated;
+
+        switch ((virFDStreamSparseType) hdr.type) {
+        case VIR_FDSTREAM_SPARSE_DATA:
+            remaining = hdr.length;
+            while (remaining) {
+                if ((got = saferead(STDIN_FILENO, buf,
+                                    MIN(buflen, remaining))) < 0) {
+                    virReportSystemError(errno, "%s",
+                                         _("Unable to read stdin"));
+                    return -1;
+                }
+                if (got == 0)
+                    goto truncated;
+                if (safewrite(fd, buf, got) < 0) {
+                    virReportSystemError(errno, _("Unable to write %s"), path);
+                    return -1;
+                }
+                remaining -= got;
+            }
+            break;
+
+        case VIR_FDSTREAM_SPARSE_HOLE:
+            if (virFileWriteHole(fd, hdr.length) < 0) {
+                virReportSystemError(errno, _("Unable to write hole to %s"),
+                                     path);
+                return -1;
+            }
+            break;
+
+        default:
+            virReportError(VIR_ERR_INTERNAL_ERROR,
+                           _("Unknown sparse stream chunk type %u"), hdr.type);
+            return -1;
+        }
+    }
+
+    return 0;
+
+truncated:
+    virReportError(VIR_ERR_INTERNAL_ERROR, "%s",
+                   _("Sparse stream on stdin is truncated"));
+    return -1;
+}
+
+static int
+runIO(const char *path, int fd, int oflags, unsigned long long length,
+      bool sparse)
 {
     void *base = NULL; /* Location to be freed */
     char *buf = NULL; /* Aligned location within base */
@@ -137,44 +265,60 @@ runIO(const char *path, int fd, int oflags, unsigned long long length)
         goto cleanup;
     }
 
-    while (1) {
-        ssize_t got;
+    if (sparse) {
+        if (direct) {
+            virReportSystemError(EINVAL, "%s",
+                                 _("O_DIRECT is not supported with sparse "
+                                   "streams"));
+            goto cleanup;
+        }
+        if (fdin == fd) {
+            if (runIOSparseRead(path, fd, buf, buflen, length) < 0)
+                goto cleanup;
+        } else {
+            if (runIOSparseWrite(path, fd, buf, buflen) < 0)
+                goto cleanup;
+        }
+    } else {
+        while (1) {
+            ssize_t got;
 
-        if (length &&
-            (length - total) < buflen)
-            buflen = length - total;
+            if (length &&
+                (length - total) < buflen)
+                buflen = length - total;
 
-        if (buflen == 0)
-            break; /* End of requested data from client */
+            if (buflen == 0)
+                break; /* End of requested data from client */
 
-        if ((got = saferead(fdin, buf, buflen)) < 0) {
-            virReportSystemError(errno, _("Unable to read %s"), fdinname);
-            goto cleanup;
-        }
-        if (got == 0)
-            break; /* End of file before end of requested data */
-        if (got < buflen || (buflen & alignMask)) {
-            /* O_DIRECT can handle at most one short read, at end of file */
-            if (direct && shortRead) {
-                virReportSystemError(EINVAL, "%s",
-                                     _("Too many short reads for O_DIRECT"));
+            if ((got = saferead(fdin, buf, buflen)) < 0) {
+                virReportSystemError(errno, _("Unable to read %s"), fdinname);
+                goto cleanup;
+            }
+            if (got == 0)
+                break; /* End of file before end of requested data */
+            if (got < buflen || (buflen & alignMask)) {
+                /* O_DIRECT can handle at most one short read, at end of file */
+                if (direct && shortRead) {
+                    virReportSystemError(EINVAL, "%s",
+                                         _("Too many short reads for O_DIRECT"));
+                }
+                shortRead = true;
             }
-            shortRead = true;
-        }
 
-        total += got;
-        if (fdout == fd && direct && shortRead) {
-            end = total;
-            memset(buf + got, 0, buflen - got);
-            got = (got + alignMask) & ~alignMask;
-        }
-        if (safewrite(fdout, buf, got) < 0) {
-            virReportSystemError(errno, _("Unable to write %s"), fdoutname);
-            goto cleanup;
-        }
-        if (end && ftruncate(fd, end) < 0) {
-            virReportSystemError(errno, _("Unable to truncate %s"), fdoutname);
-            goto cleanup;
+            total += got;
+            if (fdout == fd && direct && shortRead) {
+                end = total;
+                memset(buf + got, 0, buflen - got);
+                got = (got + alignMask) & ~alignMask;
+            }
+            if (safewrite(fdout, buf, got) < 0) {
+                virReportSystemError(errno, _("Unable to write %s"), fdoutname);
+                goto cleanup;
+            }
+            if (end && ftruncate(fd, end) < 0) {
+                virReportSystemError(errno, _("Unable to truncate %s"), fdoutname);
+                goto cleanup;
+            }
         }
     }
 
@@ -209,7 +353,7 @@ usage(int status)
         fprintf(stderr, _("%s: try --help for more details"), program_name);
     } else {
         printf(_("Usage: %s FILENAME OFLAGS MODE OFFSET LENGTH DELETE\n"
-                 "   or: %s FILENAME LENGTH FD\n"),
+                 "   or: %s FILENAME LENGTH FD [--sparse]\n"),
                program_name, program_name);
     }
     exit(status);
@@ -227,6 +371,7 @@ main(int argc, char **argv)
     unsigned int delete = 0;
     int fd = -1;
     int lengthIndex = 0;
+    bool sparse = false;
 
     program_name = argv[0];
 
@@ -270,13 +415,18 @@ main(int argc, char **argv)
             exit(EXIT_FAILURE);
         }
         fd = prepare(path, oflags, mode, offset);
-    } else if (argc == 4) { /* FILENAME LENGTH FD */
+    } else if (argc == 4 || argc == 5) { /* FILENAME LENGTH FD [--sparse] */
         lengthIndex = 2;
         if (virStrToLong_i(argv[3], NULL, 10, &fd) < 0) {
             fprintf(stderr, _("%s: malformed fd %s"),
                     program_name, argv[3]);
             exit(EXIT_FAILURE);
         }
+        if (argc == 5) {
+            if (STRNEQ(argv[4], "--sparse"))
+                usage(EXIT_FAILURE);
+            sparse = true;
+        }
 #ifdef F_GETFL
         oflags = fcntl(fd, F_GETFL);
 #else
@@ -301,7 +451,7 @@ main(int argc, char **argv)
         exit(EXIT_FAILURE);
     }
 
-    if (fd < 0 || runIO(path, fd, oflags, length) < 0)
+    if (fd < 0 || runIO(path, fd, oflags, length, sparse) < 0)
         goto error;
 
     if (delete)
@@ -33,6 +33,8 @@
 #include "virbuffer.h"
 #include "viralloc.h"
 
+/* Initial allocation of a buffer; it doubles from there on */
+#define VIR_BUFFER_MIN_SIZE 1024
 
 /* If adding more fields, ensure to edit buf.h to match
    the number of fields */
@@ -109,14 +111,16 @@ virBufferGetIndent(const virBuffer *buf, bool dynamic)
  * @buf: the buffer
  * @len: the minimum free size to allocate on top of existing used space
  *
- * Grow the available space of a buffer to at least @len bytes.
+ * Grow the available space of a buffer to at least @len bytes.  The
+ * allocation is doubled until it is large enough, so building a string
+ * of N bytes piecewise costs O(log N) reallocations.
  *
  * Returns zero on success or -1 on error
  */
 static int
 virBufferGrow(virBufferPtr buf, unsigned int len)
 {
-    int size;
+    unsigned int size;
 
     if (buf->error)
         return -1;
@@ -124,7 +128,19 @@ virBufferGrow(virBufferPtr buf, unsigned int len)
     if ((len + buf->use) < buf->size)
         return 0;
 
-    size = buf->use + len + 1000;
+    if (len >= UINT_MAX - buf->use) {
+        virBufferSetError(buf, ENOMEM);
+        return -1;
+    }
+
+    size = buf->size ? buf->size : VIR_BUFFER_MIN_SIZE;
+    while (size <= buf->use + len) {
+        if (size > UINT_MAX / 2) {
+            size = buf->use + len + 1;
+            break;
+        }
+        size *= 2;
+    }
 
     if (VIR_REALLOC_N_QUIET(buf->content, size) < 0) {
         virBufferSetError(buf, errno);
@@ -171,6 +187,46 @@ virBufferAdd(virBufferPtr buf, const char *str, int len)
     buf->content[buf->use] = '\0';
 }
 
+/**
+ * virBufferAddRaw:
+ * @buf: the buffer to append to
+ * @str: the string
+ * @len: the number of bytes to add
+ *
+ * Add a string range to a buffer without applying auto indentation.
+ */
+static void
+virBufferAddRaw(virBufferPtr buf, const char *str, size_t len)
+{
+    if (len == 0)
+        return;
+
+    if (len >= UINT_MAX || virBufferGrow(buf, len + 1) < 0)
+        return;
+
+    memcpy(&buf->content[buf->use], str, len);
+    buf->use += len;
+    buf->content[buf->use] = '\0';
+}
+
+/**
+ * virBufferReserve:
+ * @buf: the buffer
+ * @len: the number of bytes expected to be added
+ *
+ * Make sure that at least @len more bytes can be added to @buf without
+ * reallocating it.  Formatters that have a good idea of the size of
+ * their output can use this to size the buffer upfront.
+ */
+void
+virBufferReserve(virBufferPtr buf, unsigned int len)
+{
+    if (!buf)
+        return;
+
+    ignore_value(virBufferGrow(buf, len));
+}
+
 /**
  * virBufferAddChar:
  * @buf: the buffer to append to
@@ -352,29 +408,23 @@ virBufferVasprintf(virBufferPtr buf, const char *format, va_list argptr)
 }
 
 /**
- * virBufferEscapeString:
+ * virBufferEscapeStringFormat:
  * @buf: the buffer to append to
  * @format: a printf like format string but with only one %s parameter
  * @str: the string argument which needs to be escaped
  *
- * Do a formatted print with a single string to an XML buffer. The
- * string is escaped for use in XML.  If @str is NULL, nothing is
- * added (not even the rest of @format).  Auto indentation may be
- * applied.
+ * Slow path of virBufferEscapeString for formats that
+ * virBufferSplitFormat cannot handle: the string is escaped into a
+ * temporary copy which is then formatted into the buffer.
  */
-void
-virBufferEscapeString(virBufferPtr buf, const char *format, const char *str)
+static void
+virBufferEscapeStringFormat(virBufferPtr buf, const char *format,
+                            const char *str)
 {
     int len;
     char *escaped, *out;
     const char *cur;
 
-    if ((format == NULL) || (buf == NULL) || (str == NULL))
-        return;
-
-    if (buf->error)
-        return;
-
     len = strlen(str);
     if (strcspn(str, "<>&'\"") == len) {
         virBufferAsprintf(buf, format, str);
@@ -438,6 +488,133 @@ virBufferEscapeString(virBufferPtr buf, const char *format, const char *str)
     VIR_FREE(escaped);
 }
 
+/**
+ * virBufferSplitFormat:
+ * @format: a printf like format string
+ * @prefixlen: set to the length of @format before the "%s"
+ * @suffix: set to the part of @format after the "%s"
+ *
+ * Check whether @format consists of a single "%s" surrounded by
+ * literal text, in which case the escaping functions can write the
+ * escaped string straight into the buffer.
+ *
+ * Returns true if @format can be split, false otherwise.
+ */
+static bool
+virBufferSplitFormat(const char *format,
+                     size_t *prefixlen,
+                     const char **suffix)
+{
+    const char *conv = strchr(format, '%');
+
+    if (!conv || conv[1] != 's' || strchr(conv + 2, '%'))
+        return false;
+
+    *prefixlen = conv - format;
+    *suffix = conv + 2;
+    return true;
+}
+
+/**
+ * virBufferEscapeString:
+ * @buf: the buffer to append to
+ * @format: a printf like format string but with only one %s parameter
+ * @str: the string argument which needs to be escaped
+ *
+ * Do a formatted print with a single string to an XML buffer. The
+ * string is escaped for use in XML.  If @str is NULL, nothing is
+ * added (not even the rest of @format).  Auto indentation may be
+ * applied.
+ */
+void
+virBufferEscapeString(virBufferPtr buf, const char *format, const char *str)
+{
+    size_t len, prefixlen;
+    const char *suffix;
+    const char *cur;
+    char *out;
+
+    if ((format == NULL) || (buf == NULL) || (str == NULL))
+        return;
+
+    if (buf->error)
+        return;
+
+    if (!virBufferSplitFormat(format, &prefixlen, &suffix)) {
+        virBufferEscapeStringFormat(buf, format, str);
+        return;
+    }
+
+    virBufferAdd(buf, format, prefixlen); /* auto-indent */
+
+    len = strlen(str);
+    if (strcspn(str, "<>&'\"") == len) {
+        virBufferAddRaw(buf, str, len);
+        virBufferAddRaw(buf, suffix, strlen(suffix));
+        return;
+    }
+
+    /* size the escaped string first so that it can be written in place */
+    len = 0;
+    for (cur = str; *cur != 0; cur++) {
+        switch (*cur) {
+        case '<':
+        case '>':
+            len += 4;
+            break;
+        case '&':
+            len += 5;
+            break;
+        case '"':
+        case '\'':
+            len += 6;
+            break;
+        default:
+            if (((unsigned char)*cur >= 0x20) || (*cur == '\n') ||
+                (*cur == '\t') || (*cur == '\r'))
+                len++;
+        }
+    }
+
+    if (len >= UINT_MAX || virBufferGrow(buf, len + 1) < 0)
+        return;
+
+    out = &buf->content[buf->use];
+    for (cur = str; *cur != 0; cur++) {
+        switch (*cur) {
+        case '<':
+            memcpy(out, "&lt;", 4);
+            out += 4;
+            break;
+        case '>':
+            memcpy(out, "&gt;", 4);
+            out += 4;
+            break;
+        case '&':
+            memcpy(out, "&amp;", 5);
+            out += 5;
+            break;
+        case '"':
+            memcpy(out, "&quot;", 6);
+            out += 6;
+            break;
+        case '\'':
+            memcpy(out, "&apos;", 6);
+            out += 6;
+            break;
+        default:
+            /* see virBufferEscapeStringFormat about non-ASCII input */
+            if (((unsigned char)*cur >= 0x20) || (*cur == '\n') ||
+                (*cur == '\t') || (*cur == '\r'))
+                *out++ = *cur;
+        }
+    }
+    buf->use += len;
+    buf->content[buf->use] = '\0';
+
+    virBufferAddRaw(buf, suffix, strlen(suffix));
+}
+
 /**
  * virBufferEscapeSexpr:
  * @buf: the buffer to append to
@@ -483,6 +660,8 @@ virBufferEscape(virBufferPtr buf, char escape, const char *toescape,
                 const char *format, const char *str)
 {
     int len;
+    size_t prefixlen;
+    const char *suffix;
     char *escaped, *out;
     const char *cur;
 
@@ -493,6 +672,33 @@ virBufferEscape(virBufferPtr buf, char escape, const char *toescape,
         return;
 
     len = strlen(str);
+    if (virBufferSplitFormat(format, &prefixlen, &suffix)) {
+        size_t nescape = 0;
+
+        virBufferAdd(buf, format, prefixlen); /* auto-indent */
+
+        for (cur = str; *cur != 0; cur++) {
+            if (strchr(toescape, *cur))
+                nescape++;
+        }
+
+        if (nescape >= UINT_MAX - len ||
+            virBufferGrow(buf, len + nescape + 1) < 0)
+            return;
+
+        out = &buf->content[buf->use];
+        for (cur = str; *cur != 0; cur++) {
+            if (strchr(toescape, *cur))
+                *out++ = escape;
+            *out++ = *cur;
+        }
+        buf->use += len + nescape;
+        buf->content[buf->use] = '\0';
+
+        virBufferAddRaw(buf, suffix, strlen(suffix));
+        return;
+    }
+
     if (strcspn(str, toescape) == len) {
         virBufferAsprintf(buf, format, str);
         return;
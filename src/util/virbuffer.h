@@ -54,6 +54,7 @@ char *virBufferContentAndReset(virBufferPtr buf);
 void virBufferFreeAndReset(virBufferPtr buf);
 int virBufferError(const virBuffer *buf);
 unsigned int virBufferUse(const virBuffer *buf);
+void virBufferReserve(virBufferPtr buf, unsigned int len);
 void virBufferAdd(virBufferPtr buf, const char *str, int len);
 void virBufferAddChar(virBufferPtr buf, char c);
 void virBufferAsprintf(virBufferPtr buf, const char *format, ...)
@@ -49,6 +49,7 @@
 #include "virfile.h"
 #include "virhash.h"
 #include "virhashcode.h"
+#include "viratomic.h"
 #include "virstring.h"
 #include "virsystemd.h"
 #include "virtypedparam.h"
@@ -825,6 +826,152 @@ cleanup:
 }
 
 
+/* Large enough for all statistics files of a typical domain,
+ * bigger files are read through virCgroupGetValueStr instead */
+# define VIR_CGROUP_STAT_BUFSIZE 2048
+
+static const struct {
+    int controller;
+    const char *key;
+} virCgroupStatFiles[] = {
+    { VIR_CGROUP_CONTROLLER_CPUACCT, "cpuacct.usage" },
+    { VIR_CGROUP_CONTROLLER_CPUACCT, "cpuacct.usage_percpu" },
+    { VIR_CGROUP_CONTROLLER_CPUACCT, "cpuacct.stat" },
+    { VIR_CGROUP_CONTROLLER_MEMORY, "memory.usage_in_bytes" },
+    { VIR_CGROUP_CONTROLLER_BLKIO, "blkio.throttle.io_service_bytes" },
+    { VIR_CGROUP_CONTROLLER_BLKIO, "blkio.throttle.io_serviced" },
+};
+verify(ARRAY_CARDINALITY(virCgroupStatFiles) == VIR_CGROUP_STAT_FILE_LAST);
+
+
+static void
+virCgroupStatFilesClose(virCgroupPtr group)
+{
+    size_t i;
+
+    for (i = 0; i < VIR_CGROUP_STAT_FILE_LAST; i++)
+        VIR_FORCE_CLOSE(group->statfds[i]);
+}
+
+
+/*
+ * Return a file descriptor for the statistics @file of @group,
+ * opening it on first use. Statistics are polled for every
+ * domain over and over again, so keeping the files open saves
+ * building the path and an open/close pair on each read. The
+ * kernel regenerates the content on every read from offset 0.
+ */
+static int
+virCgroupStatFileOpen(virCgroupPtr group,
+                      virCgroupStatFile file)
+{
+    char *keypath = NULL;
+    int fd;
+
+    if ((fd = virAtomicIntGet(&group->statfds[file])) >= 0)
+        return fd;
+
+    if (virCgroupPathOfController(group,
+                                  virCgroupStatFiles[file].controller,
+                                  virCgroupStatFiles[file].key,
+                                  &keypath) < 0)
+        return -1;
+
+    VIR_DEBUG("Open stats file %s", keypath);
+
+    if ((fd = open(keypath, O_RDONLY | O_CLOEXEC)) < 0) {
+        virReportSystemError(errno,
+                             _("Unable to read from '%s'"), keypath);
+        VIR_FREE(keypath);
+        return -1;
+    }
+    VIR_FREE(keypath);
+
+    /* Concurrent queries of the same group may race us here */
+    if (!virAtomicIntCompareExchange(&group->statfds[file], -1, fd)) {
+        VIR_FORCE_CLOSE(fd);
+        fd = virAtomicIntGet(&group->statfds[file]);
+    }
+
+    return fd;
+}
+
+
+/*
+ * Read the statistics @file of @group into @buf of @buflen
+ * bytes, stripping the trailing newline. If the content does
+ * not fit, it is read into a newly allocated string stored in
+ * @alloc instead, which the caller must free.
+ *
+ * Returns pointer to the content, or NULL on error
+ */
+static char *
+virCgroupStatFileRead(virCgroupPtr group,
+                      virCgroupStatFile file,
+                      char *buf,
+                      size_t buflen,
+                      char **alloc)
+{
+    ssize_t got;
+    int fd;
+
+    *alloc = NULL;
+
+    if ((fd = virCgroupStatFileOpen(group, file)) < 0)
+        return NULL;
+
+    if ((got = pread(fd, buf, buflen, 0)) < 0) {
+        virReportSystemError(errno,
+                             _("Unable to read from '%s'"),
+                             virCgroupStatFiles[file].key);
+        return NULL;
+    }
+
+    if (got == buflen) {
+        if (virCgroupGetValueStr(group,
+                                 virCgroupStatFiles[file].controller,
+                                 virCgroupStatFiles[file].key,
+                                 alloc) < 0)
+            return NULL;
+        return *alloc;
+    }
+
+    if (got > 0 && buf[got - 1] == '\n')
+        got--;
+    buf[got] = '\0';
+
+    return buf;
+}
+
+
+static int
+virCgroupStatFileReadU64(virCgroupPtr group,
+                         virCgroupStatFile file,
+                         unsigned long long *value)
+{
+    char buf[64];
+    char *alloc = NULL;
+    char *str;
+    int ret = -1;
+
+    if (!(str = virCgroupStatFileRead(group, file, buf, sizeof(buf), &alloc)))
+        goto cleanup;
+
+    if (virStrToLong_ull(str, NULL, 10, value) < 0) {
+        virReportError(VIR_ERR_INTERNAL_ERROR,
+                       _("Unable to parse '%s' as an integer"),
+                       str);
+        goto cleanup;
+    }
+
+    ret = 0;
+
+cleanup:
+    VIR_FREE(alloc);
+    return ret;
+}
+
+
 static int
 virCgroupCpuSetInherit(virCgroupPtr parent, virCgroupPtr group)
 {
@@ -998,6 +1145,8 @@ virCgroupNew(pid_t pid,
              int controllers,
              virCgroupPtr *group)
 {
+    size_t i;
+
     VIR_DEBUG("parent=%p path=%s controllers=%d",
               parent, path, controllers);
     *group = NULL;
@@ -1005,6 +1154,9 @@ virCgroupNew(pid_t pid,
     if (VIR_ALLOC((*group)) < 0)
         goto error;
 
+    for (i = 0; i < VIR_CGROUP_STAT_FILE_LAST; i++)
+        (*group)->statfds[i] = -1;
+
     if (path[0] == '/' || !parent) {
         if (VIR_STRDUP((*group)->path, path) < 0)
             goto error;
@@ -1709,6 +1861,8 @@ virCgroupFree(virCgroupPtr *group)
     if (*group == NULL)
         return;
 
+    virCgroupStatFilesClose(*group);
+
     for (i = 0; i < VIR_CGROUP_CONTROLLER_LAST; i++) {
         VIR_FREE((*group)->controllers[i].mountPoint);
         VIR_FREE((*group)->controllers[i].linkPoint);
@@ -1791,6 +1945,56 @@ virCgroupPathOfController(virCgroupPtr group,
 }
 
 
+/*
+ * Sum up the values of all lines of blkio statistics @str
+ * which are of type @name, e.g. "8:0 Read 1234". @bytes says
+ * whether @str holds byte or request counts.
+ */
+static int
+virCgroupParseBlkioSum(char *str,
+                       const char *name,
+                       bool bytes,
+                       long long *sum)
+{
+    long long stats_val;
+    char *p = str;
+
+    *sum = 0;
+
+    while ((p = strstr(p, name))) {
+        p += strlen(name);
+        if (virStrToLong_ll(p, &p, 10, &stats_val) < 0) {
+            if (bytes)
+                virReportError(VIR_ERR_INTERNAL_ERROR,
+                               _("Cannot parse byte %sstat '%s'"),
+                               name, p);
+            else
+                virReportError(VIR_ERR_INTERNAL_ERROR,
+                               _("Cannot parse %srequest stat '%s'"),
+                               name, p);
+            return -1;
+        }
+
+        if (stats_val < 0 ||
+            (stats_val > 0 && *sum > (LLONG_MAX - stats_val)))
+        {
+            if (bytes)
+                virReportError(VIR_ERR_OVERFLOW,
+                               _("Sum of byte %sstat overflows"),
+                               name);
+            else
+                virReportError(VIR_ERR_OVERFLOW,
+                               _("Sum of %srequest stat overflows"),
+                               name);
+            return -1;
+        }
+        *sum += stats_val;
+    }
+
+    return 0;
+}
+
+
 /**
  * virCgroupGetBlkioIoServiced:
  *
@@ -1809,92 +2013,40 @@ virCgroupGetBlkioIoServiced(virCgroupPtr group,
                             long long *requests_read,
                             long long *requests_write)
 {
-    long long stats_val;
-    char *str1 = NULL, *str2 = NULL, *p1, *p2;
-    size_t i;
+    char buf[VIR_CGROUP_STAT_BUFSIZE];
+    char *alloc = NULL;
+    char *str;
     int ret = -1;
 
-    const char *value_names[] = {
-        "Read ",
-        "Write "
-    };
-    long long *bytes_ptrs[] = {
-        bytes_read,
-        bytes_write
-    };
-    long long *requests_ptrs[] = {
-        requests_read,
-        requests_write
-    };
-
     *bytes_read = 0;
     *bytes_write = 0;
     *requests_read = 0;
     *requests_write = 0;
 
-    if (virCgroupGetValueStr(group,
-                             VIR_CGROUP_CONTROLLER_BLKIO,
-                             "blkio.throttle.io_service_bytes", &str1) < 0)
+    /* sum up all entries of the same kind, from all devices */
+    if (!(str = virCgroupStatFileRead(group,
+                                      VIR_CGROUP_STAT_FILE_BLKIO_SERVICE_BYTES,
+                                      buf, sizeof(buf), &alloc)))
         goto cleanup;
 
-    if (virCgroupGetValueStr(group,
-                             VIR_CGROUP_CONTROLLER_BLKIO,
-                             "blkio.throttle.io_serviced", &str2) < 0)
+    if (virCgroupParseBlkioSum(str, "Read ", true, bytes_read) < 0 ||
+        virCgroupParseBlkioSum(str, "Write ", true, bytes_write) < 0)
         goto cleanup;
 
-    /* sum up all entries of the same kind, from all devices */
-    for (i = 0; i < ARRAY_CARDINALITY(value_names); i++) {
-        p1 = str1;
-        p2 = str2;
-
-        while ((p1 = strstr(p1, value_names[i]))) {
-            p1 += strlen(value_names[i]);
-            if (virStrToLong_ll(p1, &p1, 10, &stats_val) < 0) {
-                virReportError(VIR_ERR_INTERNAL_ERROR,
-                               _("Cannot parse byte %sstat '%s'"),
-                               value_names[i],
-                               p1);
-                goto cleanup;
-            }
-
-            if (stats_val < 0 ||
-                (stats_val > 0 && *bytes_ptrs[i] > (LLONG_MAX - stats_val)))
-            {
-                virReportError(VIR_ERR_OVERFLOW,
-                               _("Sum of byte %sstat overflows"),
-                               value_names[i]);
-                goto cleanup;
-            }
-            *bytes_ptrs[i] += stats_val;
-        }
-
-        while ((p2 = strstr(p2, value_names[i]))) {
-            p2 += strlen(value_names[i]);
-            if (virStrToLong_ll(p2, &p2, 10, &stats_val) < 0) {
-                virReportError(VIR_ERR_INTERNAL_ERROR,
-                               _("Cannot parse %srequest stat '%s'"),
-                               value_names[i],
-                               p2);
-                goto cleanup;
-            }
+    VIR_FREE(alloc);
+    if (!(str = virCgroupStatFileRead(group,
+                                      VIR_CGROUP_STAT_FILE_BLKIO_SERVICED,
+                                      buf, sizeof(buf), &alloc)))
+        goto cleanup;
 
-            if (stats_val < 0 ||
-                (stats_val > 0 && *requests_ptrs[i] > (LLONG_MAX - stats_val)))
-            {
-                virReportError(VIR_ERR_OVERFLOW,
-                               _("Sum of %srequest stat overflows"),
-                               value_names[i]);
-                goto cleanup;
-            }
-            *requests_ptrs[i] += stats_val;
-        }
-    }
+    if (virCgroupParseBlkioSum(str, "Read ", false, requests_read) < 0 ||
+        virCgroupParseBlkioSum(str, "Write ", false, requests_write) < 0)
+        goto cleanup;
 
     ret = 0;
 
 cleanup:
-    VIR_FREE(str2);
-    VIR_FREE(str1);
+    VIR_FREE(alloc);
     return ret;
 }
 
@@ -2330,9 +2482,9 @@ virCgroupGetMemoryUsage(virCgroupPtr group, unsigned long *kb)
 {
     long long unsigned int usage_in_bytes;
     int ret;
-    ret = virCgroupGetValueU64(group,
-                               VIR_CGROUP_CONTROLLER_MEMORY,
-                               "memory.usage_in_bytes", &usage_in_bytes);
+    ret = virCgroupStatFileReadU64(group,
+                                   VIR_CGROUP_STAT_FILE_MEMORY_USAGE,
+                                   &usage_in_bytes);
     if (ret == 0)
         *kb = (unsigned long) usage_in_bytes >> 10;
     return ret;
@@ -2905,40 +3057,40 @@ virCgroupGetDomainTotalCpuStats(virCgroupPtr group,
                                 virTypedParameterPtr params,
                                 int nparams)
 {
-    unsigned long long cpu_time;
-    int ret;
+    virCgroupStats stats;
+    unsigned int which = VIR_CGROUP_STATS_CPU_TIME;
 
     if (nparams == 0) /* return supported number of params */
         return CGROUP_NB_TOTAL_CPU_STAT_PARAM;
-    /* entry 0 is cputime */
-    ret = virCgroupGetCpuacctUsage(group, &cpu_time);
-    if (ret < 0) {
-        virReportSystemError(-ret, "%s", _("unable to get cpu account"));
+
+    if (nparams > 1)
+        which |= VIR_CGROUP_STATS_CPU_SPLIT;
+
+    if (virCgroupGetStats(group, which, &stats) < 0)
+        return -1;
+
+    if ((stats.fields & which) != which) {
+        virReportError(VIR_ERR_OPERATION_INVALID, "%s",
+                       _("unable to get cpu account"));
         return -1;
     }
 
+    /* entry 0 is cputime */
     if (virTypedParameterAssign(&params[0], VIR_DOMAIN_CPU_STATS_CPUTIME,
-                                VIR_TYPED_PARAM_ULLONG, cpu_time) < 0)
+                                VIR_TYPED_PARAM_ULLONG, stats.cpuTime) < 0)
         return -1;
 
     if (nparams > 1) {
-        unsigned long long user;
-        unsigned long long sys;
-
-        ret = virCgroupGetCpuacctStat(group, &user, &sys);
-        if (ret < 0) {
-            virReportSystemError(-ret, "%s", _("unable to get cpu account"));
-            return -1;
-        }
-
         if (virTypedParameterAssign(&params[1],
                                     VIR_DOMAIN_CPU_STATS_USERTIME,
-                                    VIR_TYPED_PARAM_ULLONG, user) < 0)
+                                    VIR_TYPED_PARAM_ULLONG,
+                                    stats.cpuUser) < 0)
             return -1;
         if (nparams > 2 &&
             virTypedParameterAssign(&params[2],
                                     VIR_DOMAIN_CPU_STATS_SYSTEMTIME,
-                                    VIR_TYPED_PARAM_ULLONG, sys) < 0)
+                                    VIR_TYPED_PARAM_ULLONG,
+                                    stats.cpuSystem) < 0)
             return -1;
 
         if (nparams > CGROUP_NB_TOTAL_CPU_STAT_PARAM)
@@ -2949,6 +3101,101 @@ virCgroupGetDomainTotalCpuStats(virCgroupPtr group,
 }
 
 
+/*
+ * Decide whether a failure to read one of the statistics
+ * should make virCgroupGetStats fail, or whether the kernel
+ * just does not provide the file.
+ */
+static int
+virCgroupGetStatsCheck(int rc)
+{
+    if (rc == 0)
+        return 1;
+
+    if (virLastErrorIsSystemErrno(ENOENT)) {
+        virResetLastError();
+        return 0;
+    }
+
+    return -1;
+}
+
+
+/**
+ * virCgroupGetStats:
+ *
+ * @group: The cgroup to query
+ * @stats: bitwise-OR of VIR_CGROUP_STATS_* to collect
+ * @ret: filled with the collected statistics
+ *
+ * Collect several statistics of @group in one go. This is
+ * the preferred way of polling domain statistics since the
+ * underlying files are kept open in @group between calls
+ * and their content is parsed without any allocation.
+ *
+ * Statistics whose controller is not enabled for @group,
+ * or which the kernel does not provide, are silently
+ * skipped; @ret->fields tells which ones were filled in.
+ *
+ * Returns: 0 on success, -1 on error
+ */
+int
+virCgroupGetStats(virCgroupPtr group,
+                  unsigned int stats,
+                  virCgroupStatsPtr ret)
+{
+    int rc;
+
+    memset(ret, 0, sizeof(*ret));
+
+    if (stats & VIR_CGROUP_STATS_CPU_TIME &&
+        virCgroupHasController(group, VIR_CGROUP_CONTROLLER_CPUACCT)) {
+        rc = virCgroupStatFileReadU64(group,
+                                      VIR_CGROUP_STAT_FILE_CPUACCT_USAGE,
+                                      &ret->cpuTime);
+        if ((rc = virCgroupGetStatsCheck(rc)) < 0)
+            return -1;
+        if (rc)
+            ret->fields |= VIR_CGROUP_STATS_CPU_TIME;
+    }
+
+    if (stats & VIR_CGROUP_STATS_CPU_SPLIT &&
+        virCgroupHasController(group, VIR_CGROUP_CONTROLLER_CPUACCT)) {
+        rc = virCgroupGetCpuacctStat(group, &ret->cpuUser, &ret->cpuSystem);
+        if ((rc = virCgroupGetStatsCheck(rc)) < 0)
+            return -1;
+        if (rc)
+            ret->fields |= VIR_CGROUP_STATS_CPU_SPLIT;
+    }
+
+    if (stats & VIR_CGROUP_STATS_MEMORY &&
+        virCgroupHasController(group, VIR_CGROUP_CONTROLLER_MEMORY)) {
+        rc = virCgroupStatFileReadU64(group,
+                                      VIR_CGROUP_STAT_FILE_MEMORY_USAGE,
+                                      &ret->memoryUsage);
+        if ((rc = virCgroupGetStatsCheck(rc)) < 0)
+            return -1;
+        if (rc)
+            ret->fields |= VIR_CGROUP_STATS_MEMORY;
+    }
+
+    if (stats & VIR_CGROUP_STATS_BLKIO &&
+        virCgroupHasController(group, VIR_CGROUP_CONTROLLER_BLKIO)) {
+        rc = virCgroupGetBlkioIoServiced(group,
+                                         &ret->blkioReadBytes,
+                                         &ret->blkioWriteBytes,
+                                         &ret->blkioReadRequests,
+                                         &ret->blkioWriteRequests);
+        if ((rc = virCgroupGetStatsCheck(rc)) < 0)
+            return -1;
+        if (rc)
+            ret->fields |= VIR_CGROUP_STATS_BLKIO;
+    }
+
+    return 0;
+}
+
+
 int
 virCgroupSetCpuShares(virCgroupPtr group, unsigned long long shares)
 {
@@ -3042,8 +3289,23 @@ virCgroupSetCpuCfsQuota(virCgroupPtr group, long long cfs_quota)
 int
 virCgroupGetCpuacctPercpuUsage(virCgroupPtr group, char **usage)
 {
-    return virCgroupGetValueStr(group, VIR_CGROUP_CONTROLLER_CPUACCT,
-                                "cpuacct.usage_percpu", usage);
+    char buf[VIR_CGROUP_STAT_BUFSIZE];
+    char *alloc = NULL;
+    char *str;
+
+    *usage = NULL;
+
+    if (!(str = virCgroupStatFileRead(group,
+                                      VIR_CGROUP_STAT_FILE_CPUACCT_USAGE_PERCPU,
+                                      buf, sizeof(buf), &alloc)))
+        return -1;
+
+    if (alloc) {
+        *usage = alloc;
+        return 0;
+    }
+
+    return VIR_STRDUP(*usage, str) < 0 ? -1 : 0;
 }
 
 
@@ -3118,6 +3380,8 @@ virCgroupRemove(virCgroupPtr group)
     char *grppath = NULL;
 
     VIR_DEBUG("Removing cgroup %s", group->path);
+    virCgroupStatFilesClose(group);
+
     for (i = 0; i < VIR_CGROUP_CONTROLLER_LAST; i++) {
         /* Skip over controllers not mounted */
         if (!group->controllers[i].mountPoint)
@@ -3446,9 +3710,9 @@ virCgroupGetCpuCfsQuota(virCgroupPtr group, long long *cfs_quota)
 int
 virCgroupGetCpuacctUsage(virCgroupPtr group, unsigned long long *usage)
 {
-    return virCgroupGetValueU64(group,
-                                VIR_CGROUP_CONTROLLER_CPUACCT,
-                                "cpuacct.usage", usage);
+    return virCgroupStatFileReadU64(group,
+                                    VIR_CGROUP_STAT_FILE_CPUACCT_USAGE,
+                                    usage);
 }
 
 
@@ -3456,13 +3720,15 @@ int
 virCgroupGetCpuacctStat(virCgroupPtr group, unsigned long long *user,
                         unsigned long long *sys)
 {
+    char buf[256];
+    char *alloc = NULL;
     char *str;
     char *p;
     int ret = -1;
     static double scale = -1.0;
 
-    if (virCgroupGetValueStr(group, VIR_CGROUP_CONTROLLER_CPUACCT,
-                             "cpuacct.stat", &str) < 0)
+    if (!(str = virCgroupStatFileRead(group, VIR_CGROUP_STAT_FILE_CPUACCT_STAT,
+                                      buf, sizeof(buf), &alloc)))
         return -1;
 
     if (!(p = STRSKIP(str, "user ")) ||
@@ -3496,7 +3762,7 @@ virCgroupGetCpuacctStat(virCgroupPtr group, unsigned long long *user,
 
     ret = 0;
 cleanup:
-    VIR_FREE(str);
+    VIR_FREE(alloc);
     return ret;
 }
 
@@ -4341,6 +4607,17 @@ virCgroupGetDomainTotalCpuStats(virCgroupPtr group ATTRIBUTE_UNUSED,
 }
 
 
+int
+virCgroupGetStats(virCgroupPtr group ATTRIBUTE_UNUSED,
+                  unsigned int stats ATTRIBUTE_UNUSED,
+                  virCgroupStatsPtr ret ATTRIBUTE_UNUSED)
+{
+    virReportSystemError(ENOSYS, "%s",
+                         _("Control groups not supported on this platform"));
+    return -1;
+}
+
+
 int
 virCgroupSetFreezerState(virCgroupPtr group ATTRIBUTE_UNUSED,
                          const char *state ATTRIBUTE_UNUSED)
@@ -213,6 +213,36 @@ virCgroupGetDomainTotalCpuStats(virCgroupPtr group,
                                 virTypedParameterPtr params,
                                 int nparams);
 
+enum {
+    VIR_CGROUP_STATS_CPU_TIME   = (1 << 0), /* cpuacct.usage */
+    VIR_CGROUP_STATS_CPU_SPLIT  = (1 << 1), /* cpuacct.stat */
+    VIR_CGROUP_STATS_MEMORY     = (1 << 2), /* memory.usage_in_bytes */
+    VIR_CGROUP_STATS_BLKIO      = (1 << 3), /* blkio.throttle.io_service* */
+
+    VIR_CGROUP_STATS_ALL        = (1 << 4) - 1,
+};
+
+typedef struct _virCgroupStats virCgroupStats;
+typedef virCgroupStats *virCgroupStatsPtr;
+struct _virCgroupStats {
+    unsigned int fields;            /* VIR_CGROUP_STATS_* actually filled */
+
+    unsigned long long cpuTime;     /* in nanoseconds */
+    unsigned long long cpuUser;     /* in nanoseconds */
+    unsigned long long cpuSystem;   /* in nanoseconds */
+
+    unsigned long long memoryUsage; /* in bytes */
+
+    long long blkioReadBytes;
+    long long blkioWriteBytes;
+    long long blkioReadRequests;
+    long long blkioWriteRequests;
+};
+
+int virCgroupGetStats(virCgroupPtr group,
+                      unsigned int stats,
+                      virCgroupStatsPtr ret);
+
 int virCgroupSetCpuShares(virCgroupPtr group, unsigned long long shares);
 int virCgroupGetCpuShares(virCgroupPtr group, unsigned long long *shares);
 
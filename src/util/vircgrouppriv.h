@@ -42,10 +42,26 @@ struct virCgroupController {
     char *placement;
 };
 
+/* Statistics files which are polled frequently and are
+ * therefore kept open for the lifetime of the group */
+typedef enum {
+    VIR_CGROUP_STAT_FILE_CPUACCT_USAGE,
+    VIR_CGROUP_STAT_FILE_CPUACCT_USAGE_PERCPU,
+    VIR_CGROUP_STAT_FILE_CPUACCT_STAT,
+    VIR_CGROUP_STAT_FILE_MEMORY_USAGE,
+    VIR_CGROUP_STAT_FILE_BLKIO_SERVICE_BYTES,
+    VIR_CGROUP_STAT_FILE_BLKIO_SERVICED,
+
+    VIR_CGROUP_STAT_FILE_LAST
+} virCgroupStatFile;
+
 struct virCgroup {
     char *path;
 
     struct virCgroupController controllers[VIR_CGROUP_CONTROLLER_LAST];
+
+    /* -1 if not opened yet */
+    int statfds[VIR_CGROUP_STAT_FILE_LAST];
 };
 
 #endif /* __VIR_CGROUP_PRIV_H__ */
@@ -49,6 +49,7 @@
 #include "virerror.h"
 #include "virlog.h"
 #include "virfile.h"
+#include "virhash.h"
 #include "virstring.h"
 
 #define VIR_FROM_THIS VIR_FROM_NETWORK
@@ -560,6 +561,300 @@ dnsmasqSave(const dnsmasqContext *ctx)
 }
 
 
+/* Largest hosts file we are prepared to patch in place */
+#define DNSMASQ_PATCH_MAX_LEN (64 * 1024 * 1024)
+
+/* Line counts are stored directly as the hash table payload */
+static size_t
+dnsmasqPatchCount(virHashTablePtr counts,
+                  const char *line)
+{
+    void *count = virHashLookup(counts, line);
+
+    return (uintptr_t) count;
+}
+
+/*
+ * Bring the file at @path, which was written from @oldlines, in line
+ * with @newlines: lines that went away are commented out in place and
+ * new lines are appended. Unchanged lines are not rewritten, so
+ * dnsmasq never sees a truncated file.
+ *
+ * Returns 1 if the file was changed, 0 if there was nothing to do, or
+ * -1 if the file has to be rewritten from scratch instead. That is the
+ * case if it does not hold @oldlines, if most of it would be commented
+ * out afterwards, or on any I/O error. No error is reported.
+ */
+static int
+dnsmasqFilePatch(const char *path,
+                 char **oldlines,
+                 size_t nold,
+                 char **newlines,
+                 size_t nnew)
+{
+    virHashTablePtr counts = NULL;
+    virBuffer buf = VIR_BUFFER_INITIALIZER;
+    char *content = NULL;
+    char *added = NULL;
+    char *line;
+    char *next;
+    off_t *offsets = NULL;
+    size_t noffsets = 0;
+    size_t nadded = 0;
+    size_t nremoved;
+    size_t nlive = 0;
+    size_t ndead = 0;
+    size_t count;
+    size_t i;
+    int fd = -1;
+    int ret = -1;
+
+    /* Count the old lines, then cancel out the ones that are still
+     * wanted; whatever is left over has been removed */
+    if (!(counts = virHashCreate(nold + 1, NULL)))
+        goto cleanup;
+
+    for (i = 0; i < nold; i++) {
+        count = dnsmasqPatchCount(counts, oldlines[i]);
+        if (virHashUpdateEntry(counts, oldlines[i],
+                               (void *) (uintptr_t) (count + 1)) < 0)
+            goto cleanup;
+    }
+
+    for (i = 0; i < nnew; i++) {
+        count = dnsmasqPatchCount(counts, newlines[i]);
+        if (count > 0) {
+            if (virHashUpdateEntry(counts, newlines[i],
+                                   (void *) (uintptr_t) (count - 1)) < 0)
+                goto cleanup;
+        } else {
+            virBufferAsprintf(&buf, "%s\n", newlines[i]);
+            nadded++;
+        }
+    }
+
+    nremoved = nold - (nnew - nadded);
+    if (nremoved == 0 && nadded == 0) {
+        ret = 0;
+        goto cleanup;
+    }
+
+    if ((fd = open(path, O_RDWR)) < 0)
+        goto cleanup;
+
+    if (nremoved > 0) {
+        if (virFileReadLimFD(fd, DNSMASQ_PATCH_MAX_LEN, &content) < 0 ||
+            VIR_ALLOC_N(offsets, nremoved) < 0)
+            goto cleanup;
+
+        for (line = content; *line; line = next) {
+            /* a missing newline means we did not write this file */
+            if (!(next = strchr(line, '\n')))
+                goto cleanup;
+            *next++ = '\0';
+
+            if (*line == '#') {
+                ndead++;
+                continue;
+            }
+
+            count = dnsmasqPatchCount(counts, line);
+            if (count == 0) {
+                nlive++;
+                continue;
+            }
+            if (virHashUpdateEntry(counts, line,
+                                   (void *) (uintptr_t) (count - 1)) < 0)
+                goto cleanup;
+            offsets[noffsets++] = line - content;
+        }
+
+        if (noffsets != nremoved)
+            goto cleanup;
+
+        /* Compact the file once it is mostly comments */
+        if (ndead + nremoved > nlive + nadded)
+            goto cleanup;
+
+        for (i = 0; i < noffsets; i++) {
+            if (lseek(fd, offsets[i], SEEK_SET) < 0 ||
+                safewrite(fd, "#", 1) != 1)
+                goto cleanup;
+        }
+    }
+
+    if (nadded > 0) {
+        if (virBufferError(&buf))
+            goto cleanup;
+        added = virBufferContentAndReset(&buf);
+
+        if (lseek(fd, 0, SEEK_END) < 0 ||
+            safewrite(fd, added, strlen(added)) < 0)
+            goto cleanup;
+    }
+
+    if (VIR_CLOSE(fd) < 0)
+        goto cleanup;
+
+    VIR_DEBUG("Patched %s: %zu entries added, %zu removed",
+              path, nadded, nremoved);
+    ret = 1;
+
+ cleanup:
+    VIR_FORCE_CLOSE(fd);
+    virBufferFreeAndReset(&buf);
+    virHashFree(counts);
+    VIR_FREE(offsets);
+    VIR_FREE(content);
+    VIR_FREE(added);
+    return ret;
+}
+
+static int
+hostsfileSaveChanges(dnsmasqHostsfile *hostsfile,
+                     dnsmasqHostsfile *prev)
+{
+    char **oldlines = NULL;
+    char **newlines = NULL;
+    size_t i;
+    int ret = -1;
+
+    if (VIR_ALLOC_N(oldlines, prev->nhosts) < 0 ||
+        VIR_ALLOC_N(newlines, hostsfile->nhosts) < 0)
+        goto cleanup;
+
+    for (i = 0; i < prev->nhosts; i++)
+        oldlines[i] = prev->hosts[i].host;
+    for (i = 0; i < hostsfile->nhosts; i++)
+        newlines[i] = hostsfile->hosts[i].host;
+
+    ret = dnsmasqFilePatch(hostsfile->path,
+                           oldlines, prev->nhosts,
+                           newlines, hostsfile->nhosts);
+
+ cleanup:
+    VIR_FREE(oldlines);
+    VIR_FREE(newlines);
+    if (ret < 0) {
+        virResetLastError();
+        VIR_DEBUG("Rewriting %s", hostsfile->path);
+        if (hostsfileSave(hostsfile) < 0)
+            return -1;
+        ret = 1;
+    }
+    return ret;
+}
+
+static char *
+addnhostFormat(dnsmasqAddnHost *host)
+{
+    virBuffer buf = VIR_BUFFER_INITIALIZER;
+    size_t i;
+
+    /* must match what addnhostsWrite() produces */
+    virBufferAsprintf(&buf, "%s\t", host->ip);
+    for (i = 0; i < host->nhostnames; i++)
+        virBufferAsprintf(&buf, "%s\t", host->hostnames[i]);
+
+    if (virBufferError(&buf)) {
+        virBufferFreeAndReset(&buf);
+        virReportOOMError();
+        return NULL;
+    }
+
+    return virBufferContentAndReset(&buf);
+}
+
+static int
+addnhostsSaveChanges(dnsmasqAddnHostsfile *addnhostsfile,
+                     dnsmasqAddnHostsfile *prev)
+{
+    char **oldlines = NULL;
+    char **newlines = NULL;
+    size_t i;
+    int ret = -1;
+
+    if (VIR_ALLOC_N(oldlines, prev->nhosts) < 0 ||
+        VIR_ALLOC_N(newlines, addnhostsfile->nhosts) < 0)
+        goto cleanup;
+
+    for (i = 0; i < prev->nhosts; i++) {
+        if (!(oldlines[i] = addnhostFormat(&prev->hosts[i])))
+            goto cleanup;
+    }
+    for (i = 0; i < addnhostsfile->nhosts; i++) {
+        if (!(newlines[i] = addnhostFormat(&addnhostsfile->hosts[i])))
+            goto cleanup;
+    }
+
+    ret = dnsmasqFilePatch(addnhostsfile->path,
+                           oldlines, prev->nhosts,
+                           newlines, addnhostsfile->nhosts);
+
+ cleanup:
+    if (oldlines) {
+        for (i = 0; i < prev->nhosts; i++)
+            VIR_FREE(oldlines[i]);
+        VIR_FREE(oldlines);
+    }
+    if (newlines) {
+        for (i = 0; i < addnhostsfile->nhosts; i++)
+            VIR_FREE(newlines[i]);
+        VIR_FREE(newlines);
+    }
+    if (ret < 0) {
+        virResetLastError();
+        VIR_DEBUG("Rewriting %s", addnhostsfile->path);
+        if (addnhostsSave(addnhostsfile) < 0)
+            return -1;
+        ret = 1;
+    }
+    return ret;
+}
+
+/**
+ * dnsmasqSaveChanges:
+ * @ctx: pointer to the dnsmasq context for each network
+ * @prev: context the files on disk were last saved from
+ *
+ * Like dnsmasqSave(), but only writes out what differs between @prev
+ * and @ctx: removed entries are commented out in place and new ones
+ * are appended. A file is rewritten from scratch if it does not match
+ * @prev, or once most of it has been commented out.
+ *
+ * Returns 1 if any file changed and dnsmasq needs to reread it, 0 if
+ * nothing changed, or -1 on error.
+ */
+int
+dnsmasqSaveChanges(const dnsmasqContext *ctx,
+                   const dnsmasqContext *prev)
+{
+    int changed = 0;
+    int rc;
+
+    if (virFileMakePath(ctx->config_dir) < 0) {
+        virReportSystemError(errno, _("cannot create config directory '%s'"),
+                             ctx->config_dir);
+        return -1;
+    }
+
+    if (ctx->hostsfile && prev->hostsfile) {
+        if ((rc = hostsfileSaveChanges(ctx->hostsfile, prev->hostsfile)) < 0)
+            return -1;
+        changed |= rc;
+    }
+
+    if (ctx->addnhostsfile && prev->addnhostsfile) {
+        if ((rc = addnhostsSaveChanges(ctx->addnhostsfile,
+                                       prev->addnhostsfile)) < 0)
+            return -1;
+        changed |= rc;
+    }
+
+    return changed;
+}
+
+
 /**
  * dnsmasqDelete:
  * @ctx: pointer to the dnsmasq context for each network
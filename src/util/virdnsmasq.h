@@ -92,6 +92,8 @@ int              dnsmasqAddHost(dnsmasqContext *ctx,
                                 virSocketAddr *ip,
                                 const char *name);
 int              dnsmasqSave(const dnsmasqContext *ctx);
+int              dnsmasqSaveChanges(const dnsmasqContext *ctx,
+                                    const dnsmasqContext *prev);
 int              dnsmasqDelete(const dnsmasqContext *ctx);
 int              dnsmasqReload(pid_t pid);
 
@@ -1104,6 +1104,159 @@ safezero(int fd, off_t offset, off_t len)
 #endif /* HAVE_POSIX_FALLOCATE */
 
 
+/**
+ * virFileInData:
+ * @fd: file descriptor to inspect
+ * @inData: set to true if the current position is within data
+ * @length: set to the number of bytes until the data or hole ends
+ *
+ * Looks at the section of @fd starting at its current position,
+ * without moving it. Anything but a regular file, or a file on a
+ * filesystem which can't report holes, is a single data section.
+ * At the end of the file, @inData is false and @length is 0.
+ *
+ * Returns 0 on success, -1 on failure with errno set.
+ */
+int
+virFileInData(int fd, bool *inData, unsigned long long *length)
+{
+    struct stat sb;
+    off_t cur, end;
+    int saveErrno;
+
+    if (fstat(fd, &sb) < 0 ||
+        (cur = lseek(fd, 0, SEEK_CUR)) < 0)
+        return -1;
+
+    if ((end = lseek(fd, 0, SEEK_END)) < 0)
+        goto error;
+
+    if (cur >= end) {
+        *inData = false;
+        *length = 0;
+    } else {
+        *inData = true;
+        *length = end - cur;
+    }
+
+#ifdef SEEK_DATA
+    if (S_ISREG(sb.st_mode) && cur < end) {
+        off_t next = lseek(fd, cur, SEEK_DATA);
+
+        if (next < 0) {
+            if (errno == ENXIO) {
+                /* The file ends with a hole */
+                *inData = false;
+            } else if (errno != EINVAL) {
+                goto error;
+            }
+        } else if (next > cur) {
+            *inData = false;
+            *length = next - cur;
+        } else {
+            if ((next = lseek(fd, cur, SEEK_HOLE)) < 0)
+                goto error;
+            *length = next - cur;
+        }
+    }
+#endif
+
+    if (lseek(fd, cur, SEEK_SET) < 0)
+        return -1;
+    return 0;
+
+error:
+    saveErrno = errno;
+    ignore_value(lseek(fd, cur, SEEK_SET));
+    errno = saveErrno;
+    return -1;
+}
+
+
+static int
+virFileZeroRange(int fd, off_t offset, off_t len)
+{
+    char *buf = NULL;
+    size_t buflen = 1024 * 1024;
+
+#if HAVE_FALLOCATE - 0 && defined(FALLOC_FL_PUNCH_HOLE)
+    if (fallocate(fd, FALLOC_FL_PUNCH_HOLE | FALLOC_FL_KEEP_SIZE,
+                  offset, len) == 0)
+        return 0;
+    if (errno != EOPNOTSUPP && errno != ENOSYS && errno != ENODEV)
+        return -1;
+#endif
+
+    if (lseek(fd, offset, SEEK_SET) < 0)
+        return -1;
+
+    if (VIR_ALLOC_N_QUIET(buf, MIN(buflen, len)) < 0) {
+        errno = ENOMEM;
+        return -1;
+    }
+
+    while (len) {
+        size_t chunk = MIN(buflen, len);
+
+        if (safewrite(fd, buf, chunk) < 0) {
+            VIR_FREE(buf);
+            return -1;
+        }
+        len -= chunk;
+    }
+
+    VIR_FREE(buf);
+    return 0;
+}
+
+
+/**
+ * virFileWriteHole:
+ * @fd: file descriptor open for writing
+ * @length: size of the hole
+ *
+ * Makes the @length bytes at the current position of @fd read back
+ * as zeroes and moves past them. Existing contents are punched out
+ * where the filesystem allows, and overwritten with zeroes otherwise.
+ * A regular file is extended if the hole reaches past its end.
+ *
+ * Returns 0 on success, -1 on failure with errno set.
+ */
+int
+virFileWriteHole(int fd, unsigned long long length)
+{
+    struct stat sb;
+    off_t cur, end, zeroEnd;
+
+    if (fstat(fd, &sb) < 0 ||
+        (cur = lseek(fd, 0, SEEK_CUR)) < 0)
+        return -1;
+
+    if (length > (unsigned long long) (LLONG_MAX - cur)) {
+        errno = EFBIG;
+        return -1;
+    }
+    end = zeroEnd = cur + length;
+
+    /* Beyond the end of a regular file there is nothing to clear */
+    if (S_ISREG(sb.st_mode))
+        zeroEnd = MIN(end, sb.st_size);
+
+    if (zeroEnd > cur &&
+        virFileZeroRange(fd, cur, zeroEnd - cur) < 0)
+        return -1;
+
+    if (S_ISREG(sb.st_mode) && end > sb.st_size &&
+        ftruncate(fd, end) < 0)
+        return -1;
+
+    if (lseek(fd, end, SEEK_SET) < 0)
+        return -1;
+
+    return 0;
+}
+
+
 #if defined HAVE_MNTENT_H && defined HAVE_GETMNTENT_R
 /* search /proc/mounts for mount point of *type; return pointer to
  * malloc'ed string of the path if found, otherwise return NULL
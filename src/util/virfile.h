@@ -43,6 +43,11 @@ ssize_t safewrite(int fd, const void *buf, size_t count)
 int safezero(int fd, off_t offset, off_t len)
     ATTRIBUTE_RETURN_CHECK;
 
+int virFileInData(int fd, bool *inData, unsigned long long *length)
+    ATTRIBUTE_NONNULL(2) ATTRIBUTE_NONNULL(3) ATTRIBUTE_RETURN_CHECK;
+int virFileWriteHole(int fd, unsigned long long length)
+    ATTRIBUTE_RETURN_CHECK;
+
 /* Don't call these directly - use the macros below */
 int virFileClose(int *fdptr, virFileCloseFlags flags)
         ATTRIBUTE_RETURN_CHECK;
@@ -1,5 +1,5 @@
 /*
- * virhash.c: chained hash tables
+ * virhash.c: open addressing hash tables
  *
  * Reference: Your favorite introductory book on algorithms
  *
@@ -34,10 +34,6 @@
 
 #define VIR_FROM_THIS VIR_FROM_NONE
 
-#define MAX_HASH_LEN 8
-
-/* #define DEBUG_GROW */
-
 #define virHashIterationError(ret)                                      \
     do {                                                                \
         VIR_ERROR(_("Hash operation not allowed during iteration"));   \
@@ -45,12 +41,30 @@
     } while (0)
 
 /*
- * A single entry in the hash table
+ * The table uses open addressing with Robin Hood hashing: an entry
+ * lives in the first free slot at or after its home slot (its hash
+ * code modulo the table size), and on insertion an entry that is
+ * further from its home slot than the one occupying a slot takes that
+ * slot over and the displaced entry moves on. This keeps probe
+ * sequences short even at high load, so lookups for missing keys can
+ * stop as soon as they reach an entry closer to its home than they
+ * would be. Removal shifts the following entries of the cluster back
+ * by one slot instead of leaving tombstones.
+ */
+
+/* Maximum load factor, as a fraction of 8 */
+#define VIR_HASH_MAX_LOAD 7
+
+#define VIR_HASH_MIN_SIZE 8
+
+/*
+ * A single slot in the hash table
  */
 typedef struct _virHashEntry virHashEntry;
 typedef virHashEntry *virHashEntryPtr;
 struct _virHashEntry {
-    struct _virHashEntry *next;
+    uint32_t code; /* cached hash code of name */
+    uint32_t dist; /* 1 + distance from the home slot, 0 if unused */
     void *name;
     void *payload;
 };
@@ -59,14 +73,16 @@ struct _virHashEntry {
  * The entire hash table
  */
 struct _virHashTable {
-    virHashEntryPtr *table;
+    virHashEntryPtr table;
     uint32_t seed;
-    size_t size;
+    size_t size; /* number of slots, always a power of two */
     size_t nbElems;
     /* True iff we are iterating over hash entries. */
     bool iterating;
-    /* Pointer to the current entry during iteration. */
-    virHashEntryPtr current;
+    /* Slot of the current entry during iteration. */
+    size_t current;
+    /* Set when the current entry is removed during iteration. */
+    bool currentRemoved;
     virHashDataFree dataFree;
     virHashKeyCode keyCode;
     virHashKeyEqual keyEqual;
@@ -97,11 +113,107 @@ static void virHashStrFree(void *name)
 }
 
 
+/* Number of slots needed to hold @count entries */
+static size_t
+virHashSizeFor(size_t count)
+{
+    size_t size = VIR_HASH_MIN_SIZE;
+
+    while (size * VIR_HASH_MAX_LOAD / 8 < count)
+        size *= 2;
+
+    return size;
+}
+
+/* Put an entry known not to be present yet into @table, which must
+ * have a free slot */
+static void
+virHashInsertEntry(virHashTablePtr table,
+                   uint32_t code,
+                   void *name,
+                   void *payload)
+{
+    virHashEntry entry = { code, 1, name, payload };
+    size_t mask = table->size - 1;
+    size_t i = code & mask;
+
+    for (;;) {
+        virHashEntryPtr slot = &table->table[i];
+
+        if (!slot->dist) {
+            *slot = entry;
+            return;
+        }
+
+        /* Robin Hood: take the slot from an entry closer to home */
+        if (slot->dist < entry.dist) {
+            virHashEntry tmp = *slot;
+            *slot = entry;
+            entry = tmp;
+        }
+
+        entry.dist++;
+        i = (i + 1) & mask;
+    }
+}
+
+/* Returns the slot holding @name, or NULL */
+static virHashEntryPtr
+virHashFindEntry(const virHashTable *table,
+                 const void *name,
+                 uint32_t code)
+{
+    size_t mask = table->size - 1;
+    size_t i = code & mask;
+    uint32_t dist;
+
+    for (dist = 1; ; dist++) {
+        virHashEntryPtr slot = &table->table[i];
+
+        /* @name would have displaced this entry */
+        if (slot->dist < dist)
+            return NULL;
+
+        if (slot->code == code && table->keyEqual(slot->name, name))
+            return slot;
+
+        i = (i + 1) & mask;
+    }
+}
+
+/* Clear slot @i, moving the rest of its cluster back by one */
+static void
+virHashDeleteEntry(virHashTablePtr table,
+                   size_t i)
+{
+    size_t mask = table->size - 1;
+    size_t next = (i + 1) & mask;
+
+    while (table->table[next].dist > 1) {
+        table->table[i] = table->table[next];
+        table->table[i].dist--;
+        i = next;
+        next = (next + 1) & mask;
+    }
+
+    memset(&table->table[i], 0, sizeof(table->table[i]));
+    table->nbElems--;
+}
+
+/* Iteration starts right after an unused slot and goes once around
+ * the table. Removing an entry only moves entries that follow it in
+ * the same cluster back by one slot, and no cluster extends past an
+ * unused slot, so every entry is still visited exactly once as long
+ * as the iterator stays on a slot whose entry was just removed. */
 static size_t
-virHashComputeKey(const virHashTable *table, const void *name)
+virHashIterStart(const virHashTable *table)
 {
-    uint32_t value = table->keyCode(name, table->seed);
-    return value % table->size;
+    size_t i = 0;
+
+    while (table->table[i].dist)
+        i++;
+
+    return i;
 }
 
 /**
@@ -133,7 +245,7 @@ virHashTablePtr virHashCreateFull(ssize_t size,
         return NULL;
 
     table->seed = virRandomBits(32);
-    table->size = size;
+    table->size = virHashSizeFor(size);
     table->nbElems = 0;
     table->dataFree = dataFree;
     table->keyCode = keyCode;
@@ -141,7 +253,7 @@ virHashTablePtr virHashCreateFull(ssize_t size,
     table->keyCopy = keyCopy;
     table->keyFree = keyFree;
 
-    if (VIR_ALLOC_N(table->table, size) < 0) {
+    if (VIR_ALLOC_N(table->table, table->size) < 0) {
         VIR_FREE(table);
         return NULL;
     }
@@ -182,23 +294,10 @@ static int
 virHashGrow(virHashTablePtr table, size_t size)
 {
     size_t oldsize, i;
-    virHashEntryPtr *oldtable;
-
-#ifdef DEBUG_GROW
-    size_t nbElem = 0;
-#endif
-
-    if (table == NULL)
-        return -1;
-    if (size < 8)
-        return -1;
-    if (size > 8 * 2048)
-        return -1;
+    virHashEntryPtr oldtable;
 
     oldsize = table->size;
     oldtable = table->table;
-    if (oldtable == NULL)
-        return -1;
 
     if (VIR_ALLOC_N(table->table, size) < 0) {
         table->table = oldtable;
@@ -206,28 +305,17 @@ virHashGrow(virHashTablePtr table, size_t size)
     }
     table->size = size;
 
+    /* The cached hash codes spare calling keyCode again */
     for (i = 0; i < oldsize; i++) {
-        virHashEntryPtr iter = oldtable[i];
-        while (iter) {
-            virHashEntryPtr next = iter->next;
-            size_t key = virHashComputeKey(table, iter->name);
-
-            iter->next = table->table[key];
-            table->table[key] = iter;
-
-#ifdef DEBUG_GROW
-            nbElem++;
-#endif
-            iter = next;
-        }
+        if (oldtable[i].dist)
+            virHashInsertEntry(table, oldtable[i].code,
+                               oldtable[i].name, oldtable[i].payload);
     }
 
     VIR_FREE(oldtable);
 
-#ifdef DEBUG_GROW
-    VIR_DEBUG("virHashGrow : from %d to %d, %ld elems\n", oldsize,
-              size, nbElem);
-#endif
+    VIR_DEBUG("grew hash table %p from %zu to %zu slots, %zu elements",
+              table, oldsize, size, table->nbElems);
 
     return 0;
 }
@@ -248,17 +336,15 @@ virHashFree(virHashTablePtr table)
         return;
 
     for (i = 0; i < table->size; i++) {
-        virHashEntryPtr iter = table->table[i];
-        while (iter) {
-            virHashEntryPtr next = iter->next;
+        virHashEntryPtr entry = &table->table[i];
 
-            if (table->dataFree)
-                table->dataFree(iter->payload, iter->name);
-            if (table->keyFree)
-                table->keyFree(iter->name);
-            VIR_FREE(iter);
-            iter = next;
-        }
+        if (!entry->dist)
+            continue;
+
+        if (table->dataFree)
+            table->dataFree(entry->payload, entry->name);
+        if (table->keyFree)
+            table->keyFree(entry->name);
     }
 
     VIR_FREE(table->table);
@@ -270,8 +356,8 @@ virHashAddOrUpdateEntry(virHashTablePtr table, const void *name,
                         void *userdata,
                         bool is_update)
 {
-    size_t key, len = 0;
     virHashEntryPtr entry;
+    uint32_t code;
     char *new_name;
 
     if ((table == NULL) || (name == NULL))
@@ -280,38 +366,32 @@ virHashAddOrUpdateEntry(virHashTablePtr table, const void *name,
     if (table->iterating)
         virHashIterationError(-1);
 
-    key = virHashComputeKey(table, name);
+    code = table->keyCode(name, table->seed);
 
     /* Check for duplicate entry */
-    for (entry = table->table[key]; entry; entry = entry->next) {
-        if (table->keyEqual(entry->name, name)) {
-            if (is_update) {
-                if (table->dataFree)
-                    table->dataFree(entry->payload, entry->name);
-                entry->payload = userdata;
-                return 0;
-            } else {
-                return -1;
-            }
+    if ((entry = virHashFindEntry(table, name, code))) {
+        if (is_update) {
+            if (table->dataFree)
+                table->dataFree(entry->payload, entry->name);
+            entry->payload = userdata;
+            return 0;
+        } else {
+            return -1;
         }
-        len++;
     }
 
-    if (VIR_ALLOC(entry) < 0 || !(new_name = table->keyCopy(name))) {
-        VIR_FREE(entry);
+    /* Failing to grow is fine as long as there is a slot left */
+    if ((table->nbElems + 1) * 8 > table->size * VIR_HASH_MAX_LOAD &&
+        virHashGrow(table, table->size * 2) < 0 &&
+        table->nbElems + 1 >= table->size)
         return -1;
-    }
 
-    entry->name = new_name;
-    entry->payload = userdata;
-    entry->next = table->table[key];
-    table->table[key] = entry;
+    if (!(new_name = table->keyCopy(name)))
+        return -1;
 
+    virHashInsertEntry(table, code, new_name, userdata);
     table->nbElems++;
 
-    if (len > MAX_HASH_LEN)
-        virHashGrow(table, MAX_HASH_LEN * table->size);
-
     return 0;
 }
 
@@ -363,18 +443,14 @@ virHashUpdateEntry(virHashTablePtr table, const void *name,
 void *
 virHashLookup(const virHashTable *table, const void *name)
 {
-    size_t key;
     virHashEntryPtr entry;
 
     if (!table || !name)
         return NULL;
 
-    key = virHashComputeKey(table, name);
-    for (entry = table->table[key]; entry; entry = entry->next) {
-        if (table->keyEqual(entry->name, name))
-            return entry->payload;
-    }
-    return NULL;
+    entry = virHashFindEntry(table, name, table->keyCode(name, table->seed));
+
+    return entry ? entry->payload : NULL;
 }
 
 
@@ -422,7 +498,7 @@ virHashSize(const virHashTable *table)
  * virHashTableSize:
  * @table: the hash table
  *
- * Query the size of the hash @table, i.e., number of buckets in the table.
+ * Query the size of the hash @table, i.e., number of slots in the table.
  *
  * Returns the number of keys in the hash table or
  * -1 in case of error
@@ -451,30 +527,34 @@ int
 virHashRemoveEntry(virHashTablePtr table, const void *name)
 {
     virHashEntryPtr entry;
-    virHashEntryPtr *nextptr;
+    size_t i;
+    void *oldname;
+    void *payload;
 
     if (table == NULL || name == NULL)
         return -1;
 
-    nextptr = table->table + virHashComputeKey(table, name);
-    for (entry = *nextptr; entry; entry = entry->next) {
-        if (table->keyEqual(entry->name, name)) {
-            if (table->iterating && table->current != entry)
-                virHashIterationError(-1);
+    if (!(entry = virHashFindEntry(table, name,
+                                   table->keyCode(name, table->seed))))
+        return -1;
 
-            if (table->dataFree)
-                table->dataFree(entry->payload, entry->name);
-            if (table->keyFree)
-                table->keyFree(entry->name);
-            *nextptr = entry->next;
-            VIR_FREE(entry);
-            table->nbElems--;
-            return 0;
-        }
-        nextptr = &entry->next;
+    i = entry - table->table;
+    if (table->iterating) {
+        if (table->current != i)
+            virHashIterationError(-1);
+        table->currentRemoved = true;
     }
 
-    return -1;
+    oldname = entry->name;
+    payload = entry->payload;
+    virHashDeleteEntry(table, i);
+
+    if (table->dataFree)
+        table->dataFree(payload, oldname);
+    if (table->keyFree)
+        table->keyFree(oldname);
+
+    return 0;
 }
 
 
@@ -493,7 +573,7 @@ virHashRemoveEntry(virHashTablePtr table, const void *name)
 ssize_t
 virHashForEach(virHashTablePtr table, virHashIterator iter, void *data)
 {
-    size_t i, count = 0;
+    size_t start, i, n, count = 0;
 
     if (table == NULL || iter == NULL)
         return -1;
@@ -502,19 +582,25 @@ virHashForEach(virHashTablePtr table, virHashIterator iter, void *data)
         virHashIterationError(-1);
 
     table->iterating = true;
-    table->current = NULL;
-    for (i = 0; i < table->size; i++) {
-        virHashEntryPtr entry = table->table[i];
-        while (entry) {
-            virHashEntryPtr next = entry->next;
-
-            table->current = entry;
-            iter(entry->payload, entry->name, data);
-            table->current = NULL;
+    start = virHashIterStart(table);
+    for (n = 1; n <= table->size; ) {
+        virHashEntryPtr entry;
 
-            count++;
-            entry = next;
+        i = (start + n) & (table->size - 1);
+        entry = &table->table[i];
+        if (!entry->dist) {
+            n++;
+            continue;
         }
+
+        table->current = i;
+        table->currentRemoved = false;
+        iter(entry->payload, entry->name, data);
+        count++;
+
+        /* if the entry went away, the next one took its slot */
+        if (!table->currentRemoved)
+            n++;
     }
     table->iterating = false;
 
@@ -539,7 +625,7 @@ virHashRemoveSet(virHashTablePtr table,
                  virHashSearcher iter,
                  const void *data)
 {
-    size_t i, count = 0;
+    size_t start, i, n, count = 0;
 
     if (table == NULL || iter == NULL)
         return -1;
@@ -548,25 +634,29 @@ virHashRemoveSet(virHashTablePtr table,
         virHashIterationError(-1);
 
     table->iterating = true;
-    table->current = NULL;
-    for (i = 0; i < table->size; i++) {
-        virHashEntryPtr *nextptr = table->table + i;
-
-        while (*nextptr) {
-            virHashEntryPtr entry = *nextptr;
-            if (!iter(entry->payload, entry->name, data)) {
-                nextptr = &entry->next;
-            } else {
-                count++;
-                if (table->dataFree)
-                    table->dataFree(entry->payload, entry->name);
-                if (table->keyFree)
-                    table->keyFree(entry->name);
-                *nextptr = entry->next;
-                VIR_FREE(entry);
-                table->nbElems--;
-            }
+    start = virHashIterStart(table);
+    for (n = 1; n <= table->size; ) {
+        virHashEntryPtr entry;
+        void *name;
+        void *payload;
+
+        i = (start + n) & (table->size - 1);
+        entry = &table->table[i];
+        if (!entry->dist ||
+            !iter(entry->payload, entry->name, data)) {
+            n++;
+            continue;
         }
+
+        count++;
+        name = entry->name;
+        payload = entry->payload;
+        virHashDeleteEntry(table, i);
+
+        if (table->dataFree)
+            table->dataFree(payload, name);
+        if (table->keyFree)
+            table->keyFree(name);
     }
     table->iterating = false;
 
@@ -625,14 +715,12 @@ void *virHashSearch(const virHashTable *ctable,
         virHashIterationError(NULL);
 
     table->iterating = true;
-    table->current = NULL;
     for (i = 0; i < table->size; i++) {
-        virHashEntryPtr entry;
-        for (entry = table->table[i]; entry; entry = entry->next) {
-            if (iter(entry->payload, entry->name, data)) {
-                table->iterating = false;
-                return entry->payload;
-            }
+        virHashEntryPtr entry = &table->table[i];
+
+        if (entry->dist && iter(entry->payload, entry->name, data)) {
+            table->iterating = false;
+            return entry->payload;
         }
     }
     table->iterating = false;
@@ -29,6 +29,9 @@
 #include "virlog.h"
 #include "virstring.h"
 #include "virutil.h"
+#include "virhashcode.h"
+#include "virrandom.h"
+#include "virthread.h"
 
 #if WITH_YAJL
 # include <yajl/yajl_gen.h>
@@ -59,9 +62,145 @@ struct _virJSONParser {
     virJSONValuePtr head;
     virJSONParserStatePtr state;
     unsigned int nstate;
+    virJSONArenaPtr arena;
 };
 
 
+/*
+ * Replies from QEMU monitor and guest agent are parsed into a tree,
+ * picked apart and thrown away straight after.  For those the parser
+ * can place every value, string and key into a few large chunks which
+ * are released in one go together with the root of the tree.  The
+ * pairs/values arrays of containers still live on the heap, so that
+ * such trees may be modified like any other.
+ */
+#define VIR_JSON_ARENA_CHUNK_SIZE 4096
+
+typedef struct _virJSONArenaChunk virJSONArenaChunk;
+typedef virJSONArenaChunk *virJSONArenaChunkPtr;
+struct _virJSONArenaChunk {
+    virJSONArenaChunkPtr next;
+    size_t size;
+    size_t used;
+    union {
+        void *ptr;
+        long long ll;
+        double d;
+    } data[];
+};
+
+struct _virJSONArena {
+    virJSONValuePtr root;
+    virJSONArenaChunkPtr chunks;
+};
+
+
+static int
+virJSONArenaAddChunk(virJSONArenaPtr arena,
+                     size_t size)
+{
+    virJSONArenaChunkPtr chunk;
+
+    if (VIR_ALLOC_VAR(chunk, char, size) < 0)
+        return -1;
+    chunk->size = size;
+
+    /* Keep serving small requests from the current chunk if this one
+     * was created for a single large allocation */
+    if (arena->chunks && size > VIR_JSON_ARENA_CHUNK_SIZE) {
+        chunk->next = arena->chunks->next;
+        arena->chunks->next = chunk;
+    } else {
+        chunk->next = arena->chunks;
+        arena->chunks = chunk;
+    }
+    return 0;
+}
+
+
+static void
+virJSONArenaFree(virJSONArenaPtr arena)
+{
+    virJSONArenaChunkPtr chunk;
+
+    if (!arena)
+        return;
+
+    while ((chunk = arena->chunks)) {
+        arena->chunks = chunk->next;
+        VIR_FREE(chunk);
+    }
+    VIR_FREE(arena);
+}
+
+
+/* Returns zeroed memory owned by @arena */
+static void *
+virJSONArenaAlloc(virJSONArenaPtr arena,
+                  size_t size)
+{
+    virJSONArenaChunkPtr chunk = arena->chunks;
+    char *ret;
+
+    size = VIR_ROUND_UP(size, sizeof(chunk->data[0]));
+
+    if (!chunk || chunk->size - chunk->used < size) {
+        if (virJSONArenaAddChunk(arena,
+                                 MAX(size, VIR_JSON_ARENA_CHUNK_SIZE)) < 0)
+            return NULL;
+        chunk = arena->chunks;
+        if (chunk->size - chunk->used < size)
+            chunk = chunk->next;
+    }
+
+    ret = (char *)chunk->data + chunk->used;
+    chunk->used += size;
+    return ret;
+}
+
+
+/* Copy @len bytes of @str either into @arena, or on the heap if
+ * @arena is NULL */
+static char *
+virJSONStrndup(virJSONArenaPtr arena,
+               const char *str,
+               size_t len)
+{
+    char *ret;
+
+    if (!arena) {
+        if (VIR_STRNDUP(ret, str, len) < 0)
+            return NULL;
+        return ret;
+    }
+
+    if (!(ret = virJSONArenaAlloc(arena, len + 1)))
+        return NULL;
+    memcpy(ret, str, len);
+    ret[len] = '\0';
+    return ret;
+}
+
+
+static virJSONValuePtr
+virJSONValueNewInternal(virJSONArenaPtr arena,
+                        int type)
+{
+    virJSONValuePtr val;
+
+    if (arena) {
+        if (!(val = virJSONArenaAlloc(arena, sizeof(*val))))
+            return NULL;
+        val->arena = arena;
+    } else if (VIR_ALLOC(val) < 0) {
+        return NULL;
+    }
+
+    val->type = type;
+    return val;
+}
+
+
 void virJSONValueFree(virJSONValuePtr value)
 {
     size_t i;
@@ -71,10 +210,12 @@ void virJSONValueFree(virJSONValuePtr value)
     switch ((virJSONType) value->type) {
     case VIR_JSON_TYPE_OBJECT:
         for (i = 0; i < value->data.object.npairs; i++) {
-            VIR_FREE(value->data.object.pairs[i].key);
+            if (!value->arena)
+                VIR_FREE(value->data.object.pairs[i].key);
             virJSONValueFree(value->data.object.pairs[i].value);
         }
         VIR_FREE(value->data.object.pairs);
+        VIR_FREE(value->data.object.index);
         break;
     case VIR_JSON_TYPE_ARRAY:
         for (i = 0; i < value->data.array.nvalues; i++)
@@ -82,74 +223,84 @@ void virJSONValueFree(virJSONValuePtr value)
         VIR_FREE(value->data.array.values);
         break;
     case VIR_JSON_TYPE_STRING:
-        VIR_FREE(value->data.string);
+        if (!value->arena)
+            VIR_FREE(value->data.string);
         break;
     case VIR_JSON_TYPE_NUMBER:
-        VIR_FREE(value->data.number);
+        if (!value->arena)
+            VIR_FREE(value->data.number);
         break;
     case VIR_JSON_TYPE_BOOLEAN:
     case VIR_JSON_TYPE_NULL:
         break;
     }
 
-    VIR_FREE(value);
+    if (!value->arena)
+        VIR_FREE(value);
+    else if (value->arena->root == value)
+        virJSONArenaFree(value->arena);
 }
 
 
-virJSONValuePtr virJSONValueNewString(const char *data)
+static virJSONValuePtr
+virJSONValueNewStringInternal(virJSONArenaPtr arena,
+                              const char *data,
+                              size_t length)
 {
     virJSONValuePtr val;
 
-    if (!data)
-        return virJSONValueNewNull();
-
-    if (VIR_ALLOC(val) < 0)
+    if (!(val = virJSONValueNewInternal(arena, VIR_JSON_TYPE_STRING)))
         return NULL;
 
-    val->type = VIR_JSON_TYPE_STRING;
-    if (VIR_STRDUP(val->data.string, data) < 0) {
-        VIR_FREE(val);
+    if (!(val->data.string = virJSONStrndup(arena, data, length))) {
+        if (!arena)
+            VIR_FREE(val);
         return NULL;
     }
 
     return val;
 }
 
-virJSONValuePtr virJSONValueNewStringLen(const char *data, size_t length)
+virJSONValuePtr virJSONValueNewString(const char *data)
 {
-    virJSONValuePtr val;
-
     if (!data)
         return virJSONValueNewNull();
 
-    if (VIR_ALLOC(val) < 0)
-        return NULL;
+    return virJSONValueNewStringInternal(NULL, data, strlen(data));
+}
 
-    val->type = VIR_JSON_TYPE_STRING;
-    if (VIR_STRNDUP(val->data.string, data, length) < 0) {
-        VIR_FREE(val);
-        return NULL;
-    }
+virJSONValuePtr virJSONValueNewStringLen(const char *data, size_t length)
+{
+    if (!data)
+        return virJSONValueNewNull();
 
-    return val;
+    return virJSONValueNewStringInternal(NULL, data, length);
 }
 
-static virJSONValuePtr virJSONValueNewNumber(const char *data)
+static virJSONValuePtr
+virJSONValueNewNumberInternal(virJSONArenaPtr arena,
+                              const char *data,
+                              size_t length)
 {
     virJSONValuePtr val;
 
-    if (VIR_ALLOC(val) < 0)
+    if (!(val = virJSONValueNewInternal(arena, VIR_JSON_TYPE_NUMBER)))
         return NULL;
 
-    val->type = VIR_JSON_TYPE_NUMBER;
-    if (VIR_STRDUP(val->data.number, data) < 0) {
-        VIR_FREE(val);
+    if (!(val->data.number = virJSONStrndup(arena, data, length))) {
+        if (!arena)
+            VIR_FREE(val);
         return NULL;
     }
 
     return val;
 }
 
+static virJSONValuePtr virJSONValueNewNumber(const char *data)
+{
+    return virJSONValueNewNumberInternal(NULL, data, strlen(data));
+}
+
 virJSONValuePtr virJSONValueNewNumberInt(int data)
 {
     virJSONValuePtr val = NULL;
@@ -214,10 +365,9 @@ virJSONValuePtr virJSONValueNewBoolean(int boolean_)
 {
     virJSONValuePtr val;
 
-    if (VIR_ALLOC(val) < 0)
+    if (!(val = virJSONValueNewInternal(NULL, VIR_JSON_TYPE_BOOLEAN)))
         return NULL;
 
-    val->type = VIR_JSON_TYPE_BOOLEAN;
     val->data.boolean = boolean_;
 
     return val;
@@ -225,40 +375,145 @@ virJSONValuePtr virJSONValueNewBoolean(int boolean_)
 
 virJSONValuePtr virJSONValueNewNull(void)
 {
-    virJSONValuePtr val;
+    return virJSONValueNewInternal(NULL, VIR_JSON_TYPE_NULL);
+}
 
-    if (VIR_ALLOC(val) < 0)
-        return NULL;
+virJSONValuePtr virJSONValueNewArray(void)
+{
+    return virJSONValueNewInternal(NULL, VIR_JSON_TYPE_ARRAY);
+}
 
-    val->type = VIR_JSON_TYPE_NULL;
+virJSONValuePtr virJSONValueNewObject(void)
+{
+    return virJSONValueNewInternal(NULL, VIR_JSON_TYPE_OBJECT);
+}
 
-    return val;
+
+/*
+ * Objects with this many keys get a hash index on top of the pairs
+ * array, so that lookups in big replies (query-commands, guest agent
+ * listings, ...) don't degrade to a linear scan per key.  Keys are
+ * chosen by QEMU or even the guest, hence the random seed.
+ */
+#define VIR_JSON_OBJECT_INDEX_MIN 16
+
+static uint32_t virJSONObjectIndexSeed;
+
+static int virJSONObjectIndexOnceInit(void)
+{
+    virJSONObjectIndexSeed = virRandomBits(32);
+    return 0;
 }
 
-virJSONValuePtr virJSONValueNewArray(void)
+VIR_ONCE_GLOBAL_INIT(virJSONObjectIndex)
+
+
+static uint32_t
+virJSONObjectIndexHash(const char *key)
 {
-    virJSONValuePtr val;
+    return virHashCodeGen(key, strlen(key), virJSONObjectIndexSeed);
+}
 
-    if (VIR_ALLOC(val) < 0)
-        return NULL;
 
-    val->type = VIR_JSON_TYPE_ARRAY;
+static void
+virJSONObjectIndexInsert(virJSONObjectPtr object,
+                         size_t pos)
+{
+    size_t mask = object->nindex - 1;
+    size_t i = virJSONObjectIndexHash(object->pairs[pos].key) & mask;
 
-    return val;
+    while (object->index[i])
+        i = (i + 1) & mask;
+    object->index[i] = pos + 1;
 }
 
-virJSONValuePtr virJSONValueNewObject(void)
+
+/* (Re)build the index so that it has room for twice the current
+ * number of pairs, or drop it if the object became small again */
+static int
+virJSONObjectIndexRebuild(virJSONObjectPtr object)
 {
-    virJSONValuePtr val;
+    size_t nindex = VIR_JSON_OBJECT_INDEX_MIN * 2;
+    size_t i;
 
-    if (VIR_ALLOC(val) < 0)
-        return NULL;
+    VIR_FREE(object->index);
+    object->nindex = 0;
 
-    val->type = VIR_JSON_TYPE_OBJECT;
+    if (object->npairs < VIR_JSON_OBJECT_INDEX_MIN)
+        return 0;
 
-    return val;
+    if (virJSONObjectIndexInitialize() < 0)
+        return -1;
+
+    while (nindex < object->npairs * 2)
+        nindex *= 2;
+
+    if (VIR_ALLOC_N(object->index, nindex) < 0)
+        return -1;
+    object->nindex = nindex;
+
+    for (i = 0; i < object->npairs; i++)
+        virJSONObjectIndexInsert(object, i);
+
+    return 0;
+}
+
+
+/* Returns the position of @key within @object, or -1 */
+static ssize_t
+virJSONObjectFind(virJSONObjectPtr object,
+                  const char *key)
+{
+    size_t i;
+
+    if (object->index) {
+        size_t mask = object->nindex - 1;
+
+        for (i = virJSONObjectIndexHash(key) & mask;
+             object->index[i];
+             i = (i + 1) & mask) {
+            size_t pos = object->index[i] - 1;
+            if (STREQ(object->pairs[pos].key, key))
+                return pos;
+        }
+        return -1;
+    }
+
+    for (i = 0; i < object->npairs; i++) {
+        if (STREQ(object->pairs[i].key, key))
+            return i;
+    }
+
+    return -1;
 }
 
+
+/* Append a pair to @object, taking ownership of @key only on success */
+static int
+virJSONObjectAppendPair(virJSONObjectPtr object,
+                        char *key,
+                        virJSONValuePtr value)
+{
+    if (VIR_RESIZE_N(object->pairs, object->npairs_max,
+                     object->npairs, 1) < 0)
+        return -1;
+
+    object->pairs[object->npairs].key = key;
+    object->pairs[object->npairs].value = value;
+    object->npairs++;
+
+    if (object->index && object->npairs * 2 <= object->nindex) {
+        virJSONObjectIndexInsert(object, object->npairs - 1);
+    } else if (object->npairs >= VIR_JSON_OBJECT_INDEX_MIN) {
+        /* A missing index only costs speed, so don't fail over it */
+        if (virJSONObjectIndexRebuild(object) < 0)
+            virResetLastError();
+    }
+
+    return 0;
+}
+
+
 int virJSONValueObjectAppend(virJSONValuePtr object, const char *key, virJSONValuePtr value)
 {
     char *newkey;
@@ -269,19 +524,15 @@ int virJSONValueObjectAppend(virJSONValuePtr object, const char *key, virJSONVal
     if (virJSONValueObjectHasKey(object, key))
         return -1;
 
-    if (VIR_STRDUP(newkey, key) < 0)
+    if (!(newkey = virJSONStrndup(object->arena, key, strlen(key))))
         return -1;
 
-    if (VIR_REALLOC_N(object->data.object.pairs,
-                      object->data.object.npairs + 1) < 0) {
-        VIR_FREE(newkey);
+    if (virJSONObjectAppendPair(&object->data.object, newkey, value) < 0) {
+        if (!object->arena)
+            VIR_FREE(newkey);
         return -1;
     }
 
-    object->data.object.pairs[object->data.object.npairs].key = newkey;
-    object->data.object.pairs[object->data.object.npairs].value = value;
-    object->data.object.npairs++;
-
     return 0;
 }
 
@@ -389,8 +640,8 @@ int virJSONValueArrayAppend(virJSONValuePtr array, virJSONValuePtr value)
     if (array->type != VIR_JSON_TYPE_ARRAY)
         return -1;
 
-    if (VIR_REALLOC_N(array->data.array.values,
-                      array->data.array.nvalues + 1) < 0)
+    if (VIR_RESIZE_N(array->data.array.values, array->data.array.nvalues_max,
+                     array->data.array.nvalues, 1) < 0)
         return -1;
 
     array->data.array.values[array->data.array.nvalues] = value;
@@ -401,32 +652,23 @@ int virJSONValueArrayAppend(virJSONValuePtr array, virJSONValuePtr value)
 
 int virJSONValueObjectHasKey(virJSONValuePtr object, const char *key)
 {
-    size_t i;
-
     if (object->type != VIR_JSON_TYPE_OBJECT)
         return -1;
 
-    for (i = 0; i < object->data.object.npairs; i++) {
-        if (STREQ(object->data.object.pairs[i].key, key))
-            return 1;
-    }
-
-    return 0;
+    return virJSONObjectFind(&object->data.object, key) >= 0;
 }
 
 virJSONValuePtr virJSONValueObjectGet(virJSONValuePtr object, const char *key)
 {
-    size_t i;
+    ssize_t pos;
 
     if (object->type != VIR_JSON_TYPE_OBJECT)
         return NULL;
 
-    for (i = 0; i < object->data.object.npairs; i++) {
-        if (STREQ(object->data.object.pairs[i].key, key))
-            return object->data.object.pairs[i].value;
-    }
+    if ((pos = virJSONObjectFind(&object->data.object, key)) < 0)
+        return NULL;
 
-    return NULL;
+    return object->data.object.pairs[pos].value;
 }
 
 int virJSONValueObjectKeysNumber(virJSONValuePtr object)
@@ -448,14 +690,75 @@ const char *virJSONValueObjectGetKey(virJSONValuePtr object, unsigned int n)
     return object->data.object.pairs[n].key;
 }
 
+/* Deep copy @in to the heap, so that the copy can outlive the arena
+ * @in was allocated from */
+static virJSONValuePtr
+virJSONValueCopyToHeap(virJSONValuePtr in)
+{
+    virJSONValuePtr out = NULL;
+    virJSONValuePtr child;
+    size_t i;
+
+    switch ((virJSONType) in->type) {
+    case VIR_JSON_TYPE_OBJECT:
+        if (!(out = virJSONValueNewObject()))
+            return NULL;
+        for (i = 0; i < in->data.object.npairs; i++) {
+            if (!(child = virJSONValueCopyToHeap(in->data.object.pairs[i].value)))
+                goto error;
+            if (virJSONValueObjectAppend(out, in->data.object.pairs[i].key,
+                                         child) < 0) {
+                virJSONValueFree(child);
+                goto error;
+            }
+        }
+        break;
+    case VIR_JSON_TYPE_ARRAY:
+        if (!(out = virJSONValueNewArray()))
+            return NULL;
+        for (i = 0; i < in->data.array.nvalues; i++) {
+            if (!(child = virJSONValueCopyToHeap(in->data.array.values[i])))
+                goto error;
+            if (virJSONValueArrayAppend(out, child) < 0) {
+                virJSONValueFree(child);
+                goto error;
+            }
+        }
+        break;
+    case VIR_JSON_TYPE_STRING:
+        out = virJSONValueNewString(in->data.string);
+        break;
+    case VIR_JSON_TYPE_NUMBER:
+        out = virJSONValueNewNumber(in->data.number);
+        break;
+    case VIR_JSON_TYPE_BOOLEAN:
+        out = virJSONValueNewBoolean(in->data.boolean);
+        break;
+    case VIR_JSON_TYPE_NULL:
+        out = virJSONValueNewNull();
+        break;
+    }
+
+    return out;
+
+error:
+    virJSONValueFree(out);
+    return NULL;
+}
+
+
 /* Remove the key-value pair tied to @key out of @object.  If @value is
  * not NULL, the dropped value object is returned instead of freed.
+ * Values living in a parser arena are handed out as a heap copy, as
+ * the arena goes away with the rest of the tree.
  * Returns 1 on success, 0 if no key was found, and -1 on error.  */
 int
 virJSONValueObjectRemoveKey(virJSONValuePtr object, const char *key,
                             virJSONValuePtr *value)
 {
-    size_t i;
+    virJSONObjectPtr obj = &object->data.object;
+    virJSONValuePtr val;
+    ssize_t pos;
 
     if (value)
         *value = NULL;
@@ -463,21 +766,29 @@ virJSONValueObjectRemoveKey(virJSONValuePtr object, const char *key,
     if (object->type != VIR_JSON_TYPE_OBJECT)
         return -1;
 
-    for (i = 0; i < object->data.object.npairs; i++) {
-        if (STREQ(object->data.object.pairs[i].key, key)) {
-            if (value) {
-                *value = object->data.object.pairs[i].value;
-                object->data.object.pairs[i].value = NULL;
-            }
-            VIR_FREE(object->data.object.pairs[i].key);
-            virJSONValueFree(object->data.object.pairs[i].value);
-            VIR_DELETE_ELEMENT(object->data.object.pairs, i,
-                               object->data.object.npairs);
-            return 1;
+    if ((pos = virJSONObjectFind(obj, key)) < 0)
+        return 0;
+
+    val = obj->pairs[pos].value;
+    if (value) {
+        if (val->arena) {
+            if (!(*value = virJSONValueCopyToHeap(val)))
+                return -1;
+        } else {
+            *value = val;
+            val = NULL;
         }
     }
 
-    return 0;
+    if (!object->arena)
+        VIR_FREE(obj->pairs[pos].key);
+    virJSONValueFree(val);
+    VIR_DELETE_ELEMENT_INPLACE(obj->pairs, pos, obj->npairs);
+
+    if (obj->index && virJSONObjectIndexRebuild(obj) < 0)
+        virResetLastError();
+
+    return 1;
 }
 
 virJSONValuePtr virJSONValueObjectGetValue(virJSONValuePtr object, unsigned int n)
@@ -693,11 +1004,30 @@ int virJSONValueObjectIsNull(virJSONValuePtr object, const char *key)
 
 
 #if WITH_YAJL
+static virJSONArenaPtr
+virJSONArenaNew(size_t hint)
+{
+    virJSONArenaPtr arena;
+
+    if (VIR_ALLOC(arena) < 0)
+        return NULL;
+
+    if (virJSONArenaAddChunk(arena, MAX(hint, VIR_JSON_ARENA_CHUNK_SIZE)) < 0) {
+        VIR_FREE(arena);
+        return NULL;
+    }
+
+    return arena;
+}
+
+
 static int virJSONParserInsertValue(virJSONParserPtr parser,
                                     virJSONValuePtr value)
 {
     if (!parser->head) {
         parser->head = value;
+        if (parser->arena)
+            parser->arena->root = value;
     } else {
         virJSONParserStatePtr state;
         if (!parser->nstate) {
@@ -714,12 +1044,17 @@ static int virJSONParserInsertValue(virJSONParserPtr parser,
                 return -1;
             }
 
-            if (virJSONValueObjectAppend(state->value,
-                                         state->key,
-                                         value) < 0)
+            if (virJSONObjectFind(&state->value->data.object,
+                                  state->key) >= 0) {
+                VIR_DEBUG("duplicate key '%s' in object", state->key);
+                return -1;
+            }
+
+            if (virJSONObjectAppendPair(&state->value->data.object,
+                                        state->key, value) < 0)
                 return -1;
 
-            VIR_FREE(state->key);
+            state->key = NULL;
         }   break;
 
         case VIR_JSON_TYPE_ARRAY: {
@@ -742,10 +1077,20 @@ static int virJSONParserInsertValue(virJSONParserPtr parser,
     return 0;
 }
 
+static void virJSONParserStateFreeKey(virJSONParserPtr parser,
+                                      virJSONParserStatePtr state)
+{
+    if (parser->arena)
+        state->key = NULL;
+    else
+        VIR_FREE(state->key);
+}
+
 static int virJSONParserHandleNull(void *ctx)
 {
     virJSONParserPtr parser = ctx;
-    virJSONValuePtr value = virJSONValueNewNull();
+    virJSONValuePtr value = virJSONValueNewInternal(parser->arena,
+                                                    VIR_JSON_TYPE_NULL);
 
     VIR_DEBUG("parser=%p", parser);
 
@@ -763,12 +1108,14 @@ static int virJSONParserHandleNull(void *ctx)
 static int virJSONParserHandleBoolean(void *ctx, int boolean_)
 {
     virJSONParserPtr parser = ctx;
-    virJSONValuePtr value = virJSONValueNewBoolean(boolean_);
+    virJSONValuePtr value = virJSONValueNewInternal(parser->arena,
+                                                    VIR_JSON_TYPE_BOOLEAN);
 
     VIR_DEBUG("parser=%p boolean=%d", parser, boolean_);
 
     if (!value)
         return 0;
+    value->data.boolean = boolean_;
 
     if (virJSONParserInsertValue(parser, value) < 0) {
         virJSONValueFree(value);
@@ -783,15 +1130,10 @@ static int virJSONParserHandleNumber(void *ctx,
                                      yajl_size_t l)
 {
     virJSONParserPtr parser = ctx;
-    char *str;
-    virJSONValuePtr value;
+    virJSONValuePtr value = virJSONValueNewNumberInternal(parser->arena, s, l);
 
-    if (VIR_STRNDUP(str, s, l) < 0)
-        return -1;
-    value = virJSONValueNewNumber(str);
-    VIR_FREE(str);
-
-    VIR_DEBUG("parser=%p str=%s", parser, str);
+    VIR_DEBUG("parser=%p str=%s", parser,
+              NULLSTR(value ? value->data.number : NULL));
 
     if (!value)
         return 0;
@@ -809,8 +1151,9 @@ static int virJSONParserHandleString(void *ctx,
                                      yajl_size_t stringLen)
 {
     virJSONParserPtr parser = ctx;
-    virJSONValuePtr value = virJSONValueNewStringLen((const char *)stringVal,
-                                                     stringLen);
+    virJSONValuePtr value = virJSONValueNewStringInternal(parser->arena,
+                                                          (const char *)stringVal,
+                                                          stringLen);
 
     VIR_DEBUG("parser=%p str=%p", parser, (const char *)stringVal);
 
@@ -840,7 +1183,8 @@ static int virJSONParserHandleMapKey(void *ctx,
     state = &parser->state[parser->nstate-1];
     if (state->key)
         return 0;
-    if (VIR_STRNDUP(state->key, (const char *)stringVal, stringLen) < 0)
+    if (!(state->key = virJSONStrndup(parser->arena,
+                                      (const char *)stringVal, stringLen)))
         return 0;
     return 1;
 }
@@ -848,7 +1192,8 @@ static int virJSONParserHandleMapKey(void *ctx,
 static int virJSONParserHandleStartMap(void *ctx)
 {
     virJSONParserPtr parser = ctx;
-    virJSONValuePtr value = virJSONValueNewObject();
+    virJSONValuePtr value = virJSONValueNewInternal(parser->arena,
+                                                    VIR_JSON_TYPE_OBJECT);
 
     VIR_DEBUG("parser=%p", parser);
 
@@ -885,7 +1230,7 @@ static int virJSONParserHandleEndMap(void *ctx)
 
     state = &(parser->state[parser->nstate-1]);
     if (state->key) {
-        VIR_FREE(state->key);
+        virJSONParserStateFreeKey(parser, state);
         return 0;
     }
 
@@ -900,7 +1245,8 @@ static int virJSONParserHandleEndMap(void *ctx)
 static int virJSONParserHandleStartArray(void *ctx)
 {
     virJSONParserPtr parser = ctx;
-    virJSONValuePtr value = virJSONValueNewArray();
+    virJSONValuePtr value = virJSONValueNewInternal(parser->arena,
+                                                    VIR_JSON_TYPE_ARRAY);
 
     VIR_DEBUG("parser=%p", parser);
 
@@ -935,7 +1281,7 @@ static int virJSONParserHandleEndArray(void *ctx)
 
     state = &(parser->state[parser->nstate-1]);
     if (state->key) {
-        VIR_FREE(state->key);
+        virJSONParserStateFreeKey(parser, state);
         return 0;
     }
 
@@ -963,10 +1309,12 @@ static const yajl_callbacks parserCallbacks = {
 
 
 /* XXX add an incremental streaming parser - yajl trivially supports it */
-virJSONValuePtr virJSONValueFromString(const char *jsonstring)
+static virJSONValuePtr
+virJSONValueFromStringInternal(const char *jsonstring,
+                               bool useArena)
 {
     yajl_handle hand;
-    virJSONParser parser = { NULL, NULL, 0 };
+    virJSONParser parser = { NULL, NULL, 0, NULL };
     virJSONValuePtr ret = NULL;
 # ifndef WITH_YAJL2
     yajl_parser_config cfg = { 1, 1 };
@@ -974,6 +1322,11 @@ virJSONValuePtr virJSONValueFromString(const char *jsonstring)
 
     VIR_DEBUG("string=%s", jsonstring);
 
+    /* The tree is usually about twice the size of its text */
+    if (useArena &&
+        !(parser.arena = virJSONArenaNew(strlen(jsonstring) * 2)))
+        return NULL;
+
 # ifdef WITH_YAJL2
     hand = yajl_alloc(&parserCallbacks, NULL, &parser);
     if (hand) {
@@ -1019,16 +1372,42 @@ cleanup:
     if (parser.nstate) {
         size_t i;
         for (i = 0; i < parser.nstate; i++)
-            VIR_FREE(parser.state[i].key);
+            virJSONParserStateFreeKey(&parser, &parser.state[i]);
         VIR_FREE(parser.state);
     }
 
+    /* Otherwise the arena was released along with the root value */
+    if (!parser.head)
+        virJSONArenaFree(parser.arena);
+
     VIR_DEBUG("result=%p", parser.head);
 
     return ret;
 }
 
 
+virJSONValuePtr virJSONValueFromString(const char *jsonstring)
+{
+    return virJSONValueFromStringInternal(jsonstring, false);
+}
+
+
+/**
+ * virJSONValueFromStringArena:
+ * @jsonstring: the string to parse
+ *
+ * Like virJSONValueFromString, but allocates the resulting tree out
+ * of a single arena which is released by virJSONValueFree on the
+ * root.  This is meant for short lived trees, e.g. monitor replies.
+ * The tree may be modified as usual, but freeing any value other than
+ * the root only releases the heap parts it holds.
+ */
+virJSONValuePtr virJSONValueFromStringArena(const char *jsonstring)
+{
+    return virJSONValueFromStringInternal(jsonstring, true);
+}
+
+
 static int virJSONValueToStringOne(virJSONValuePtr object,
                                    yajl_gen g)
 {
@@ -1149,6 +1528,12 @@ virJSONValuePtr virJSONValueFromString(const char *jsonstring ATTRIBUTE_UNUSED)
                    _("No JSON parser implementation is available"));
     return NULL;
 }
+virJSONValuePtr virJSONValueFromStringArena(const char *jsonstring ATTRIBUTE_UNUSED)
+{
+    virReportError(VIR_ERR_INTERNAL_ERROR, "%s",
+                   _("No JSON parser implementation is available"));
+    return NULL;
+}
 char *virJSONValueToString(virJSONValuePtr object ATTRIBUTE_UNUSED,
                            bool pretty ATTRIBUTE_UNUSED)
 {
@@ -48,6 +48,9 @@ typedef virJSONObjectPair *virJSONObjectPairPtr;
 typedef struct _virJSONArray virJSONArray;
 typedef virJSONArray *virJSONArrayPtr;
 
+typedef struct _virJSONArena virJSONArena;
+typedef virJSONArena *virJSONArenaPtr;
+
 
 struct _virJSONObjectPair {
     char *key;
@@ -56,17 +59,26 @@ struct _virJSONObjectPair {
 
 struct _virJSONObject {
     size_t npairs;
+    size_t npairs_max;
     virJSONObjectPairPtr pairs;
+    /* Open addressing table of pair positions + 1, only
+     * maintained for objects with many keys */
+    size_t nindex;
+    size_t *index;
 };
 
 struct _virJSONArray {
     size_t nvalues;
+    size_t nvalues_max;
     virJSONValuePtr *values;
 };
 
 struct _virJSONValue {
     int type; /* enum virJSONType */
     bool protect; /* prevents deletion when embedded in another object */
+    /* If set, the value itself, its string data and (for objects)
+     * its keys were carved out of this arena by the parser */
+    virJSONArenaPtr arena;
 
     union {
         virJSONObject object;
@@ -136,6 +148,7 @@ int virJSONValueObjectRemoveKey(virJSONValuePtr object, const char *key,
     ATTRIBUTE_NONNULL(1) ATTRIBUTE_NONNULL(2);
 
 virJSONValuePtr virJSONValueFromString(const char *jsonstring);
+virJSONValuePtr virJSONValueFromStringArena(const char *jsonstring);
 char *virJSONValueToString(virJSONValuePtr object,
                            bool pretty);
 
@@ -29,6 +29,7 @@
 #include "virerror.h"
 #include "virlog.h"
 #include "virstring.h"
+#include "virbuffer.h"
 
 #define VIR_FROM_THIS VIR_FROM_NONE
 
@@ -36,19 +37,46 @@ static unsigned int magicCounter = 0xCAFE0000;
 
 struct _virClass {
     virClassPtr parent;
+    virClassPtr next; /* link in the list of all registered classes */
 
     unsigned int magic;
     char *name;
     size_t objectSize;
 
     virObjectDisposeCallback dispose;
+
+    /* Allocation statistics, updated atomically */
+    int live;      /* instances currently referenced */
+    int allocated; /* instances handed out so far (may wrap) */
+    int reused;    /* ... of which were taken from the pool */
+
+    /* Free list of disposed instances, only if poolSize > 0 */
+    virMutex poolLock;
+    size_t poolSize;
+    size_t npool;
+    void **pool;
 };
 
 static virClassPtr virObjectClass;
 static virClassPtr virObjectLockableClass;
 
+static virMutex virClassListLock;
+static virClassPtr virClassList;
+
 static void virObjectLockableDispose(void *anyobj);
 
+static int virClassListOnceInit(void)
+{
+    if (virMutexInit(&virClassListLock) < 0) {
+        virReportSystemError(errno, "%s",
+                             _("Unable to initialize mutex"));
+        return -1;
+    }
+    return 0;
+}
+
+VIR_ONCE_GLOBAL_INIT(virClassList);
+
 static int virObjectOnceInit(void)
 {
     if (!(virObjectClass = virClassNew(NULL,
@@ -117,9 +145,40 @@ virClassPtr virClassNew(virClassPtr parent,
                         const char *name,
                         size_t objectSize,
                         virObjectDisposeCallback dispose)
+{
+    return virClassNewPooled(parent, name, objectSize, dispose, 0);
+}
+
+
+/**
+ * virClassNewPooled:
+ * @parent: the parent class
+ * @name: the class name
+ * @objectSize: total size of the object struct
+ * @dispose: callback to run to free object fields
+ * @poolSize: maximum number of disposed instances to keep around
+ *
+ * Like virClassNew, but instead of freeing the memory of
+ * disposed instances, keep up to @poolSize of them on a
+ * per-class free list and hand them out again from
+ * virObjectNew. This is meant for classes which are
+ * created and destroyed at a high rate, such as the
+ * public API handles or events. A @poolSize of 0 disables
+ * pooling.
+ *
+ * Returns a new class instance
+ */
+virClassPtr virClassNewPooled(virClassPtr parent,
+                              const char *name,
+                              size_t objectSize,
+                              virObjectDisposeCallback dispose,
+                              size_t poolSize)
 {
     virClassPtr klass;
 
+    if (virClassListInitialize() < 0)
+        return NULL;
+
     if (parent == NULL &&
         STRNEQ(name, "virObject")) {
         virReportInvalidNonNullArg(parent);
@@ -142,9 +201,29 @@ virClassPtr virClassNew(virClassPtr parent,
     klass->objectSize = objectSize;
     klass->dispose = dispose;
 
+    if (poolSize) {
+        if (VIR_ALLOC_N(klass->pool, poolSize) < 0)
+            goto error;
+        if (virMutexInit(&klass->poolLock) < 0) {
+            virReportSystemError(errno, "%s",
+                                 _("Unable to initialize mutex"));
+            goto error;
+        }
+        klass->poolSize = poolSize;
+    }
+
+    virMutexLock(&virClassListLock);
+    klass->next = virClassList;
+    virClassList = klass;
+    virMutexUnlock(&virClassListLock);
+
     return klass;
 
 error:
+    if (klass) {
+        VIR_FREE(klass->pool);
+        VIR_FREE(klass->name);
+    }
     VIR_FREE(klass);
     return NULL;
 }
@@ -187,10 +266,24 @@ void *virObjectNew(virClassPtr klass)
 {
     virObjectPtr obj = NULL;
 
-    if (VIR_ALLOC_VAR(obj,
-                      char,
-                      klass->objectSize - sizeof(virObject)) < 0)
+    if (klass->poolSize) {
+        virMutexLock(&klass->poolLock);
+        if (klass->npool)
+            obj = klass->pool[--klass->npool];
+        virMutexUnlock(&klass->poolLock);
+    }
+
+    /* Pooled instances were cleared when they were disposed */
+    if (obj) {
+        virAtomicIntInc(&klass->reused);
+    } else if (VIR_ALLOC_VAR(obj,
+                             char,
+                             klass->objectSize - sizeof(virObject)) < 0) {
         return NULL;
+    }
+
+    virAtomicIntInc(&klass->allocated);
+    virAtomicIntInc(&klass->live);
 
     obj->u.s.magic = klass->magic;
     obj->klass = klass;
@@ -256,7 +349,8 @@ bool virObjectUnref(void *anyobj)
     PROBE(OBJECT_UNREF, "obj=%p", obj);
     if (lastRef) {
         PROBE(OBJECT_DISPOSE, "obj=%p", obj);
-        virClassPtr klass = obj->klass;
+        virClassPtr objklass = obj->klass;
+        virClassPtr klass = objklass;
         while (klass) {
             if (klass->dispose)
                 klass->dispose(obj);
@@ -264,9 +358,20 @@ bool virObjectUnref(void *anyobj)
         }
 
         /* Clear & poison object */
-        memset(obj, 0, obj->klass->objectSize);
+        memset(obj, 0, objklass->objectSize);
         obj->u.s.magic = 0xDEADBEEF;
         obj->klass = (void*)0xDEADBEEF;
+
+        virAtomicIntAdd(&objklass->live, -1);
+
+        if (objklass->poolSize) {
+            virMutexLock(&objklass->poolLock);
+            if (objklass->npool < objklass->poolSize) {
+                objklass->pool[objklass->npool++] = obj;
+                obj = NULL;
+            }
+            virMutexUnlock(&objklass->poolLock);
+        }
         VIR_FREE(obj);
     }
 
@@ -387,3 +492,49 @@ void virObjectFreeCallback(void *opaque)
 {
     virObjectUnref(opaque);
 }
+
+
+/**
+ * virObjectStatsFormat:
+ * @buf: buffer to format into
+ *
+ * Append one line per registered class to @buf, giving
+ * the number of live instances, the number of instances
+ * allocated so far, how many of those were recycled from
+ * the class pool and how many are sitting in the pool now.
+ * Classes which never had any instance are skipped.
+ *
+ * This is a debugging aid for spotting leaks and
+ * allocation churn in long running processes.
+ */
+void virObjectStatsFormat(virBufferPtr buf)
+{
+    virClassPtr klass;
+
+    if (virClassListInitialize() < 0)
+        return;
+
+    virMutexLock(&virClassListLock);
+    for (klass = virClassList; klass; klass = klass->next) {
+        size_t npool = 0;
+        unsigned int allocated = virAtomicIntGet(&klass->allocated);
+
+        if (!allocated)
+            continue;
+
+        if (klass->poolSize) {
+            virMutexLock(&klass->poolLock);
+            npool = klass->npool;
+            virMutexUnlock(&klass->poolLock);
+        }
+
+        virBufferAsprintf(buf, "%s: live=%d allocated=%u reused=%u "
+                          "pooled=%zu/%zu\n",
+                          klass->name,
+                          virAtomicIntGet(&klass->live),
+                          allocated,
+                          (unsigned int) virAtomicIntGet(&klass->reused),
+                          npool, klass->poolSize);
+    }
+    virMutexUnlock(&virClassListLock);
+}
@@ -24,6 +24,7 @@
 
 # include "internal.h"
 # include "virthread.h"
+# include "virbuffer.h"
 
 typedef struct _virClass virClass;
 typedef virClass *virClassPtr;
@@ -72,6 +73,13 @@ virClassPtr virClassNew(virClassPtr parent,
                         virObjectDisposeCallback dispose)
     VIR_PARENT_REQUIRED ATTRIBUTE_NONNULL(2);
 
+virClassPtr virClassNewPooled(virClassPtr parent,
+                              const char *name,
+                              size_t objectSize,
+                              virObjectDisposeCallback dispose,
+                              size_t poolSize)
+    VIR_PARENT_REQUIRED ATTRIBUTE_NONNULL(2);
+
 const char *virClassName(virClassPtr klass)
     ATTRIBUTE_NONNULL(1);
 
@@ -98,5 +106,8 @@ void virObjectLock(void *lockableobj)
 void virObjectUnlock(void *lockableobj)
     ATTRIBUTE_NONNULL(1);
 
+void virObjectStatsFormat(virBufferPtr buf)
+    ATTRIBUTE_NONNULL(1);
+
 
 #endif /* __VIR_OBJECT_H */
@@ -0,0 +1,178 @@
+/*
+ * virobjectindex.c: name and UUID index for driver object lists
+ *
+ * Copyright (C) 2014 Red Hat, Inc.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library.  If not, see
+ * <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#include <config.h>
+
+#include "virobjectindex.h"
+#include "virerror.h"
+#include "viruuid.h"
+
+#define VIR_FROM_THIS VIR_FROM_NONE
+
+
+/**
+ * virObjectIndexClear:
+ * @idx: the index
+ *
+ * Drop all entries. Lookups through @idx are not possible again
+ * until an object is added to an empty list.
+ */
+void
+virObjectIndexClear(virObjectIndexPtr idx)
+{
+    virHashFree(idx->byName);
+    virHashFree(idx->byUUID);
+    idx->byName = NULL;
+    idx->byUUID = NULL;
+}
+
+
+/**
+ * virObjectIndexIsValid:
+ * @idx: the index
+ *
+ * Returns true if @idx covers every object in the list, false if
+ * callers have to scan the list instead.
+ */
+bool
+virObjectIndexIsValid(virObjectIndexPtr idx)
+{
+    return idx->byName != NULL;
+}
+
+
+/**
+ * virObjectIndexAdd:
+ * @idx: the index
+ * @nobjs: number of objects in the list before @obj is added
+ * @uuid: UUID of @obj, or NULL if the object type has none
+ * @name: name of @obj, or NULL if it has none
+ * @obj: the object
+ *
+ * Record @obj under @name and @uuid. Failure is not reported to the
+ * caller; it only drops the index.
+ */
+void
+virObjectIndexAdd(virObjectIndexPtr idx,
+                  size_t nobjs,
+                  const unsigned char *uuid,
+                  const char *name,
+                  void *obj)
+{
+    char uuidstr[VIR_UUID_STRING_BUFLEN];
+
+    if (nobjs == 0 && !idx->byName) {
+        if (!(idx->byName = virHashCreate(16, NULL)) ||
+            !(idx->byUUID = virHashCreate(16, NULL)))
+            goto error;
+    }
+
+    if (!idx->byName)
+        return;
+
+    if (name && virHashUpdateEntry(idx->byName, name, obj) < 0)
+        goto error;
+
+    if (uuid) {
+        virUUIDFormat(uuid, uuidstr);
+        if (virHashUpdateEntry(idx->byUUID, uuidstr, obj) < 0)
+            goto error;
+    }
+
+    return;
+
+error:
+    virResetLastError();
+    virObjectIndexClear(idx);
+}
+
+
+/**
+ * virObjectIndexRemove:
+ * @idx: the index
+ * @uuid: UUID @obj was added with, or NULL
+ * @name: name @obj was added with, or NULL
+ * @obj: the object
+ *
+ * Forget @obj. Entries for @name and @uuid that refer to some other
+ * object are left alone.
+ */
+void
+virObjectIndexRemove(virObjectIndexPtr idx,
+                     const unsigned char *uuid,
+                     const char *name,
+                     void *obj)
+{
+    char uuidstr[VIR_UUID_STRING_BUFLEN];
+
+    if (!idx->byName)
+        return;
+
+    if (name && virHashLookup(idx->byName, name) == obj)
+        ignore_value(virHashRemoveEntry(idx->byName, name));
+
+    if (uuid) {
+        virUUIDFormat(uuid, uuidstr);
+        if (virHashLookup(idx->byUUID, uuidstr) == obj)
+            ignore_value(virHashRemoveEntry(idx->byUUID, uuidstr));
+    }
+}
+
+
+/**
+ * virObjectIndexFindByName:
+ * @idx: the index
+ * @name: name to look up
+ *
+ * Returns the unlocked object recorded under @name, or NULL. Only
+ * meaningful if virObjectIndexIsValid() is true.
+ */
+void *
+virObjectIndexFindByName(virObjectIndexPtr idx,
+                         const char *name)
+{
+    if (!idx->byName)
+        return NULL;
+
+    return virHashLookup(idx->byName, name);
+}
+
+
+/**
+ * virObjectIndexFindByUUID:
+ * @idx: the index
+ * @uuid: UUID to look up
+ *
+ * Returns the unlocked object recorded under @uuid, or NULL. Only
+ * meaningful if virObjectIndexIsValid() is true.
+ */
+void *
+virObjectIndexFindByUUID(virObjectIndexPtr idx,
+                         const unsigned char *uuid)
+{
+    char uuidstr[VIR_UUID_STRING_BUFLEN];
+
+    if (!idx->byUUID)
+        return NULL;
+
+    virUUIDFormat(uuid, uuidstr);
+    return virHashLookup(idx->byUUID, uuidstr);
+}
@@ -0,0 +1,74 @@
+/*
+ * virobjectindex.h: name and UUID index for driver object lists
+ *
+ * Copyright (C) 2014 Red Hat, Inc.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library.  If not, see
+ * <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#ifndef __VIR_OBJECT_INDEX_H__
+# define __VIR_OBJECT_INDEX_H__
+
+# include "internal.h"
+# include "virhash.h"
+
+/*
+ * Driver object lists (networks, nwfilters, interfaces, storage
+ * pools, node devices) keep their objects in a plain array so that
+ * iteration order stays stable, and embed one of these next to the
+ * array to answer name and UUID lookups without walking it.
+ *
+ * The index is purely an accelerator. It is created when the first
+ * object is added to an empty list. If updating it ever fails it is
+ * dropped, virObjectIndexIsValid() returns false, and callers fall
+ * back to scanning the array until the list is emptied again.
+ *
+ * Lookups return the object without locking it; callers must lock
+ * the object and then verify that its key still matches.
+ */
+typedef struct _virObjectIndex virObjectIndex;
+typedef virObjectIndex *virObjectIndexPtr;
+struct _virObjectIndex {
+    virHashTablePtr byName;
+    virHashTablePtr byUUID;
+};
+
+void virObjectIndexClear(virObjectIndexPtr idx);
+
+bool virObjectIndexIsValid(virObjectIndexPtr idx);
+
+void virObjectIndexAdd(virObjectIndexPtr idx,
+                       size_t nobjs,
+                       const unsigned char *uuid,
+                       const char *name,
+                       void *obj)
+    ATTRIBUTE_NONNULL(1) ATTRIBUTE_NONNULL(5);
+
+void virObjectIndexRemove(virObjectIndexPtr idx,
+                          const unsigned char *uuid,
+                          const char *name,
+                          void *obj)
+    ATTRIBUTE_NONNULL(1) ATTRIBUTE_NONNULL(4);
+
+void *virObjectIndexFindByName(virObjectIndexPtr idx,
+                               const char *name)
+    ATTRIBUTE_NONNULL(1) ATTRIBUTE_NONNULL(2);
+
+void *virObjectIndexFindByUUID(virObjectIndexPtr idx,
+                               const unsigned char *uuid)
+    ATTRIBUTE_NONNULL(1) ATTRIBUTE_NONNULL(2);
+
+#endif /* __VIR_OBJECT_INDEX_H__ */
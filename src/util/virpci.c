@@ -42,8 +42,11 @@
 #include "vircommand.h"
 #include "virerror.h"
 #include "virfile.h"
+#include "virhash.h"
 #include "virkmod.h"
 #include "virstring.h"
+#include "virthread.h"
+#include "virtime.h"
 #include "virutil.h"
 
 #define PCI_SYSFS "/sys/bus/pci/"
@@ -104,8 +107,14 @@ struct _virPCIDeviceList {
 #define PCI_HEADER_TYPE_MULTI  0x80
 
 /* PCI30 6.2.1  Device Identification */
+#define PCI_VENDOR_ID           0x00    /* 16 bits */
 #define PCI_CLASS_DEVICE        0x0a    /* Device class */
 
+/* Vendor IDs read back while a device is not ready after a reset.
+ * PCIe20 2.3.2  Configuration Request Retry Status */
+#define PCI_VENDOR_ID_INVALID   0xffff
+#define PCI_VENDOR_ID_CRS       0x0001
+
 /* Class Code for bridge; PCI30 D.7  Base Class 06h */
 #define PCI_CLASS_BRIDGE_PCI    0x0604
 
@@ -135,6 +144,12 @@ struct _virPCIDeviceList {
 /* BR12 3.2.5.18  Bridge Control Register */
 #define PCI_BRIDGE_CTL_RESET   0x40    /* Secondary bus reset */
 
+/* Reset timing, in milliseconds */
+#define PCI_RESET_ASSERT_MS         2     /* PCI30 4.3.2 Trst is 1ms */
+#define PCI_RESET_RECOVERY_MS       100   /* PCIe20 6.6.1 */
+#define PCI_RESET_READY_TIMEOUT_MS  1000  /* Further wait for readiness */
+#define PCI_POLL_MAX_DELAY_MS       64    /* Longest single poll interval */
+
 /* PM12 3.2.4  Power Management Control/Status (Offset = 4) */
 #define PCI_PM_CTRL                4    /* PM control and status register */
 #define PCI_PM_CTRL_STATE_MASK    0x3  /* Current power state (D0 to D3) */
@@ -170,6 +185,11 @@ struct _virPCIDeviceList {
 
 static virClassPtr virPCIDeviceListClass;
 
+/* Bridges with a secondary bus reset in progress, keyed by name */
+static virMutex virPCIBusResetLock;
+static virCond virPCIBusResetCond;
+static virHashTablePtr virPCIBusResets;
+
 static void virPCIDeviceListDispose(void *obj);
 
 static int virPCIOnceInit(void)
@@ -180,6 +200,16 @@ static int virPCIOnceInit(void)
                                               virPCIDeviceListDispose)))
         return -1;
 
+    if (virMutexInit(&virPCIBusResetLock) < 0 ||
+        virCondInit(&virPCIBusResetCond) < 0) {
+        virReportSystemError(errno, "%s",
+                             _("cannot initialize PCI bus reset lock"));
+        return -1;
+    }
+
+    if (!(virPCIBusResets = virHashCreate(8, NULL)))
+        return -1;
+
     return 0;
 }
 
@@ -761,6 +791,84 @@ virPCIDeviceGetParent(virPCIDevicePtr dev, virPCIDevicePtr *parent)
     return ret;
 }
 
+/* After a reset the device does not answer config requests, or
+ * answers them with a retry status, until it is done initializing.
+ * Poll its vendor ID with exponential backoff until it reads back a
+ * valid value, rather than sleeping for a fixed worst case time.
+ */
+static int
+virPCIDeviceWaitReady(virPCIDevicePtr dev, int cfgfd)
+{
+    unsigned long long start;
+    unsigned long long now;
+    unsigned int delay = 1;
+    uint16_t vendor;
+
+    if (virTimeMillisNow(&start) < 0)
+        return -1;
+
+    for (;;) {
+        vendor = virPCIDeviceRead16(dev, cfgfd, PCI_VENDOR_ID);
+        if (vendor != PCI_VENDOR_ID_INVALID &&
+            vendor != PCI_VENDOR_ID_CRS &&
+            vendor != 0)
+            break;
+
+        if (virTimeMillisNow(&now) < 0)
+            return -1;
+        if (now - start >= PCI_RESET_READY_TIMEOUT_MS) {
+            virReportError(VIR_ERR_INTERNAL_ERROR,
+                           _("PCI device %s is not ready %llums after reset"),
+                           dev->name, now - start);
+            return -1;
+        }
+
+        usleep(delay * 1000);
+        delay = MIN(delay * 2, PCI_POLL_MAX_DELAY_MS);
+    }
+
+    if (virTimeMillisNow(&now) == 0)
+        VIR_DEBUG("%s %s: ready %llums after reset",
+                  dev->id, dev->name, now - start);
+    return 0;
+}
+
+/* virPCIDeviceListReset keeps the devices below one root port in a
+ * single thread, but separate callers may still reset devices behind
+ * the same bridge at once, so claim the bridge for the duration of a
+ * secondary bus reset.
+ */
+static int
+virPCIDeviceClaimBridge(virPCIDevicePtr parent)
+{
+    int ret = -1;
+
+    virMutexLock(&virPCIBusResetLock);
+    while (virHashLookup(virPCIBusResets, parent->name)) {
+        if (virCondWait(&virPCIBusResetCond, &virPCIBusResetLock) < 0) {
+            virReportSystemError(errno, "%s",
+                                 _("cannot wait on condition"));
+            goto cleanup;
+        }
+    }
+    if (virHashAddEntry(virPCIBusResets, parent->name, parent) < 0)
+        goto cleanup;
+    ret = 0;
+
+cleanup:
+    virMutexUnlock(&virPCIBusResetLock);
+    return ret;
+}
+
+static void
+virPCIDeviceReleaseBridge(virPCIDevicePtr parent)
+{
+    virMutexLock(&virPCIBusResetLock);
+    virHashRemoveEntry(virPCIBusResets, parent->name);
+    virCondBroadcast(&virPCIBusResetCond);
+    virMutexUnlock(&virPCIBusResetLock);
+}
+
 /* Secondary Bus Reset is our sledgehammer - it resets all
  * devices behind a bus.
  */
@@ -774,6 +882,10 @@ virPCIDeviceTrySecondaryBusReset(virPCIDevicePtr dev,
     uint16_t ctl;
     int ret = -1;
     int parentfd;
+    bool claimed = false;
+
+    if (virPCIInitialize() < 0)
+        return -1;
 
     /* Refuse to do a secondary bus reset if there are other
      * devices/functions behind the bus are used by the host
@@ -798,6 +910,10 @@ virPCIDeviceTrySecondaryBusReset(virPCIDevicePtr dev,
     if ((parentfd = virPCIDeviceConfigOpen(parent, true)) < 0)
         goto out;
 
+    if (virPCIDeviceClaimBridge(parent) < 0)
+        goto out;
+    claimed = true;
+
     VIR_DEBUG("%s %s: doing a secondary bus reset", dev->id, dev->name);
 
     /* Save and restore the device's config space; we only do this
@@ -811,19 +927,22 @@ virPCIDeviceTrySecondaryBusReset(virPCIDevicePtr dev,
         goto out;
     }
 
-    /* Read the control register, set the reset flag, wait 200ms,
-     * unset the reset flag and wait 200ms.
+    /* Read the control register, set the reset flag, wait 2ms,
+     * unset the reset flag, then wait for the device to recover.
      */
     ctl = virPCIDeviceRead16(dev, cfgfd, PCI_BRIDGE_CONTROL);
 
     virPCIDeviceWrite16(parent, parentfd, PCI_BRIDGE_CONTROL,
                         ctl | PCI_BRIDGE_CTL_RESET);
 
-    usleep(200 * 1000); /* sleep 200ms */
+    usleep(PCI_RESET_ASSERT_MS * 1000);
 
     virPCIDeviceWrite16(parent, parentfd, PCI_BRIDGE_CONTROL, ctl);
 
-    usleep(200 * 1000); /* sleep 200ms */
+    usleep(PCI_RESET_RECOVERY_MS * 1000);
+
+    if (virPCIDeviceWaitReady(dev, cfgfd) < 0)
+        goto out;
 
     if (virPCIDeviceWrite(dev, cfgfd, 0, config_space, PCI_CONF_LEN) < 0) {
         virReportError(VIR_ERR_INTERNAL_ERROR,
@@ -834,6 +953,8 @@ virPCIDeviceTrySecondaryBusReset(virPCIDevicePtr dev,
     ret = 0;
 
 out:
+    if (claimed)
+        virPCIDeviceReleaseBridge(parent);
     virPCIDeviceConfigClose(parent, parentfd);
     virPCIDeviceFree(parent);
     return ret;
@@ -875,6 +996,9 @@ virPCIDeviceTryPowerManagementReset(virPCIDevicePtr dev, int cfgfd)
 
     usleep(10 * 1000); /* sleep 10ms */
 
+    if (virPCIDeviceWaitReady(dev, cfgfd) < 0)
+        return -1;
+
     if (virPCIDeviceWrite(dev, cfgfd, 0, &config_space[0], PCI_CONF_LEN) < 0) {
         virReportError(VIR_ERR_INTERNAL_ERROR,
                        _("Failed to restore PCI config space for %s"),
@@ -975,6 +1099,205 @@ cleanup:
 }
 
 
+typedef struct _virPCIDeviceResetGroup virPCIDeviceResetGroup;
+typedef virPCIDeviceResetGroup *virPCIDeviceResetGroupPtr;
+struct _virPCIDeviceResetGroup {
+    char *key;
+    virPCIDevicePtr *devs;
+    size_t ndevs;
+
+    virPCIDeviceListPtr activeDevs;
+    virPCIDeviceListPtr inactiveDevs;
+
+    virThread thread;
+    bool started;
+    int ret;
+    virErrorPtr err;
+};
+
+static void
+virPCIDeviceResetGroupRun(void *opaque)
+{
+    virPCIDeviceResetGroupPtr group = opaque;
+    size_t i;
+
+    for (i = 0; i < group->ndevs; i++) {
+        if (virPCIDeviceReset(group->devs[i], group->activeDevs,
+                              group->inactiveDevs) < 0) {
+            /* Keep the first error, log the others */
+            if (group->ret == 0) {
+                group->ret = -1;
+                group->err = virSaveLastError();
+            } else {
+                virErrorPtr err = virGetLastError();
+                VIR_ERROR(_("Failed to reset PCI device %s: %s"),
+                          group->devs[i]->name,
+                          err ? err->message : _("unknown error"));
+            }
+            virResetLastError();
+        }
+    }
+}
+
+/* A secondary bus reset reaches every bus below the bridge doing it,
+ * so two devices can only be reset independently if no bridge is above
+ * both of them. Name the group of @dev after the bridge closest to the
+ * root bus among its ancestors, or after its own bus if it has none.
+ */
+static int
+virPCIDeviceGetResetGroupKey(virPCIDevicePtr dev, char **key)
+{
+    virPCIDevicePtr top = NULL;
+    virPCIDevicePtr parent = NULL;
+    size_t depth;
+    int ret = -1;
+
+    *key = NULL;
+
+    /* Bus numbers are 8 bit, so a longer chain means a broken topology */
+    for (depth = 0; depth < 256; depth++) {
+        if (virPCIDeviceGetParent(top ? top : dev, &parent) < 0)
+            goto cleanup;
+        if (!parent)
+            break;
+        virPCIDeviceFree(top);
+        top = parent;
+        parent = NULL;
+    }
+    if (depth == 256) {
+        virReportError(VIR_ERR_INTERNAL_ERROR,
+                       _("Too many bridges above PCI device %s"),
+                       dev->name);
+        goto cleanup;
+    }
+
+    if (top) {
+        if (VIR_STRDUP(*key, top->name) < 0)
+            goto cleanup;
+    } else {
+        if (virAsprintf(key, "%.4x:%.2x", dev->domain, dev->bus) < 0)
+            goto cleanup;
+    }
+    ret = 0;
+
+cleanup:
+    virPCIDeviceFree(top);
+    return ret;
+}
+
+/**
+ * virPCIDeviceListReset:
+ * @list: devices to reset
+ * @activeDevs: devices in use by the host or guests
+ * @inactiveDevs: devices about to be assigned
+ *
+ * Reset every device of @list, as virPCIDeviceReset does.
+ *
+ * Devices below the same root port are reset one after another, since
+ * a secondary bus reset affects every bus below the bridge doing it.
+ * Devices below different root ports are independent and are reset in
+ * parallel. If the topology cannot be determined, all devices are
+ * reset one after another. Every device is attempted even if resetting
+ * an earlier one failed.
+ *
+ * Returns 0 on success, -1 with the first error reported if any device
+ * failed to reset.
+ */
+int
+virPCIDeviceListReset(virPCIDeviceListPtr list,
+                      virPCIDeviceListPtr activeDevs,
+                      virPCIDeviceListPtr inactiveDevs)
+{
+    virPCIDeviceResetGroupPtr groups = NULL;
+    size_t ngroups = 0;
+    size_t i, j;
+    char *key = NULL;
+    bool serial = false;
+    int ret = -1;
+
+    for (i = 0; i < list->count; i++) {
+        virPCIDevicePtr dev = list->devs[i];
+
+        if (!serial && virPCIDeviceGetResetGroupKey(dev, &key) < 0) {
+            virErrorPtr err = virGetLastError();
+            VIR_WARN("Unable to find the bridges above PCI device %s, "
+                     "not resetting devices in parallel: %s",
+                     dev->name, err ? err->message : _("unknown error"));
+            virResetLastError();
+            serial = true;
+        }
+
+        for (j = 0; j < ngroups; j++) {
+            if (STREQ_NULLABLE(groups[j].key, key))
+                break;
+        }
+        if (j == ngroups) {
+            if (VIR_EXPAND_N(groups, ngroups, 1) < 0)
+                goto cleanup;
+            groups[j].key = key;
+            key = NULL;
+            groups[j].activeDevs = activeDevs;
+            groups[j].inactiveDevs = inactiveDevs;
+        }
+        VIR_FREE(key);
+        if (VIR_APPEND_ELEMENT(groups[j].devs, groups[j].ndevs, dev) < 0)
+            goto cleanup;
+    }
+
+    VIR_DEBUG("Resetting %zu PCI devices in %zu groups%s",
+              list->count, ngroups, serial ? ", one after another" : "");
+
+    /* The calling thread handles the first group, and all of them if
+     * it is not known which ones are independent */
+    for (i = 1; !serial && i < ngroups; i++) {
+        if (virThreadCreate(&groups[i].thread, true,
+                            virPCIDeviceResetGroupRun, &groups[i]) < 0) {
+            char ebuf[1024];
+            VIR_WARN("Unable to create thread to reset PCI devices: %s",
+                     virStrerror(errno, ebuf, sizeof(ebuf)));
+            continue;
+        }
+        groups[i].started = true;
+    }
+
+    if (ngroups)
+        virPCIDeviceResetGroupRun(&groups[0]);
+
+    for (i = 1; i < ngroups; i++) {
+        if (groups[i].started)
+            virThreadJoin(&groups[i].thread);
+        else
+            virPCIDeviceResetGroupRun(&groups[i]);
+    }
+
+    ret = 0;
+    for (i = 0; i < ngroups; i++) {
+        if (groups[i].ret == 0)
+            continue;
+        if (ret == 0) {
+            ret = -1;
+            if (groups[i].err)
+                virSetError(groups[i].err);
+            else
+                virReportOOMError();
+        } else if (groups[i].err) {
+            VIR_ERROR(_("Failed to reset PCI device: %s"),
+                      groups[i].err->message);
+        }
+    }
+
+cleanup:
+    for (i = 0; i < ngroups; i++) {
+        VIR_FREE(groups[i].key);
+        VIR_FREE(groups[i].devs);
+        virFreeError(groups[i].err);
+    }
+    VIR_FREE(groups);
+    VIR_FREE(key);
+    return ret;
+}
+
+
 static int
 virPCIProbeStubDriver(const char *driver)
 {
@@ -58,6 +58,9 @@ int virPCIDeviceReattach(virPCIDevicePtr dev,
 int virPCIDeviceReset(virPCIDevicePtr dev,
                       virPCIDeviceListPtr activeDevs,
                       virPCIDeviceListPtr inactiveDevs);
+int virPCIDeviceListReset(virPCIDeviceListPtr list,
+                          virPCIDeviceListPtr activeDevs,
+                          virPCIDeviceListPtr inactiveDevs);
 
 void virPCIDeviceSetManaged(virPCIDevice *dev,
                             bool managed);
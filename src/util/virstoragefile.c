@@ -35,6 +35,7 @@
 # include <sys/statfs.h>
 #endif
 #include "dirname.h"
+#include "stat-time.h"
 #include "viralloc.h"
 #include "virerror.h"
 #include "virlog.h"
@@ -45,6 +46,8 @@
 #include "virendian.h"
 #include "virstring.h"
 #include "virutil.h"
+#include "virobject.h"
+#include "virthread.h"
 #if HAVE_SYS_SYSCALL_H
 # include <sys/syscall.h>
 #endif
@@ -1035,13 +1038,338 @@ virStorageFileGetMetadataFromFD(const char *path,
 }
 
 
+/* Open PATH as UID:GID and parse its header, without recursing.  If
+ * SB is not NULL, fill it with the status of the opened file.  */
+static virStorageFileMetadataPtr
+virStorageFileProbeMetadata(const char *path, const char *directory,
+                            int format, uid_t uid, gid_t gid,
+                            struct stat *sb)
+{
+    virStorageFileMetadataPtr ret;
+    int fd;
+
+    if ((fd = virFileOpenAs(path, O_RDONLY, 0, uid, gid, 0)) < 0) {
+        virReportSystemError(-fd, _("Failed to open file '%s'"), path);
+        return NULL;
+    }
+
+    ret = virStorageFileGetMetadataFromFDInternal(path, fd, directory, format);
+
+    if (ret && sb && fstat(fd, sb) < 0)
+        memset(sb, 0, sizeof(*sb));
+
+    if (VIR_CLOSE(fd) < 0)
+        VIR_WARN("could not close file %s", path);
+
+    return ret;
+}
+
+
+/* Cache of parsed image headers, shared by all users of a driver so
+ * that a base image common to many domains is only read once.  Entries
+ * describe a single file, without its backing chain, and are keyed by
+ * everything the parsed result depends on: the identity and the
+ * modification time of the file, the name and directory it is looked
+ * up by (as relative backing names are resolved against them), the
+ * requested format and the credentials used to open it.  */
+
+/* Start over once this many images are cached */
+#define VIR_STORAGE_FILE_METADATA_CACHE_MAX 1024
+
+/* File systems may keep timestamps with a granularity of several
+ * milliseconds, so two writes in a row can leave the same modification
+ * time behind.  Images modified more recently than this many seconds
+ * ago are thus not cached; they are likely being written anyway.  */
+#define VIR_STORAGE_FILE_METADATA_CACHE_SETTLE 2
+
+typedef struct _virStorageFileMetadataCacheEntry virStorageFileMetadataCacheEntry;
+typedef virStorageFileMetadataCacheEntry *virStorageFileMetadataCacheEntryPtr;
+struct _virStorageFileMetadataCacheEntry {
+    unsigned long long id;
+    char *path;
+    virStorageFileMetadataPtr meta; /* NULL while the file is probed */
+};
+
+struct _virStorageFileMetadataCache {
+    virObjectLockable parent;
+
+    virHashTablePtr entries; /* key -> virStorageFileMetadataCacheEntry */
+    virCond probed; /* signalled whenever a probe finishes */
+    unsigned long long lastId;
+};
+
+static virClassPtr virStorageFileMetadataCacheClass;
+static void virStorageFileMetadataCacheDispose(void *obj);
+
+static int virStorageFileMetadataCacheOnceInit(void)
+{
+    if (!(virStorageFileMetadataCacheClass =
+          virClassNew(virClassForObjectLockable(),
+                      "virStorageFileMetadataCache",
+                      sizeof(virStorageFileMetadataCache),
+                      virStorageFileMetadataCacheDispose)))
+        return -1;
+
+    return 0;
+}
+
+VIR_ONCE_GLOBAL_INIT(virStorageFileMetadataCache)
+
+
+static void
+virStorageFileMetadataCacheEntryFree(void *payload,
+                                     const void *name ATTRIBUTE_UNUSED)
+{
+    virStorageFileMetadataCacheEntryPtr entry = payload;
+
+    virStorageFileFreeMetadata(entry->meta);
+    VIR_FREE(entry->path);
+    VIR_FREE(entry);
+}
+
+/**
+ * virStorageFileMetadataCacheNew:
+ *
+ * Create an empty cache of image metadata, to be passed to
+ * virStorageFileGetMetadataCached.  Release it with virObjectUnref.
+ */
+virStorageFileMetadataCachePtr
+virStorageFileMetadataCacheNew(void)
+{
+    virStorageFileMetadataCachePtr cache;
+
+    if (virStorageFileMetadataCacheInitialize() < 0)
+        return NULL;
+
+    if (!(cache = virObjectLockableNew(virStorageFileMetadataCacheClass)))
+        return NULL;
+
+    if (virCondInit(&cache->probed) < 0) {
+        virReportError(VIR_ERR_INTERNAL_ERROR, "%s",
+                       _("cannot initialize metadata cache condition"));
+        virObjectUnref(cache);
+        return NULL;
+    }
+
+    if (!(cache->entries =
+          virHashCreate(32, virStorageFileMetadataCacheEntryFree))) {
+        virObjectUnref(cache);
+        return NULL;
+    }
+
+    return cache;
+}
+
+static void
+virStorageFileMetadataCacheDispose(void *obj)
+{
+    virStorageFileMetadataCachePtr cache = obj;
+
+    virHashFree(cache->entries);
+    virCondDestroy(&cache->probed);
+}
+
+/* Copy a single element of a chain, leaving out its backing chain */
+static virStorageFileMetadataPtr
+virStorageFileMetadataCopyOne(virStorageFileMetadataPtr src)
+{
+    virStorageFileMetadataPtr ret;
+
+    if (VIR_ALLOC(ret) < 0)
+        return NULL;
+
+    if (VIR_STRDUP(ret->backingStore, src->backingStore) < 0 ||
+        VIR_STRDUP(ret->backingStoreRaw, src->backingStoreRaw) < 0 ||
+        VIR_STRDUP(ret->directory, src->directory) < 0 ||
+        VIR_STRDUP(ret->compat, src->compat) < 0)
+        goto error;
+
+    if (src->features && !(ret->features = virBitmapNewCopy(src->features)))
+        goto error;
+
+    ret->backingStoreFormat = src->backingStoreFormat;
+    ret->backingStoreIsFile = src->backingStoreIsFile;
+    ret->capacity = src->capacity;
+    ret->encrypted = src->encrypted;
+    return ret;
+
+error:
+    virStorageFileFreeMetadata(ret);
+    return NULL;
+}
+
+static char *
+virStorageFileMetadataCacheKey(const struct stat *sb,
+                               const char *path, const char *directory,
+                               int format, uid_t uid, gid_t gid)
+{
+    struct timespec mtime = get_stat_mtime(sb);
+    char *key;
+
+    ignore_value(virAsprintf(&key, "%llu:%llu:%lld.%09ld:%lld:%d:%d:%d:%s:%s",
+                             (unsigned long long)sb->st_dev,
+                             (unsigned long long)sb->st_ino,
+                             (long long)mtime.tv_sec,
+                             (long)mtime.tv_nsec,
+                             (long long)sb->st_size,
+                             format, (int)uid, (int)gid,
+                             directory ? directory : "", path));
+    return key;
+}
+
+struct virStorageFileMetadataCacheMatch {
+    const char *path; /* NULL matches every path */
+    unsigned long long keep;
+};
+
+static int
+virStorageFileMetadataCacheMatch(const void *payload,
+                                 const void *name ATTRIBUTE_UNUSED,
+                                 const void *opaque)
+{
+    const virStorageFileMetadataCacheEntry *entry = payload;
+    const struct virStorageFileMetadataCacheMatch *match = opaque;
+
+    if (entry->id == match->keep)
+        return 0;
+    if (match->path && STRNEQ(entry->path, match->path))
+        return 0;
+    return 1;
+}
+
+/* Parse the header of PATH, or copy it from CACHE if PATH did not
+ * change since it was last read.  Callers asking for an image that is
+ * being read already wait for that read rather than repeating it.  */
+static virStorageFileMetadataPtr
+virStorageFileMetadataCacheProbe(virStorageFileMetadataCachePtr cache,
+                                 const char *path, const char *directory,
+                                 int format, uid_t uid, gid_t gid)
+{
+    virStorageFileMetadataCacheEntryPtr entry;
+    virStorageFileMetadataPtr ret = NULL;
+    struct virStorageFileMetadataCacheMatch match;
+    struct stat sb;
+    struct stat probed;
+    char *key = NULL;
+    char *probedKey = NULL;
+    unsigned long long id;
+
+    /* The contents of block devices can change without their inode
+     * telling, so only regular files are cached */
+    if (stat(path, &sb) < 0 || !S_ISREG(sb.st_mode))
+        return virStorageFileProbeMetadata(path, directory, format,
+                                           uid, gid, NULL);
+
+    if (!(key = virStorageFileMetadataCacheKey(&sb, path, directory,
+                                               format, uid, gid)))
+        return NULL;
+
+    virObjectLock(cache);
+    while ((entry = virHashLookup(cache->entries, key)) && !entry->meta) {
+        if (virCondWait(&cache->probed, &cache->parent.lock) < 0) {
+            virReportSystemError(errno, "%s",
+                                 _("failed to wait for image probe"));
+            virObjectUnlock(cache);
+            goto cleanup;
+        }
+    }
+
+    if (entry) {
+        VIR_DEBUG("Using cached metadata of '%s'", path);
+        ret = virStorageFileMetadataCopyOne(entry->meta);
+        virObjectUnlock(cache);
+        goto cleanup;
+    }
+
+    if (virHashSize(cache->entries) >= VIR_STORAGE_FILE_METADATA_CACHE_MAX) {
+        match.path = NULL;
+        match.keep = 0;
+        ignore_value(virHashRemoveSet(cache->entries,
+                                      virStorageFileMetadataCacheMatch,
+                                      &match));
+    }
+
+    /* Claim the key so that concurrent callers wait for this probe */
+    id = ++cache->lastId;
+    if (VIR_ALLOC(entry) < 0 ||
+        VIR_STRDUP(entry->path, path) < 0 ||
+        virHashAddEntry(cache->entries, key, entry) < 0) {
+        if (entry)
+            virStorageFileMetadataCacheEntryFree(entry, NULL);
+        virObjectUnlock(cache);
+        goto cleanup;
+    }
+    entry->id = id;
+    virObjectUnlock(cache);
+
+    ret = virStorageFileProbeMetadata(path, directory, format,
+                                      uid, gid, &probed);
+
+    /* Only keep the result if the file did not change while it was
+     * read, has settled, and if it does not depend on a backing file
+     * that is currently missing */
+    if (ret && !(ret->backingStoreRaw && !ret->backingStore) &&
+        get_stat_mtime(&probed).tv_sec + VIR_STORAGE_FILE_METADATA_CACHE_SETTLE <
+        time(NULL))
+        probedKey = virStorageFileMetadataCacheKey(&probed, path, directory,
+                                                   format, uid, gid);
+
+    virObjectLock(cache);
+    entry = virHashLookup(cache->entries, key);
+    if (entry && entry->id == id) {
+        if (probedKey && STREQ(key, probedKey) &&
+            (entry->meta = virStorageFileMetadataCopyOne(ret))) {
+            /* Older versions of the same file are of no use any more */
+            match.path = path;
+            match.keep = id;
+            ignore_value(virHashRemoveSet(cache->entries,
+                                          virStorageFileMetadataCacheMatch,
+                                          &match));
+        } else {
+            ignore_value(virHashRemoveEntry(cache->entries, key));
+        }
+    }
+    virCondBroadcast(&cache->probed);
+    virObjectUnlock(cache);
+
+cleanup:
+    VIR_FREE(key);
+    VIR_FREE(probedKey);
+    return ret;
+}
+
+/**
+ * virStorageFileMetadataCacheInvalidate:
+ *
+ * Forget everything CACHE knows about PATH.  Used when an image is
+ * about to be rewritten in place, where its modification time might
+ * not tell the difference.  CACHE may be NULL.
+ */
+void
+virStorageFileMetadataCacheInvalidate(virStorageFileMetadataCachePtr cache,
+                                      const char *path)
+{
+    struct virStorageFileMetadataCacheMatch match = { path, 0 };
+
+    if (!cache)
+        return;
+
+    virObjectLock(cache);
+    ignore_value(virHashRemoveSet(cache->entries,
+                                  virStorageFileMetadataCacheMatch,
+                                  &match));
+    virCondBroadcast(&cache->probed);
+    virObjectUnlock(cache);
+}
+
+
 /* Recursive workhorse for virStorageFileGetMetadata.  */
 static virStorageFileMetadataPtr
 virStorageFileGetMetadataRecurse(const char *path, const char *directory,
                                  int format, uid_t uid, gid_t gid,
-                                 bool allow_probe, virHashTablePtr cycle)
+                                 bool allow_probe, virHashTablePtr cycle,
+                                 virStorageFileMetadataCachePtr cache)
 {
-    int fd;
     VIR_DEBUG("path=%s format=%d uid=%d gid=%d probe=%d",
               path, format, (int)uid, (int)gid, allow_probe);
 
@@ -1056,15 +1384,12 @@ virStorageFileGetMetadataRecurse(const char *path, const char *directory,
     if (virHashAddEntry(cycle, path, (void *)1) < 0)
         return NULL;
 
-    if ((fd = virFileOpenAs(path, O_RDONLY, 0, uid, gid, 0)) < 0) {
-        virReportSystemError(-fd, _("Failed to open file '%s'"), path);
-        return NULL;
-    }
-
-    ret = virStorageFileGetMetadataFromFDInternal(path, fd, directory, format);
-
-    if (VIR_CLOSE(fd) < 0)
-        VIR_WARN("could not close file %s", path);
+    if (cache)
+        ret = virStorageFileMetadataCacheProbe(cache, path, directory,
+                                               format, uid, gid);
+    else
+        ret = virStorageFileProbeMetadata(path, directory, format,
+                                          uid, gid, NULL);
 
     if (ret && ret->backingStoreIsFile) {
         if (ret->backingStoreFormat == VIR_STORAGE_FILE_AUTO && !allow_probe)
@@ -1077,7 +1402,7 @@ virStorageFileGetMetadataRecurse(const char *path, const char *directory,
                                                             format,
                                                             uid, gid,
                                                             allow_probe,
-                                                            cycle);
+                                                            cycle, cache);
     }
 
     return ret;
@@ -1110,8 +1435,27 @@ virStorageFileGetMetadata(const char *path, int format,
                           uid_t uid, gid_t gid,
                           bool allow_probe)
 {
-    VIR_DEBUG("path=%s format=%d uid=%d gid=%d probe=%d",
-              path, format, (int)uid, (int)gid, allow_probe);
+    return virStorageFileGetMetadataCached(NULL, path, format,
+                                           uid, gid, allow_probe);
+}
+
+/**
+ * virStorageFileGetMetadataCached:
+ *
+ * Same as virStorageFileGetMetadata, but reuse the headers in CACHE
+ * of images that did not change since they were last read, and add
+ * the ones that had to be read.  CACHE may be NULL.
+ *
+ * Caller MUST free result after use via virStorageFileFreeMetadata.
+ */
+virStorageFileMetadataPtr
+virStorageFileGetMetadataCached(virStorageFileMetadataCachePtr cache,
+                                const char *path, int format,
+                                uid_t uid, gid_t gid,
+                                bool allow_probe)
+{
+    VIR_DEBUG("cache=%p path=%s format=%d uid=%d gid=%d probe=%d",
+              cache, path, format, (int)uid, (int)gid, allow_probe);
 
     virHashTablePtr cycle = virHashCreate(5, NULL);
     virStorageFileMetadataPtr ret;
@@ -1122,7 +1466,7 @@ virStorageFileGetMetadata(const char *path, int format,
     if (format <= VIR_STORAGE_FILE_NONE)
         format = allow_probe ? VIR_STORAGE_FILE_AUTO : VIR_STORAGE_FILE_RAW;
     ret = virStorageFileGetMetadataRecurse(path, NULL, format, uid, gid,
-                                           allow_probe, cycle);
+                                           allow_probe, cycle, cache);
     virHashFree(cycle);
     return ret;
 }
@@ -95,6 +95,19 @@ virStorageFileMetadataPtr virStorageFileGetMetadata(const char *path,
                                                     int format,
                                                     uid_t uid, gid_t gid,
                                                     bool allow_probe);
+typedef struct _virStorageFileMetadataCache virStorageFileMetadataCache;
+typedef virStorageFileMetadataCache *virStorageFileMetadataCachePtr;
+
+virStorageFileMetadataCachePtr virStorageFileMetadataCacheNew(void);
+void virStorageFileMetadataCacheInvalidate(virStorageFileMetadataCachePtr cache,
+                                           const char *path)
+    ATTRIBUTE_NONNULL(2);
+virStorageFileMetadataPtr
+virStorageFileGetMetadataCached(virStorageFileMetadataCachePtr cache,
+                                const char *path,
+                                int format,
+                                uid_t uid, gid_t gid,
+                                bool allow_probe);
 virStorageFileMetadataPtr virStorageFileGetMetadataFromFD(const char *path,
                                                           int fd,
                                                           int format);
@@ -0,0 +1,257 @@
+#include <config.h>
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "testutils.h"
+#include "domain_autostart.h"
+#include "viralloc.h"
+#include "virerror.h"
+#include "virstring.h"
+#include "virthread.h"
+
+#define VIR_FROM_THIS VIR_FROM_NONE
+
+#define NDOMAINS 24
+
+typedef struct _testAutostartData testAutostartData;
+typedef testAutostartData *testAutostartDataPtr;
+struct _testAutostartData {
+    virMutex lock;
+    size_t running;
+    size_t maxRunning;
+    size_t seq;
+    /* Sequence numbers at which each domain started and finished */
+    size_t started[NDOMAINS];
+    size_t finished[NDOMAINS];
+    const char *fail;
+};
+
+static virDomainXMLOptionPtr xmlopt;
+
+/* Host memory the fake memory callback reports, in KiB */
+static unsigned long long testAvailMemory;
+
+static int
+testAutostartMemory(unsigned long long *avail)
+{
+    *avail = testAvailMemory;
+    return 0;
+}
+
+static int
+testAutostartMemoryFail(unsigned long long *avail ATTRIBUTE_UNUSED)
+{
+    virReportError(VIR_ERR_NO_SUPPORT, "%s",
+                   "no memory statistics");
+    return -1;
+}
+
+static const char *testNames[] = { "db", "web", "misc" };
+
+static virDomainObjListPtr
+testAutostartDomains(void)
+{
+    virDomainObjListPtr doms = NULL;
+    virDomainDefPtr def = NULL;
+    virDomainObjPtr vm;
+    size_t i;
+
+    if (!(doms = virDomainObjListNew()))
+        return NULL;
+
+    for (i = 0; i < NDOMAINS; i++) {
+        if (VIR_ALLOC(def) < 0)
+            goto error;
+        def->id = -1;
+        def->mem.max_balloon = 1024;
+        memset(def->uuid, 0, VIR_UUID_BUFLEN);
+        def->uuid[0] = i + 1;
+        if (virAsprintf(&def->name, "%s-%zu",
+                        testNames[i % ARRAY_CARDINALITY(testNames)], i) < 0)
+            goto error;
+
+        if (!(vm = virDomainObjListAdd(doms, def, xmlopt, 0, NULL)))
+            goto error;
+        def = NULL;
+        /* Every fourth domain is not marked for autostart */
+        vm->autostart = i % 4 != 3;
+        virObjectUnlock(vm);
+    }
+
+    return doms;
+
+error:
+    virDomainDefFree(def);
+    virObjectUnref(doms);
+    return NULL;
+}
+
+static int
+testAutostartStart(virDomainObjPtr vm,
+                   void *opaque)
+{
+    testAutostartDataPtr data = opaque;
+    size_t idx;
+    int ret = 0;
+
+    virObjectLock(vm);
+    idx = vm->def->uuid[0] - 1;
+    if (data->fail && STREQ(vm->def->name, data->fail))
+        ret = -1;
+    virObjectUnlock(vm);
+
+    virMutexLock(&data->lock);
+    data->started[idx] = ++data->seq;
+    if (++data->running > data->maxRunning)
+        data->maxRunning = data->running;
+    virMutexUnlock(&data->lock);
+
+    usleep(20 * 1000);
+
+    virMutexLock(&data->lock);
+    data->running--;
+    data->finished[idx] = ++data->seq;
+    virMutexUnlock(&data->lock);
+
+    return ret;
+}
+
+struct testAutostartInfo {
+    unsigned int maxConcurrent;
+    unsigned long long reservedMemory;
+    virDomainAutostartMemoryCallback memoryCallback;
+    unsigned long long availMemory;
+    const char **groups;
+    const char *fail;
+    size_t expectMaxRunning;
+};
+
+static size_t
+testAutostartGroup(const char **groups,
+                   size_t idx)
+{
+    const char *prefix = testNames[idx % ARRAY_CARDINALITY(testNames)];
+    size_t i;
+
+    for (i = 0; groups && groups[i]; i++) {
+        if (STRPREFIX(groups[i], prefix))
+            return i;
+    }
+    return i;
+}
+
+static int
+testAutostart(const void *opaque)
+{
+    const struct testAutostartInfo *info = opaque;
+    virDomainObjListPtr doms = NULL;
+    testAutostartData data;
+    size_t i, j;
+    int rc;
+    int ret = -1;
+
+    memset(&data, 0, sizeof(data));
+    data.fail = info->fail;
+    if (virMutexInit(&data.lock) < 0)
+        return -1;
+
+    if (!(doms = testAutostartDomains()))
+        goto cleanup;
+
+    testAvailMemory = info->availMemory;
+    rc = virDomainAutostartRun(doms, info->maxConcurrent,
+                               info->reservedMemory,
+                               info->memoryCallback,
+                               (char **) info->groups,
+                               testAutostartStart, &data);
+    if (rc != (info->fail ? 1 : 0)) {
+        fprintf(stderr, "unexpected number of failures %d\n", rc);
+        goto cleanup;
+    }
+
+    for (i = 0; i < NDOMAINS; i++) {
+        bool autostart = i % 4 != 3;
+
+        if (autostart != !!data.started[i]) {
+            fprintf(stderr, "domain %zu %s started\n",
+                    i, autostart ? "was not" : "was");
+            goto cleanup;
+        }
+        if (!autostart)
+            continue;
+
+        /* A domain must not start before every domain of an
+         * earlier group has finished starting */
+        for (j = 0; j < NDOMAINS; j++) {
+            if (!data.started[j] ||
+                testAutostartGroup(info->groups, j) >=
+                testAutostartGroup(info->groups, i))
+                continue;
+            if (data.finished[j] > data.started[i]) {
+                fprintf(stderr, "domain %zu started before domain %zu "
+                        "of an earlier group finished\n", i, j);
+                goto cleanup;
+            }
+        }
+    }
+
+    if (data.maxRunning > info->expectMaxRunning ||
+        (info->expectMaxRunning == 1 && data.maxRunning != 1)) {
+        fprintf(stderr, "%zu domains were started at once, expected %zu\n",
+                data.maxRunning, info->expectMaxRunning);
+        goto cleanup;
+    }
+
+    ret = 0;
+
+cleanup:
+    virObjectUnref(doms);
+    virMutexDestroy(&data.lock);
+    return ret;
+}
+
+static int
+mymain(void)
+{
+    int ret = 0;
+    const char *groups[] = { "db-*", "web-*", NULL };
+
+    if (!(xmlopt = virDomainXMLOptionNew(NULL, NULL, NULL)))
+        return EXIT_FAILURE;
+
+#define DO_TEST_FULL(name, max, mem, memcb, avail, grp, failname, expect) \
+    do {                                                                \
+        struct testAutostartInfo info = {                               \
+            max, mem, memcb, avail, grp, failname, expect,              \
+        };                                                              \
+        if (virtTestRun("Autostart " name, testAutostart, &info) < 0)   \
+            ret = -1;                                                   \
+    } while (0)
+
+#define DO_TEST(name, max, grp, failname, expect)                       \
+    DO_TEST_FULL(name, max, 0, NULL, 0, grp, failname, expect)
+
+    DO_TEST("serial", 1, NULL, NULL, 1);
+    DO_TEST("concurrent", 4, NULL, NULL, 4);
+    DO_TEST("groups", 4, groups, NULL, 4);
+    DO_TEST("serial groups", 0, groups, NULL, 1);
+    DO_TEST("failure", 4, groups, "web-4", 4);
+    /* Room for three domains of 1MiB each */
+    DO_TEST_FULL("memory", 4, 0, testAutostartMemory, 3 * 1024,
+                 groups, NULL, 3);
+    /* Room for none of them, so domains start one by one */
+    DO_TEST_FULL("reserved memory", 4, 1024 * 1024, testAutostartMemory,
+                 3 * 1024, groups, NULL, 1);
+    /* Without memory statistics, memory is not waited for */
+    DO_TEST_FULL("no memory stats", 4, 1024 * 1024, testAutostartMemoryFail,
+                 0, groups, NULL, 4);
+
+    virObjectUnref(xmlopt);
+
+    return ret == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+}
+
+VIRT_TEST_MAIN(mymain)
@@ -24,6 +24,7 @@
 #include "virerror.h"
 #include "viralloc.h"
 #include "virlog.h"
+#include "virtime.h"
 
 #include "domain_conf.h"
 
@@ -83,6 +84,88 @@ cleanup:
     return ret;
 }
 
+/*
+ * Measure the cost of formatting a domain with a fair number of
+ * devices.  With VIR_TEST_EXPENSIVE set the loop runs long enough to
+ * give meaningful numbers, which are printed with VIR_TEST_VERBOSE;
+ * allocations are only counted in --enable-test-oom builds.
+ */
+static int testFormatBench(const void *opaque)
+{
+    int ret = -1;
+    const char *name = opaque;
+    char *filename = NULL;
+    char *xmlData = NULL;
+    char *expect = NULL;
+    char *actual = NULL;
+    virDomainDefPtr def = NULL;
+    unsigned long long start, end;
+    size_t i, iterations = virTestGetExpensive() ? 10000 : 10;
+#ifdef TEST_OOM
+    int nalloc = 0;
+#endif
+
+    if (virAsprintf(&filename, "%s/domainconfdata/%s.xml",
+                    abs_srcdir, name) < 0)
+        goto cleanup;
+
+    if (virtTestLoadFile(filename, &xmlData) < 0)
+        goto cleanup;
+
+    if (!(def = virDomainDefParseString(xmlData, caps, xmlopt,
+                                        1 << VIR_DOMAIN_VIRT_TEST, 0)))
+        goto cleanup;
+
+    if (!(expect = virDomainDefFormat(def, 0)))
+        goto cleanup;
+
+#ifdef TEST_OOM
+    if (!virtTestOOMActive())
+        virAllocTestInit();
+#endif
+
+    if (virTimeMillisNow(&start) < 0)
+        goto cleanup;
+
+    for (i = 0; i < iterations; i++) {
+        if (!(actual = virDomainDefFormat(def, 0)))
+            goto cleanup;
+
+        if (STRNEQ(expect, actual)) {
+            virtTestDifference(stderr, expect, actual);
+            goto cleanup;
+        }
+        VIR_FREE(actual);
+    }
+
+    if (virTimeMillisNow(&end) < 0)
+        goto cleanup;
+
+#ifdef TEST_OOM
+    if (!virtTestOOMActive())
+        nalloc = virAllocTestCount();
+#endif
+
+    if (virTestGetVerbose()) {
+        fprintf(stderr, "%zu bytes, %.2f us", strlen(expect),
+                (double) (end - start) * 1000 / iterations);
+#ifdef TEST_OOM
+        fprintf(stderr, ", %.1f allocs", (double) nalloc / iterations);
+#endif
+        fprintf(stderr, " per call ");
+    }
+
+    ret = 0;
+
+cleanup:
+    virDomainDefFree(def);
+    VIR_FREE(actual);
+    VIR_FREE(expect);
+    VIR_FREE(xmlData);
+    VIR_FREE(filename);
+    return ret;
+}
+
 static int
 mymain(void)
 {
@@ -110,6 +193,9 @@ mymain(void)
     DO_TEST_GET_FS("/dev/pts", false);
     DO_TEST_GET_FS("/doesnotexist", false);
 
+    if (virtTestRun("Format benchmark", testFormatBench, "formatbench") < 0)
+        ret = -1;
+
     virObjectUnref(caps);
     virObjectUnref(xmlopt);
 
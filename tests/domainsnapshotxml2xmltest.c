@@ -19,6 +19,7 @@
 # include "qemu/qemu_domain.h"
 # include "testutilsqemu.h"
 # include "virstring.h"
+# include "virtime.h"
 
 # define VIR_FROM_THIS VIR_FROM_NONE
 
@@ -150,6 +151,232 @@ testCompareXMLToXMLHelper(const void *data)
 }
 
 
+static virDomainSnapshotObjPtr
+testSnapshotNew(virDomainSnapshotObjListPtr snapshots,
+                const char *name,
+                const char *parent)
+{
+    virDomainSnapshotDefPtr def;
+    virDomainSnapshotObjPtr snap;
+
+    if (VIR_ALLOC(def) < 0 ||
+        VIR_STRDUP(def->name, name) < 0 ||
+        VIR_STRDUP(def->parent, parent) < 0)
+        goto error;
+
+    if (!(snap = virDomainSnapshotAssignDef(snapshots, def)))
+        goto error;
+
+    return snap;
+
+error:
+    virDomainSnapshotDefFree(def);
+    return NULL;
+}
+
+static void
+testSnapshotCount(void *payload ATTRIBUTE_UNUSED,
+                  const void *name ATTRIBUTE_UNUSED,
+                  void *data)
+{
+    size_t *count = data;
+
+    (*count)++;
+}
+
+/* Check the child count and sibling links of every child of parent */
+static int
+testSnapshotCheckChildren(virDomainSnapshotObjPtr parent)
+{
+    virDomainSnapshotObjPtr child;
+    virDomainSnapshotObjPtr prev = NULL;
+    size_t count = 0;
+
+    for (child = parent->first_child; child; child = child->sibling) {
+        if (child->parent != parent || child->prev_sibling != prev)
+            return -1;
+        prev = child;
+        count++;
+    }
+
+    return count == parent->nchildren ? 0 : -1;
+}
+
+/* Delete snapshot the way the drivers do when keeping its children */
+static void
+testSnapshotDelete(virDomainSnapshotObjListPtr snapshots,
+                   virDomainSnapshotObjPtr snap)
+{
+    virDomainSnapshotMoveChildren(snap, snap->parent);
+    virDomainSnapshotDropParent(snap);
+    virDomainSnapshotObjListRemove(snapshots, snap);
+}
+
+static int
+testSnapshotTree(const void *data ATTRIBUTE_UNUSED)
+{
+    virDomainSnapshotObjListPtr snapshots;
+    virDomainSnapshotObjPtr metaroot;
+    virDomainSnapshotObjPtr snap;
+    virDomainSnapshotObjPtr chain[6];
+    char name[32];
+    char parent[32];
+    size_t count = 0;
+    size_t i;
+    int ret = -1;
+
+    if (!(snapshots = virDomainSnapshotObjListNew()))
+        return -1;
+    metaroot = virDomainSnapshotFindByName(snapshots, NULL);
+
+    for (i = 0; i < 3; i++) {
+        snprintf(name, sizeof(name), "root%zu", i);
+        if (!testSnapshotNew(snapshots, name, NULL))
+            goto cleanup;
+    }
+    for (i = 0; i < ARRAY_CARDINALITY(chain); i++) {
+        snprintf(name, sizeof(name), "chain%zu", i);
+        snprintf(parent, sizeof(parent), "chain%zu", i - 1);
+        if (!(chain[i] = testSnapshotNew(snapshots, name,
+                                         i ? parent : "root0")))
+            goto cleanup;
+    }
+
+    if (virDomainSnapshotUpdateRelations(snapshots) < 0 ||
+        metaroot->nchildren != 3 ||
+        testSnapshotCheckChildren(metaroot) < 0 ||
+        chain[3]->parent != chain[2] ||
+        virDomainSnapshotForEachDescendant(metaroot, testSnapshotCount,
+                                           &count) != 9 ||
+        count != 9)
+        goto cleanup;
+
+    /* Removing a snapshot in the middle of the chain hands its child
+     * over to its parent */
+    testSnapshotDelete(snapshots, chain[3]);
+    if (chain[4]->parent != chain[2] ||
+        testSnapshotCheckChildren(chain[2]) < 0 ||
+        virDomainSnapshotForEachDescendant(chain[0], testSnapshotCount,
+                                           &count) != 4)
+        goto cleanup;
+
+    /* Dropping a root in the middle of the sibling list */
+    snap = virDomainSnapshotFindByName(snapshots, "root1");
+    virDomainSnapshotDropParent(snap);
+    virDomainSnapshotSetParent(snap, chain[5]);
+    if (testSnapshotCheckChildren(metaroot) < 0 ||
+        metaroot->nchildren != 2 ||
+        testSnapshotCheckChildren(chain[5]) < 0 ||
+        chain[5]->nchildren != 1)
+        goto cleanup;
+
+    /* Removing a snapshot with several children keeps them all */
+    testSnapshotDelete(snapshots, chain[2]);
+    if (testSnapshotCheckChildren(chain[1]) < 0 ||
+        chain[1]->nchildren != 1 ||
+        virDomainSnapshotForEachDescendant(metaroot, testSnapshotCount,
+                                           &count) != 7)
+        goto cleanup;
+
+    virDomainSnapshotObjListFree(snapshots);
+
+    /* A circular chain is reported and broken up */
+    if (!(snapshots = virDomainSnapshotObjListNew()))
+        return -1;
+    metaroot = virDomainSnapshotFindByName(snapshots, NULL);
+    if (!testSnapshotNew(snapshots, "a", "c") ||
+        !testSnapshotNew(snapshots, "b", "a") ||
+        !testSnapshotNew(snapshots, "c", "b") ||
+        !testSnapshotNew(snapshots, "d", "c") ||
+        !testSnapshotNew(snapshots, "e", "missing"))
+        goto cleanup;
+
+    if (virDomainSnapshotUpdateRelations(snapshots) == 0 ||
+        metaroot->nchildren != 2 ||
+        testSnapshotCheckChildren(metaroot) < 0 ||
+        virDomainSnapshotForEachDescendant(metaroot, testSnapshotCount,
+                                           &count) != 5)
+        goto cleanup;
+
+    ret = 0;
+
+cleanup:
+    virDomainSnapshotObjListFree(snapshots);
+    return ret;
+}
+
+# define TEST_BENCH_SNAPSHOTS 20000
+
+/* Load, walk and delete a long chain of rolling snapshots, and a
+ * domain with as many independent snapshots deleted oldest first */
+static int
+testSnapshotTreeBench(const void *data ATTRIBUTE_UNUSED)
+{
+    virDomainSnapshotObjListPtr snapshots = NULL;
+    virDomainSnapshotObjPtr metaroot;
+    virDomainSnapshotObjPtr *list = NULL;
+    unsigned long long start, loaded, walked, end;
+    char name[32];
+    char parent[32];
+    size_t count = 0;
+    size_t i;
+    int flat;
+    int ret = -1;
+
+    if (VIR_ALLOC_N(list, TEST_BENCH_SNAPSHOTS) < 0)
+        return -1;
+
+    for (flat = 0; flat < 2; flat++) {
+        if (!(snapshots = virDomainSnapshotObjListNew()))
+            goto cleanup;
+        metaroot = virDomainSnapshotFindByName(snapshots, NULL);
+
+        for (i = 0; i < TEST_BENCH_SNAPSHOTS; i++) {
+            snprintf(name, sizeof(name), "snap%zu", i);
+            snprintf(parent, sizeof(parent), "snap%zu", i - 1);
+            if (!(list[i] = testSnapshotNew(snapshots, name,
+                                            flat || !i ? NULL : parent)))
+                goto cleanup;
+        }
+
+        if (virTimeMillisNow(&start) < 0 ||
+            virDomainSnapshotUpdateRelations(snapshots) < 0 ||
+            virTimeMillisNow(&loaded) < 0)
+            goto cleanup;
+
+        if (virDomainSnapshotForEachDescendant(metaroot, testSnapshotCount,
+                                               &count) != TEST_BENCH_SNAPSHOTS ||
+            virTimeMillisNow(&walked) < 0)
+            goto cleanup;
+
+        for (i = 0; i < TEST_BENCH_SNAPSHOTS; i++)
+            testSnapshotDelete(snapshots, list[i]);
+
+        if (virTimeMillisNow(&end) < 0 ||
+            metaroot->nchildren != 0 ||
+            virDomainSnapshotForEach(snapshots, testSnapshotCount,
+                                     &count) != 0)
+            goto cleanup;
+
+        if (virTestGetVerbose())
+            fprintf(stderr, "%s%d %s snapshots: load %llums, walk %llums, "
+                    "delete %llums ", flat ? "" : "\n", TEST_BENCH_SNAPSHOTS,
+                    flat ? "flat" : "chained",
+                    loaded - start, walked - loaded, end - walked);
+
+        virDomainSnapshotObjListFree(snapshots);
+        snapshots = NULL;
+    }
+
+    ret = 0;
+
+cleanup:
+    virDomainSnapshotObjListFree(snapshots);
+    VIR_FREE(list);
+    return ret;
+}
+
+
 static int
 mymain(void)
 {
@@ -226,6 +453,12 @@ mymain(void)
     DO_TEST_IN("description_only", NULL);
     DO_TEST_IN("name_only", NULL);
 
+    if (virtTestRun("SNAPSHOT tree", testSnapshotTree, NULL) < 0)
+        ret = -1;
+    if (virtTestRun("SNAPSHOT tree benchmark",
+                    testSnapshotTreeBench, NULL) < 0)
+        ret = -1;
+
 cleanup:
     if (testSnapshotXMLVariableLineRegex)
         regfree(testSnapshotXMLVariableLineRegex);
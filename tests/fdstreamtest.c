@@ -312,6 +312,196 @@ static int testFDStreamWriteNonblock(const void *data)
     return testFDStreamWriteCommon(data, false);
 }
 
+
+#define SPARSE_CHUNK (64 * 1024)
+
+/* Sum up the holes the filesystem reports in @path, which
+ * is 0 if it can't report holes at all */
+static int testFDStreamCountHoles(const char *path,
+                                  unsigned long long *holes)
+{
+    int fd;
+    bool inData;
+    unsigned long long section;
+
+    if ((fd = open(path, O_RDONLY)) < 0)
+        return -1;
+
+    *holes = 0;
+    while (virFileInData(fd, &inData, &section) == 0 && section) {
+        if (!inData)
+            *holes += section;
+        if (lseek(fd, section, SEEK_CUR) < 0)
+            break;
+    }
+
+    return VIR_CLOSE(fd);
+}
+
+static int testFDStreamSparseCommon(const char *scratchdir, bool blocking)
+{
+    int fd = -1;
+    char *src = NULL;
+    char *dst = NULL;
+    char *srcdata = NULL;
+    char *dstdata = NULL;
+    char *buf = NULL;
+    int srclen, dstlen;
+    int ret = -1;
+    virStreamPtr in = NULL;
+    virStreamPtr out = NULL;
+    virConnectPtr conn = NULL;
+    unsigned long long expectHoles, holes = 0;
+    long long hole;
+    size_t i;
+    int flags = 0;
+
+    if (!blocking)
+        flags |= VIR_STREAM_NONBLOCK;
+
+    if (!(conn = virConnectOpen("test:///default")))
+        goto cleanup;
+
+    if (VIR_ALLOC_N(buf, SPARSE_CHUNK) < 0)
+        goto cleanup;
+
+    for (i = 0; i < SPARSE_CHUNK; i++)
+        buf[i] = i % 251 + 1;
+
+    if (virAsprintf(&src, "%s/sparse.in", scratchdir) < 0 ||
+        virAsprintf(&dst, "%s/sparse.out", scratchdir) < 0)
+        goto cleanup;
+
+    /* hole, data, hole, data, hole */
+    if ((fd = open(src, O_CREAT|O_WRONLY|O_EXCL, 0600)) < 0 ||
+        pwrite(fd, buf, SPARSE_CHUNK, 16 * SPARSE_CHUNK) != SPARSE_CHUNK ||
+        pwrite(fd, buf, SPARSE_CHUNK, 48 * SPARSE_CHUNK) != SPARSE_CHUNK ||
+        ftruncate(fd, 64 * SPARSE_CHUNK) < 0 ||
+        VIR_CLOSE(fd) < 0)
+        goto cleanup;
+
+    /* The target exists already, with data where the source has holes */
+    if ((fd = open(dst, O_CREAT|O_WRONLY|O_EXCL, 0600)) < 0)
+        goto cleanup;
+    for (i = 0; i < 8; i++) {
+        if (safewrite(fd, buf, SPARSE_CHUNK) != SPARSE_CHUNK)
+            goto cleanup;
+    }
+    if (VIR_CLOSE(fd) < 0)
+        goto cleanup;
+
+    if (testFDStreamCountHoles(src, &expectHoles) < 0)
+        goto cleanup;
+
+    if (!(in = virStreamNew(conn, flags)) ||
+        !(out = virStreamNew(conn, flags)))
+        goto cleanup;
+
+    if (virFDStreamOpenSparseFile(in, src, 0, 0, O_RDONLY) < 0 ||
+        virFDStreamOpenSparseFile(out, dst, 0, 0, O_WRONLY) < 0)
+        goto cleanup;
+
+    while (1) {
+        int got;
+        size_t offset = 0;
+
+        got = in->driver->streamRecvFlags(in, buf, SPARSE_CHUNK,
+                                          VIR_STREAM_RECV_STOP_AT_HOLE);
+        if (got == -2 && !blocking) {
+            usleep(20 * 1000);
+            continue;
+        }
+        if (got == -3) {
+            if (in->driver->streamRecvHole(in, &hole, 0) < 0)
+                goto error;
+            while ((got = out->driver->streamSendHole(out, hole, 0)) == -2 &&
+                   !blocking)
+                usleep(20 * 1000);
+            if (got < 0)
+                goto error;
+            holes += hole;
+            continue;
+        }
+        if (got < 0)
+            goto error;
+        if (got == 0)
+            break;
+
+        while (offset < got) {
+            int sent = out->driver->streamSend(out, buf + offset, got - offset);
+            if (sent == -2 && !blocking) {
+                usleep(20 * 1000);
+                continue;
+            }
+            if (sent < 0)
+                goto error;
+            offset += sent;
+        }
+    }
+
+    if (in->driver->streamFinish(in) != 0 ||
+        out->driver->streamFinish(out) != 0)
+        goto error;
+
+    if (holes != expectHoles) {
+        virFilePrintf(stderr, "Expected %llu bytes of holes, got %llu\n",
+                      expectHoles, holes);
+        goto cleanup;
+    }
+
+    if ((srclen = virFileReadAll(src, 128 * SPARSE_CHUNK, &srcdata)) < 0 ||
+        (dstlen = virFileReadAll(dst, 128 * SPARSE_CHUNK, &dstdata)) < 0)
+        goto cleanup;
+
+    if (srclen != dstlen ||
+        memcmp(srcdata, dstdata, srclen) != 0) {
+        virFilePrintf(stderr, "Mismatched sparse copy\n");
+        goto cleanup;
+    }
+
+    if (testFDStreamCountHoles(dst, &holes) < 0)
+        goto cleanup;
+    if (expectHoles && !holes) {
+        virFilePrintf(stderr, "Sparse copy has no holes\n");
+        goto cleanup;
+    }
+
+    ret = 0;
+cleanup:
+    if (in)
+        virStreamFree(in);
+    if (out)
+        virStreamFree(out);
+    VIR_FORCE_CLOSE(fd);
+    if (src != NULL)
+        unlink(src);
+    if (dst != NULL)
+        unlink(dst);
+    if (conn)
+        virConnectClose(conn);
+    VIR_FREE(src);
+    VIR_FREE(dst);
+    VIR_FREE(srcdata);
+    VIR_FREE(dstdata);
+    VIR_FREE(buf);
+    return ret;
+
+error:
+    virFilePrintf(stderr, "Failed to copy sparse stream: %s\n",
+                  virGetLastErrorMessage());
+    goto cleanup;
+}
+
+
+static int testFDStreamSparseBlock(const void *data)
+{
+    return testFDStreamSparseCommon(data, true);
+}
+static int testFDStreamSparseNonblock(const void *data)
+{
+    return testFDStreamSparseCommon(data, false);
+}
+
 #define SCRATCHDIRTEMPLATE abs_builddir "/fakesysfsdir-XXXXXX"
 
 static int
@@ -336,6 +526,10 @@ mymain(void)
         ret = -1;
     if (virtTestRun("Stream write non-blocking ", testFDStreamWriteNonblock, scratchdir) < 0)
         ret = -1;
+    if (virtTestRun("Stream sparse blocking ", testFDStreamSparseBlock, scratchdir) < 0)
+        ret = -1;
+    if (virtTestRun("Stream sparse non-blocking ", testFDStreamSparseNonblock, scratchdir) < 0)
+        ret = -1;
 
     if (getenv("LIBVIRT_SKIP_CLEANUP") == NULL)
         virFileDeleteTree(scratchdir);
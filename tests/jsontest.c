@@ -7,8 +7,13 @@
 
 #include "internal.h"
 #include "virjson.h"
+#include "viralloc.h"
+#include "virstring.h"
+#include "virtime.h"
 #include "testutils.h"
 
+#define VIR_FROM_THIS VIR_FROM_NONE
+
 struct testInfo {
     const char *doc;
     const char *expect;
@@ -130,6 +135,280 @@ cleanup:
 }
 
 
+/* A tree parsed into an arena must look exactly like a heap one, also
+ * after detaching and appending values */
+static int
+testJSONArena(const void *data)
+{
+    const struct testInfo *info = data;
+    virJSONValuePtr heap = NULL;
+    virJSONValuePtr arena = NULL;
+    virJSONValuePtr removed = NULL;
+    char *expect = NULL;
+    char *actual = NULL;
+    char *key = NULL;
+    int ret = -1;
+
+    if (!(heap = virJSONValueFromString(info->doc)) ||
+        !(arena = virJSONValueFromStringArena(info->doc))) {
+        if (virTestGetVerbose())
+            fprintf(stderr, "Fail to parse %s\n", info->doc);
+        goto cleanup;
+    }
+
+    if (!(expect = virJSONValueToString(heap, false)) ||
+        !(actual = virJSONValueToString(arena, false)))
+        goto cleanup;
+
+    if (STRNEQ(expect, actual)) {
+        virtTestDifference(stderr, expect, actual);
+        goto cleanup;
+    }
+
+    if (heap->type != VIR_JSON_TYPE_OBJECT ||
+        virJSONValueObjectKeysNumber(heap) == 0) {
+        ret = 0;
+        goto cleanup;
+    }
+
+    /* Move the first key to the end of both objects */
+    if (VIR_STRDUP(key, virJSONValueObjectGetKey(arena, 0)) < 0)
+        goto cleanup;
+
+    if (virJSONValueObjectRemoveKey(arena, key, &removed) != 1 ||
+        virJSONValueObjectAppend(arena, key, removed) < 0)
+        goto cleanup;
+    removed = NULL;
+    if (virJSONValueObjectRemoveKey(heap, key, &removed) != 1 ||
+        virJSONValueObjectAppend(heap, key, removed) < 0)
+        goto cleanup;
+    removed = NULL;
+
+    /* Detached values must outlive the arena they were parsed into */
+    if (virJSONValueObjectRemoveKey(arena, key, &removed) != 1)
+        goto cleanup;
+    virJSONValueFree(arena);
+    arena = NULL;
+    if (!(arena = virJSONValueNewObject()) ||
+        virJSONValueObjectAppend(arena, key, removed) < 0)
+        goto cleanup;
+    removed = NULL;
+
+    VIR_FREE(expect);
+    VIR_FREE(actual);
+    if (virJSONValueObjectRemoveKey(heap, key, &removed) != 1 ||
+        !(expect = virJSONValueToString(removed, false)) ||
+        !(actual = virJSONValueToString(virJSONValueObjectGet(arena, key),
+                                        false)))
+        goto cleanup;
+
+    if (STRNEQ(expect, actual)) {
+        virtTestDifference(stderr, expect, actual);
+        goto cleanup;
+    }
+
+    ret = 0;
+
+cleanup:
+    virJSONValueFree(heap);
+    virJSONValueFree(arena);
+    virJSONValueFree(removed);
+    VIR_FREE(expect);
+    VIR_FREE(actual);
+    VIR_FREE(key);
+    return ret;
+}
+
+
+#define TEST_LARGE_OBJECT_KEYS 1000
+
+static int
+testJSONLargeObject(const void *data ATTRIBUTE_UNUSED)
+{
+    virJSONValuePtr obj = NULL;
+    virJSONValuePtr parsed = NULL;
+    char *key = NULL;
+    char *str = NULL;
+    size_t i;
+    unsigned int val;
+    int ret = -1;
+
+    if (!(obj = virJSONValueNewObject()))
+        goto cleanup;
+
+    for (i = 0; i < TEST_LARGE_OBJECT_KEYS; i++) {
+        if (virAsprintf(&key, "key-%zu", i) < 0 ||
+            virJSONValueObjectAppendNumberUint(obj, key, i) < 0)
+            goto cleanup;
+        VIR_FREE(key);
+    }
+
+    if (virJSONValueObjectAppendNull(obj, "key-10") == 0) {
+        if (virTestGetVerbose())
+            fprintf(stderr, "%s", "duplicate key was accepted\n");
+        goto cleanup;
+    }
+
+    /* Drop every odd key */
+    for (i = 1; i < TEST_LARGE_OBJECT_KEYS; i += 2) {
+        if (virAsprintf(&key, "key-%zu", i) < 0)
+            goto cleanup;
+        if (virJSONValueObjectRemoveKey(obj, key, NULL) != 1) {
+            if (virTestGetVerbose())
+                fprintf(stderr, "failed to remove %s\n", key);
+            goto cleanup;
+        }
+        VIR_FREE(key);
+    }
+
+    if (!(str = virJSONValueToString(obj, false)) ||
+        !(parsed = virJSONValueFromStringArena(str)))
+        goto cleanup;
+
+    for (i = 0; i < TEST_LARGE_OBJECT_KEYS; i++) {
+        if (virAsprintf(&key, "key-%zu", i) < 0)
+            goto cleanup;
+
+        if (i % 2) {
+            if (virJSONValueObjectHasKey(obj, key) != 0 ||
+                virJSONValueObjectGet(parsed, key)) {
+                if (virTestGetVerbose())
+                    fprintf(stderr, "removed %s still present\n", key);
+                goto cleanup;
+            }
+        } else {
+            if (virJSONValueObjectGetNumberUint(obj, key, &val) < 0 ||
+                val != i ||
+                virJSONValueObjectGetNumberUint(parsed, key, &val) < 0 ||
+                val != i) {
+                if (virTestGetVerbose())
+                    fprintf(stderr, "wrong value for %s\n", key);
+                goto cleanup;
+            }
+        }
+        VIR_FREE(key);
+    }
+
+    if (virJSONValueObjectKeysNumber(parsed) != TEST_LARGE_OBJECT_KEYS / 2 ||
+        STRNEQ_NULLABLE(virJSONValueObjectGetKey(parsed, 1), "key-2"))
+        goto cleanup;
+
+    ret = 0;
+
+cleanup:
+    virJSONValueFree(obj);
+    virJSONValueFree(parsed);
+    VIR_FREE(key);
+    VIR_FREE(str);
+    return ret;
+}
+
+
+struct testBenchInfo {
+    const char *name;
+    bool arena;
+};
+
+/* Parse a monitor reply and look up every key in it, which is the
+ * usual life cycle of a reply */
+static int
+testJSONBenchLookupAll(virJSONValuePtr value)
+{
+    size_t i;
+    int n;
+
+    switch (value->type) {
+    case VIR_JSON_TYPE_OBJECT:
+        n = virJSONValueObjectKeysNumber(value);
+        for (i = 0; i < n; i++) {
+            const char *key = virJSONValueObjectGetKey(value, i);
+            if (virJSONValueObjectGet(value, key) !=
+                virJSONValueObjectGetValue(value, i) ||
+                testJSONBenchLookupAll(virJSONValueObjectGetValue(value, i)) < 0)
+                return -1;
+        }
+        break;
+    case VIR_JSON_TYPE_ARRAY:
+        n = virJSONValueArraySize(value);
+        for (i = 0; i < n; i++) {
+            if (testJSONBenchLookupAll(virJSONValueArrayGet(value, i)) < 0)
+                return -1;
+        }
+        break;
+    }
+
+    return 0;
+}
+
+static int
+testJSONBench(const void *opaque)
+{
+    const struct testBenchInfo *info = opaque;
+    virJSONValuePtr json = NULL;
+    char *filename = NULL;
+    char *doc = NULL;
+    unsigned long long start, end;
+    size_t i, iterations = virTestGetExpensive() ? 100000 : 100;
+    int ret = -1;
+#ifdef TEST_OOM
+    int nalloc = 0;
+#endif
+
+    if (virAsprintf(&filename, "%s/qemumonitorjsondata/qemumonitorjson-%s.json",
+                    abs_srcdir, info->name) < 0)
+        goto cleanup;
+
+    if (virtTestLoadFile(filename, &doc) < 0)
+        goto cleanup;
+
+#ifdef TEST_OOM
+    if (!virtTestOOMActive())
+        virAllocTestInit();
+#endif
+
+    if (virTimeMillisNow(&start) < 0)
+        goto cleanup;
+
+    for (i = 0; i < iterations; i++) {
+        if (info->arena)
+            json = virJSONValueFromStringArena(doc);
+        else
+            json = virJSONValueFromString(doc);
+
+        if (!json || testJSONBenchLookupAll(json) < 0)
+            goto cleanup;
+
+        virJSONValueFree(json);
+        json = NULL;
+    }
+
+    if (virTimeMillisNow(&end) < 0)
+        goto cleanup;
+
+#ifdef TEST_OOM
+    if (!virtTestOOMActive())
+        nalloc = virAllocTestCount();
+#endif
+
+    if (virTestGetVerbose()) {
+        fprintf(stderr, "%zu bytes, %.2f us", strlen(doc),
+                (double) (end - start) * 1000 / iterations);
+#ifdef TEST_OOM
+        fprintf(stderr, ", %.1f allocs", (double) nalloc / iterations);
+#endif
+        fprintf(stderr, " per reply ");
+    }
+
+    ret = 0;
+
+cleanup:
+    virJSONValueFree(json);
+    VIR_FREE(doc);
+    VIR_FREE(filename);
+    return ret;
+}
+
+
 static int
 mymain(void)
 {
@@ -142,8 +421,11 @@ mymain(void)
             ret = -1;                                               \
     } while (0)
 
-#define DO_TEST_PARSE(name, doc)                \
-    DO_TEST_FULL(name, FromString, doc, NULL, true)
+#define DO_TEST_PARSE(name, doc)                                \
+    do {                                                        \
+        DO_TEST_FULL(name, FromString, doc, NULL, true);        \
+        DO_TEST_FULL(name " (arena)", Arena, doc, NULL, true);  \
+    } while (0)
 
 #define DO_TEST_PARSE_FAIL(name, doc)           \
     DO_TEST_FULL(name, FromString, doc, NULL, false)
@@ -214,6 +496,24 @@ mymain(void)
                        "[ {[\"key1\", \"key2\"]: \"value\"} ]");
     DO_TEST_PARSE_FAIL("object with unterminated key", "{ \"key:7 }");
 
+    if (virtTestRun("large object", testJSONLargeObject, NULL) < 0)
+        ret = -1;
+
+#define DO_TEST_BENCH(name)                                         \
+    do {                                                            \
+        struct testBenchInfo heap = { name, false };                \
+        struct testBenchInfo arena = { name, true };                \
+        if (virtTestRun("bench " name " (heap)",                    \
+                        testJSONBench, &heap) < 0)                  \
+            ret = -1;                                               \
+        if (virtTestRun("bench " name " (arena)",                   \
+                        testJSONBench, &arena) < 0)                 \
+            ret = -1;                                               \
+    } while (0)
+
+    DO_TEST_BENCH("getcpu-full");
+    DO_TEST_BENCH("getcpu-host");
+
     return (ret == 0) ? EXIT_SUCCESS : EXIT_FAILURE;
 }
 
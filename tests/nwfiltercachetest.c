@@ -0,0 +1,340 @@
+/*
+ * Copyright (C) 2014 Red Hat, Inc.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library.  If not, see
+ * <http://www.gnu.org/licenses/>.
+ */
+
+#include <config.h>
+
+#include <stdlib.h>
+#include <unistd.h>
+
+#include "testutils.h"
+#include "viralloc.h"
+#include "virbuffer.h"
+#include "virfile.h"
+#include "virstring.h"
+#include "nwfilter/nwfilter_gentech_driverpriv.h"
+#include "nwfilter/nwfilter_ebiptables_driver.h"
+
+#define VIR_FROM_THIS VIR_FROM_NONE
+
+static virNWFilterDriverState driver;
+static virNWFilterHashTablePtr vars;
+
+static const char *rootXML =
+    "<filter name='cache-root' chain='root'>"
+    "  <rule action='drop' direction='out' priority='100'>"
+    "    <mac match='no' srcmacaddr='$MAC'/>"
+    "  </rule>"
+    "  <filterref filter='cache-arp'/>"
+    "</filter>";
+
+static const char *arpXML =
+    "<filter name='cache-arp' chain='arp'>"
+    "  <rule action='accept' direction='inout' priority='500'>"
+    "    <arp opcode='Request'/>"
+    "  </rule>"
+    "</filter>";
+
+static const char *arpXML2 =
+    "<filter name='cache-arp' chain='arp'>"
+    "  <rule action='accept' direction='inout' priority='500'>"
+    "    <arp opcode='Reply'/>"
+    "  </rule>"
+    "</filter>";
+
+static const char *otherXML =
+    "<filter name='cache-other' chain='root'>"
+    "  <rule action='drop' direction='in' priority='100'>"
+    "    <mac protocolid='ipv6'/>"
+    "  </rule>"
+    "</filter>";
+
+
+static int
+testDefineFilter(const char *xml)
+{
+    virNWFilterDefPtr def;
+    virNWFilterObjPtr obj;
+
+    if (!(def = virNWFilterDefParseString(xml)))
+        return -1;
+
+    if (!(obj = virNWFilterObjAssignDef(&driver.nwfilters, def))) {
+        virNWFilterDefFree(def);
+        return -1;
+    }
+    virNWFilterObjUnlock(obj);
+    return 0;
+}
+
+
+/*
+ * Instantiate the filter @name for @ifname and format the resulting
+ * commands, one per line, into @commands. @hit tells whether the cache
+ * is expected to be used.
+ */
+static int
+testInstantiate(const char *name,
+                const char *ifname,
+                bool hit,
+                char **commands)
+{
+    virNWFilterObjPtr obj;
+    virNWFilterRuleInstPtr *insts = NULL;
+    int ninsts = 0;
+    unsigned long long hits, misses, hits2, misses2;
+    virBuffer buf = VIR_BUFFER_INITIALIZER;
+    size_t i, j;
+    int rc;
+
+    if (!(obj = virNWFilterObjFindByName(&driver.nwfilters, name)))
+        return -1;
+
+    virNWFilterInstCacheGetStats(&hits, &misses);
+    rc = virNWFilterInstantiateCached(&ebiptables_driver,
+                                      VIR_DOMAIN_NET_TYPE_ETHERNET,
+                                      obj->def, ifname, vars,
+                                      &ninsts, &insts, &driver);
+    virNWFilterObjUnlock(obj);
+    if (rc < 0)
+        goto error;
+
+    virNWFilterInstCacheGetStats(&hits2, &misses2);
+    if (hits2 - hits != (hit ? 1 : 0) ||
+        misses2 - misses != (hit ? 0 : 1)) {
+        if (virTestGetVerbose())
+            fprintf(stderr, "%s on %s: expected a cache %s\n",
+                    name, ifname, hit ? "hit" : "miss");
+        goto error;
+    }
+
+    for (i = 0; i < ninsts; i++) {
+        for (j = 0; j < insts[i]->ndata; j++) {
+            ebiptablesRuleInstPtr inst = insts[i]->data[j];
+
+            virBufferAsprintf(&buf, "%s %s\n",
+                              inst->neededProtocolChain,
+                              inst->commandTemplate);
+        }
+    }
+
+    for (i = 0; i < ninsts; i++)
+        virNWFilterRuleInstFree(insts[i]);
+    VIR_FREE(insts);
+
+    if (virBufferError(&buf))
+        goto error;
+    *commands = virBufferContentAndReset(&buf);
+    return 0;
+
+error:
+    for (i = 0; i < ninsts; i++)
+        virNWFilterRuleInstFree(insts[i]);
+    VIR_FREE(insts);
+    virBufferFreeAndReset(&buf);
+    return -1;
+}
+
+
+static int
+testCompare(const char *what,
+            const char *expect,
+            const char *actual,
+            bool equal)
+{
+    if (STREQ(expect, actual) == equal)
+        return 0;
+
+    if (virTestGetVerbose()) {
+        fprintf(stderr, "%s: commands unexpectedly %s\n",
+                what, equal ? "differ" : "match");
+        if (equal)
+            virtTestDifference(stderr, expect, actual);
+    }
+    return -1;
+}
+
+
+/*
+ * The second interface gets the rules of the first with only the
+ * interface name changed, and the same as compiling them afresh
+ */
+static int
+testCacheHit(const void *data ATTRIBUTE_UNUSED)
+{
+    char *vnet0 = NULL;
+    char *vnet1 = NULL;
+    char *fresh = NULL;
+    char *expect = NULL;
+    int ret = -1;
+
+    virNWFilterInstCacheInvalidate(NULL);
+
+    if (testInstantiate("cache-root", "vnet0", false, &vnet0) < 0 ||
+        testInstantiate("cache-root", "vnet1", true, &vnet1) < 0)
+        goto cleanup;
+
+    if (!strstr(vnet1, "vnet1") || strstr(vnet1, "vnet0")) {
+        if (virTestGetVerbose())
+            fprintf(stderr, "rules not moved to vnet1:\n%s", vnet1);
+        goto cleanup;
+    }
+
+    virNWFilterInstCacheInvalidate(NULL);
+    if (testInstantiate("cache-root", "vnet1", false, &fresh) < 0 ||
+        testCompare("cached vs compiled", fresh, vnet1, true) < 0)
+        goto cleanup;
+
+    /* and back again, from an entry built for vnet1 */
+    if (!(expect = virStringReplace(vnet1, "vnet1", "vnet0")))
+        goto cleanup;
+    VIR_FREE(vnet0);
+    if (testInstantiate("cache-root", "vnet0", true, &vnet0) < 0 ||
+        testCompare("moved back", expect, vnet0, true) < 0)
+        goto cleanup;
+
+    ret = 0;
+ cleanup:
+    VIR_FREE(vnet0);
+    VIR_FREE(vnet1);
+    VIR_FREE(fresh);
+    VIR_FREE(expect);
+    return ret;
+}
+
+
+/*
+ * Redefining a filter frees its old definition straight away. Cached
+ * rules must not refer to it, and invalidating the filter must drop
+ * every tree using it but no other
+ */
+static int
+testCacheInvalidate(const void *data ATTRIBUTE_UNUSED)
+{
+    char *before = NULL;
+    char *stale = NULL;
+    char *after = NULL;
+    char *other = NULL;
+    int ret = -1;
+
+    virNWFilterInstCacheInvalidate(NULL);
+
+    if (testInstantiate("cache-root", "vnet0", false, &before) < 0 ||
+        testInstantiate("cache-other", "vnet0", false, &other) < 0)
+        goto cleanup;
+    VIR_FREE(other);
+
+    if (testDefineFilter(arpXML2) < 0)
+        goto cleanup;
+
+    /* as the driver would do after the definition is replaced */
+    if (testInstantiate("cache-root", "vnet1", true, &stale) < 0)
+        goto cleanup;
+    virNWFilterInstCacheInvalidate("cache-arp");
+
+    if (testInstantiate("cache-other", "vnet1", true, &other) < 0 ||
+        testInstantiate("cache-root", "vnet0", false, &after) < 0 ||
+        testCompare("redefined", before, after, false) < 0)
+        goto cleanup;
+
+    /* dropping the subfilter drops the tree using it */
+    VIR_FREE(after);
+    if (testInstantiate("cache-root", "vnet1", true, &after) < 0)
+        goto cleanup;
+    virNWFilterInstCacheInvalidate("cache-arp");
+    VIR_FREE(after);
+    if (testInstantiate("cache-root", "vnet1", false, &after) < 0)
+        goto cleanup;
+
+    ret = 0;
+ cleanup:
+    ignore_value(testDefineFilter(arpXML));
+    VIR_FREE(before);
+    VIR_FREE(stale);
+    VIR_FREE(after);
+    VIR_FREE(other);
+    return ret;
+}
+
+
+static int
+mymain(void)
+{
+    int ret = 0;
+    char *bindir = NULL;
+    char *ebtables = NULL;
+    char *path = NULL;
+    char *mac = NULL;
+
+    /* The rules are only built, never applied, but the tech driver
+     * refuses to build ebtables rules without finding the tool */
+    if (VIR_STRDUP(bindir, abs_builddir "/nwfiltercachedata-XXXXXX") < 0 ||
+        !mkdtemp(bindir) ||
+        virAsprintf(&ebtables, "%s/ebtables", bindir) < 0 ||
+        symlink("/bin/true", ebtables) < 0 ||
+        VIR_STRDUP(path, getenv("PATH")) < 0 ||
+        setenv("PATH", bindir, 1) < 0) {
+        ret = -1;
+        goto cleanup;
+    }
+
+    if (virNWFilterTechDriversInit(true) < 0 ||
+        !(ebiptables_driver.flags & TECHDRV_FLAG_INITIALIZED)) {
+        ret = -1;
+        goto cleanup;
+    }
+
+    if (testDefineFilter(arpXML) < 0 ||
+        testDefineFilter(rootXML) < 0 ||
+        testDefineFilter(otherXML) < 0 ||
+        VIR_STRDUP(mac, "52:54:00:00:00:01") < 0) {
+        ret = -1;
+        goto shutdown;
+    }
+
+    /* takes over mac */
+    if (!(vars = virNWFilterCreateVarHashmap(mac, NULL))) {
+        VIR_FREE(mac);
+        ret = -1;
+        goto shutdown;
+    }
+
+    if (virtTestRun("Cache hit", testCacheHit, NULL) < 0)
+        ret = -1;
+    if (virtTestRun("Cache invalidate", testCacheInvalidate, NULL) < 0)
+        ret = -1;
+
+ shutdown:
+    virNWFilterHashTableFree(vars);
+    virNWFilterObjListFree(&driver.nwfilters);
+    virNWFilterTechDriversShutdown();
+
+ cleanup:
+    if (path)
+        ignore_value(setenv("PATH", path, 1));
+    if (ebtables)
+        unlink(ebtables);
+    if (bindir)
+        rmdir(bindir);
+    VIR_FREE(ebtables);
+    VIR_FREE(bindir);
+    VIR_FREE(path);
+
+    return ret == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+}
+
+VIRT_TEST_MAIN(mymain)
@@ -48,9 +48,7 @@ testQemuAgentFSFreeze(const void *data)
                                "{ \"return\" : 5 }") < 0)
         goto cleanup;
 
-    if (qemuMonitorTestAddAgentSyncResponse(test) < 0)
-        goto cleanup;
-
+    /* no guest-sync right after a command was answered */
     if (qemuMonitorTestAddItem(test, "guest-fsfreeze-freeze",
                                "{ \"return\" : 7 }") < 0)
         goto cleanup;
@@ -98,9 +96,7 @@ testQemuAgentFSThaw(const void *data)
                                "{ \"return\" : 5 }") < 0)
         goto cleanup;
 
-    if (qemuMonitorTestAddAgentSyncResponse(test) < 0)
-        goto cleanup;
-
+    /* no guest-sync right after a command was answered */
     if (qemuMonitorTestAddItem(test, "guest-fsfreeze-thaw",
                                "{ \"return\" : 7 }") < 0)
         goto cleanup;
@@ -423,9 +419,6 @@ testQemuAgentCPU(const void *data)
     if (qemuAgentUpdateCPUInfo(2, cpuinfo, nvcpus) < 0)
         goto cleanup;
 
-    if (qemuMonitorTestAddAgentSyncResponse(test) < 0)
-        goto cleanup;
-
     if (qemuMonitorTestAddItemParams(test, "guest-set-vcpus",
                                      "{ \"return\" : 4 }",
                                      "vcpus", testQemuAgentCPUArguments1,
@@ -443,9 +436,6 @@ testQemuAgentCPU(const void *data)
     }
 
     /* try to hotplug two */
-    if (qemuMonitorTestAddAgentSyncResponse(test) < 0)
-        goto cleanup;
-
     if (qemuMonitorTestAddItemParams(test, "guest-set-vcpus",
                                      "{ \"return\" : 4 }",
                                      "vcpus", testQemuAgentCPUArguments2,
@@ -570,6 +560,18 @@ testQemuAgentTimeout(const void *data)
         goto cleanup;
     }
 
+    /* the reply to a timed out command could still arrive, so the
+     * next command has to sync again */
+    if (qemuMonitorTestAddAgentSyncResponse(test) < 0)
+        goto cleanup;
+
+    if (qemuMonitorTestAddItem(test, "guest-fsfreeze-thaw",
+                               "{ \"return\" : 0 }") < 0)
+        goto cleanup;
+
+    if (qemuAgentFSThaw(qemuMonitorTestGetAgent(test)) != 0)
+        goto cleanup;
+
     ret = 0;
 
 cleanup:
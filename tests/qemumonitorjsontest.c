@@ -1023,6 +1023,132 @@ cleanup:
     return ret;
 }
 
+struct testQemuMonitorJSONBatchData {
+    char *firstID;
+};
+
+/* Holds back the reply to the first command of a batch */
+static int
+testQemuMonitorJSONBatchFirst(qemuMonitorTestPtr test ATTRIBUTE_UNUSED,
+                              qemuMonitorTestItemPtr item,
+                              const char *cmdstr)
+{
+    struct testQemuMonitorJSONBatchData *data;
+    virJSONValuePtr val;
+    int ret;
+
+    data = qemuMonitorTestItemGetPrivateData(item);
+    if (!(val = virJSONValueFromString(cmdstr)))
+        return -1;
+
+    ret = VIR_STRDUP(data->firstID, virJSONValueObjectGetString(val, "id"));
+    virJSONValueFree(val);
+    return ret < 0 ? -1 : 0;
+}
+
+/* Replies to the second command of a batch before the first one,
+ * preceded by a late reply to a command nobody waits for */
+static int
+testQemuMonitorJSONBatchSecond(qemuMonitorTestPtr test,
+                               qemuMonitorTestItemPtr item,
+                               const char *cmdstr)
+{
+    struct testQemuMonitorJSONBatchData *data;
+    virJSONValuePtr val;
+    char *reply = NULL;
+    int ret = -1;
+
+    data = qemuMonitorTestItemGetPrivateData(item);
+    if (!(val = virJSONValueFromString(cmdstr)))
+        return -1;
+
+    if (!data->firstID)
+        goto cleanup;
+
+    if (qemuMonitorTestAddReponse(test,
+                                  "{\"return\": \"stale\", "
+                                  "\"id\": \"libvirt-stale\"}") < 0)
+        goto cleanup;
+
+    if (virAsprintf(&reply, "{\"return\": \"second\", \"id\": \"%s\"}",
+                    virJSONValueObjectGetString(val, "id")) < 0 ||
+        qemuMonitorTestAddReponse(test, reply) < 0)
+        goto cleanup;
+    VIR_FREE(reply);
+
+    if (virAsprintf(&reply, "{\"return\": \"first\", \"id\": \"%s\"}",
+                    data->firstID) < 0 ||
+        qemuMonitorTestAddReponse(test, reply) < 0)
+        goto cleanup;
+
+    ret = 0;
+
+cleanup:
+    VIR_FREE(reply);
+    virJSONValueFree(val);
+    return ret;
+}
+
+static int
+testQemuMonitorJSONCommandBatch(const void *data)
+{
+    virDomainXMLOptionPtr xmlopt = (virDomainXMLOptionPtr)data;
+    qemuMonitorTestPtr test = qemuMonitorTestNewSimple(true, xmlopt);
+    struct testQemuMonitorJSONBatchData batch = { NULL };
+    const char *expected[] = { "first", "second", "third" };
+    virJSONValuePtr cmds[ARRAY_CARDINALITY(expected)] = { NULL };
+    virJSONValuePtr replies[ARRAY_CARDINALITY(expected)] = { NULL };
+    size_t i;
+    int ret = -1;
+
+    if (!test)
+        return -1;
+
+    /* The first two replies arrive out of order and are matched by
+     * their "id", the last one has none and goes to the oldest
+     * command still waiting. A reply with an unknown "id" is
+     * dropped */
+    if (qemuMonitorTestAddHandler(test, testQemuMonitorJSONBatchFirst,
+                                  &batch, NULL) < 0 ||
+        qemuMonitorTestAddHandler(test, testQemuMonitorJSONBatchSecond,
+                                  &batch, NULL) < 0 ||
+        qemuMonitorTestAddItem(test, "query-name",
+                               "{\"return\": \"third\"}") < 0)
+        goto cleanup;
+
+    for (i = 0; i < ARRAY_CARDINALITY(cmds); i++) {
+        if (!(cmds[i] = virJSONValueFromString("{\"execute\":\"query-name\"}")))
+            goto cleanup;
+    }
+
+    if (qemuMonitorJSONCommandBatch(qemuMonitorTestGetMonitor(test),
+                                    cmds, ARRAY_CARDINALITY(cmds),
+                                    replies) < 0)
+        goto cleanup;
+
+    for (i = 0; i < ARRAY_CARDINALITY(replies); i++) {
+        const char *got = virJSONValueObjectGetString(replies[i], "return");
+
+        if (STRNEQ_NULLABLE(got, expected[i])) {
+            virReportError(VIR_ERR_INTERNAL_ERROR,
+                           "reply %zu is '%s', expected '%s'",
+                           i, NULLSTR(got), expected[i]);
+            goto cleanup;
+        }
+    }
+
+    ret = 0;
+
+cleanup:
+    for (i = 0; i < ARRAY_CARDINALITY(cmds); i++) {
+        virJSONValueFree(cmds[i]);
+        virJSONValueFree(replies[i]);
+    }
+    VIR_FREE(batch.firstID);
+    qemuMonitorTestFree(test);
+    return ret;
+}
+
 static int
 testQemuMonitorJSONCPU(const void *data)
 {
@@ -2136,6 +2262,7 @@ mymain(void)
     DO_TEST(GetObjectProperty);
     DO_TEST(SetObjectProperty);
     DO_TEST(GetDeviceAliases);
+    DO_TEST(CommandBatch);
     DO_TEST(CPU);
     DO_TEST(GetNonExistingCPUData);
     DO_TEST_SIMPLE("qmp_capabilities", qemuMonitorJSONSetCapabilities);
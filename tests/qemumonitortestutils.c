@@ -115,6 +115,44 @@ qemuMonitorTestAddReponse(qemuMonitorTestPtr test,
 }
 
 
+/*
+ * Appends a canned reply to a JSON command. Like QEMU, the reply
+ * carries the "id" of the command rather than the one it was
+ * recorded with.
+ */
+static int
+qemuMonitorTestAddCommandResponse(qemuMonitorTestPtr test,
+                                  virJSONValuePtr cmd,
+                                  const char *response)
+{
+    virJSONValuePtr reply = NULL;
+    const char *id;
+    char *replystr = NULL;
+    int ret = -1;
+
+    if (!(id = virJSONValueObjectGetString(cmd, "id")) ||
+        !(reply = virJSONValueFromString(response)) ||
+        reply->type != VIR_JSON_TYPE_OBJECT ||
+        virJSONValueObjectHasKey(reply, "id") != 1) {
+        virResetLastError();
+        ret = qemuMonitorTestAddReponse(test, response);
+        goto cleanup;
+    }
+
+    if (virJSONValueObjectRemoveKey(reply, "id", NULL) < 0 ||
+        virJSONValueObjectAppendString(reply, "id", id) < 0 ||
+        !(replystr = virJSONValueToString(reply, false)))
+        goto cleanup;
+
+    ret = qemuMonitorTestAddReponse(test, replystr);
+
+cleanup:
+    virJSONValueFree(reply);
+    VIR_FREE(replystr);
+    return ret;
+}
+
+
 int
 qemuMonitorTestAddUnexpectedErrorResponse(qemuMonitorTestPtr test)
 {
@@ -488,6 +526,8 @@ qemuMonitorTestProcessCommandDefault(qemuMonitorTestPtr test,
 
     if (data->command_name && STRNEQ(data->command_name, cmdname))
         ret = qemuMonitorTestAddUnexpectedErrorResponse(test);
+    else if (val)
+        ret = qemuMonitorTestAddCommandResponse(test, val, data->response);
     else
         ret = qemuMonitorTestAddReponse(test, data->response);
 
@@ -649,7 +689,7 @@ qemuMonitorTestProcessCommandWithArgs(qemuMonitorTestPtr test,
     }
 
     /* arguments checked out, return the response */
-    ret = qemuMonitorTestAddReponse(test, data->response);
+    ret = qemuMonitorTestAddCommandResponse(test, val, data->response);
 
 cleanup:
     VIR_FREE(argstr);
@@ -0,0 +1,191 @@
+#include <config.h>
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "testutils.h"
+#include "security/security_manager.h"
+#include "viralloc.h"
+#include "viratomic.h"
+#include "virerror.h"
+#include "virstring.h"
+
+#define VIR_FROM_THIS VIR_FROM_NONE
+
+#define NPATHS 100
+
+typedef struct _testLabelEntry testLabelEntry;
+typedef testLabelEntry *testLabelEntryPtr;
+struct _testLabelEntry {
+    int applied;
+    int undone;
+    bool fail;
+};
+
+static virSecurityManagerPtr mgr;
+
+static int
+testLabelApply(virSecurityManagerPtr manager ATTRIBUTE_UNUSED,
+               const char *path,
+               void *data)
+{
+    testLabelEntryPtr entry = data;
+
+    virAtomicIntInc(&entry->applied);
+    if (entry->fail) {
+        virReportError(VIR_ERR_INTERNAL_ERROR,
+                       "cannot label %s", path);
+        return -1;
+    }
+    /* odd entries report that labelling was skipped */
+    return (path[strlen(path) - 1] - '0') % 2;
+}
+
+static int
+testLabelUndo(virSecurityManagerPtr manager ATTRIBUTE_UNUSED,
+              const char *path ATTRIBUTE_UNUSED,
+              void *data)
+{
+    testLabelEntryPtr entry = data;
+
+    entry->undone++;
+    return 0;
+}
+
+static int
+testLabelJobsQueue(virSecurityManagerLabelJobsPtr jobs,
+                   testLabelEntryPtr entries,
+                   ssize_t *idx)
+{
+    char path[64];
+    size_t i;
+
+    for (i = 0; i < NPATHS; i++) {
+        snprintf(path, sizeof(path), "/images/disk%zu", i);
+        if ((idx[i] = virSecurityManagerLabelJobsAdd(jobs, path, &entries[i],
+                                                     i % 3 != 0)) < 0)
+            return -1;
+    }
+    return 0;
+}
+
+static int
+testLabelJobsSuccess(const void *data ATTRIBUTE_UNUSED)
+{
+    virSecurityManagerLabelJobsPtr jobs = NULL;
+    testLabelEntry entries[NPATHS];
+    ssize_t idx[NPATHS];
+    size_t i;
+    int ret = -1;
+
+    memset(entries, 0, sizeof(entries));
+
+    if (!(jobs = virSecurityManagerLabelJobsNew(mgr, testLabelApply,
+                                                testLabelUndo, NULL)))
+        goto cleanup;
+
+    if (testLabelJobsQueue(jobs, entries, idx) < 0)
+        goto cleanup;
+
+    /* queueing a path again must not label it twice */
+    if (virSecurityManagerLabelJobsAdd(jobs, "/images/disk7",
+                                       &entries[7], true) != idx[7]) {
+        fprintf(stderr, "duplicate path got a new job\n");
+        goto cleanup;
+    }
+
+    if (virSecurityManagerLabelJobsRun(jobs) < 0)
+        goto cleanup;
+
+    for (i = 0; i < NPATHS; i++) {
+        if (entries[i].applied != 1 || entries[i].undone != 0) {
+            fprintf(stderr, "path %zu applied %d times, undone %d times\n",
+                    i, entries[i].applied, entries[i].undone);
+            goto cleanup;
+        }
+        if (virSecurityManagerLabelJobsGetResult(jobs, idx[i]) != i % 2) {
+            fprintf(stderr, "wrong result for path %zu\n", i);
+            goto cleanup;
+        }
+    }
+
+    ret = 0;
+
+cleanup:
+    virSecurityManagerLabelJobsFree(jobs);
+    return ret;
+}
+
+static int
+testLabelJobsRollback(const void *data ATTRIBUTE_UNUSED)
+{
+    virSecurityManagerLabelJobsPtr jobs = NULL;
+    testLabelEntry entries[NPATHS];
+    ssize_t idx[NPATHS];
+    virErrorPtr err;
+    size_t i;
+    int ret = -1;
+
+    memset(entries, 0, sizeof(entries));
+    entries[NPATHS / 2].fail = true;
+
+    if (!(jobs = virSecurityManagerLabelJobsNew(mgr, testLabelApply,
+                                                testLabelUndo, NULL)))
+        goto cleanup;
+
+    if (testLabelJobsQueue(jobs, entries, idx) < 0)
+        goto cleanup;
+
+    if (virSecurityManagerLabelJobsRun(jobs) == 0) {
+        fprintf(stderr, "failing label was not reported\n");
+        goto cleanup;
+    }
+
+    err = virGetLastError();
+    if (!err || !err->message ||
+        STRNEQ(err->message, "internal error: cannot label /images/disk50")) {
+        fprintf(stderr, "unexpected error '%s'\n",
+                err && err->message ? err->message : "");
+        goto cleanup;
+    }
+    virResetLastError();
+
+    for (i = 0; i < NPATHS; i++) {
+        int expect = (i % 3 != 0 && !entries[i].fail) ? entries[i].applied : 0;
+
+        if (entries[i].applied > 1 || entries[i].undone != expect) {
+            fprintf(stderr, "path %zu applied %d times, undone %d times\n",
+                    i, entries[i].applied, entries[i].undone);
+            goto cleanup;
+        }
+    }
+
+    ret = 0;
+
+cleanup:
+    virSecurityManagerLabelJobsFree(jobs);
+    return ret;
+}
+
+static int
+mymain(void)
+{
+    int ret = 0;
+
+    if (!(mgr = virSecurityManagerNew("none", "QEMU", false, true, false))) {
+        fprintf(stderr, "Failed to start security driver\n");
+        return EXIT_FAILURE;
+    }
+
+    if (virtTestRun("Label jobs", testLabelJobsSuccess, NULL) < 0)
+        ret = -1;
+    if (virtTestRun("Label jobs rollback", testLabelJobsRollback, NULL) < 0)
+        ret = -1;
+
+    virObjectUnref(mgr);
+
+    return ret == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+}
+
+VIRT_TEST_MAIN(mymain)
@@ -0,0 +1,280 @@
+#include <config.h>
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "internal.h"
+#include "testutils.h"
+#include "storage_conf.h"
+#include "viralloc.h"
+#include "virstring.h"
+#include "virtime.h"
+
+#define VIR_FROM_THIS VIR_FROM_NONE
+
+static virStoragePoolObjPtr
+testStoragePoolNew(virStoragePoolObjListPtr pools,
+                   size_t n)
+{
+    virStoragePoolDefPtr def = NULL;
+    virStoragePoolObjPtr pool = NULL;
+    char *xml = NULL;
+
+    if (virAsprintf(&xml,
+                    "<pool type='dir'>\n"
+                    "  <name>pool%zu</name>\n"
+                    "  <target><path>/pool%zu</path></target>\n"
+                    "</pool>\n", n, n) < 0)
+        goto cleanup;
+
+    if (!(def = virStoragePoolDefParseString(xml)))
+        goto cleanup;
+
+    if (!(pool = virStoragePoolObjAssignDef(pools, def)))
+        goto cleanup;
+    def = NULL;
+    virStoragePoolObjUnlock(pool);
+
+cleanup:
+    virStoragePoolDefFree(def);
+    VIR_FREE(xml);
+    return pool;
+}
+
+static virStorageVolDefPtr
+testStorageVolNew(virStoragePoolObjPtr pool,
+                  size_t n,
+                  const char *key)
+{
+    virStorageVolDefPtr vol;
+
+    if (VIR_ALLOC(vol) < 0)
+        return NULL;
+
+    if (virAsprintf(&vol->name, "vol%zu", n) < 0 ||
+        virAsprintf(&vol->target.path, "%s/vol%zu",
+                    pool->def->target.path, n) < 0 ||
+        (key ? VIR_STRDUP(vol->key, key) :
+               virAsprintf(&vol->key, "key-%s-%zu",
+                           pool->def->name, n)) < 0 ||
+        virStoragePoolObjAddVol(pool, vol) < 0) {
+        virStorageVolDefFree(vol);
+        return NULL;
+    }
+
+    return vol;
+}
+
+static int
+testStorageVolCheck(virStoragePoolObjPtr pool,
+                    virStorageVolDefPtr vol,
+                    bool present)
+{
+    virStorageVolDefPtr expect = present ? vol : NULL;
+
+    if (virStorageVolDefFindByName(pool, vol->name) != expect ||
+        virStorageVolDefFindByKey(pool, vol->key) != expect ||
+        virStorageVolDefFindByPath(pool, vol->target.path) != expect) {
+        if (virTestGetVerbose())
+            fprintf(stderr, "volume '%s' unexpectedly %s\n",
+                    vol->name, present ? "missing" : "found");
+        return -1;
+    }
+
+    return 0;
+}
+
+#define TEST_VOLS 1000
+
+static int
+testStorageVolIndex(const void *data ATTRIBUTE_UNUSED)
+{
+    virStoragePoolObjList pools = { 0 };
+    virStoragePoolObjPtr pool;
+    virStorageVolDefPtr *vols = NULL;
+    virStorageVolDefPtr dup1, dup2;
+    size_t i;
+    int ret = -1;
+
+    if (VIR_ALLOC_N(vols, TEST_VOLS) < 0 ||
+        !(pool = testStoragePoolNew(&pools, 0)))
+        goto cleanup;
+
+    for (i = 0; i < TEST_VOLS; i++) {
+        if (!(vols[i] = testStorageVolNew(pool, i, NULL)))
+            goto cleanup;
+    }
+
+    /* Drop every odd volume */
+    for (i = 1; i < TEST_VOLS; i += 2) {
+        virStoragePoolObjRemoveVol(pool, vols[i]);
+        if (testStorageVolCheck(pool, vols[i], false) < 0)
+            goto cleanup;
+        virStorageVolDefFree(vols[i]);
+        vols[i] = NULL;
+    }
+
+    for (i = 0; i < TEST_VOLS; i += 2) {
+        if (testStorageVolCheck(pool, vols[i], true) < 0)
+            goto cleanup;
+    }
+
+    if (pool->volumes.count != TEST_VOLS / 2)
+        goto cleanup;
+
+    /* With a shared key, the volume added first must win */
+    if (!(dup1 = testStorageVolNew(pool, TEST_VOLS, "shared")) ||
+        !(dup2 = testStorageVolNew(pool, TEST_VOLS + 1, "shared")))
+        goto cleanup;
+
+    if (virStorageVolDefFindByKey(pool, "shared") != dup1)
+        goto cleanup;
+
+    virStoragePoolObjRemoveVol(pool, dup1);
+    virStorageVolDefFree(dup1);
+    if (virStorageVolDefFindByKey(pool, "shared") != dup2 ||
+        testStorageVolCheck(pool, dup2, true) < 0 ||
+        testStorageVolCheck(pool, vols[0], true) < 0)
+        goto cleanup;
+
+    virStoragePoolObjClearVols(pool);
+    if (virStorageVolDefFindByName(pool, "vol0"))
+        goto cleanup;
+
+    ret = 0;
+
+cleanup:
+    virStoragePoolObjListFree(&pools);
+    VIR_FREE(vols);
+    return ret;
+}
+
+#define TEST_POOLS 50
+
+static int
+testStoragePoolIndex(const void *data ATTRIBUTE_UNUSED)
+{
+    virStoragePoolObjList pools = { 0 };
+    virStoragePoolObjPtr pool;
+    virStoragePoolObjPtr list[TEST_POOLS];
+    unsigned char uuid[VIR_UUID_BUFLEN];
+    size_t i;
+    int ret = -1;
+
+    for (i = 0; i < TEST_POOLS; i++) {
+        if (!(list[i] = testStoragePoolNew(&pools, i)))
+            goto cleanup;
+    }
+
+    for (i = 0; i < TEST_POOLS; i++) {
+        if (!(pool = virStoragePoolObjFindByName(&pools,
+                                                 list[i]->def->name)))
+            goto cleanup;
+        virStoragePoolObjUnlock(pool);
+        if (pool != list[i])
+            goto cleanup;
+
+        if (!(pool = virStoragePoolObjFindByUUID(&pools,
+                                                 list[i]->def->uuid)))
+            goto cleanup;
+        virStoragePoolObjUnlock(pool);
+        if (pool != list[i])
+            goto cleanup;
+    }
+
+    memcpy(uuid, list[0]->def->uuid, VIR_UUID_BUFLEN);
+    virStoragePoolObjLock(list[0]);
+    virStoragePoolObjRemove(&pools, list[0]);
+
+    if (virStoragePoolObjFindByName(&pools, "pool0") ||
+        virStoragePoolObjFindByUUID(&pools, uuid))
+        goto cleanup;
+
+    ret = 0;
+
+cleanup:
+    virStoragePoolObjListFree(&pools);
+    return ret;
+}
+
+/* Resolve every volume by path the way storageVolLookupByPath would
+ * without its path index: by asking each pool in turn */
+static int
+testStorageVolLookupBench(const void *data ATTRIBUTE_UNUSED)
+{
+    virStoragePoolObjList pools = { 0 };
+    virStoragePoolObjPtr pool;
+    virStorageVolDefPtr vol;
+    size_t npools = 50;
+    size_t nvols = virTestGetExpensive() ? 20000 : 1000;
+    unsigned long long start, end;
+    char *path = NULL;
+    size_t i, j;
+    int ret = -1;
+
+    for (i = 0; i < npools; i++) {
+        if (!(pool = testStoragePoolNew(&pools, i)))
+            goto cleanup;
+    }
+
+    for (i = 0; i < nvols; i++) {
+        pool = pools.objs[i % npools];
+        if (!testStorageVolNew(pool, i, NULL))
+            goto cleanup;
+    }
+
+    if (virTimeMillisNow(&start) < 0)
+        goto cleanup;
+
+    for (i = 0; i < nvols; i++) {
+        if (virAsprintf(&path, "/pool%zu/vol%zu", i % npools, i) < 0)
+            goto cleanup;
+
+        vol = NULL;
+        for (j = 0; j < pools.count && !vol; j++) {
+            virStoragePoolObjLock(pools.objs[j]);
+            vol = virStorageVolDefFindByPath(pools.objs[j], path);
+            virStoragePoolObjUnlock(pools.objs[j]);
+        }
+
+        if (!vol || j - 1 != i % npools) {
+            if (virTestGetVerbose())
+                fprintf(stderr, "failed to find '%s'\n", path);
+            goto cleanup;
+        }
+        VIR_FREE(path);
+    }
+
+    if (virTimeMillisNow(&end) < 0)
+        goto cleanup;
+
+    if (virTestGetVerbose())
+        fprintf(stderr, "%zu pools, %zu vols, %.2f us per lookup ",
+                npools, nvols, (double) (end - start) * 1000 / nvols);
+
+    ret = 0;
+
+cleanup:
+    VIR_FREE(path);
+    virStoragePoolObjListFree(&pools);
+    return ret;
+}
+
+static int
+mymain(void)
+{
+    int ret = 0;
+
+    if (virtTestRun("Volume index", testStorageVolIndex, NULL) < 0)
+        ret = -1;
+    if (virtTestRun("Pool index", testStoragePoolIndex, NULL) < 0)
+        ret = -1;
+    if (virtTestRun("Volume lookup by path benchmark",
+                    testStorageVolLookupBench, NULL) < 0)
+        ret = -1;
+
+    return ret == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+}
+
+VIRT_TEST_MAIN(mymain)
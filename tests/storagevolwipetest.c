@@ -0,0 +1,175 @@
+/*
+ * Copyright (C) 2014 Red Hat, Inc.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library.  If not, see
+ * <http://www.gnu.org/licenses/>.
+ */
+
+#include <config.h>
+
+#include <fcntl.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <sys/stat.h>
+
+#include "testutils.h"
+#include "viralloc.h"
+#include "virerror.h"
+#include "virfile.h"
+#include "virstring.h"
+#include "storage/storage_driverpriv.h"
+
+#define VIR_FROM_THIS VIR_FROM_NONE
+
+/* Not a multiple of the write buffer, so the last write is short */
+#define TEST_VOL_SIZE (3 * 1024 * 1024 + 512)
+
+static char *datadir;
+
+
+/* Create a fully allocated volume of TEST_VOL_SIZE bytes, none of
+ * them zero */
+static char *
+testVolCreate(const char *name)
+{
+    char *path = NULL;
+    char *buf = NULL;
+    int fd = -1;
+
+    if (virAsprintf(&path, "%s/%s", datadir, name) < 0 ||
+        VIR_ALLOC_N(buf, TEST_VOL_SIZE) < 0)
+        goto error;
+    memset(buf, 0xaa, TEST_VOL_SIZE);
+
+    if ((fd = open(path, O_WRONLY | O_CREAT | O_TRUNC, 0600)) < 0 ||
+        safewrite(fd, buf, TEST_VOL_SIZE) != TEST_VOL_SIZE ||
+        VIR_CLOSE(fd) < 0)
+        goto error;
+
+    VIR_FREE(buf);
+    return path;
+
+error:
+    VIR_FORCE_CLOSE(fd);
+    VIR_FREE(buf);
+    VIR_FREE(path);
+    return NULL;
+}
+
+
+static int
+testVolWipeZero(const void *data ATTRIBUTE_UNUSED)
+{
+    char *path = NULL;
+    char *buf = NULL;
+    int wipeAbort = 0;
+    struct stat st;
+    size_t i;
+    int ret = -1;
+
+    if (!(path = testVolCreate("zero")))
+        goto cleanup;
+
+    if (storageVolWipeInternal(path, TEST_VOL_SIZE, &wipeAbort,
+                               VIR_STORAGE_VOL_WIPE_ALG_ZERO) < 0)
+        goto cleanup;
+
+    if (stat(path, &st) < 0 || st.st_size != TEST_VOL_SIZE) {
+        if (virTestGetVerbose())
+            fprintf(stderr, "volume size changed by the wipe\n");
+        goto cleanup;
+    }
+
+    if (virFileReadAll(path, TEST_VOL_SIZE, &buf) != TEST_VOL_SIZE)
+        goto cleanup;
+
+    for (i = 0; i < TEST_VOL_SIZE; i++) {
+        if (buf[i]) {
+            if (virTestGetVerbose())
+                fprintf(stderr, "byte %zu not wiped\n", i);
+            goto cleanup;
+        }
+    }
+
+    ret = 0;
+ cleanup:
+    if (path)
+        unlink(path);
+    VIR_FREE(path);
+    VIR_FREE(buf);
+    return ret;
+}
+
+
+/* A wipe whose abort flag is set stops at its first progress check
+ * and reports that it was cancelled */
+static int
+testVolWipeCancel(const void *data ATTRIBUTE_UNUSED)
+{
+    char *path = NULL;
+    int wipeAbort = 1;
+    virErrorPtr err;
+    int ret = -1;
+
+    if (!(path = testVolCreate("cancel")))
+        goto cleanup;
+
+    if (storageVolWipeInternal(path, TEST_VOL_SIZE, &wipeAbort,
+                               VIR_STORAGE_VOL_WIPE_ALG_ZERO) == 0) {
+        if (virTestGetVerbose())
+            fprintf(stderr, "cancelled wipe succeeded\n");
+        goto cleanup;
+    }
+
+    if (!(err = virGetLastError()) ||
+        err->code != VIR_ERR_OPERATION_ABORTED) {
+        if (virTestGetVerbose())
+            fprintf(stderr, "unexpected error: %s\n",
+                    err && err->message ? err->message : "none");
+        goto cleanup;
+    }
+    virResetLastError();
+
+    ret = 0;
+ cleanup:
+    if (path)
+        unlink(path);
+    VIR_FREE(path);
+    return ret;
+}
+
+
+static int
+mymain(void)
+{
+    int ret = 0;
+
+    if (VIR_STRDUP(datadir, abs_builddir "/storagevolwipedata-XXXXXX") < 0 ||
+        !mkdtemp(datadir)) {
+        VIR_FREE(datadir);
+        return EXIT_FAILURE;
+    }
+
+    if (virtTestRun("Wipe zero", testVolWipeZero, NULL) < 0)
+        ret = -1;
+    if (virtTestRun("Wipe cancel", testVolWipeCancel, NULL) < 0)
+        ret = -1;
+
+    rmdir(datadir);
+    VIR_FREE(datadir);
+
+    return ret == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+}
+
+VIRT_TEST_MAIN(mymain)
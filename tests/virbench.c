@@ -0,0 +1,623 @@
+/*
+ * virbench.c: measure libvirt's own overhead on top of the test driver
+ *
+ * By default everything runs in-process against test:///default.  To
+ * include the RPC layer, start libvirtd and point the benchmark at it:
+ *
+ *   VIR_BENCH_URI=test+unix:///default ./virbench
+ *
+ * VIR_BENCH_OBJECTS sets how many domains, networks and volumes are
+ * created (default 100) and VIR_BENCH_ROUNDS how many times the
+ * list-all calls are repeated (default 100).  The results table is
+ * printed when VIR_TEST_VERBOSE or VIR_TEST_DEBUG is set.
+ */
+
+#include <config.h>
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "internal.h"
+#include "testutils.h"
+#include "viralloc.h"
+#include "virstring.h"
+
+#define VIR_FROM_THIS VIR_FROM_NONE
+
+#define VIR_BENCH_STREAM_SIZE (1024 * 1024)
+#define VIR_BENCH_STREAM_CHUNK (64 * 1024)
+
+typedef struct _virBenchData virBenchData;
+typedef virBenchData *virBenchDataPtr;
+struct _virBenchData {
+    virConnectPtr conn;
+    virStoragePoolPtr pool;
+    size_t nobjects;
+    size_t nrounds;
+
+    virDomainPtr *doms;
+    virNetworkPtr *nets;
+    virStorageVolPtr *vols;
+    char *buf; /* VIR_BENCH_STREAM_CHUNK bytes of zeroes */
+
+    int events;
+};
+
+typedef int (*virBenchOp)(virBenchDataPtr data, size_t i);
+
+typedef struct _virBenchResult virBenchResult;
+struct _virBenchResult {
+    const char *name;
+    size_t count;
+    double total; /* seconds */
+    double p50; /* microseconds */
+    double p99; /* microseconds */
+};
+
+static virBenchResult results[32];
+static size_t nresults;
+
+static unsigned long long
+virBenchNow(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1000000000ull + ts.tv_nsec;
+}
+
+static int
+virBenchCompare(const void *a,
+                const void *b)
+{
+    unsigned long long x = *(const unsigned long long *)a;
+    unsigned long long y = *(const unsigned long long *)b;
+
+    return x < y ? -1 : x > y;
+}
+
+/* Run op @count times, timing each call individually */
+static int
+virBenchRun(const char *name,
+            virBenchDataPtr data,
+            virBenchOp op,
+            size_t count)
+{
+    unsigned long long *samples = NULL;
+    unsigned long long start;
+    unsigned long long total = 0;
+    virBenchResult *res;
+    size_t i;
+    int ret = -1;
+
+    if (nresults == ARRAY_CARDINALITY(results) ||
+        VIR_ALLOC_N(samples, count) < 0)
+        return -1;
+
+    for (i = 0; i < count; i++) {
+        start = virBenchNow();
+        if (op(data, i) < 0)
+            goto cleanup;
+        samples[i] = virBenchNow() - start;
+        total += samples[i];
+    }
+
+    qsort(samples, count, sizeof(*samples), virBenchCompare);
+
+    res = &results[nresults++];
+    res->name = name;
+    res->count = count;
+    res->total = total / 1e9;
+    res->p50 = samples[count / 2] / 1e3;
+    res->p99 = samples[(count * 99) / 100] / 1e3;
+    ret = 0;
+
+cleanup:
+    VIR_FREE(samples);
+    return ret;
+}
+
+static int
+virBenchDomainDefine(virBenchDataPtr data,
+                     size_t i)
+{
+    char *xml = NULL;
+
+    if (virAsprintf(&xml,
+                    "<domain type='test'>"
+                    "  <name>bench%zu</name>"
+                    "  <memory>65536</memory>"
+                    "  <os><type>hvm</type></os>"
+                    "</domain>", i) < 0)
+        return -1;
+
+    data->doms[i] = virDomainDefineXML(data->conn, xml);
+    VIR_FREE(xml);
+    return data->doms[i] ? 0 : -1;
+}
+
+static int
+virBenchDomainLookup(virBenchDataPtr data,
+                     size_t i)
+{
+    virDomainPtr dom;
+    char name[32];
+
+    snprintf(name, sizeof(name), "bench%zu", i);
+    if (!(dom = virDomainLookupByName(data->conn, name)))
+        return -1;
+    virDomainFree(dom);
+    return 0;
+}
+
+static int
+virBenchDomainListAll(virBenchDataPtr data,
+                      size_t i ATTRIBUTE_UNUSED)
+{
+    virDomainPtr *doms = NULL;
+    int ndoms;
+    int j;
+
+    if ((ndoms = virConnectListAllDomains(data->conn, &doms, 0)) < 0)
+        return -1;
+    for (j = 0; j < ndoms; j++)
+        virDomainFree(doms[j]);
+    VIR_FREE(doms);
+    return ndoms < data->nobjects ? -1 : 0;
+}
+
+static int
+virBenchDomainDumpXML(virBenchDataPtr data,
+                      size_t i)
+{
+    char *xml;
+
+    if (!(xml = virDomainGetXMLDesc(data->doms[i], 0)))
+        return -1;
+    VIR_FREE(xml);
+    return 0;
+}
+
+static void
+virBenchDomainEvent(virConnectPtr conn ATTRIBUTE_UNUSED,
+                    virDomainPtr dom ATTRIBUTE_UNUSED,
+                    int event ATTRIBUTE_UNUSED,
+                    int detail ATTRIBUTE_UNUSED,
+                    void *opaque)
+{
+    virBenchDataPtr data = opaque;
+
+    data->events++;
+}
+
+/* Dispatch events until @count more have arrived, or give up after
+ * ten seconds */
+static int
+virBenchWaitEvents(virBenchDataPtr data,
+                   int count)
+{
+    unsigned long long deadline = virBenchNow() + 10 * 1000000000ull;
+
+    while (data->events < count) {
+        if (virBenchNow() > deadline) {
+            fprintf(stderr, "timed out waiting for domain events\n");
+            return -1;
+        }
+        if (virEventRunDefaultImpl() < 0)
+            return -1;
+    }
+    data->events -= count;
+    return 0;
+}
+
+/* Time from issuing a start until its lifecycle event is delivered;
+ * stopping the domain again is not part of the measurement */
+static int
+virBenchDomainStartEvent(virBenchDataPtr data,
+                         size_t i)
+{
+    if (virDomainCreate(data->doms[i]) < 0 ||
+        virBenchWaitEvents(data, 1) < 0)
+        return -1;
+    return 0;
+}
+
+static int
+virBenchDomainUndefine(virBenchDataPtr data,
+                       size_t i)
+{
+    if (virDomainUndefine(data->doms[i]) < 0)
+        return -1;
+    virDomainFree(data->doms[i]);
+    data->doms[i] = NULL;
+    return 0;
+}
+
+static int
+virBenchNetworkDefine(virBenchDataPtr data,
+                      size_t i)
+{
+    char *xml = NULL;
+
+    if (virAsprintf(&xml,
+                    "<network>"
+                    "  <name>bench%zu</name>"
+                    "  <bridge name='vbench%zu'/>"
+                    "  <ip address='10.%zu.%zu.1' netmask='255.255.255.0'/>"
+                    "</network>", i, i, i / 256, i % 256) < 0)
+        return -1;
+
+    data->nets[i] = virNetworkDefineXML(data->conn, xml);
+    VIR_FREE(xml);
+    return data->nets[i] ? 0 : -1;
+}
+
+static int
+virBenchNetworkLookup(virBenchDataPtr data,
+                      size_t i)
+{
+    virNetworkPtr net;
+    char name[32];
+
+    snprintf(name, sizeof(name), "bench%zu", i);
+    if (!(net = virNetworkLookupByName(data->conn, name)))
+        return -1;
+    virNetworkFree(net);
+    return 0;
+}
+
+static int
+virBenchNetworkListAll(virBenchDataPtr data,
+                       size_t i ATTRIBUTE_UNUSED)
+{
+    virNetworkPtr *nets = NULL;
+    int nnets;
+    int j;
+
+    if ((nnets = virConnectListAllNetworks(data->conn, &nets, 0)) < 0)
+        return -1;
+    for (j = 0; j < nnets; j++)
+        virNetworkFree(nets[j]);
+    VIR_FREE(nets);
+    return nnets < data->nobjects ? -1 : 0;
+}
+
+static int
+virBenchNetworkDumpXML(virBenchDataPtr data,
+                       size_t i)
+{
+    char *xml;
+
+    if (!(xml = virNetworkGetXMLDesc(data->nets[i], 0)))
+        return -1;
+    VIR_FREE(xml);
+    return 0;
+}
+
+static int
+virBenchNetworkUndefine(virBenchDataPtr data,
+                        size_t i)
+{
+    if (virNetworkUndefine(data->nets[i]) < 0)
+        return -1;
+    virNetworkFree(data->nets[i]);
+    data->nets[i] = NULL;
+    return 0;
+}
+
+static int
+virBenchVolumeCreate(virBenchDataPtr data,
+                     size_t i)
+{
+    char *xml = NULL;
+
+    if (virAsprintf(&xml,
+                    "<volume>"
+                    "  <name>bench%zu.img</name>"
+                    "  <capacity>%d</capacity>"
+                    "</volume>", i, VIR_BENCH_STREAM_SIZE) < 0)
+        return -1;
+
+    data->vols[i] = virStorageVolCreateXML(data->pool, xml, 0);
+    VIR_FREE(xml);
+    return data->vols[i] ? 0 : -1;
+}
+
+static int
+virBenchVolumeLookup(virBenchDataPtr data,
+                     size_t i)
+{
+    virStorageVolPtr vol;
+    char name[32];
+
+    snprintf(name, sizeof(name), "bench%zu.img", i);
+    if (!(vol = virStorageVolLookupByName(data->pool, name)))
+        return -1;
+    virStorageVolFree(vol);
+    return 0;
+}
+
+static int
+virBenchVolumeListAll(virBenchDataPtr data,
+                      size_t i ATTRIBUTE_UNUSED)
+{
+    virStorageVolPtr *vols = NULL;
+    int nvols;
+    int j;
+
+    if ((nvols = virStoragePoolListAllVolumes(data->pool, &vols, 0)) < 0)
+        return -1;
+    for (j = 0; j < nvols; j++)
+        virStorageVolFree(vols[j]);
+    VIR_FREE(vols);
+    return nvols < data->nobjects ? -1 : 0;
+}
+
+static int
+virBenchVolumeDumpXML(virBenchDataPtr data,
+                      size_t i)
+{
+    char *xml;
+
+    if (!(xml = virStorageVolGetXMLDesc(data->vols[i], 0)))
+        return -1;
+    VIR_FREE(xml);
+    return 0;
+}
+
+static int
+virBenchVolumeDownload(virBenchDataPtr data,
+                       size_t i)
+{
+    virStreamPtr st;
+    size_t total = 0;
+    int got;
+    int ret = -1;
+
+    if (!(st = virStreamNew(data->conn, 0)))
+        return -1;
+
+    if (virStorageVolDownload(data->vols[i], st, 0, 0, 0) < 0)
+        goto cleanup;
+
+    while ((got = virStreamRecv(st, data->buf,
+                                VIR_BENCH_STREAM_CHUNK)) > 0)
+        total += got;
+    if (got < 0) {
+        virStreamAbort(st);
+        goto cleanup;
+    }
+    if (virStreamFinish(st) < 0)
+        goto cleanup;
+
+    if (total != VIR_BENCH_STREAM_SIZE) {
+        fprintf(stderr, "downloaded %zu bytes instead of %d\n",
+                total, VIR_BENCH_STREAM_SIZE);
+        goto cleanup;
+    }
+
+    ret = 0;
+
+cleanup:
+    virStreamFree(st);
+    return ret;
+}
+
+static int
+virBenchVolumeUpload(virBenchDataPtr data,
+                     size_t i)
+{
+    virStreamPtr st;
+    size_t total = 0;
+    int sent;
+    int ret = -1;
+
+    if (!(st = virStreamNew(data->conn, 0)))
+        return -1;
+
+    if (virStorageVolUpload(data->vols[i], st, 0, 0, 0) < 0)
+        goto cleanup;
+
+    while (total < VIR_BENCH_STREAM_SIZE) {
+        if ((sent = virStreamSend(st, data->buf,
+                                    VIR_BENCH_STREAM_CHUNK)) < 0) {
+            virStreamAbort(st);
+            goto cleanup;
+        }
+        total += sent;
+    }
+    if (virStreamFinish(st) < 0)
+        goto cleanup;
+
+    ret = 0;
+
+cleanup:
+    virStreamFree(st);
+    return ret;
+}
+
+static int
+virBenchVolumeDelete(virBenchDataPtr data,
+                     size_t i)
+{
+    if (virStorageVolDelete(data->vols[i], 0) < 0)
+        return -1;
+    virStorageVolFree(data->vols[i]);
+    data->vols[i] = NULL;
+    return 0;
+}
+
+struct testInfo {
+    const char *name;
+    virBenchDataPtr data;
+    virBenchOp op;
+    bool perObject;
+};
+
+static int
+testBench(const void *opaque)
+{
+    const struct testInfo *info = opaque;
+
+    return virBenchRun(info->name, info->data, info->op,
+                       info->perObject ? info->data->nobjects :
+                       info->data->nrounds);
+}
+
+static int
+testDomainEvents(const void *opaque)
+{
+    virBenchDataPtr data = (virBenchDataPtr)opaque;
+    size_t i;
+    int id;
+    int ret = -1;
+
+    if ((id = virConnectDomainEventRegisterAny(data->conn, NULL,
+                                               VIR_DOMAIN_EVENT_ID_LIFECYCLE,
+                                               VIR_DOMAIN_EVENT_CALLBACK(virBenchDomainEvent),
+                                               data, NULL)) < 0)
+        return -1;
+
+    if (virBenchRun("domain start event", data,
+                    virBenchDomainStartEvent, data->nobjects) < 0)
+        goto cleanup;
+
+    for (i = 0; i < data->nobjects; i++) {
+        if (virDomainDestroy(data->doms[i]) < 0 ||
+            virBenchWaitEvents(data, 1) < 0)
+            goto cleanup;
+    }
+
+    ret = 0;
+
+cleanup:
+    virConnectDomainEventDeregisterAny(data->conn, id);
+    return ret;
+}
+
+static size_t
+virBenchGetSize(const char *name,
+                size_t def)
+{
+    const char *str = getenv(name);
+    unsigned long val;
+
+    if (!str || virStrToLong_ul(str, NULL, 10, &val) < 0 || !val)
+        return def;
+    return val;
+}
+
+static void
+virBenchReport(const char *uri,
+               size_t nobjects)
+{
+    size_t i;
+
+    printf("\n%s, %zu objects\n", uri, nobjects);
+    printf("%-22s %8s %12s %10s %10s\n",
+           "operation", "count", "ops/sec", "p50 (us)", "p99 (us)");
+    for (i = 0; i < nresults; i++)
+        printf("%-22s %8zu %12.0f %10.1f %10.1f\n",
+               results[i].name, results[i].count,
+               results[i].count / results[i].total,
+               results[i].p50, results[i].p99);
+}
+
+static int
+mymain(void)
+{
+    virBenchData data;
+    const char *uri = getenv("VIR_BENCH_URI");
+    size_t i;
+    int ret = 0;
+
+    if (!uri) {
+#ifndef WITH_TEST
+        return EXIT_AM_SKIP;
+#endif
+        uri = "test:///default";
+    }
+
+    memset(&data, 0, sizeof(data));
+    data.nobjects = virBenchGetSize("VIR_BENCH_OBJECTS", 100);
+    data.nrounds = virBenchGetSize("VIR_BENCH_ROUNDS", 100);
+
+    /* The 10.x.y.0/24 networks run out beyond this */
+    if (data.nobjects > 65536)
+        data.nobjects = 65536;
+
+    virEventRegisterDefaultImpl();
+
+    if (!(data.conn = virConnectOpen(uri)))
+        return EXIT_FAILURE;
+
+    if (!(data.pool = virStoragePoolLookupByName(data.conn, "default-pool")) ||
+        VIR_ALLOC_N(data.doms, data.nobjects) < 0 ||
+        VIR_ALLOC_N(data.nets, data.nobjects) < 0 ||
+        VIR_ALLOC_N(data.vols, data.nobjects) < 0 ||
+        VIR_ALLOC_N(data.buf, VIR_BENCH_STREAM_CHUNK) < 0) {
+        ret = -1;
+        goto cleanup;
+    }
+
+#define DO_TEST(name, op, perObject)                                    \
+    do {                                                                \
+        const struct testInfo info = { name, &data, op, perObject };    \
+        if (virtTestRun("Bench " name, testBench, &info) < 0)           \
+            ret = -1;                                                   \
+    } while (0)
+
+    DO_TEST("domain define", virBenchDomainDefine, true);
+    DO_TEST("domain lookup", virBenchDomainLookup, true);
+    DO_TEST("domain list-all", virBenchDomainListAll, false);
+    DO_TEST("domain dumpxml", virBenchDomainDumpXML, true);
+    if (virtTestRun("Bench domain events", testDomainEvents, &data) < 0)
+        ret = -1;
+    DO_TEST("domain undefine", virBenchDomainUndefine, true);
+
+    DO_TEST("network define", virBenchNetworkDefine, true);
+    DO_TEST("network lookup", virBenchNetworkLookup, true);
+    DO_TEST("network list-all", virBenchNetworkListAll, false);
+    DO_TEST("network dumpxml", virBenchNetworkDumpXML, true);
+    DO_TEST("network undefine", virBenchNetworkUndefine, true);
+
+    DO_TEST("volume create", virBenchVolumeCreate, true);
+    DO_TEST("volume lookup", virBenchVolumeLookup, true);
+    DO_TEST("volume list-all", virBenchVolumeListAll, false);
+    DO_TEST("volume dumpxml", virBenchVolumeDumpXML, true);
+    DO_TEST("volume download 1MiB", virBenchVolumeDownload, true);
+    DO_TEST("volume upload 1MiB", virBenchVolumeUpload, true);
+    DO_TEST("volume delete", virBenchVolumeDelete, true);
+
+    if (ret == 0 && virTestGetVerbose())
+        virBenchReport(uri, data.nobjects);
+
+cleanup:
+    for (i = 0; i < data.nobjects; i++) {
+        if (data.doms && data.doms[i]) {
+            virDomainUndefine(data.doms[i]);
+            virDomainFree(data.doms[i]);
+        }
+        if (data.nets && data.nets[i]) {
+            virNetworkUndefine(data.nets[i]);
+            virNetworkFree(data.nets[i]);
+        }
+        if (data.vols && data.vols[i]) {
+            virStorageVolDelete(data.vols[i], 0);
+            virStorageVolFree(data.vols[i]);
+        }
+    }
+    VIR_FREE(data.doms);
+    VIR_FREE(data.nets);
+    VIR_FREE(data.vols);
+    VIR_FREE(data.buf);
+    if (data.pool)
+        virStoragePoolFree(data.pool);
+    virConnectClose(data.conn);
+
+    return ret == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+}
+
+VIRT_TEST_MAIN(mymain)
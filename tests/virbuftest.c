@@ -200,6 +200,116 @@ cleanup:
     return ret;
 }
 
+struct testBufEscapeData {
+    const char *name;
+    const char *format;
+    const char *str;
+    const char *expect;
+};
+
+static int testBufEscapeString(const void *opaque)
+{
+    const struct testBufEscapeData *data = opaque;
+    virBuffer bufinit = VIR_BUFFER_INITIALIZER;
+    virBufferPtr buf = &bufinit;
+    char *result = NULL;
+    int ret = -1;
+
+    virBufferAddLit(buf, "<a>\n");
+    virBufferAdjustIndent(buf, 2);
+    virBufferEscapeString(buf, data->format, data->str);
+    virBufferEscapeString(buf, data->format, data->str);
+    virBufferAdjustIndent(buf, -2);
+    virBufferAddLit(buf, "</a>");
+
+    if (virBufferError(buf)) {
+        TEST_ERROR("Buffer had error");
+        goto cleanup;
+    }
+
+    result = virBufferContentAndReset(buf);
+    if (!result || STRNEQ(result, data->expect)) {
+        virtTestDifference(stderr, data->expect, result);
+        goto cleanup;
+    }
+
+    ret = 0;
+
+cleanup:
+    virBufferFreeAndReset(buf);
+    VIR_FREE(result);
+    return ret;
+}
+
+static int testBufEscape(const void *data ATTRIBUTE_UNUSED)
+{
+    virBuffer bufinit = VIR_BUFFER_INITIALIZER;
+    virBufferPtr buf = &bufinit;
+    const char *expected = "  (a \\'b\\\\\\')\n  [c]\n  d\\'%\n";
+    char *result = NULL;
+    int ret = -1;
+
+    virBufferAdjustIndent(buf, 2);
+    virBufferEscapeSexpr(buf, "(a %s)\n", "'b\\'");
+    virBufferEscapeSexpr(buf, "[%s]\n", "c");
+    virBufferEscape(buf, '\\', "'", "%s%%\n", "d'");
+
+    if (virBufferError(buf)) {
+        TEST_ERROR("Buffer had error");
+        goto cleanup;
+    }
+
+    result = virBufferContentAndReset(buf);
+    if (!result || STRNEQ(result, expected)) {
+        virtTestDifference(stderr, expected, result);
+        goto cleanup;
+    }
+
+    ret = 0;
+
+cleanup:
+    virBufferFreeAndReset(buf);
+    VIR_FREE(result);
+    return ret;
+}
+
+static int testBufReserve(const void *data ATTRIBUTE_UNUSED)
+{
+    virBuffer bufinit = VIR_BUFFER_INITIALIZER;
+    virBufferPtr buf = &bufinit;
+    const char *content;
+    size_t i;
+    int ret = -1;
+
+    virBufferReserve(buf, 100000);
+    if (virBufferError(buf) || virBufferUse(buf) != 0) {
+        TEST_ERROR("Reserving space changed the buffer");
+        goto cleanup;
+    }
+
+    virBufferAddLit(buf, "0123456789");
+    content = virBufferCurrentContent(buf);
+    for (i = 1; i < 10000; i++)
+        virBufferAddLit(buf, "0123456789");
+
+    if (virBufferError(buf) || virBufferUse(buf) != 100000) {
+        TEST_ERROR("Buffer had error");
+        goto cleanup;
+    }
+
+    /* This relies on virBuffer internals: no reallocation must happen */
+    if (virBufferCurrentContent(buf) != content) {
+        TEST_ERROR("Buffer was reallocated despite reserved space");
+        goto cleanup;
+    }
+
+    ret = 0;
+
+cleanup:
+    virBufferFreeAndReset(buf);
+    return ret;
+}
+
 
 static int
 mymain(void)
@@ -218,6 +328,28 @@ mymain(void)
     DO_TEST("VSprintf infinite loop", testBufInfiniteLoop, 0);
     DO_TEST("Auto-indentation", testBufAutoIndent, 0);
     DO_TEST("Trim", testBufTrim, 0);
+    DO_TEST("Escape", testBufEscape, 0);
+    DO_TEST("Reserve", testBufReserve, 0);
+
+#define DO_TEST_ESCAPE(name, fmt, str, expect)                         \
+    do {                                                               \
+        struct testBufEscapeData data = { name, fmt, str, expect };    \
+        if (virtTestRun("Buf: EscapeString " name,                     \
+                        testBufEscapeString, &data) < 0)               \
+            ret = -1;                                                  \
+    } while (0)
+
+    DO_TEST_ESCAPE("plain", "<b>%s</b>\n", "plain",
+                   "<a>\n  <b>plain</b>\n  <b>plain</b>\n</a>");
+    DO_TEST_ESCAPE("entities", "<b>%s</b>\n", "<&>'\"",
+                   "<a>\n  <b>&lt;&amp;&gt;&apos;&quot;</b>\n"
+                   "  <b>&lt;&amp;&gt;&apos;&quot;</b>\n</a>");
+    DO_TEST_ESCAPE("control chars", "%s\n", "x\x01<y\n",
+                   "<a>\n  x&lt;y\n\n  x&lt;y\n\n</a>");
+    DO_TEST_ESCAPE("empty", "<c v='%s'/>\n", "",
+                   "<a>\n  <c v=''/>\n  <c v=''/>\n</a>");
+    DO_TEST_ESCAPE("percent", "<d>%s%%</d>\n", "5&6",
+                   "<a>\n  <d>5&amp;6%</d>\n  <d>5&amp;6%</d>\n</a>");
 
     return ret==0 ? EXIT_SUCCESS : EXIT_FAILURE;
 }
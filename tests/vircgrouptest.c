@@ -675,6 +675,52 @@ cleanup:
     return ret;
 }
 
+static int testCgroupGetStats(const void *args ATTRIBUTE_UNUSED)
+{
+    virCgroupPtr cgroup = NULL;
+    virCgroupStats stats;
+    unsigned long long scale = 1000000000ULL / sysconf(_SC_CLK_TCK);
+    size_t i;
+    int rv, ret = -1;
+
+    if ((rv = virCgroupNewPartition("/virtualmachines", true,
+                                    (1 << VIR_CGROUP_CONTROLLER_CPU) |
+                                    (1 << VIR_CGROUP_CONTROLLER_CPUACCT) |
+                                    (1 << VIR_CGROUP_CONTROLLER_MEMORY) |
+                                    (1 << VIR_CGROUP_CONTROLLER_BLKIO),
+                                    &cgroup)) < 0) {
+        fprintf(stderr, "Could not create /virtualmachines cgroup: %d\n", -rv);
+        goto cleanup;
+    }
+
+    /* Second round is served from the cached file descriptors */
+    for (i = 0; i < 2; i++) {
+        if (virCgroupGetStats(cgroup, VIR_CGROUP_STATS_ALL, &stats) < 0) {
+            fprintf(stderr, "Could not retrieve stats for /virtualmachines cgroup\n");
+            goto cleanup;
+        }
+
+        if (stats.fields != VIR_CGROUP_STATS_ALL ||
+            stats.cpuTime != 2787788855799582ULL ||
+            stats.cpuUser != 216687025ULL * scale ||
+            stats.cpuSystem != 43421396ULL * scale ||
+            stats.memoryUsage != 1455321088ULL ||
+            stats.blkioReadBytes != 119084214273LL ||
+            stats.blkioWriteBytes != 822880960513LL ||
+            stats.blkioReadRequests != 9665167 ||
+            stats.blkioWriteRequests != 73283807) {
+            fprintf(stderr, "Wrong values from virCgroupGetStats\n");
+            goto cleanup;
+        }
+    }
+
+    ret = 0;
+
+cleanup:
+    virCgroupFree(&cgroup);
+    return ret;
+}
+
 static int testCgroupGetBlkioIoDeviceServiced(const void *args ATTRIBUTE_UNUSED)
 {
     virCgroupPtr cgroup = NULL;
@@ -801,6 +847,9 @@ mymain(void)
     if (virtTestRun("virCgroupGetPercpuStats works", testCgroupGetPercpuStats, NULL) < 0)
         ret = -1;
 
+    if (virtTestRun("virCgroupGetStats works", testCgroupGetStats, NULL) < 0)
+        ret = -1;
+
     setenv("VIR_CGROUP_MOCK_MODE", "allinone", 1);
     if (virtTestRun("New cgroup for self (allinone)", testCgroupNewForSelfAllInOne, NULL) < 0)
         ret = -1;
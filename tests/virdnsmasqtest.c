@@ -0,0 +1,227 @@
+#include <config.h>
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "internal.h"
+#include "testutils.h"
+#include "virdnsmasq.h"
+#include "viralloc.h"
+#include "virbuffer.h"
+#include "virfile.h"
+#include "virstring.h"
+
+#define VIR_FROM_THIS VIR_FROM_NONE
+
+#define SCRATCHDIRTEMPLATE abs_builddir "/virdnsmasqdata-XXXXXX"
+
+static char scratchdir[] = SCRATCHDIRTEMPLATE;
+
+/* Build a context holding dhcp hosts @first..@last, skipping @skip */
+static dnsmasqContext *
+testDhcpContext(size_t first,
+                size_t last,
+                size_t skip)
+{
+    dnsmasqContext *ctx;
+    virSocketAddr ip;
+    char mac[VIR_MAC_STRING_BUFLEN];
+    char addr[32];
+    char name[32];
+    size_t i;
+
+    if (!(ctx = dnsmasqContextNew("test", scratchdir)))
+        return NULL;
+
+    for (i = first; i <= last; i++) {
+        if (i == skip)
+            continue;
+        snprintf(mac, sizeof(mac), "52:54:00:00:00:%02zx", i);
+        snprintf(addr, sizeof(addr), "192.168.122.%zu", i + 10);
+        snprintf(name, sizeof(name), "host%zu", i);
+        if (virSocketAddrParse(&ip, addr, AF_INET) < 0 ||
+            dnsmasqAddDhcpHost(ctx, mac, &ip, name, NULL, false) < 0) {
+            dnsmasqContextFree(ctx);
+            return NULL;
+        }
+    }
+
+    return ctx;
+}
+
+static void
+testDhcpLine(virBufferPtr buf,
+             size_t i,
+             bool removed)
+{
+    virBufferAsprintf(buf, "%s2:54:00:00:00:%02zx,192.168.122.%zu,host%zu\n",
+                      removed ? "#" : "5", i, i + 10, i);
+}
+
+static int
+testCompareFile(const char *suffix,
+                virBufferPtr expect)
+{
+    char *path = NULL;
+    char *actual = NULL;
+    char *expected = NULL;
+    int ret = -1;
+
+    if (virAsprintf(&path, "%s/test.%s", scratchdir, suffix) < 0 ||
+        virFileReadAll(path, 1024 * 1024, &actual) < 0)
+        goto cleanup;
+
+    if (virBufferError(expect))
+        goto cleanup;
+    expected = virBufferContentAndReset(expect);
+
+    if (STRNEQ(expected, actual)) {
+        virtTestDifference(stderr, expected, actual);
+        goto cleanup;
+    }
+
+    ret = 0;
+
+cleanup:
+    virBufferFreeAndReset(expect);
+    VIR_FREE(path);
+    VIR_FREE(actual);
+    VIR_FREE(expected);
+    return ret;
+}
+
+static int
+testDhcpHostsPatch(const void *data ATTRIBUTE_UNUSED)
+{
+    dnsmasqContext *ctx0 = NULL;
+    dnsmasqContext *ctx1 = NULL;
+    dnsmasqContext *ctx2 = NULL;
+    virBuffer buf = VIR_BUFFER_INITIALIZER;
+    size_t i;
+    int ret = -1;
+
+    if (!(ctx0 = testDhcpContext(0, 9, -1)) ||
+        !(ctx1 = testDhcpContext(0, 10, 3)) ||
+        !(ctx2 = testDhcpContext(0, 0, -1)))
+        goto cleanup;
+
+    if (dnsmasqSave(ctx0) < 0)
+        goto cleanup;
+
+    /* host3 is commented out in place, host10 is appended */
+    if (dnsmasqSaveChanges(ctx1, ctx0) != 1)
+        goto cleanup;
+    for (i = 0; i <= 10; i++)
+        testDhcpLine(&buf, i, i == 3);
+    if (testCompareFile("hostsfile", &buf) < 0)
+        goto cleanup;
+
+    /* nothing to do */
+    if (dnsmasqSaveChanges(ctx1, ctx1) != 0)
+        goto cleanup;
+    for (i = 0; i <= 10; i++)
+        testDhcpLine(&buf, i, i == 3);
+    if (testCompareFile("hostsfile", &buf) < 0)
+        goto cleanup;
+
+    /* removing most entries rewrites the file */
+    if (dnsmasqSaveChanges(ctx2, ctx1) != 1)
+        goto cleanup;
+    testDhcpLine(&buf, 0, false);
+    if (testCompareFile("hostsfile", &buf) < 0)
+        goto cleanup;
+
+    /* a file that does not match the old context is rewritten too */
+    if (dnsmasqSaveChanges(ctx1, ctx0) != 1)
+        goto cleanup;
+    for (i = 0; i <= 10; i++) {
+        if (i != 3)
+            testDhcpLine(&buf, i, false);
+    }
+    if (testCompareFile("hostsfile", &buf) < 0)
+        goto cleanup;
+
+    ret = 0;
+
+cleanup:
+    virBufferFreeAndReset(&buf);
+    dnsmasqContextFree(ctx0);
+    dnsmasqContextFree(ctx1);
+    dnsmasqContextFree(ctx2);
+    return ret;
+}
+
+static int
+testAddnHostsPatch(const void *data ATTRIBUTE_UNUSED)
+{
+    dnsmasqContext *ctx0 = NULL;
+    dnsmasqContext *ctx1 = NULL;
+    virBuffer buf = VIR_BUFFER_INITIALIZER;
+    virSocketAddr ip;
+    char addr[32];
+    char name[32];
+    size_t i;
+    int ret = -1;
+
+    if (!(ctx0 = dnsmasqContextNew("test", scratchdir)) ||
+        !(ctx1 = dnsmasqContextNew("test", scratchdir)))
+        goto cleanup;
+
+    for (i = 1; i <= 6; i++) {
+        snprintf(addr, sizeof(addr), "10.0.0.%zu", i);
+        snprintf(name, sizeof(name), "name%zu", i);
+        if (virSocketAddrParse(&ip, addr, AF_INET) < 0)
+            goto cleanup;
+        if (i <= 5 && dnsmasqAddHost(ctx0, &ip, name) < 0)
+            goto cleanup;
+        if (dnsmasqAddHost(ctx1, &ip, name) < 0)
+            goto cleanup;
+        if (i == 1 && dnsmasqAddHost(ctx1, &ip, "alias1") < 0)
+            goto cleanup;
+    }
+
+    if (dnsmasqSave(ctx0) < 0 ||
+        dnsmasqSaveChanges(ctx1, ctx0) != 1)
+        goto cleanup;
+
+    /* the line for 10.0.0.1 gained a name, so it is replaced */
+    virBufferAddLit(&buf, "#0.0.0.1\tname1\t\n");
+    for (i = 2; i <= 5; i++)
+        virBufferAsprintf(&buf, "10.0.0.%zu\tname%zu\t\n", i, i);
+    virBufferAddLit(&buf, "10.0.0.1\tname1\talias1\t\n");
+    virBufferAddLit(&buf, "10.0.0.6\tname6\t\n");
+    if (testCompareFile("addnhosts", &buf) < 0)
+        goto cleanup;
+
+    ret = 0;
+
+cleanup:
+    virBufferFreeAndReset(&buf);
+    dnsmasqContextFree(ctx0);
+    dnsmasqContextFree(ctx1);
+    return ret;
+}
+
+static int
+mymain(void)
+{
+    int ret = 0;
+
+    if (!mkdtemp(scratchdir)) {
+        fprintf(stderr, "Cannot create scratch directory\n");
+        return EXIT_FAILURE;
+    }
+
+    if (virtTestRun("DHCP hostsfile patching", testDhcpHostsPatch, NULL) < 0)
+        ret = -1;
+    if (virtTestRun("Addn hosts patching", testAddnHostsPatch, NULL) < 0)
+        ret = -1;
+
+    if (getenv("LIBVIRT_SKIP_CLEANUP") == NULL)
+        virFileDeleteTree(scratchdir);
+
+    return ret == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+}
+
+VIRT_TEST_MAIN(mymain)
@@ -12,6 +12,7 @@
 #include "viralloc.h"
 #include "virlog.h"
 #include "virstring.h"
+#include "virtime.h"
 
 #define VIR_FROM_THIS VIR_FROM_NONE
 
@@ -659,10 +660,141 @@ cleanup:
     return ret;
 }
 
+#define TEST_BENCH_KEYLEN 24
+
+struct testHashBenchData {
+    virHashTablePtr hash;
+    size_t visited;
+    bool failed;
+};
+
+static void
+testHashBenchRemoveOdd(void *payload,
+                       const void *name,
+                       void *data)
+{
+    struct testHashBenchData *bench = data;
+    size_t n = (size_t) payload;
+
+    bench->visited++;
+    if (n % 2 && virHashRemoveEntry(bench->hash, name) < 0)
+        bench->failed = true;
+}
+
+static void
+testHashBenchReport(const char *what,
+                    size_t count,
+                    unsigned long long start,
+                    unsigned long long end)
+{
+    if (virTestGetVerbose())
+        fprintf(stderr, "\n%s: %.3f us per entry", what,
+                (double) (end - start) * 1000 / count);
+}
+
+/* Insert, look up and remove @count entries, checking along the way
+ * that iteration with removal visits every entry exactly once */
+static int
+testHashBench(const void *data)
+{
+    const struct testInfo *info = data;
+    struct testHashBenchData bench = { NULL, 0, false };
+    char *keys = NULL;
+    unsigned long long start, end;
+    size_t i;
+    int ret = -1;
+
+    if (VIR_ALLOC_N(keys, info->count * TEST_BENCH_KEYLEN) < 0 ||
+        !(bench.hash = virHashCreate(0, NULL)))
+        goto cleanup;
+
+    for (i = 0; i < info->count; i++)
+        snprintf(keys + i * TEST_BENCH_KEYLEN, TEST_BENCH_KEYLEN,
+                 "key%zu", i);
+
+    if (virTimeMillisNow(&start) < 0)
+        goto cleanup;
+    for (i = 0; i < info->count; i++) {
+        if (virHashAddEntry(bench.hash, keys + i * TEST_BENCH_KEYLEN,
+                            (void *) i) < 0) {
+            testError("\nfailed to add entry %zu\n", i);
+            goto cleanup;
+        }
+    }
+    if (virTimeMillisNow(&end) < 0)
+        goto cleanup;
+    testHashBenchReport("insert", info->count, start, end);
+
+    if (testHashCheckCount(bench.hash, info->count) < 0)
+        goto cleanup;
+
+    if (virTimeMillisNow(&start) < 0)
+        goto cleanup;
+    for (i = 0; i < info->count; i++) {
+        if (virHashLookup(bench.hash, keys + i * TEST_BENCH_KEYLEN) !=
+            (void *) i) {
+            testError("\nentry %zu not found\n", i);
+            goto cleanup;
+        }
+    }
+    if (virTimeMillisNow(&end) < 0)
+        goto cleanup;
+    testHashBenchReport("lookup", info->count, start, end);
+
+    if (virTimeMillisNow(&start) < 0)
+        goto cleanup;
+    if (virHashForEach(bench.hash, testHashBenchRemoveOdd, &bench) < 0 ||
+        bench.failed || bench.visited != info->count) {
+        testError("\niteration visited %zu of %zu entries\n",
+                  bench.visited, info->count);
+        goto cleanup;
+    }
+    if (virTimeMillisNow(&end) < 0)
+        goto cleanup;
+    testHashBenchReport("iterate and remove half", info->count, start, end);
+
+    if (testHashCheckCount(bench.hash, info->count - info->count / 2) < 0)
+        goto cleanup;
+
+    if (virTimeMillisNow(&start) < 0)
+        goto cleanup;
+    for (i = 0; i < info->count; i++) {
+        const char *key = keys + i * TEST_BENCH_KEYLEN;
+
+        if (i % 2) {
+            if (virHashLookup(bench.hash, key)) {
+                testError("\nremoved entry %zu still present\n", i);
+                goto cleanup;
+            }
+        } else if (virHashRemoveEntry(bench.hash, key) < 0) {
+            testError("\nfailed to remove entry %zu\n", i);
+            goto cleanup;
+        }
+    }
+    if (virTimeMillisNow(&end) < 0)
+        goto cleanup;
+    testHashBenchReport("lookup or remove", info->count, start, end);
+
+    if (testHashCheckCount(bench.hash, 0) < 0)
+        goto cleanup;
+
+    if (virTestGetVerbose())
+        fprintf(stderr, "\n%74s", "... ");
+
+    ret = 0;
+
+cleanup:
+    virHashFree(bench.hash);
+    VIR_FREE(keys);
+    return ret;
+}
+
 
 static int
 mymain(void)
 {
+    const char *benchstr = getenv("VIR_HASH_BENCH_ENTRIES");
+    unsigned long benchcount;
     int ret = 0;
 
 #define DO_TEST_FULL(name, cmd, data, count)                        \
@@ -698,6 +830,13 @@ mymain(void)
     DO_TEST("Search", Search);
     DO_TEST("GetItems", GetItems);
     DO_TEST("Equal", Equal);
+    DO_TEST_COUNT("Bench", Bench, 1000);
+
+    /* Larger runs, e.g. with a million entries, are only done on request */
+    if (benchstr &&
+        virStrToLong_ul(benchstr, NULL, 10, &benchcount) == 0 &&
+        benchcount > 0)
+        DO_TEST_FULL("Bench(VIR_HASH_BENCH_ENTRIES)", Bench, NULL, benchcount);
 
     return (ret == 0) ? EXIT_SUCCESS : EXIT_FAILURE;
 }
@@ -0,0 +1,285 @@
+/*
+ * Copyright (C) 2014 Red Hat, Inc.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library.  If not, see
+ * <http://www.gnu.org/licenses/>.
+ */
+
+#include <config.h>
+
+#include "testutils.h"
+#include "viralloc.h"
+#include "virerror.h"
+
+#define __VIR_NET_SERVER_ALLOW_INCLUDE_PRIV_H__
+#include "rpc/virnetserverpriv.h"
+
+#define VIR_FROM_THIS VIR_FROM_RPC
+
+static virNetServerPtr
+testServerNew(void)
+{
+    virNetServerPtr srv;
+
+    if (!(srv = virNetServerNew(0, 0, 0, 10, -1, 0, false, NULL,
+                                NULL, NULL, NULL, NULL)))
+        virDispatchError(NULL);
+    return srv;
+}
+
+
+static int
+testCheckWeight(virNetServerPtr srv,
+                bool readonly,
+                bool local,
+                unsigned int expect)
+{
+    unsigned int weight;
+
+    virObjectLock(srv);
+    weight = virNetServerGetClientWeight(srv, readonly, local);
+    virObjectUnlock(srv);
+
+    if (weight != expect) {
+        if (virTestGetVerbose())
+            fprintf(stderr, "readonly=%d local=%d: expected weight %u, got %u\n",
+                    readonly, local, expect, weight);
+        return -1;
+    }
+    return 0;
+}
+
+
+static int
+testClientWeights(const void *data ATTRIBUTE_UNUSED)
+{
+    virNetServerPtr srv;
+    int ret = -1;
+
+    if (!(srv = testServerNew()))
+        return -1;
+
+    if (testCheckWeight(srv, true, true, 1) < 0 ||
+        testCheckWeight(srv, false, false, 1) < 0)
+        goto cleanup;
+
+    virNetServerSetClientWeights(srv, 2, 1, 3, 1);
+    if (testCheckWeight(srv, true, true, 6) < 0 ||
+        testCheckWeight(srv, true, false, 2) < 0 ||
+        testCheckWeight(srv, false, true, 3) < 0 ||
+        testCheckWeight(srv, false, false, 1) < 0)
+        goto cleanup;
+
+    /* Out of range weights are clamped, so that a wrapped negative
+     * value from a config file cannot make the product overflow */
+    virNetServerSetClientWeights(srv, 0, UINT_MAX,
+                                 VIR_NET_SERVER_CLIENT_WEIGHT_MAX + 1,
+                                 (unsigned int)-5);
+    if (testCheckWeight(srv, true, true,
+                        VIR_NET_SERVER_CLIENT_WEIGHT_MAX) < 0 ||
+        testCheckWeight(srv, false, true,
+                        VIR_NET_SERVER_CLIENT_WEIGHT_MAX *
+                        VIR_NET_SERVER_CLIENT_WEIGHT_MAX) < 0 ||
+        testCheckWeight(srv, true, false,
+                        VIR_NET_SERVER_CLIENT_WEIGHT_MAX) < 0)
+        goto cleanup;
+
+    ret = 0;
+ cleanup:
+    virObjectUnref(srv);
+    return ret;
+}
+
+
+static virNetServerClientQueuePtr
+testQueueNew(virNetServerPtr srv,
+             unsigned int weight)
+{
+    virNetServerClientQueuePtr queue;
+
+    if (VIR_ALLOC(queue) < 0)
+        return NULL;
+    queue->srv = srv;
+    queue->weight = weight;
+    return queue;
+}
+
+
+/* Two clients, weights 1 and 3, each queueing four calls in turn.
+ * The fair lane must hand them out one call of the first client for
+ * three of the second, and the priority lane in arrival order */
+static int
+testFairLane(const void *data ATTRIBUTE_UNUSED)
+{
+    virNetServerPtr srv;
+    virNetServerClientQueuePtr queues[2] = { NULL, NULL };
+    virNetServerJob jobs[8];
+    virNetServerJob prio[2];
+    virNetServerJobPtr job;
+    const char *expect = "ABBBABAA";
+    size_t i;
+    int ret = -1;
+
+    memset(jobs, 0, sizeof(jobs));
+    memset(prio, 0, sizeof(prio));
+
+    if (!(srv = testServerNew()))
+        return -1;
+
+    if (!(queues[0] = testQueueNew(srv, 1)) ||
+        !(queues[1] = testQueueNew(srv, 3)))
+        goto cleanup;
+
+    for (i = 0; i < ARRAY_CARDINALITY(jobs); i++) {
+        jobs[i].queue = queues[i % 2];
+        if (virNetServerQueueJob(srv, &jobs[i], false) < 0)
+            goto cleanup;
+    }
+    for (i = 0; i < ARRAY_CARDINALITY(prio); i++) {
+        prio[i].queue = queues[1];
+        if (virNetServerQueueJob(srv, &prio[i], true) < 0)
+            goto cleanup;
+    }
+
+    if (queues[1]->stats.depth != 6 || queues[1]->stats.maxDepth != 6) {
+        if (virTestGetVerbose())
+            fprintf(stderr, "expected 6 calls waiting, got %zu (max %zu)\n",
+                    queues[1]->stats.depth, queues[1]->stats.maxDepth);
+        goto cleanup;
+    }
+
+    for (i = 0; i < ARRAY_CARDINALITY(prio); i++) {
+        if (virNetServerTakeJob(srv, true) != &prio[i]) {
+            if (virTestGetVerbose())
+                fprintf(stderr, "priority call %zu taken out of order\n", i);
+            goto cleanup;
+        }
+    }
+    if (virNetServerTakeJob(srv, true)) {
+        if (virTestGetVerbose())
+            fprintf(stderr, "priority lane should be empty\n");
+        goto cleanup;
+    }
+
+    for (i = 0; expect[i]; i++) {
+        size_t want = expect[i] - 'A';
+
+        if (!(job = virNetServerTakeJob(srv, false))) {
+            if (virTestGetVerbose())
+                fprintf(stderr, "fair lane empty after %zu calls\n", i);
+            goto cleanup;
+        }
+        if ((job - jobs) % 2 != want) {
+            if (virTestGetVerbose())
+                fprintf(stderr, "call %zu came from client %c, expected %c\n",
+                        i, (char)('A' + (job - jobs) % 2), expect[i]);
+            goto cleanup;
+        }
+    }
+    if (virNetServerTakeJob(srv, false)) {
+        if (virTestGetVerbose())
+            fprintf(stderr, "fair lane should be empty\n");
+        goto cleanup;
+    }
+
+    if (queues[0]->stats.depth != 0 || queues[0]->stats.calls != 4 ||
+        queues[1]->stats.depth != 0 || queues[1]->stats.calls != 6) {
+        if (virTestGetVerbose())
+            fprintf(stderr, "unexpected queue statistics\n");
+        goto cleanup;
+    }
+
+    ret = 0;
+ cleanup:
+    VIR_FREE(queues[0]);
+    VIR_FREE(queues[1]);
+    virObjectUnref(srv);
+    return ret;
+}
+
+
+/* A client rejoining the lane goes to the back of the round, and a
+ * removed client's queue is released with its last call */
+static int
+testFairLaneRejoin(const void *data ATTRIBUTE_UNUSED)
+{
+    virNetServerPtr srv;
+    virNetServerClientQueuePtr a = NULL;
+    virNetServerClientQueuePtr b = NULL;
+    virNetServerJob jobs[4];
+    int ret = -1;
+
+    memset(jobs, 0, sizeof(jobs));
+
+    if (!(srv = testServerNew()))
+        return -1;
+
+    if (!(a = testQueueNew(srv, 1)) ||
+        !(b = testQueueNew(srv, 1)))
+        goto cleanup;
+
+    jobs[0].queue = a;
+    jobs[1].queue = b;
+    jobs[2].queue = b;
+    if (virNetServerQueueJob(srv, &jobs[0], false) < 0 ||
+        virNetServerQueueJob(srv, &jobs[1], false) < 0 ||
+        virNetServerQueueJob(srv, &jobs[2], false) < 0)
+        goto cleanup;
+
+    if (virNetServerTakeJob(srv, false) != &jobs[0])
+        goto cleanup;
+
+    /* a left the lane when drained and now queues behind b */
+    jobs[3].queue = a;
+    if (virNetServerQueueJob(srv, &jobs[3], false) < 0)
+        goto cleanup;
+
+    b->removed = true;
+    if (virNetServerTakeJob(srv, false) != &jobs[1])
+        goto cleanup;
+    if (virNetServerTakeJob(srv, false) != &jobs[3])
+        goto cleanup;
+    /* frees b */
+    if (virNetServerTakeJob(srv, false) != &jobs[2])
+        goto cleanup;
+    b = NULL;
+
+    if (virNetServerTakeJob(srv, false))
+        goto cleanup;
+
+    ret = 0;
+ cleanup:
+    VIR_FREE(a);
+    VIR_FREE(b);
+    virObjectUnref(srv);
+    return ret;
+}
+
+
+static int
+mymain(void)
+{
+    int ret = 0;
+
+    if (virtTestRun("Client weights", testClientWeights, NULL) < 0)
+        ret = -1;
+    if (virtTestRun("Fair lane", testFairLane, NULL) < 0)
+        ret = -1;
+    if (virtTestRun("Fair lane rejoin", testFairLaneRejoin, NULL) < 0)
+        ret = -1;
+
+    return ret == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+}
+
+VIRT_TEST_MAIN(mymain)
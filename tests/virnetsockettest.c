@@ -331,6 +331,105 @@ cleanup:
     return ret;
 }
 
+/* Several messages and a file descriptor sent back to back must
+ * come out of the read ahead buffer in the order they were sent */
+static int testSocketUNIXReadAhead(const void *data ATTRIBUTE_UNUSED)
+{
+    virNetSocketPtr lsock = NULL; /* Listen socket */
+    virNetSocketPtr ssock = NULL; /* Server socket */
+    virNetSocketPtr csock = NULL; /* Client socket */
+    int pipefd[2] = { -1, -1 };
+    int recvfd = -1;
+    char buf[6];
+    char c;
+    int ret = -1;
+
+    char *path = NULL;
+    char *tmpdir;
+    char template[] = "/tmp/libvirt_XXXXXX";
+
+    tmpdir = mkdtemp(template);
+    if (tmpdir == NULL) {
+        VIR_WARN("Failed to create temporary directory");
+        goto cleanup;
+    }
+    if (virAsprintf(&path, "%s/test.sock", tmpdir) < 0)
+        goto cleanup;
+
+    if (pipe(pipefd) < 0)
+        goto cleanup;
+
+    if (virNetSocketNewListenUNIX(path, 0700, -1, getegid(), &lsock) < 0)
+        goto cleanup;
+
+    if (virNetSocketListen(lsock, 0) < 0)
+        goto cleanup;
+
+    if (virNetSocketNewConnectUNIX(path, false, NULL, &csock) < 0)
+        goto cleanup;
+
+    if (virNetSocketAccept(lsock, &ssock) < 0 || !ssock) {
+        VIR_DEBUG("Unexpected client socket missing");
+        goto cleanup;
+    }
+
+    virNetSocketSetReadAhead(ssock, true);
+
+    if (virNetSocketWrite(csock, "helloworld", 10) != 10 ||
+        virNetSocketSendFD(csock, pipefd[0]) != 1 ||
+        virNetSocketWrite(csock, "again", 5) != 5)
+        goto cleanup;
+
+    memset(buf, 0, sizeof(buf));
+    if (virNetSocketRead(ssock, buf, 5) != 5 || STRNEQ(buf, "hello")) {
+        VIR_DEBUG("Unexpected first message '%s'", buf);
+        goto cleanup;
+    }
+
+    if (!virNetSocketHasCachedData(ssock)) {
+        VIR_DEBUG("Expected second message to be read ahead");
+        goto cleanup;
+    }
+
+    if (virNetSocketRead(ssock, buf, 5) != 5 || STRNEQ(buf, "world")) {
+        VIR_DEBUG("Unexpected second message '%s'", buf);
+        goto cleanup;
+    }
+
+    if (virNetSocketRecvFD(ssock, &recvfd) != 1)
+        goto cleanup;
+
+    if (safewrite(pipefd[1], "x", 1) != 1 ||
+        saferead(recvfd, &c, 1) != 1 || c != 'x') {
+        VIR_DEBUG("Received file descriptor is not the pipe");
+        goto cleanup;
+    }
+
+    if (virNetSocketRead(ssock, buf, 5) != 5 || STRNEQ(buf, "again")) {
+        VIR_DEBUG("Unexpected third message '%s'", buf);
+        goto cleanup;
+    }
+
+    if (virNetSocketHasCachedData(ssock)) {
+        VIR_DEBUG("Unexpected data left in read ahead buffer");
+        goto cleanup;
+    }
+
+    ret = 0;
+
+cleanup:
+    VIR_FREE(path);
+    VIR_FORCE_CLOSE(pipefd[0]);
+    VIR_FORCE_CLOSE(pipefd[1]);
+    VIR_FORCE_CLOSE(recvfd);
+    virObjectUnref(lsock);
+    virObjectUnref(ssock);
+    virObjectUnref(csock);
+    if (tmpdir)
+        rmdir(tmpdir);
+    return ret;
+}
+
 static int testSocketCommandNormal(const void *data ATTRIBUTE_UNUSED)
 {
     virNetSocketPtr csock = NULL; /* Client socket */
@@ -499,6 +598,9 @@ mymain(void)
     if (virtTestRun("Socket UNIX Addrs", testSocketUNIXAddrs, NULL) < 0)
         ret = -1;
 
+    if (virtTestRun("Socket UNIX Read Ahead", testSocketUNIXReadAhead, NULL) < 0)
+        ret = -1;
+
 #if 0
     if (virtTestRun("Socket External Command /dev/zero", testSocketCommandNormal, NULL) < 0)
         ret = -1;
@@ -0,0 +1,517 @@
+#include <config.h>
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "internal.h"
+#include "testutils.h"
+#include "network_conf.h"
+#include "nwfilter_conf.h"
+#include "interface_conf.h"
+#include "node_device_conf.h"
+#include "viralloc.h"
+#include "virstring.h"
+#include "virtime.h"
+#include "viruuid.h"
+
+#define VIR_FROM_THIS VIR_FROM_NONE
+
+static void
+testMakeUUID(unsigned char *uuid,
+             unsigned char type,
+             size_t n)
+{
+    memset(uuid, 0, VIR_UUID_BUFLEN);
+    uuid[0] = type;
+    uuid[12] = (n >> 24) & 0xff;
+    uuid[13] = (n >> 16) & 0xff;
+    uuid[14] = (n >> 8) & 0xff;
+    uuid[15] = n & 0xff;
+}
+
+static virNetworkObjPtr
+testNetworkNew(virNetworkObjListPtr nets,
+               size_t n)
+{
+    virNetworkDefPtr def = NULL;
+    virNetworkObjPtr net = NULL;
+    unsigned char uuid[VIR_UUID_BUFLEN];
+    char uuidstr[VIR_UUID_STRING_BUFLEN];
+    char *xml = NULL;
+
+    testMakeUUID(uuid, 'n', n);
+    virUUIDFormat(uuid, uuidstr);
+    if (virAsprintf(&xml,
+                    "<network>\n"
+                    "  <name>net%zu</name>\n"
+                    "  <uuid>%s</uuid>\n"
+                    "</network>\n", n, uuidstr) < 0)
+        goto cleanup;
+
+    if (!(def = virNetworkDefParseString(xml)))
+        goto cleanup;
+
+    if (!(net = virNetworkAssignDef(nets, def, false)))
+        goto cleanup;
+    def = NULL;
+    virNetworkObjUnlock(net);
+
+cleanup:
+    virNetworkDefFree(def);
+    VIR_FREE(xml);
+    return net;
+}
+
+static virNWFilterObjPtr
+testNWFilterNew(virNWFilterObjListPtr nwfilters,
+                size_t n,
+                size_t uuidn)
+{
+    virNWFilterDefPtr def = NULL;
+    virNWFilterObjPtr nwfilter = NULL;
+    unsigned char uuid[VIR_UUID_BUFLEN];
+    char uuidstr[VIR_UUID_STRING_BUFLEN];
+    char *xml = NULL;
+
+    testMakeUUID(uuid, 'f', uuidn);
+    virUUIDFormat(uuid, uuidstr);
+    if (virAsprintf(&xml,
+                    "<filter name='filter%zu' chain='root'>\n"
+                    "  <uuid>%s</uuid>\n"
+                    "</filter>\n", n, uuidstr) < 0)
+        goto cleanup;
+
+    if (!(def = virNWFilterDefParseString(xml)))
+        goto cleanup;
+
+    if (!(nwfilter = virNWFilterObjAssignDef(nwfilters, def)))
+        goto cleanup;
+    def = NULL;
+    virNWFilterObjUnlock(nwfilter);
+
+cleanup:
+    virNWFilterDefFree(def);
+    VIR_FREE(xml);
+    return nwfilter;
+}
+
+static virInterfaceObjPtr
+testInterfaceNew(virInterfaceObjListPtr ifaces,
+                 size_t n)
+{
+    virInterfaceDefPtr def = NULL;
+    virInterfaceObjPtr iface = NULL;
+    char *xml = NULL;
+
+    if (virAsprintf(&xml,
+                    "<interface type='ethernet' name='eth%zu'>\n"
+                    "  <start mode='onboot'/>\n"
+                    "</interface>\n", n) < 0)
+        goto cleanup;
+
+    if (!(def = virInterfaceDefParseString(xml)))
+        goto cleanup;
+
+    if (!(iface = virInterfaceAssignDef(ifaces, def)))
+        goto cleanup;
+    def = NULL;
+    virInterfaceObjUnlock(iface);
+
+cleanup:
+    virInterfaceDefFree(def);
+    VIR_FREE(xml);
+    return iface;
+}
+
+static virNodeDeviceObjPtr
+testNodeDeviceNew(virNodeDeviceObjListPtr devs,
+                  const char *name,
+                  const char *path)
+{
+    virNodeDeviceDefPtr def = NULL;
+    virNodeDeviceObjPtr dev;
+
+    if (VIR_ALLOC(def) < 0 ||
+        VIR_STRDUP(def->name, name) < 0 ||
+        VIR_STRDUP(def->sysfs_path, path) < 0 ||
+        !(dev = virNodeDeviceAssignDef(devs, def))) {
+        virNodeDeviceDefFree(def);
+        return NULL;
+    }
+    virNodeDeviceObjUnlock(dev);
+
+    return dev;
+}
+
+static int
+testNetworkCheck(virNetworkObjListPtr nets,
+                 size_t n,
+                 virNetworkObjPtr expect)
+{
+    virNetworkObjPtr net;
+    unsigned char uuid[VIR_UUID_BUFLEN];
+    char *name = NULL;
+    int ret = -1;
+
+    testMakeUUID(uuid, 'n', n);
+    if (virAsprintf(&name, "net%zu", n) < 0)
+        return -1;
+
+    if ((net = virNetworkFindByName(nets, name)))
+        virNetworkObjUnlock(net);
+    if (net != expect)
+        goto cleanup;
+
+    if ((net = virNetworkFindByUUID(nets, uuid)))
+        virNetworkObjUnlock(net);
+    if (net != expect)
+        goto cleanup;
+
+    ret = 0;
+
+cleanup:
+    if (ret < 0 && virTestGetVerbose())
+        fprintf(stderr, "network '%s' unexpectedly %s\n",
+                name, expect ? "missing" : "found");
+    VIR_FREE(name);
+    return ret;
+}
+
+#define TEST_OBJS 200
+
+static int
+testNetworkIndex(const void *data ATTRIBUTE_UNUSED)
+{
+    virNetworkObjList nets = { 0 };
+    virNetworkObjPtr list[TEST_OBJS];
+    size_t i;
+    int ret = -1;
+
+    for (i = 0; i < TEST_OBJS; i++) {
+        if (!(list[i] = testNetworkNew(&nets, i)))
+            goto cleanup;
+    }
+
+    /* Redefining a network keeps the object */
+    if (testNetworkNew(&nets, 0) != list[0] ||
+        nets.count != TEST_OBJS)
+        goto cleanup;
+
+    for (i = 1; i < TEST_OBJS; i += 2) {
+        virNetworkObjLock(list[i]);
+        virNetworkRemoveInactive(&nets, list[i]);
+        list[i] = NULL;
+    }
+
+    for (i = 0; i < TEST_OBJS; i++) {
+        if (testNetworkCheck(&nets, i, list[i]) < 0)
+            goto cleanup;
+    }
+
+    /* Iteration order follows insertion */
+    for (i = 0; i < nets.count; i++) {
+        if (nets.objs[i] != list[i * 2])
+            goto cleanup;
+    }
+
+    virNetworkObjListFree(&nets);
+    if (testNetworkCheck(&nets, 0, NULL) < 0 ||
+        !testNetworkNew(&nets, 0) ||
+        testNetworkCheck(&nets, 0, nets.objs[0]) < 0)
+        goto cleanup;
+
+    ret = 0;
+
+cleanup:
+    virNetworkObjListFree(&nets);
+    return ret;
+}
+
+static int
+testNWFilterIndex(const void *data ATTRIBUTE_UNUSED)
+{
+    virNWFilterObjList nwfilters = { 0 };
+    virNWFilterObjPtr list[TEST_OBJS];
+    virNWFilterObjPtr nwfilter;
+    unsigned char uuid[VIR_UUID_BUFLEN];
+    size_t i;
+    int ret = -1;
+
+    for (i = 0; i < TEST_OBJS; i++) {
+        if (!(list[i] = testNWFilterNew(&nwfilters, i, i)))
+            goto cleanup;
+    }
+
+    /* An identical definition under a new UUID replaces the old one */
+    if (testNWFilterNew(&nwfilters, 0, TEST_OBJS) != list[0])
+        goto cleanup;
+
+    testMakeUUID(uuid, 'f', 0);
+    if (virNWFilterObjFindByUUID(&nwfilters, uuid))
+        goto cleanup;
+
+    testMakeUUID(uuid, 'f', TEST_OBJS);
+    if (!(nwfilter = virNWFilterObjFindByUUID(&nwfilters, uuid)))
+        goto cleanup;
+    virNWFilterObjUnlock(nwfilter);
+    if (nwfilter != list[0])
+        goto cleanup;
+
+    /* A different name under a known UUID is rejected */
+    if (testNWFilterNew(&nwfilters, TEST_OBJS, 1))
+        goto cleanup;
+    virResetLastError();
+
+    for (i = 0; i < TEST_OBJS; i++) {
+        char name[32];
+
+        snprintf(name, sizeof(name), "filter%zu", i);
+        if (!(nwfilter = virNWFilterObjFindByName(&nwfilters, name)))
+            goto cleanup;
+        if (nwfilter != list[i]) {
+            virNWFilterObjUnlock(nwfilter);
+            goto cleanup;
+        }
+        if (i % 2) {
+            virNWFilterObjRemove(&nwfilters, nwfilter);
+            if (virNWFilterObjFindByName(&nwfilters, name))
+                goto cleanup;
+        } else {
+            virNWFilterObjUnlock(nwfilter);
+        }
+    }
+
+    if (nwfilters.count != TEST_OBJS / 2)
+        goto cleanup;
+
+    ret = 0;
+
+cleanup:
+    virNWFilterObjListFree(&nwfilters);
+    return ret;
+}
+
+static int
+testInterfaceIndex(const void *data ATTRIBUTE_UNUSED)
+{
+    virInterfaceObjList ifaces = { 0 };
+    virInterfaceObjPtr list[TEST_OBJS];
+    virInterfaceObjPtr iface;
+    size_t i;
+    int ret = -1;
+
+    for (i = 0; i < TEST_OBJS; i++) {
+        if (!(list[i] = testInterfaceNew(&ifaces, i)))
+            goto cleanup;
+    }
+
+    for (i = 0; i < TEST_OBJS; i++) {
+        char name[32];
+
+        snprintf(name, sizeof(name), "eth%zu", i);
+        if (!(iface = virInterfaceFindByName(&ifaces, name)))
+            goto cleanup;
+        virInterfaceObjUnlock(iface);
+        if (iface != list[i])
+            goto cleanup;
+        if (i % 2) {
+            virInterfaceRemove(&ifaces, iface);
+            if (virInterfaceFindByName(&ifaces, name))
+                goto cleanup;
+        }
+    }
+
+    if (ifaces.count != TEST_OBJS / 2 ||
+        virInterfaceFindByName(&ifaces, "eth1"))
+        goto cleanup;
+
+    ret = 0;
+
+cleanup:
+    virInterfaceObjListFree(&ifaces);
+    return ret;
+}
+
+/* Check that @name and @path, whichever is given, resolve to @expect */
+static int
+testNodeDeviceCheck(virNodeDeviceObjListPtr devs,
+                    const char *name,
+                    const char *path,
+                    virNodeDeviceObjPtr expect)
+{
+    virNodeDeviceObjPtr dev;
+
+    if (name) {
+        if ((dev = virNodeDeviceFindByName(devs, name)))
+            virNodeDeviceObjUnlock(dev);
+        if (dev != expect) {
+            if (virTestGetVerbose())
+                fprintf(stderr, "device '%s' unexpectedly %s\n",
+                        name, expect ? "missing" : "found");
+            return -1;
+        }
+    }
+
+    if (path) {
+        if ((dev = virNodeDeviceFindBySysfsPath(devs, path)))
+            virNodeDeviceObjUnlock(dev);
+        if (dev != expect) {
+            if (virTestGetVerbose())
+                fprintf(stderr, "device with path '%s' unexpectedly %s\n",
+                        path, expect ? "missing" : "found");
+            return -1;
+        }
+    }
+
+    return 0;
+}
+
+static int
+testNodeDeviceIndex(const void *data ATTRIBUTE_UNUSED)
+{
+    virNodeDeviceObjList devs = { 0 };
+    virNodeDeviceObjPtr list[TEST_OBJS];
+    virNodeDeviceObjPtr dev;
+    char name[32];
+    char path[64];
+    size_t i;
+    int ret = -1;
+
+    /* As with udev, the first device has no sysfs path */
+    if (!(list[0] = testNodeDeviceNew(&devs, "computer", NULL)))
+        goto cleanup;
+
+    for (i = 1; i < TEST_OBJS; i++) {
+        snprintf(name, sizeof(name), "dev%zu", i);
+        snprintf(path, sizeof(path), "/sys/devices/dev%zu", i);
+        if (!(list[i] = testNodeDeviceNew(&devs, name, path)))
+            goto cleanup;
+    }
+
+    if (!virObjectIndexIsValid(&devs.index) ||
+        !virObjectIndexIsValid(&devs.pathIndex)) {
+        if (virTestGetVerbose())
+            fprintf(stderr, "node device index was not created\n");
+        goto cleanup;
+    }
+
+    if (testNodeDeviceCheck(&devs, "computer", NULL, list[0]) < 0)
+        goto cleanup;
+
+    for (i = 1; i < TEST_OBJS; i++) {
+        snprintf(name, sizeof(name), "dev%zu", i);
+        snprintf(path, sizeof(path), "/sys/devices/dev%zu", i);
+        if (testNodeDeviceCheck(&devs, name, path, list[i]) < 0)
+            goto cleanup;
+    }
+
+    /* A device sharing the path of dev1 gets it once dev1 is gone */
+    if (!(dev = testNodeDeviceNew(&devs, "dup", "/sys/devices/dev1")) ||
+        testNodeDeviceCheck(&devs, NULL, "/sys/devices/dev1", list[1]) < 0)
+        goto cleanup;
+
+    virNodeDeviceObjLock(list[1]);
+    virNodeDeviceObjRemove(&devs, list[1]);
+    if (testNodeDeviceCheck(&devs, "dev1", NULL, NULL) < 0 ||
+        testNodeDeviceCheck(&devs, "dup", "/sys/devices/dev1", dev) < 0)
+        goto cleanup;
+
+    /* Redefining a device with another path moves it in the index */
+    if (testNodeDeviceNew(&devs, "dev2", "/sys/devices/moved") != list[2] ||
+        testNodeDeviceCheck(&devs, NULL, "/sys/devices/dev2", NULL) < 0 ||
+        testNodeDeviceCheck(&devs, "dev2", "/sys/devices/moved", list[2]) < 0)
+        goto cleanup;
+
+    ret = 0;
+
+cleanup:
+    virNodeDeviceObjListFree(&devs);
+    return ret;
+}
+
+#define TEST_BENCH_OBJS 10000
+
+/* Resolve every network and filter by name and UUID the way the
+ * drivers do on each API call and filter instantiation */
+static int
+testLookupBench(const void *data ATTRIBUTE_UNUSED)
+{
+    virNetworkObjList nets = { 0 };
+    virNWFilterObjList nwfilters = { 0 };
+    virNetworkObjPtr net;
+    virNWFilterObjPtr nwfilter;
+    unsigned char uuid[VIR_UUID_BUFLEN];
+    char name[32];
+    unsigned long long start, end;
+    size_t i;
+    int ret = -1;
+
+    for (i = 0; i < TEST_BENCH_OBJS; i++) {
+        if (!testNetworkNew(&nets, i) ||
+            !testNWFilterNew(&nwfilters, i, i))
+            goto cleanup;
+    }
+
+    if (virTimeMillisNow(&start) < 0)
+        goto cleanup;
+
+    for (i = 0; i < TEST_BENCH_OBJS; i++) {
+        snprintf(name, sizeof(name), "net%zu", i);
+        if (!(net = virNetworkFindByName(&nets, name)))
+            goto cleanup;
+        virNetworkObjUnlock(net);
+
+        testMakeUUID(uuid, 'n', i);
+        if (!(net = virNetworkFindByUUID(&nets, uuid)))
+            goto cleanup;
+        virNetworkObjUnlock(net);
+
+        snprintf(name, sizeof(name), "filter%zu", i);
+        if (!(nwfilter = virNWFilterObjFindByName(&nwfilters, name)))
+            goto cleanup;
+        virNWFilterObjUnlock(nwfilter);
+
+        testMakeUUID(uuid, 'f', i);
+        if (!(nwfilter = virNWFilterObjFindByUUID(&nwfilters, uuid)))
+            goto cleanup;
+        virNWFilterObjUnlock(nwfilter);
+    }
+
+    if (virTimeMillisNow(&end) < 0)
+        goto cleanup;
+
+    if (virTestGetVerbose())
+        fprintf(stderr, "%d networks, %d filters, %.2f us per lookup ",
+                TEST_BENCH_OBJS, TEST_BENCH_OBJS,
+                (double) (end - start) * 1000 / (TEST_BENCH_OBJS * 4));
+
+    ret = 0;
+
+cleanup:
+    virNetworkObjListFree(&nets);
+    virNWFilterObjListFree(&nwfilters);
+    return ret;
+}
+
+static int
+mymain(void)
+{
+    int ret = 0;
+
+    if (virtTestRun("Network index", testNetworkIndex, NULL) < 0)
+        ret = -1;
+    if (virtTestRun("NWFilter index", testNWFilterIndex, NULL) < 0)
+        ret = -1;
+    if (virtTestRun("Interface index", testInterfaceIndex, NULL) < 0)
+        ret = -1;
+    if (virtTestRun("Node device index", testNodeDeviceIndex, NULL) < 0)
+        ret = -1;
+    if (virtTestRun("Network and filter lookup benchmark",
+                    testLookupBench, NULL) < 0)
+        ret = -1;
+
+    return ret == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+}
+
+VIRT_TEST_MAIN(mymain)
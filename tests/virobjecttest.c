@@ -0,0 +1,190 @@
+/*
+ * Copyright (C) 2014 Red Hat, Inc.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library.  If not, see
+ * <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#include <config.h>
+
+#include "testutils.h"
+#include "virobject.h"
+#include "viralloc.h"
+#include "virstring.h"
+
+#define VIR_FROM_THIS VIR_FROM_NONE
+
+typedef struct _virObjectTest virObjectTest;
+struct _virObjectTest {
+    virObject parent;
+    int value;
+    char *str;
+};
+
+static int disposed;
+
+static void
+virObjectTestDispose(void *obj)
+{
+    virObjectTest *test = obj;
+
+    VIR_FREE(test->str);
+    disposed++;
+}
+
+
+static int
+testObjectStatsCheck(const char *expect)
+{
+    virBuffer buf = VIR_BUFFER_INITIALIZER;
+    char *stats = NULL;
+    int ret = -1;
+
+    virObjectStatsFormat(&buf);
+    if (!(stats = virBufferContentAndReset(&buf)))
+        goto cleanup;
+
+    if (!strstr(stats, expect)) {
+        if (virTestGetDebug())
+            fprintf(stderr, "Missing '%s' in:\n%s", expect, stats);
+        goto cleanup;
+    }
+
+    ret = 0;
+
+cleanup:
+    VIR_FREE(stats);
+    return ret;
+}
+
+
+static int
+testObjectPool(const void *data ATTRIBUTE_UNUSED)
+{
+    virClassPtr klass;
+    virObjectTest *a = NULL;
+    virObjectTest *b = NULL;
+    virObjectTest *c = NULL;
+    void *old;
+    int ret = -1;
+
+    if (!(klass = virClassNewPooled(virClassForObject(),
+                                    "virObjectTestPooled",
+                                    sizeof(virObjectTest),
+                                    virObjectTestDispose,
+                                    1)))
+        return -1;
+
+    disposed = 0;
+    if (!(a = virObjectNew(klass)) ||
+        !(b = virObjectNew(klass)))
+        goto cleanup;
+
+    a->value = 42;
+    if (VIR_STRDUP(a->str, "test") < 0)
+        goto cleanup;
+
+    if (testObjectStatsCheck("virObjectTestPooled: live=2 allocated=2 "
+                             "reused=0 pooled=0/1\n") < 0)
+        goto cleanup;
+
+    /* Only one instance fits in the pool, the other one is freed */
+    old = a;
+    virObjectUnref(a);
+    a = NULL;
+    virObjectUnref(b);
+    b = NULL;
+    if (disposed != 2)
+        goto cleanup;
+
+    if (testObjectStatsCheck("virObjectTestPooled: live=0 allocated=2 "
+                             "reused=0 pooled=1/1\n") < 0)
+        goto cleanup;
+
+    /* The pooled instance must come back cleared */
+    if (!(c = virObjectNew(klass)))
+        goto cleanup;
+    if (c != old || c->value != 0 || c->str ||
+        !virObjectIsClass(c, klass)) {
+        if (virTestGetDebug())
+            fprintf(stderr, "Pooled instance not reused properly\n");
+        goto cleanup;
+    }
+
+    if (testObjectStatsCheck("virObjectTestPooled: live=1 allocated=3 "
+                             "reused=1 pooled=0/1\n") < 0)
+        goto cleanup;
+
+    ret = 0;
+
+cleanup:
+    virObjectUnref(a);
+    virObjectUnref(b);
+    virObjectUnref(c);
+    return ret;
+}
+
+
+static int
+testObjectStats(const void *data ATTRIBUTE_UNUSED)
+{
+    virClassPtr klass;
+    virObjectPtr objs[10] = { NULL };
+    size_t i;
+    int ret = -1;
+
+    if (!(klass = virClassNew(virClassForObject(),
+                              "virObjectTestPlain",
+                              sizeof(virObjectTest),
+                              virObjectTestDispose)))
+        return -1;
+
+    for (i = 0; i < ARRAY_CARDINALITY(objs); i++) {
+        if (!(objs[i] = virObjectNew(klass)))
+            goto cleanup;
+    }
+
+    for (i = 0; i < 4; i++) {
+        virObjectUnref(objs[i]);
+        objs[i] = NULL;
+    }
+
+    if (testObjectStatsCheck("virObjectTestPlain: live=6 allocated=10 "
+                             "reused=0 pooled=0/0\n") < 0)
+        goto cleanup;
+
+    ret = 0;
+
+cleanup:
+    for (i = 0; i < ARRAY_CARDINALITY(objs); i++)
+        virObjectUnref(objs[i]);
+    return ret;
+}
+
+
+static int
+mymain(void)
+{
+    int ret = 0;
+
+    if (virtTestRun("Object pool", testObjectPool, NULL) < 0)
+        ret = -1;
+    if (virtTestRun("Object stats", testObjectStats, NULL) < 0)
+        ret = -1;
+
+    return ret == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+}
+
+VIRT_TEST_MAIN(mymain)
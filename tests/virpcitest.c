@@ -164,6 +164,56 @@ cleanup:
     return ret;
 }
 
+static int
+testVirPCIDeviceListReset(const void *opaque ATTRIBUTE_UNUSED)
+{
+    int ret = -1;
+    /* Devices spread over three buses */
+    unsigned int addrs[][4] = {
+        { 0, 0, 1, 0 }, { 0, 0, 2, 0 }, { 0, 0, 3, 0 },
+        { 1, 1, 0, 0 }, { 1, 1, 0, 1 },
+        { 5, 0x90, 1, 0 }, { 5, 0x90, 1, 1 }, { 5, 0x90, 1, 2 },
+    };
+    size_t i, nDev = ARRAY_CARDINALITY(addrs);
+    virPCIDeviceListPtr devs = NULL;
+    virPCIDeviceListPtr activeDevs = NULL, inactiveDevs = NULL;
+    virPCIDevicePtr dev;
+    int count;
+
+    if (!(devs = virPCIDeviceListNew()) ||
+        !(activeDevs = virPCIDeviceListNew()) ||
+        !(inactiveDevs = virPCIDeviceListNew()))
+        goto cleanup;
+
+    for (i = 0; i < nDev; i++) {
+        if (!(dev = virPCIDeviceNew(addrs[i][0], addrs[i][1],
+                                    addrs[i][2], addrs[i][3])))
+            goto cleanup;
+
+        if (virPCIDeviceListAdd(devs, dev) < 0) {
+            virPCIDeviceFree(dev);
+            goto cleanup;
+        }
+
+        /* All of them are about to be assigned */
+        if (virPCIDeviceListAddCopy(inactiveDevs, dev) < 0)
+            goto cleanup;
+    }
+
+    if (virPCIDeviceListReset(devs, activeDevs, inactiveDevs) < 0)
+        goto cleanup;
+
+    CHECK_LIST_COUNT(devs, nDev);
+    CHECK_LIST_COUNT(activeDevs, 0);
+
+    ret = 0;
+cleanup:
+    virObjectUnref(devs);
+    virObjectUnref(activeDevs);
+    virObjectUnref(inactiveDevs);
+    return ret;
+}
+
 static int
 testVirPCIDeviceReattach(const void *opaque ATTRIBUTE_UNUSED)
 {
@@ -417,6 +467,7 @@ mymain(void)
     DO_TEST(testVirPCIDeviceNew);
     DO_TEST(testVirPCIDeviceDetach);
     DO_TEST(testVirPCIDeviceReset);
+    DO_TEST(testVirPCIDeviceListReset);
     DO_TEST(testVirPCIDeviceReattach);
     DO_TEST_PCI(testVirPCIDeviceIsAssignable, 5, 0x90, 1, 0);
     DO_TEST_PCI(testVirPCIDeviceIsAssignable, 1, 1, 0, 0);
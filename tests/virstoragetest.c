@@ -21,6 +21,8 @@
 #include <config.h>
 
 #include <stdlib.h>
+#include <fcntl.h>
+#include <sys/time.h>
 
 #include "testutils.h"
 #include "vircommand.h"
@@ -33,6 +35,7 @@
 #define VIR_FROM_THIS VIR_FROM_NONE
 
 #define datadir abs_builddir "/virstoragedata"
+#define cachedir abs_builddir "/virstoragecachedata"
 
 /* This test creates the following files, all in datadir:
 
@@ -57,6 +60,9 @@ static char *abswrap;
 static char *absqed;
 static char *abslink2;
 
+/* Shared by all chain tests, which rewrite images between tests */
+static virStorageFileMetadataCachePtr metaCache;
+
 static void
 testCleanupImages(void)
 {
@@ -226,35 +232,31 @@ struct testChainData
 };
 
 static int
-testStorageChain(const void *args)
+testStorageChainCheck(const struct testChainData *data,
+                      virStorageFileMetadataPtr meta)
 {
-    const struct testChainData *data = args;
-    int ret = -1;
-    virStorageFileMetadataPtr meta;
     virStorageFileMetadataPtr elt;
     size_t i = 0;
 
-    meta = virStorageFileGetMetadata(data->start, data->format, -1, -1,
-                                     (data->flags & ALLOW_PROBE) != 0);
     if (!meta) {
         if (data->flags & EXP_FAIL) {
             virResetLastError();
-            ret = 0;
+            return 0;
         }
-        goto cleanup;
+        return -1;
     } else if (data->flags & EXP_FAIL) {
         fprintf(stderr, "call should have failed\n");
-        goto cleanup;
+        return -1;
     }
     if (data->flags & EXP_WARN) {
         if (!virGetLastError()) {
             fprintf(stderr, "call should have warned\n");
-            goto cleanup;
+            return -1;
         }
         virResetLastError();
     } else if (virGetLastError()) {
         fprintf(stderr, "call should not have warned\n");
-        goto cleanup;
+        return -1;
     }
 
     elt = meta;
@@ -264,7 +266,7 @@ testStorageChain(const void *args)
 
         if (i == data->nfiles) {
             fprintf(stderr, "probed chain was too long\n");
-            goto cleanup;
+            return -1;
         }
 
         if (virAsprintf(&expect,
@@ -285,13 +287,13 @@ testStorageChain(const void *args)
                         elt->capacity, elt->encrypted) < 0) {
             VIR_FREE(expect);
             VIR_FREE(actual);
-            goto cleanup;
+            return -1;
         }
         if (STRNEQ(expect, actual)) {
             virtTestDifference(stderr, expect, actual);
             VIR_FREE(expect);
             VIR_FREE(actual);
-            goto cleanup;
+            return -1;
         }
         VIR_FREE(expect);
         VIR_FREE(actual);
@@ -300,12 +302,127 @@ testStorageChain(const void *args)
     }
     if (i != data->nfiles) {
         fprintf(stderr, "probed chain was too short\n");
+        return -1;
+    }
+
+    return 0;
+}
+
+static int
+testStorageChain(const void *args)
+{
+    const struct testChainData *data = args;
+    virStorageFileMetadataPtr meta;
+    size_t pass;
+
+    /* Probe directly, then twice through the cache, once filling it
+     * and once using what it remembers */
+    for (pass = 0; pass < 3; pass++) {
+        int rc;
+
+        if (pass == 0)
+            meta = virStorageFileGetMetadata(data->start, data->format,
+                                             -1, -1,
+                                             (data->flags & ALLOW_PROBE) != 0);
+        else
+            meta = virStorageFileGetMetadataCached(metaCache,
+                                                   data->start, data->format,
+                                                   -1, -1,
+                                                   (data->flags & ALLOW_PROBE) != 0);
+        rc = testStorageChainCheck(data, meta);
+        virStorageFileFreeMetadata(meta);
+        if (rc < 0) {
+            if (pass)
+                fprintf(stderr, "cached lookup %zu differs\n", pass);
+            return -1;
+        }
+    }
+
+    return 0;
+}
+
+/* Write a qcow2 v2 header of a 1024 byte image backed by BACKING,
+ * and make it look like it was last modified at MTIME */
+static int
+testWriteQcow2(const char *path, const char *backing, time_t mtime)
+{
+    struct timeval times[2] = { { mtime, 0 }, { mtime, 0 } };
+    char buf[512];
+    size_t len = strlen(backing);
+    int fd;
+
+    memset(buf, 0, sizeof(buf));
+    memcpy(buf, "QFI\xfb", 4);
+    buf[7] = 2;         /* version */
+    buf[15] = 72;       /* backing file offset */
+    buf[19] = len;      /* backing file size */
+    buf[30] = 1024 >> 8; /* image size */
+    memcpy(buf + 72, backing, len);
+
+    if ((fd = open(path, O_WRONLY | O_CREAT | O_TRUNC, 0600)) < 0)
+        return -1;
+    if (safewrite(fd, buf, sizeof(buf)) != sizeof(buf) ||
+        VIR_CLOSE(fd) < 0) {
+        VIR_FORCE_CLOSE(fd);
+        return -1;
+    }
+
+    return utimes(path, times);
+}
+
+static int
+testMetadataCache(const void *args ATTRIBUTE_UNUSED)
+{
+    virStorageFileMetadataCachePtr cache = NULL;
+    virStorageFileMetadataPtr meta = NULL;
+    /* The second lookup is served from the cache, even though the
+     * image changed behind its back without a new modification time */
+    const char *expect[] = { "base1", "base1", "base2", "base1" };
+    size_t i;
+    int ret = -1;
+
+    if (virFileMakePath(cachedir) < 0 ||
+        virFileWriteStr(cachedir "/base1", "", 0600) < 0 ||
+        virFileWriteStr(cachedir "/base2", "", 0600) < 0 ||
+        testWriteQcow2(cachedir "/top", "base1", 1000000000) < 0)
+        goto cleanup;
+
+    if (!(cache = virStorageFileMetadataCacheNew()))
         goto cleanup;
+
+    for (i = 0; i < ARRAY_CARDINALITY(expect); i++) {
+        if (i == 1 &&
+            testWriteQcow2(cachedir "/top", "base2", 1000000000) < 0)
+            goto cleanup;
+        if (i == 2)
+            virStorageFileMetadataCacheInvalidate(cache, cachedir "/top");
+        if (i == 3 &&
+            testWriteQcow2(cachedir "/top", "base1", 1000000001) < 0)
+            goto cleanup;
+
+        if (!(meta = virStorageFileGetMetadataCached(cache, cachedir "/top",
+                                                     VIR_STORAGE_FILE_QCOW2,
+                                                     -1, -1, false)))
+            goto cleanup;
+
+        if (STRNEQ_NULLABLE(meta->backingStoreRaw, expect[i]) ||
+            meta->capacity != 1024 ||
+            meta->backingStoreFormat != VIR_STORAGE_FILE_RAW ||
+            !meta->backingMeta || meta->backingMeta->backingMeta) {
+            fprintf(stderr, "lookup %zu: unexpected chain, backing '%s'\n",
+                    i, NULLSTR(meta->backingStoreRaw));
+            goto cleanup;
+        }
+        virStorageFileFreeMetadata(meta);
+        meta = NULL;
     }
 
     ret = 0;
+
 cleanup:
     virStorageFileFreeMetadata(meta);
+    virObjectUnref(cache);
+    virFileDeleteTree(cachedir);
     return ret;
 }
 
@@ -315,11 +432,17 @@ mymain(void)
     int ret;
     virCommandPtr cmd = NULL;
 
+    if (virtTestRun("Storage metadata cache", testMetadataCache, NULL) < 0)
+        return EXIT_FAILURE;
+
     /* Prep some files with qemu-img; if that is not found on PATH, or
      * if it lacks support for qcow2 and qed, skip this test.  */
     if ((ret = testPrepImages()) != 0)
         return ret;
 
+    if (!(metaCache = virStorageFileMetadataCacheNew()))
+        return EXIT_FAILURE;
+
 #define TEST_ONE_CHAIN(id, start, format, chain, flags)              \
     do {                                                             \
         struct testChainData data = {                                \
@@ -568,6 +691,7 @@ mymain(void)
     /* Final cleanup */
     testCleanupImages();
     virCommandFree(cmd);
+    virObjectUnref(metaCache);
 
     return ret == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
 }
@@ -621,6 +621,10 @@ static const vshCmdOptDef opts_vol_upload[] = {
      .type = VSH_OT_INT,
      .help = N_("amount of data to upload")
     },
+    {.name = "sparse",
+     .type = VSH_OT_BOOL,
+     .help = N_("preserve sparseness of the file")
+    },
     {.name = NULL}
 };
 
@@ -633,6 +637,55 @@ cmdVolUploadSource(virStreamPtr st ATTRIBUTE_UNUSED,
     return saferead(*fd, bytes, nbytes);
 }
 
+/* Like virStreamSendAll, but holes in @fd are skipped
+ * rather than sent as zeroes */
+static int
+vshVolUploadSparse(virStreamPtr st, int fd)
+{
+    char *buf = NULL;
+    size_t buflen = 64 * 1024;
+    unsigned long long section;
+    bool inData;
+    ssize_t got, done;
+    int sent;
+    int ret = -1;
+
+    if (VIR_ALLOC_N(buf, buflen) < 0)
+        return -1;
+
+    while (1) {
+        if (virFileInData(fd, &inData, &section) < 0)
+            goto cleanup;
+        if (section == 0)
+            break;
+
+        if (!inData) {
+            if (virStreamSendHole(st, section, 0) < 0 ||
+                lseek(fd, section, SEEK_CUR) < 0)
+                goto cleanup;
+            continue;
+        }
+
+        while (section) {
+            if ((got = saferead(fd, buf, MIN(buflen, section))) < 0)
+                goto cleanup;
+            if (got == 0)
+                break;
+            for (done = 0; done < got; done += sent) {
+                if ((sent = virStreamSend(st, buf + done, got - done)) < 0)
+                    goto cleanup;
+            }
+            section -= got;
+        }
+    }
+
+    ret = 0;
+
+cleanup:
+    VIR_FREE(buf);
+    return ret;
+}
+
 static bool
 cmdVolUpload(vshControl *ctl, const vshCmd *cmd)
 {
@@ -643,6 +696,8 @@ cmdVolUpload(vshControl *ctl, const vshCmd *cmd)
     virStreamPtr st = NULL;
     const char *name = NULL;
     unsigned long long offset = 0, length = 0;
+    unsigned int flags = 0;
+    bool sparse = vshCommandOptBool(cmd, "sparse");
 
     if (vshCommandOptULongLong(cmd, "offset", &offset) < 0) {
         vshError(ctl, _("Unable to parse integer"));
@@ -654,6 +709,9 @@ cmdVolUpload(vshControl *ctl, const vshCmd *cmd)
         return false;
     }
 
+    if (sparse)
+        flags |= VIR_STORAGE_VOL_UPLOAD_SPARSE_STREAM;
+
     if (!(vol = vshCommandOptVol(ctl, cmd, "vol", "pool", &name))) {
         return false;
     }
@@ -671,12 +729,18 @@ cmdVolUpload(vshControl *ctl, const vshCmd *cmd)
         goto cleanup;
     }
 
-    if (virStorageVolUpload(vol, st, offset, length, 0) < 0) {
+    if (virStorageVolUpload(vol, st, offset, length, flags) < 0) {
         vshError(ctl, _("cannot upload to volume %s"), name);
         goto cleanup;
     }
 
-    if (virStreamSendAll(st, cmdVolUploadSource, &fd) < 0) {
+    if (sparse) {
+        if (vshVolUploadSparse(st, fd) < 0) {
+            vshError(ctl, _("cannot send data to volume %s"), name);
+            virStreamAbort(st);
+            goto cleanup;
+        }
+    } else if (virStreamSendAll(st, cmdVolUploadSource, &fd) < 0) {
         vshError(ctl, _("cannot send data to volume %s"), name);
         goto cleanup;
     }
@@ -739,9 +803,51 @@ static const vshCmdOptDef opts_vol_download[] = {
      .type = VSH_OT_INT,
      .help = N_("amount of data to download")
     },
+    {.name = "sparse",
+     .type = VSH_OT_BOOL,
+     .help = N_("preserve sparseness of the volume")
+    },
     {.name = NULL}
 };
 
+/* Like virStreamRecvAll, but holes in the stream are
+ * punched into @fd rather than written as zeroes */
+static int
+vshVolDownloadSparse(virStreamPtr st, int fd)
+{
+    char *buf = NULL;
+    size_t buflen = 64 * 1024;
+    long long hole;
+    int got;
+    int ret = -1;
+
+    if (VIR_ALLOC_N(buf, buflen) < 0)
+        return -1;
+
+    while (1) {
+        got = virStreamRecvFlags(st, buf, buflen,
+                                 VIR_STREAM_RECV_STOP_AT_HOLE);
+        if (got == -3) {
+            if (virStreamRecvHole(st, &hole, 0) < 0 ||
+                virFileWriteHole(fd, hole) < 0)
+                goto cleanup;
+            continue;
+        }
+        if (got < 0)
+            goto cleanup;
+        if (got == 0)
+            break;
+        if (safewrite(fd, buf, got) < 0)
+            goto cleanup;
+    }
+
+    ret = 0;
+
+cleanup:
+    VIR_FREE(buf);
+    return ret;
+}
+
 static bool
 cmdVolDownload(vshControl *ctl, const vshCmd *cmd)
 {
@@ -753,6 +859,8 @@ cmdVolDownload(vshControl *ctl, const vshCmd *cmd)
     const char *name = NULL;
     unsigned long long offset = 0, length = 0;
     bool created = false;
+    unsigned int flags = 0;
+    bool sparse = vshCommandOptBool(cmd, "sparse");
 
     if (vshCommandOptULongLong(cmd, "offset", &offset) < 0) {
         vshError(ctl, _("Unable to parse integer"));
@@ -764,6 +872,9 @@ cmdVolDownload(vshControl *ctl, const vshCmd *cmd)
         return false;
     }
 
+    if (sparse)
+        flags |= VIR_STORAGE_VOL_DOWNLOAD_SPARSE_STREAM;
+
     if (!(vol = vshCommandOptVol(ctl, cmd, "vol", "pool", &name)))
         return false;
 
@@ -785,12 +896,18 @@ cmdVolDownload(vshControl *ctl, const vshCmd *cmd)
         goto cleanup;
     }
 
-    if (virStorageVolDownload(vol, st, offset, length, 0) < 0) {
+    if (virStorageVolDownload(vol, st, offset, length, flags) < 0) {
         vshError(ctl, _("cannot download from volume %s"), name);
         goto cleanup;
     }
 
-    if (virStreamRecvAll(st, vshStreamSink, &fd) < 0) {
+    if (sparse) {
+        if (vshVolDownloadSparse(st, fd) < 0) {
+            vshError(ctl, _("cannot receive data from volume %s"), name);
+            virStreamAbort(st);
+            goto cleanup;
+        }
+    } else if (virStreamRecvAll(st, vshStreamSink, &fd) < 0) {
         vshError(ctl, _("cannot receive data from volume %s"), name);
         goto cleanup;
     }